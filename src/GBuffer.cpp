@@ -11,7 +11,7 @@
 
 extern std::vector<std::string> defaultSearchPaths;
 
-void GBuffer::resize(nvvk::ResourceAllocatorDma* allocator, VkDevice device,
+void GBuffer::resize(nvvk::ResourceAllocator* allocator, VkDevice device,
                      uint32_t graphicsQueueIndex, VkExtent2D extent,
                      VkRenderPass& pass) {
   m_allocator          = allocator;
@@ -21,10 +21,7 @@ void GBuffer::resize(nvvk::ResourceAllocatorDma* allocator, VkDevice device,
   if (m_framebuffer != VK_NULL_HANDLE)
     vkDestroyFramebuffer(m_device, m_framebuffer, nullptr);
 
-  allocator->destroy(m_albedoTexture);
-  allocator->destroy(m_normalTexture);
-  allocator->destroy(m_materialPropertiesTexture);
-  allocator->destroy(m_worldPosTexture);
+  allocator->destroy(m_packedTexture);
 
   nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
   VkCommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
@@ -35,51 +32,17 @@ void GBuffer::resize(nvvk::ResourceAllocatorDma* allocator, VkDevice device,
   samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
 
   VkImageCreateInfo imageCreateInfo = nvvk::makeImage2DCreateInfo(
-      extent, VK_FORMAT_R32G32B32A32_SFLOAT,
+      extent, VK_FORMAT_R32G32B32A32_UINT,
       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
           VK_IMAGE_USAGE_STORAGE_BIT);
   {
     nvvk::Image image = allocator->createImage(imageCreateInfo);
     VkImageViewCreateInfo ivInfo =
         nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-    m_albedoTexture =
+    m_packedTexture =
         allocator->createTexture(image, ivInfo, samplerCreateInfo);
-    m_albedoTexture.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_albedoTexture.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
-  }
-  {
-    nvvk::Image image = allocator->createImage(imageCreateInfo);
-    VkImageViewCreateInfo ivInfo =
-        nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-    m_normalTexture =
-        allocator->createTexture(image, ivInfo, samplerCreateInfo);
-    m_normalTexture.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_normalTexture.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
-  }
-  {
-    nvvk::Image image = allocator->createImage(imageCreateInfo);
-    VkImageViewCreateInfo ivInfo =
-        nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-    m_materialPropertiesTexture =
-        allocator->createTexture(image, ivInfo, samplerCreateInfo);
-    m_materialPropertiesTexture.descriptor.imageLayout =
-        VK_IMAGE_LAYOUT_GENERAL;
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_materialPropertiesTexture.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
-  }
-  {
-    nvvk::Image image = allocator->createImage(imageCreateInfo);
-    VkImageViewCreateInfo ivInfo =
-        nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-    m_worldPosTexture =
-        allocator->createTexture(image, ivInfo, samplerCreateInfo);
-    m_worldPosTexture.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_worldPosTexture.image,
+    m_packedTexture.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_packedTexture.image,
                                 VK_IMAGE_LAYOUT_UNDEFINED,
                                 VK_IMAGE_LAYOUT_GENERAL);
   }
@@ -90,16 +53,7 @@ void GBuffer::resize(nvvk::ResourceAllocatorDma* allocator, VkDevice device,
 void GBuffer::transitionLayout() {
   {
     nvvk::ScopeCommandBuffer cmdBuf(m_device, m_graphicsQueueIndex);
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_albedoTexture.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_normalTexture.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_materialPropertiesTexture.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_worldPosTexture.image,
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_packedTexture.image,
                                 VK_IMAGE_LAYOUT_UNDEFINED,
                                 VK_IMAGE_LAYOUT_GENERAL);
   }
@@ -109,8 +63,5 @@ void GBuffer::transitionLayout() {
 void GBuffer::destroy() {
   if (m_framebuffer != VK_NULL_HANDLE)
     vkDestroyFramebuffer(m_device, m_framebuffer, nullptr);
-  m_allocator->destroy(m_albedoTexture);
-  m_allocator->destroy(m_normalTexture);
-  m_allocator->destroy(m_materialPropertiesTexture);
-  m_allocator->destroy(m_worldPosTexture);
+  m_allocator->destroy(m_packedTexture);
 }
\ No newline at end of file
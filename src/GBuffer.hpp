@@ -1,31 +1,24 @@
 #include "utils/restir_utils.h"
 
+// One rgba32ui texel per pixel holding depth, normal, albedo and material
+// properties, see `shaders/headers/gbuffer.glsl`
 class GBuffer {
 public:
   GBuffer(){};
   [[nodiscard]] VkFramebuffer getFramebuffer() const { return m_framebuffer; }
 
-  [[nodiscard]] nvvk::Texture getAlbedoTexture() const {
-    return m_albedoTexture;
-  }
-  [[nodiscard]] nvvk::Texture getNormalTexture() const {
-    return m_normalTexture;
-  }
-  [[nodiscard]] nvvk::Texture getMaterialPropertiesTexture() const {
-    return m_materialPropertiesTexture;
-  }
-  [[nodiscard]] nvvk::Texture getWorldPosTexture() const {
-    return m_worldPosTexture;
+  [[nodiscard]] nvvk::Texture getPackedTexture() const {
+    return m_packedTexture;
   }
 
   void transitionLayout();
 
-  void resize(nvvk::ResourceAllocatorDma* allocator, VkDevice device,
+  void resize(nvvk::ResourceAllocator* allocator, VkDevice device,
               uint32_t graphicsQueueIndex, VkExtent2D extent,
               VkRenderPass& pass);
 
-  [[nodiscard]] void create(nvvk::ResourceAllocatorDma* allocator,
-                            VkDevice device, uint32_t graphicsQueueIndex,
+  [[nodiscard]] void create(nvvk::ResourceAllocator* allocator, VkDevice device,
+                            uint32_t graphicsQueueIndex,
                             VkExtent2D bufferExtent, VkRenderPass& pass) {
     resize(allocator, device, graphicsQueueIndex, bufferExtent, pass);
   }
@@ -35,12 +28,9 @@ public:
 private:
   VkDevice m_device;
   uint32_t m_graphicsQueueIndex;
-  nvvk::ResourceAllocatorDma* m_allocator;
+  nvvk::ResourceAllocator* m_allocator;
 
-  nvvk::Texture m_albedoTexture;
-  nvvk::Texture m_normalTexture;
-  nvvk::Texture m_materialPropertiesTexture;
-  nvvk::Texture m_worldPosTexture;
+  nvvk::Texture m_packedTexture;
 
   VkFramebuffer m_framebuffer{VK_NULL_HANDLE};
 };
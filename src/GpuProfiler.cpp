@@ -0,0 +1,125 @@
+#include "GpuProfiler.hpp"
+
+#include "spdlog/spdlog.h"
+
+GpuProfiler& GpuProfiler::global() {
+  static GpuProfiler profiler;
+  return profiler;
+}
+
+void GpuProfiler::setup(VkDevice device, VkPhysicalDevice physicalDevice,
+                        uint32_t queueFamilyIndex, uint32_t frames,
+                        uint32_t maxScopes) {
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                           families.data());
+  m_validBits = families[queueFamilyIndex].timestampValidBits;
+  if (m_validBits == 0) {
+    spdlog::warn("Queue family {} has no timestamps, not profiling the device",
+                 queueFamilyIndex);
+    return;
+  }
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_timestampPeriod = properties.limits.timestampPeriod;
+
+  m_device    = device;
+  m_maxScopes = maxScopes;
+  m_frames.assign(frames, Frame{});
+
+  // a begin and an end timestamp per scope
+  VkQueryPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  poolInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = frames * maxScopes * 2;
+  vkCreateQueryPool(m_device, &poolInfo, nullptr, &m_queryPool);
+
+  spdlog::info("Profiling the device with up to {} scopes per frame",
+               maxScopes);
+}
+
+void GpuProfiler::beginFrame(const VkCommandBuffer& cmdBuf, uint32_t slot) {
+  if (m_queryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  collect(slot);
+
+  m_slot  = slot;
+  m_depth = 0;
+  m_frames[slot].scopes.clear();
+  m_frames[slot].hostStart = Profiler::global().now();
+  vkCmdResetQueryPool(cmdBuf, m_queryPool, slot * m_maxScopes * 2,
+                      m_maxScopes * 2);
+}
+
+uint32_t GpuProfiler::begin(const VkCommandBuffer& cmdBuf, const char* name) {
+  if (m_queryPool == VK_NULL_HANDLE ||
+      m_frames[m_slot].scopes.size() >= m_maxScopes) {
+    return kNoScope;
+  }
+  std::vector<Scope>& scopes = m_frames[m_slot].scopes;
+  const uint32_t scope       = static_cast<uint32_t>(scopes.size());
+  scopes.push_back({name, m_depth++});
+  vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool,
+                      (m_slot * m_maxScopes + scope) * 2);
+  return scope;
+}
+
+void GpuProfiler::end(const VkCommandBuffer& cmdBuf, uint32_t scope) {
+  if (scope == kNoScope) {
+    return;
+  }
+  --m_depth;
+  vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      m_queryPool, (m_slot * m_maxScopes + scope) * 2 + 1);
+}
+
+void GpuProfiler::collectAll() {
+  for (uint32_t slot = 0; slot < m_frames.size(); ++slot) {
+    collect(slot);
+    m_frames[slot].scopes.clear();
+  }
+}
+
+void GpuProfiler::collect(uint32_t slot) {
+  const std::vector<Scope>& scopes = m_frames[slot].scopes;
+  if (scopes.empty()) {
+    return;
+  }
+  // value and availability of each query
+  const uint32_t queries = static_cast<uint32_t>(scopes.size()) * 2;
+  std::vector<uint64_t> results(queries * 2);
+  vkGetQueryPoolResults(
+      m_device, m_queryPool, slot * m_maxScopes * 2, queries,
+      results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+  const uint64_t origin = results[0];
+  if (results[1] == 0) {
+    return;
+  }
+  for (size_t i = 0; i < scopes.size(); ++i) {
+    // begin and end, each followed by its availability
+    const uint64_t* scope = &results[i * 4];
+    if (scope[1] == 0 || scope[3] == 0) {
+      continue;
+    }
+    Profiler::global().record(
+        {scopes[i].name, Profiler::kGpuTrack, scopes[i].depth,
+         m_frames[slot].hostStart + timestampMicroseconds(origin, scope[0],
+                                                          m_validBits,
+                                                          m_timestampPeriod),
+         timestampMicroseconds(scope[0], scope[2], m_validBits,
+                               m_timestampPeriod)});
+  }
+}
+
+void GpuProfiler::destroy() {
+  if (m_queryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+  }
+  m_queryPool = VK_NULL_HANDLE;
+  m_frames.clear();
+}
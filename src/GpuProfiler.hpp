@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <vector>
+
+#include "utils/profiler.hpp"
+
+// Times scopes of the command buffers with timestamp queries, one range of
+// queries per frame in flight. The results of a frame are read when its slot
+// is recorded again, after the host waited for it, and recorded on the device
+// track of `Profiler::global()`. The device clock is anchored at the host
+// time the frame was recorded, so the device scopes of a frame are placed
+// relative to its first timestamp rather than on a calibrated timeline.
+class GpuProfiler {
+public:
+  static constexpr uint32_t kDefaultMaxScopes = 32;  // per frame
+  static constexpr uint32_t kNoScope          = ~0u;
+
+  static GpuProfiler& global();
+
+  /// No-op when the queue family has no timestamps
+  void setup(VkDevice device, VkPhysicalDevice physicalDevice,
+             uint32_t queueFamilyIndex, uint32_t frames,
+             uint32_t maxScopes = kDefaultMaxScopes);
+
+  /// Records the last results of `slot` and resets its queries, outside of
+  /// a render pass
+  void beginFrame(const VkCommandBuffer& cmdBuf, uint32_t slot);
+
+  /// Index of the scope, kNoScope when out of queries
+  uint32_t begin(const VkCommandBuffer& cmdBuf, const char* name);
+  void end(const VkCommandBuffer& cmdBuf, uint32_t scope);
+
+  /// Records the results of every frame and forgets them, once the device
+  /// is idle
+  void collectAll();
+
+  void destroy();
+
+private:
+  struct Scope {
+    const char* name;
+    uint32_t depth;
+  };
+
+  struct Frame {
+    std::vector<Scope> scopes;
+    double hostStart = 0.0;  // Profiler::global() time it was recorded
+  };
+
+  void collect(uint32_t slot);
+
+  VkDevice m_device{VK_NULL_HANDLE};
+  VkQueryPool m_queryPool{VK_NULL_HANDLE};
+  uint32_t m_validBits{0};
+  float m_timestampPeriod{1.f};  // nanoseconds per tick
+  uint32_t m_maxScopes{0};
+
+  std::vector<Frame> m_frames;
+  uint32_t m_slot{0};   // being recorded
+  uint32_t m_depth{0};  // of its open scopes
+};
+
+// Times its lifetime on the device
+class GpuProfileScope {
+public:
+  GpuProfileScope(const VkCommandBuffer& cmdBuf, const char* name)
+      : m_cmdBuf(cmdBuf), m_scope(GpuProfiler::global().begin(cmdBuf, name)) {}
+  ~GpuProfileScope() { GpuProfiler::global().end(m_cmdBuf, m_scope); }
+  GpuProfileScope(const GpuProfileScope&) = delete;
+  GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+  VkCommandBuffer m_cmdBuf;
+  uint32_t m_scope;
+};
+
+#ifdef USE_PROFILER
+#define PROFILE_GPU_SCOPE(cmdBuf, name)                              \
+  const GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)( \
+      cmdBuf, name)
+#else
+#define PROFILE_GPU_SCOPE(cmdBuf, name)
+#endif
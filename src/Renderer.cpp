@@ -17,11 +17,16 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
 #include <sstream>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <random>
 
+#include "GpuProfiler.hpp"
 #include "Renderer.h"
 #include "SingletonManager.hpp"
 #include "config/static_config.hpp"
@@ -38,7 +43,12 @@
 #include "obj_loader.h"
 #include "stb_image.h"
 #include "utils/logging.hpp"
+#include "utils/parallel.hpp"
+#include "utils/pipeline_cache.hpp"
+#include "utils/restir_frame.hpp"
 #include "utils/shader_functions.hpp"
+#include "utils/transient_allocator.hpp"
+#include "utils/upsampling.hpp"
 
 extern std::vector<std::string> defaultSearchPaths;
 
@@ -79,21 +89,292 @@ VkSamplerCreateInfo gltfSamplerToVulkan(tinygltf::Sampler& tSampler) {
   samplerCreateInfo.maxLod = FLT_MAX;
   return samplerCreateInfo;
 }
+
+// the BLAS of the volume chunks are refit by the animation
+constexpr VkBuildAccelerationStructureFlagsKHR kVolumeBlasFlags =
+    VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR |
+    VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+// volume chunks built at once when loading, more if more of them move
+constexpr uint32_t kVolumeBuildBatch = 16;
+
+// Host cached memory for the headless readback when the device has it, the
+// frames are read by the CPU; plain host visible memory otherwise
+VkMemoryPropertyFlags readbackMemoryFlags(VkPhysicalDevice physicalDevice) {
+  const VkMemoryPropertyFlags coherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  const VkMemoryPropertyFlags cached =
+      coherent | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+  for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+    if ((properties.memoryTypes[i].propertyFlags & cached) == cached) {
+      return cached;
+    }
+  }
+  spdlog::info("No host cached memory, reading back uncached frames");
+  return coherent;
+}
 }  // namespace
 
 //--------------------------------------------------------------------------------------------------
 // Keep the handle on the device
-// Initialize the tool to do all our allocations: buffers, images
+// Initialize the tool to do all our allocations: buffers, images, in the
+// device memory of TlsfMemAllocator under the budget of the device
 //
 void Renderer::setup(const VkInstance& instance, const VkDevice& device,
                      const VkPhysicalDevice& physicalDevice,
                      uint32_t queueFamily) {
   AppBaseVk::setup(instance, device, physicalDevice, queueFamily);
-  m_alloc.init(instance, device, physicalDevice);
+  m_memAlloc.init(device, physicalDevice, m_hasMemoryBudget);
+  m_alloc.init(device, physicalDevice, &m_memAlloc);
   m_debug.setup(m_device);
   m_offscreenDepthFormat = nvvk::findDepthFormat(physicalDevice);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Replaces the empty pipeline cache of AppBaseVk with the one of the previous
+// runs on this device and driver, written back to `filename` by
+// `destroyResources`
+//
+void Renderer::createPipelineCache(const std::string& filename) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+  PipelineCacheDevice device{properties.vendorID, properties.deviceID, {}};
+  std::copy(std::begin(properties.pipelineCacheUUID),
+            std::end(properties.pipelineCacheUUID),
+            device.pipelineCacheUUID.begin());
+
+  const std::optional<std::vector<uint8_t>> data =
+      loadPipelineCache(filename, device);
+  VkPipelineCacheCreateInfo createInfo{
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+  if (data) {
+    createInfo.initialDataSize = data->size();
+    createInfo.pInitialData    = data->data();
+    spdlog::info("Loaded pipeline cache of {} KiB from {}", data->size() >> 10,
+                 filename);
+  }
+  vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+  vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_pipelineCache);
+  m_pipelineCacheFile = filename;
+}
+
+void Renderer::savePipelineCache() const {
+  size_t size = 0;
+  vkGetPipelineCacheData(m_device, m_pipelineCache, &size, nullptr);
+  std::vector<uint8_t> data(size);
+  vkGetPipelineCacheData(m_device, m_pipelineCache, &size, data.data());
+  data.resize(size);
+  if (::savePipelineCache(m_pipelineCacheFile, data)) {
+    spdlog::info("Saved pipeline cache of {} KiB to {}", size >> 10,
+                 m_pipelineCacheFile);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Instead of `createSwapchain` when rendering without a window: the post
+// render pass then draws into a float image that is read back
+//
+void Renderer::setupHeadless(uint32_t width, uint32_t height) {
+  m_size        = VkExtent2D{width, height};
+  m_colorFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+  // as createSwapchain picks it
+  const VkFormatFeatureFlags feature =
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  for (const VkFormat format :
+       {VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+        VK_FORMAT_D16_UNORM_S8_UINT}) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+    if ((properties.optimalTilingFeatures & feature) == feature) {
+      m_depthFormat = format;
+      break;
+    }
+  }
+  CameraManip.setWindowSize(width, height);
+  m_headless = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The post render pass of AppBaseVk ends in the present layout; without a
+// swapchain it ends where endHeadlessFrame copies the color target from
+//
+void Renderer::createRenderPass() {
+  if (!m_headless) {
+    AppBaseVk::createRenderPass();
+    return;
+  }
+  if (m_renderPass) {
+    vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+  }
+  m_renderPass = nvvk::createRenderPass(
+      m_device, {m_colorFormat}, m_depthFormat, 1, true, true,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+  m_debug.setObjectName(m_renderPass, "Headless post");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Color target of the post render pass, and per readback slot a command
+// buffer, its fence and a host buffer the frame is copied to
+//
+void Renderer::createHeadlessTargets(uint32_t slots) {
+  const VkImageCreateInfo colorCreateInfo = nvvk::makeImage2DCreateInfo(
+      m_size, m_colorFormat,
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+  nvvk::Image image = m_alloc.createImage(colorCreateInfo);
+  const VkImageViewCreateInfo ivInfo =
+      nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
+  m_headlessColor = m_alloc.createTexture(image, ivInfo);
+  m_debug.setObjectName(m_headlessColor.image, "Headless color");
+
+  const std::array<VkImageView, 2> attachments = {
+      m_headlessColor.descriptor.imageView, m_depthView};
+  VkFramebufferCreateInfo info{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+  info.renderPass      = m_renderPass;
+  info.attachmentCount = static_cast<uint32_t>(attachments.size());
+  info.pAttachments    = attachments.data();
+  info.width           = m_size.width;
+  info.height          = m_size.height;
+  info.layers          = 1;
+  vkCreateFramebuffer(m_device, &info, nullptr, &m_headlessFramebuffer);
+
+  VkCommandBufferAllocateInfo allocateInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  allocateInfo.commandPool        = m_cmdPool;
+  allocateInfo.commandBufferCount = slots;
+  allocateInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  m_headlessCmdBufs.resize(slots);
+  vkAllocateCommandBuffers(m_device, &allocateInfo, m_headlessCmdBufs.data());
+
+  const VkDeviceSize size =
+      VkDeviceSize(m_size.width) * m_size.height * 4 * sizeof(float);
+  m_headlessFences.resize(slots);
+  m_readbackBuffers.resize(slots);
+  m_readbackData.resize(slots);
+  const VkMemoryPropertyFlags readbackFlags =
+      readbackMemoryFlags(m_physicalDevice);
+  for (uint32_t slot = 0; slot < slots; ++slot) {
+    VkFenceCreateInfo fenceCreateInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    vkCreateFence(m_device, &fenceCreateInfo, nullptr,
+                  &m_headlessFences[slot]);
+    m_readbackBuffers[slot] = m_alloc.createBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackFlags);
+    // mapped once, the worker thread reading it must not use the allocator
+    m_readbackData[slot] =
+        static_cast<const float*>(m_alloc.map(m_readbackBuffers[slot]));
+  }
+}
+
+VkCommandBuffer Renderer::beginHeadlessFrame(uint32_t slot) {
+  // the previous frame of the slot was read back, see readHeadlessFrame
+  vkResetFences(m_device, 1, &m_headlessFences[slot]);
+  const VkCommandBuffer cmdBuf = m_headlessCmdBufs[slot];
+  VkCommandBufferBeginInfo beginInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cmdBuf, &beginInfo);
+  return cmdBuf;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Copies the color target into the buffer of `slot` after the post render
+// pass, which leaves it in the transfer source layout, and submits the frame
+//
+void Renderer::endHeadlessFrame(uint32_t slot) {
+  const VkCommandBuffer cmdBuf = m_headlessCmdBufs[slot];
+  // no layout change, only the attachment writes made visible to the copy
+  VkImageMemoryBarrier toTransfer{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  toTransfer.srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  toTransfer.dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
+  toTransfer.oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  toTransfer.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.image               = m_headlessColor.image;
+  toTransfer.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &toTransfer);
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent      = {m_size.width, m_size.height, 1};
+  vkCmdCopyImageToBuffer(cmdBuf, m_headlessColor.image,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         m_readbackBuffers[slot].buffer, 1, &region);
+  VkBufferMemoryBarrier toHost{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+  toHost.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toHost.dstAccessMask       = VK_ACCESS_HOST_READ_BIT;
+  toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.buffer              = m_readbackBuffers[slot].buffer;
+  toHost.size                = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost,
+                       0, nullptr);
+  vkEndCommandBuffer(cmdBuf);
+
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &cmdBuf;
+  vkQueueSubmit(m_queue, 1, &submitInfo, m_headlessFences[slot]);
+}
+
+// on the worker thread of runBatchRender
+void Renderer::readHeadlessFrame(uint32_t slot, BatchImage& image) const {
+  vkWaitForFences(m_device, 1, &m_headlessFences[slot], VK_TRUE, UINT64_MAX);
+  image.width  = m_size.width;
+  image.height = m_size.height;
+  image.rgba.assign(m_readbackData[slot],
+                    m_readbackData[slot] + size_t(m_size.width) *
+                                               m_size.height * 4);
+}
+
+//--------------------------------------------------------------------------------------------------
+// A fence per frame slot, signaled after the last frame of the slot
+//
+void Renderer::createFrameFences() {
+  m_frameFences.resize(m_frameRing.slots());
+  for (VkFence& fence : m_frameFences) {
+    VkFenceCreateInfo fenceCreateInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    vkCreateFence(m_device, &fenceCreateInfo, nullptr, &fence);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Moves to the next frame slot before its uniforms are written, waiting for
+// the frame that used it last when it is still in flight
+//
+uint32_t Renderer::beginFrameSlot() {
+  return m_frameRing.begin([&](uint32_t slot) {
+    vkWaitForFences(m_device, 1, &m_frameFences[slot], VK_TRUE, UINT64_MAX);
+    vkResetFences(m_device, 1, &m_frameFences[slot]);
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+// After the frame of the slot was submitted: an empty submission signals the
+// fence of the slot once the frame and everything before it completed
+//
+void Renderer::endFrameSlot() {
+  vkQueueSubmit(m_queue, 0, nullptr, m_frameFences[m_frameRing.current()]);
+  m_frameRing.end();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Scene uploads go through the transfer queue, the graphics one when there is
+// no dedicated transfer queue
+//
+void Renderer::setupUploads(const VkQueue& transferQueue,
+                            uint32_t transferQueueIndex) {
+  if (transferQueue == VK_NULL_HANDLE) {
+    m_uploader.setup(m_device, &m_alloc, m_queue, m_graphicsQueueIndex,
+                     m_queue, m_graphicsQueueIndex);
+    return;
+  }
+  m_uploader.setup(m_device, &m_alloc, transferQueue, transferQueueIndex,
+                   m_queue, m_graphicsQueueIndex);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Create GBuffers for ReSTIR
 //
@@ -111,10 +392,10 @@ void Renderer::updateGBufferFrameIdx() {
 }
 
 //--------------------------------------------------------------------------------------------------
-// Called at each frame to update the camera matrix
+// Called at each frame to update the camera matrix, in the buffer of the
+// current frame slot that no frame in flight reads
 //
-void Renderer::updateUniformBuffer(const VkCommandBuffer& cmdBuf) {
-  // Prepare new UBO contents on host.
+void Renderer::updateUniformBuffer() {
   const float aspectRatio = m_size.width / static_cast<float>(m_size.height);
   GlobalUniforms hostUBO  = {};
   const auto& view        = CameraManip.getMatrix();
@@ -127,37 +408,8 @@ void Renderer::updateUniformBuffer(const VkCommandBuffer& cmdBuf) {
   hostUBO.viewInverse = nvmath::invert(view);
   hostUBO.projInverse = nvmath::invert(proj);
 
-  // UBO on the device, and what stages access it.
-  VkBuffer deviceUBO  = m_bGlobals.buffer;
-  auto uboUsageStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
-                        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
-
-  // Ensure that the modified UBO is not visible to previous frames.
-  VkBufferMemoryBarrier beforeBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
-  beforeBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  beforeBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  beforeBarrier.buffer        = deviceUBO;
-  beforeBarrier.offset        = 0;
-  beforeBarrier.size          = sizeof(hostUBO);
-  vkCmdPipelineBarrier(cmdBuf, uboUsageStages, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                       VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 1,
-                       &beforeBarrier, 0, nullptr);
-
-  // Schedule the host-to-device upload. (hostUBO is copied into the cmd
-  // buffer so it is okay to deallocate when the function returns).
-  vkCmdUpdateBuffer(cmdBuf, m_bGlobals.buffer, 0, sizeof(GlobalUniforms),
-                    &hostUBO);
-
-  // Making sure the updated UBO will be visible.
-  VkBufferMemoryBarrier afterBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
-  afterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  afterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  afterBarrier.buffer        = deviceUBO;
-  afterBarrier.offset        = 0;
-  afterBarrier.size          = sizeof(hostUBO);
-  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, uboUsageStages,
-                       VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 1,
-                       &afterBarrier, 0, nullptr);
+  // host coherent, visible to the frame once it is submitted
+  *m_globalsData[m_frameRing.current()] = hostUBO;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -228,27 +480,39 @@ void Renderer::createDescriptorSetLayout() {
 #endif
 
   m_descSetLayout = m_descSetLayoutBind.createLayout(m_device);
-  m_descPool      = m_descSetLayoutBind.createPool(m_device, 1);
-  m_descSet =
-      nvvk::allocateDescriptorSet(m_device, m_descPool, m_descSetLayout);
+  m_descPool = m_descSetLayoutBind.createPool(m_device, m_frameRing.slots());
+  nvvk::allocateDescriptorSets(m_device, m_descPool, m_descSetLayout,
+                               m_frameRing.slots(), m_descSets);
   spdlog::info("Created global descriptor set layout");
 }
 
 //--------------------------------------------------------------------------------------------------
-// Setting up the buffers in the descriptor set
+// Setting up the buffers in the descriptor set of every frame slot
 //
 void Renderer::updateDescriptorSet() {
+  for (uint32_t slot = 0; slot < m_frameRing.slots(); ++slot) {
+    updateDescriptorSet(slot);
+  }
+  spdlog::info("Updated global descriptor set");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Setting up the buffers in the descriptor set of one frame slot; only the
+// camera matrices differ between the slots
+//
+void Renderer::updateDescriptorSet(uint32_t slot) {
   std::vector<VkWriteDescriptorSet> writes;
+  const VkDescriptorSet descSet = m_descSets[slot];
 
-  // Camera matrices and scene description
-  VkDescriptorBufferInfo dbiUnif{m_bGlobals.buffer, 0, VK_WHOLE_SIZE};
+  // Camera matrices of the slot and scene description
+  VkDescriptorBufferInfo dbiUnif{m_bGlobals[slot].buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(m_descSetLayoutBind.makeWrite(
-      m_descSet, SceneBindings::eGlobals, &dbiUnif));
+      descSet, SceneBindings::eGlobals, &dbiUnif));
 
 #ifndef USE_GLTF
   VkDescriptorBufferInfo dbiSceneDesc{m_bObjDesc.buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(m_descSetLayoutBind.makeWrite(
-      m_descSet, SceneBindings::eObjDescs, &dbiSceneDesc));
+      descSet, SceneBindings::eObjDescs, &dbiSceneDesc));
 
   // All OBJ texture samplers
   std::vector<VkDescriptorImageInfo> diit;
@@ -256,19 +520,19 @@ void Renderer::updateDescriptorSet() {
     diit.emplace_back(texture.descriptor);
   }
   writes.emplace_back(m_descSetLayoutBind.makeWriteArray(
-      m_descSet, SceneBindings::eTextures, diit.data()));
+      descSet, SceneBindings::eTextures, diit.data()));
 #endif
 
   // spheres
   VkDescriptorBufferInfo dbiSpheres{m_spheresBuffer.buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(
-      m_descSetLayoutBind.makeWrite(m_descSet, eImplicit, &dbiSpheres));
+      m_descSetLayoutBind.makeWrite(descSet, eImplicit, &dbiSpheres));
 
   VkDescriptorBufferInfo spherematInfo{m_sphereMaterialsBuffer.buffer, 0,
                                        VK_WHOLE_SIZE};
 
   writes.emplace_back(m_descSetLayoutBind.makeWrite(
-      m_descSet, SceneBindings::eSphereMaterial, &spherematInfo));
+      descSet, SceneBindings::eSphereMaterial, &spherematInfo));
 
 #ifdef USE_GLTF
   // GLTF stuff
@@ -284,23 +548,23 @@ void Renderer::updateDescriptorSet() {
     VkDescriptorBufferInfo colInfo{m_gltfColors.buffer, 0, VK_WHOLE_SIZE};
 
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFPrimLookup, &primInfo));
+        descSet, SceneBindings::eGLTFPrimLookup, &primInfo));
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFVertices, &verInfo));
+        descSet, SceneBindings::eGLTFVertices, &verInfo));
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFNormals, &norInfo));
+        descSet, SceneBindings::eGLTFNormals, &norInfo));
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFTexcoords, &texInfo));
+        descSet, SceneBindings::eGLTFTexcoords, &texInfo));
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFIndices, &idxInfo));
+        descSet, SceneBindings::eGLTFIndices, &idxInfo));
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFMaterials, &mateInfo));
+        descSet, SceneBindings::eGLTFMaterials, &mateInfo));
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFMatrices, &mtxInfo));
+        descSet, SceneBindings::eGLTFMatrices, &mtxInfo));
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFTangents, &tanInfo));
+        descSet, SceneBindings::eGLTFTangents, &tanInfo));
     writes.emplace_back(m_descSetLayoutBind.makeWrite(
-        m_descSet, SceneBindings::eGLTFColors, &colInfo));
+        descSet, SceneBindings::eGLTFColors, &colInfo));
   }
 
   // All GLTF texture samplers
@@ -309,13 +573,12 @@ void Renderer::updateDescriptorSet() {
     diit.emplace_back(texture.descriptor);
   }
   writes.emplace_back(m_descSetLayoutBind.makeWriteArray(
-      m_descSet, SceneBindings::eGLTFTextures, diit.data()));
+      descSet, SceneBindings::eGLTFTextures, diit.data()));
 #endif
 
   // Writing the information
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()),
                          writes.data(), 0, nullptr);
-  spdlog::info("Updated global descriptor set");
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -356,7 +619,7 @@ void Renderer::createGraphicsPipeline() {
        static_cast<uint32_t>(offsetof(VertexObj, texCoord))},
   });
 
-  m_graphicsPipeline = gpb.createPipeline();
+  m_graphicsPipeline = gpb.createPipeline(m_pipelineCache);
   m_debug.setObjectName(m_graphicsPipeline, "Graphics");
   spdlog::info("Created Graphics Pipeline");
 }
@@ -364,57 +627,16 @@ void Renderer::createGraphicsPipeline() {
 void Renderer::loadGLTFModel(const std::string& filename) {
   spdlog::info("Loading GLTF Model...");
   SingletonManager::GetGLTFLoader().loadScene(filename);
-  nvh::GltfScene gltfScene = SingletonManager::GetGLTFLoader().getGLTFScene();
+  const nvh::GltfScene& gltfScene =
+      SingletonManager::GetGLTFLoader().getGLTFScene();
 
   // ---------- Collect point lights ----------
-  m_pointLights.reserve(gltfScene.m_lights.size());
-  for (const nvh::GltfLight& light : gltfScene.m_lights) {
-    PointLight& addedLight = m_pointLights.emplace_back(
-        PointLight{light.worldMatrix.col(3),
-                   nvmath::vec4f(light.light.color[0], light.light.color[1],
-                                 light.light.color[2], 0.0f)});
-    addedLight.emission_luminance.w = shader::luminance(
-        addedLight.emission_luminance.x, addedLight.emission_luminance.y,
-        addedLight.emission_luminance.z);
-  }
+  m_pointLights = collectPointLights(gltfScene);
   spdlog::info("Collected GLTF point lights of size: {}", m_pointLights.size());
 
   // ---------- Collect Triangle Lights ----------
-  for (const nvh::GltfNode& node : gltfScene.m_nodes) {
-    const nvh::GltfPrimMesh& mesh = gltfScene.m_primMeshes[node.primMesh];
-    const nvh::GltfMaterial& material =
-        gltfScene.m_materials[mesh.materialIndex];
-    if (material.emissiveFactor.sq_norm() > 1e-6) {
-      const uint32_t* indices = gltfScene.m_indices.data() + mesh.firstIndex;
-      const nvmath::vec3f* pos =
-          gltfScene.m_positions.data() + mesh.vertexOffset;
-      for (uint32_t i = 0; i < mesh.indexCount; i += 3, indices += 3) {
-        // triangle
-        nvmath::vec4f p1 =
-            node.worldMatrix * nvmath::vec4f(pos[indices[0]], 1.0f);
-        nvmath::vec4f p2 =
-            node.worldMatrix * nvmath::vec4f(pos[indices[1]], 1.0f);
-        nvmath::vec4f p3 =
-            node.worldMatrix * nvmath::vec4f(pos[indices[2]], 1.0f);
-        nvmath::vec3f p1_vec3(p1.x, p1.y, p1.z), p2_vec3(p2.x, p2.y, p2.z),
-            p3_vec3(p3.x, p3.y, p3.z);
-
-        nvmath::vec3f normal =
-            nvmath::cross(p2_vec3 - p1_vec3, p3_vec3 - p1_vec3);
-        float area = normal.norm();
-        normal /= area;
-        area *= 0.5f;
-
-        float emissionLuminance = shader::luminance(material.emissiveFactor.x,
-                                                    material.emissiveFactor.y,
-                                                    material.emissiveFactor.z);
-        m_triangleLights.push_back(TriangleLight{
-            p1, p2, p3,
-            nvmath::vec4f(material.emissiveFactor, emissionLuminance),
-            nvmath::vec4f(normal, area)});
-      }
-    }
-  }
+  m_triangleLights = collectTriangleLights(
+      gltfScene, &SingletonManager::GetGLTFLoader().getTModel());
   spdlog::info("Collected GLTF triangle lights of size: {}",
                m_triangleLights.size());
   spdlog::info("GLTF Model has been loaded");
@@ -426,38 +648,39 @@ void Renderer::createGLTFBuffer() {
     throw std::runtime_error("creating empty GLTF buffer");
   }
 
+  MemoryCategoryScope geometry(m_memAlloc, MemoryCategory::eGeometry);
   nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
   VkCommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
 
   nvh::GltfScene gltfScene = SingletonManager::GetGLTFLoader().getGLTFScene();
 
   // GLTF Scenes
-  m_gltfVertices = m_alloc.createBuffer(
-      cmdBuf, gltfScene.m_positions,
+  m_gltfVertices = m_uploader.createBuffer(
+      gltfScene.m_positions,
       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
           VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
-  m_gltfIndices = m_alloc.createBuffer(
-      cmdBuf, gltfScene.m_indices,
+  m_gltfIndices = m_uploader.createBuffer(
+      gltfScene.m_indices,
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
           VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
           VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
-  m_gltfNormals   = m_alloc.createBuffer(cmdBuf, gltfScene.m_normals,
-                                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-  m_gltfTexcoords = m_alloc.createBuffer(cmdBuf, gltfScene.m_texcoords0,
+  m_gltfNormals   = m_uploader.createBuffer(gltfScene.m_normals,
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_gltfTexcoords = m_uploader.createBuffer(gltfScene.m_texcoords0,
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_gltfTangents  = m_uploader.createBuffer(gltfScene.m_tangents,
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_gltfColors    = m_uploader.createBuffer(gltfScene.m_colors0,
                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-  m_gltfTangents  = m_alloc.createBuffer(cmdBuf, gltfScene.m_tangents,
-                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-  m_gltfColors    = m_alloc.createBuffer(cmdBuf, gltfScene.m_colors0,
-                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
   // GLTF Primitive Lookups
   std::vector<RestirPrimitiveLookup> primLookup;
   for (auto& primMesh : gltfScene.m_primMeshes)
     primLookup.push_back(
         {primMesh.firstIndex, primMesh.vertexOffset, primMesh.materialIndex});
-  m_gltfPrimLookup = m_alloc.createBuffer(cmdBuf, primLookup,
-                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_gltfPrimLookup = m_uploader.createBuffer(
+      primLookup, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
   // GLTF Materials
   std::vector<GltfMaterials> shadeMaterials;
@@ -485,8 +708,8 @@ void Renderer::createGLTFBuffer() {
     smat.normalTextureScale = m.normalTextureScale;
     shadeMaterials.emplace_back(smat);
   }
-  m_gltfMaterials = m_alloc.createBuffer(cmdBuf, shadeMaterials,
-                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_gltfMaterials = m_uploader.createBuffer(
+      shadeMaterials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
   // GLTF Model Matrices
   std::vector<GLTFModelMatrices> nodeMatrices;
@@ -496,8 +719,8 @@ void Renderer::createGLTFBuffer() {
     mat.transformInverseTransposed = invert(node.worldMatrix);
     nodeMatrices.emplace_back(mat);
   }
-  m_gltfMatrices = m_alloc.createBuffer(cmdBuf, nodeMatrices,
-                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_gltfMatrices = m_uploader.createBuffer(nodeMatrices,
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
   // ------------ Create texture buffer ------------
   VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
@@ -565,6 +788,7 @@ void Renderer::createGLTFBuffer() {
           std::string("restirGLTFTxt" + std::to_string(i)).c_str());
     }
   }
+  m_uploader.finish();
   cmdBufGet.submitAndWait(cmdBuf);
   m_alloc.finalizeAndReleaseStaging();
 }
@@ -574,6 +798,7 @@ void Renderer::createGLTFBuffer() {
 //
 void Renderer::loadModel(const std::string& filename, nvmath::mat4f transform) {
   LOGI("Loading File:  %s \n", filename.c_str());
+  MemoryCategoryScope geometry(m_memAlloc, MemoryCategory::eGeometry);
   ObjLoader loader;
   loader.loadModel(filename);
 
@@ -605,16 +830,15 @@ void Renderer::loadModel(const std::string& filename, nvmath::mat4f transform) {
       flag |
       VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-  model.vertexBuffer =
-      m_alloc.createBuffer(cmdBuf, loader.m_vertices,
-                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
-  model.indexBuffer =
-      m_alloc.createBuffer(cmdBuf, loader.m_indices,
-                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT | rayTracingFlags);
-  model.matColorBuffer = m_alloc.createBuffer(
-      cmdBuf, loader.m_materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
-  model.matIndexBuffer = m_alloc.createBuffer(
-      cmdBuf, loader.m_matIndx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  model.vertexBuffer = m_uploader.createBuffer(
+      loader.m_vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
+  model.indexBuffer = m_uploader.createBuffer(
+      loader.m_indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | rayTracingFlags);
+  model.matColorBuffer = m_uploader.createBuffer(
+      loader.m_materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  model.matIndexBuffer = m_uploader.createBuffer(
+      loader.m_matIndx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  m_uploader.finish();
   // Creates all textures found and find the offset for this model
   auto txtOffset = static_cast<uint32_t>(m_textures.size());
   createTextureImages(cmdBuf, loader.m_textures);
@@ -655,15 +879,22 @@ void Renderer::loadModel(const std::string& filename, nvmath::mat4f transform) {
 }
 
 //--------------------------------------------------------------------------------------------------
-// Creating the uniform buffer holding the camera matrices
-// - Buffer is host visible
+// Creating the uniform buffers holding the camera matrices, one per frame slot
+// - Buffers are host visible and stay mapped
 //
 void Renderer::createUniformBuffer() {
-  m_bGlobals = m_alloc.createBuffer(
-      sizeof(GlobalUniforms),
-      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  m_debug.setObjectName(m_bGlobals.buffer, "Globals");
+  m_bGlobals.resize(m_frameRing.slots());
+  m_globalsData.resize(m_frameRing.slots());
+  for (uint32_t slot = 0; slot < m_frameRing.slots(); ++slot) {
+    m_bGlobals[slot] = m_alloc.createBuffer(
+        sizeof(GlobalUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_debug.setObjectName(m_bGlobals[slot].buffer,
+                          "Globals" + std::to_string(slot));
+    m_globalsData[slot] =
+        static_cast<GlobalUniforms*>(m_alloc.map(m_bGlobals[slot]));
+  }
   spdlog::info("Allocated Global Uniform buffer");
 }
 
@@ -675,89 +906,205 @@ void Renderer::createRestirBuffer() {
   VkCommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
 
   // resize reservoir buffers
-  m_reservoirInfoBuffers.resize(static_config::kNumGBuffers);
-  m_reservoirWeightBuffers.resize(static_config::kNumGBuffers);
+  m_reservoirBuffers.resize(static_config::kNumGBuffers);
 
-  // create image sampler
+  // create image sampler; the storage image accumulates the upsampled
+  // frame of restir_post.frag, one texel per screen pixel
   auto colorCreateInfo = nvvk::makeImage2DCreateInfo(
       m_size, VK_FORMAT_R32G32B32A32_SFLOAT,
       VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
           VK_IMAGE_USAGE_STORAGE_BIT);
+  // one packed reservoir per texel of the reservoir grid and one layer per
+  // reservoir of a pixel, see shaders/headers/reservoir.glsl
+  auto reservoirCreateInfo = nvvk::makeImage2DCreateInfo(
+      getRenderExtent(), VK_FORMAT_R32G32B32A32_UINT,
+      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+  reservoirCreateInfo.arrayLayers = RESERVOIR_SIZE;
   VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
   samplerCreateInfo.minFilter  = VK_FILTER_NEAREST;
   samplerCreateInfo.magFilter  = VK_FILTER_NEAREST;
   samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
 
-  // set reservoir buffers
-  for (size_t i = 0; i < static_config::kNumGBuffers; ++i) {
-    // m_reservoirInfoBuffers
-    {
-      nvvk::Image image = m_alloc.createImage(colorCreateInfo);
-      VkImageViewCreateInfo ivInfo =
-          nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-      m_reservoirInfoBuffers[i] =
-          m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-      m_reservoirInfoBuffers[i].descriptor.imageLayout =
-          VK_IMAGE_LAYOUT_GENERAL;
-      nvvk::cmdBarrierImageLayout(cmdBuf, m_reservoirInfoBuffers[i].image,
-                                  VK_IMAGE_LAYOUT_UNDEFINED,
-                                  VK_IMAGE_LAYOUT_GENERAL);
+  // the reservoirs, temporary reservoirs, visibility cache and storage image
+  // share memory where their lifetimes over the frames allow; images of
+  // identical parameters bound to the same memory see each other's content
+  reservoirCreateInfo.flags |= VK_IMAGE_CREATE_ALIAS_BIT;
+  colorCreateInfo.flags |= VK_IMAGE_CREATE_ALIAS_BIT;
+  constexpr uint32_t kNumGBuffers = uint32_t(static_config::kNumGBuffers);
+  std::vector<VkImageCreateInfo> createInfos(kNumGBuffers + 2,
+                                             reservoirCreateInfo);
+  createInfos.push_back(colorCreateInfo);
+  std::vector<VkImage> images(createInfos.size());
+  std::vector<TransientRequirements> requirements;
+  for (size_t i = 0; i < images.size(); ++i) {
+    vkCreateImage(m_device, &createInfos[i], nullptr, &images[i]);
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(m_device, images[i], &memReqs);
+    requirements.push_back(
+        {memReqs.size, memReqs.alignment, memReqs.memoryTypeBits});
+  }
+
+  // resource ids of `restirFrameUses`: the GBuffers, then `images`
+  uint32_t gBufferIds[kNumGBuffers], reservoirIds[kNumGBuffers];
+  for (uint32_t i = 0; i < kNumGBuffers; ++i) {
+    gBufferIds[i]   = i;
+    reservoirIds[i] = kNumGBuffers + i;
+  }
+  std::vector<std::vector<ResourceUse>> passes;
+  for (uint32_t frame = 0; frame < kNumGBuffers; ++frame) {
+    const std::vector<std::vector<ResourceUse>> frameUses = restirFrameUses(
+        restirFrameResources(gBufferIds, reservoirIds, 2 * kNumGBuffers,
+                             2 * kNumGBuffers + 1, 2 * kNumGBuffers + 2,
+                             frame),
+        spatialReuseDispatches(static_config::kSpatialReuseIterations));
+    passes.insert(passes.end(), frameUses.begin(), frameUses.end());
+  }
+  std::vector<std::vector<bool>> lifetimes = computeTransientLifetimes(
+      uint32_t(kNumGBuffers + images.size()), passes);
+  lifetimes.erase(lifetimes.begin(), lifetimes.begin() + kNumGBuffers);
+  const TransientPlan plan = packTransientResources(requirements, lifetimes);
+
+  nvvk::MemAllocator* memAllocator = m_alloc.getMemoryAllocator();
+  for (const TransientBlock& block : plan.blocks) {
+    const VkMemoryRequirements memReqs{block.size, block.alignment,
+                                       block.memoryTypeBits};
+    m_transientBlocks.push_back(memAllocator->allocMemory(
+        nvvk::MemAllocateInfo(memReqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              true)));
+  }
+  std::vector<VkImage> firstOfBlock(plan.blocks.size(), VK_NULL_HANDLE);
+  m_imageAliases.clear();
+  for (size_t i = 0; i < images.size(); ++i) {
+    const TransientPlacement& placement = plan.placements[i];
+    const nvvk::MemAllocator::MemInfo info =
+        memAllocator->getMemoryInfo(m_transientBlocks[placement.block]);
+    vkBindImageMemory(m_device, images[i], info.memory,
+                      info.offset + placement.offset);
+    // the render graph orders the images of a block as one resource
+    VkImage& first = firstOfBlock[placement.block];
+    if (first == VK_NULL_HANDLE) {
+      first = images[i];
+    } else {
+      m_imageAliases[images[i]] = first;
     }
-    // m_reservoirWeightBuffers
-    {
-      nvvk::Image image = m_alloc.createImage(colorCreateInfo);
-      VkImageViewCreateInfo ivInfo =
-          nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-      m_reservoirWeightBuffers[i] =
-          m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-      m_reservoirWeightBuffers[i].descriptor.imageLayout =
-          VK_IMAGE_LAYOUT_GENERAL;
-      nvvk::cmdBarrierImageLayout(cmdBuf, m_reservoirWeightBuffers[i].image,
-                                  VK_IMAGE_LAYOUT_UNDEFINED,
-                                  VK_IMAGE_LAYOUT_GENERAL);
+  }
+  spdlog::info("Packed {} ReSTIR images into {} blocks: {:.1f} MiB, {:.1f} MiB "
+               "dedicated",
+               images.size(), plan.blocks.size(),
+               plan.packedBytes / 1048576.0, plan.dedicatedBytes / 1048576.0);
+
+  const auto createTexture = [&](size_t i) {
+    VkImageViewCreateInfo ivInfo =
+        nvvk::makeImageViewCreateInfo(images[i], createInfos[i]);
+    if (createInfos[i].arrayLayers > 1) {
+      ivInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
     }
+    nvvk::Texture texture = m_alloc.createTexture(
+        nvvk::Image{images[i], nullptr}, ivInfo, samplerCreateInfo);
+    texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    nvvk::cmdBarrierImageLayout(cmdBuf, texture.image,
+                                VK_IMAGE_LAYOUT_UNDEFINED,
+                                VK_IMAGE_LAYOUT_GENERAL);
+    return texture;
+  };
+
+  // the memory of a block may have held other images before; zero texels are
+  // empty reservoirs and cache entries that match no epoch
+  const auto clearLayers = [&](const nvvk::Texture& texture) {
+    VkClearColorValue clearValue{};
+    VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0,
+                                  RESERVOIR_SIZE};
+    vkCmdClearColorImage(cmdBuf, texture.image, VK_IMAGE_LAYOUT_GENERAL,
+                         &clearValue, 1, &range);
+  };
+
+  // set reservoir buffers, which frame 0 temporal reuse and the texels the
+  // passes skip read before anything is written
+  for (size_t i = 0; i < kNumGBuffers; ++i) {
+    m_reservoirBuffers[i] = createTexture(i);
+    clearLayers(m_reservoirBuffers[i]);
   }
+  m_reservoirTmpBuffer = createTexture(kNumGBuffers);
+  clearLayers(m_reservoirTmpBuffer);
+
+  // m_visibilityCache
+  m_visibilityCache = createTexture(kNumGBuffers + 1);
+  clearLayers(m_visibilityCache);
+
+  // m_storageImage
+  m_storageImage = createTexture(kNumGBuffers + 2);
 
-  // m_reservoirTmpInfoBuffer
+  // the volume of the scene, not a frame image
+  MemoryCategoryScope geometry(m_memAlloc, MemoryCategory::eGeometry);
+
+  // m_densityGridTexture, a single empty voxel without a VDB
   {
-    nvvk::Image image = m_alloc.createImage(colorCreateInfo);
+    const bool empty = m_densityGrid.extinction.empty();
+    const std::vector<float> emptyVoxel{0.0f};
+    const std::vector<float>& voxels =
+        empty ? emptyVoxel : m_densityGrid.extinction;
+    VkExtent3D extent{1, 1, 1};
+    if (!empty) {
+      extent = VkExtent3D{uint32_t(m_densityGrid.resolution.x),
+                          uint32_t(m_densityGrid.resolution.y),
+                          uint32_t(m_densityGrid.resolution.z)};
+    }
+    auto densityCreateInfo =
+        nvvk::makeImage3DCreateInfo(extent, VK_FORMAT_R32_SFLOAT);
+    nvvk::Image image = m_uploader.createImage(
+        voxels.size() * sizeof(float), voxels.data(), densityCreateInfo);
     VkImageViewCreateInfo ivInfo =
-        nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-    m_reservoirTmpInfoBuffer =
+        nvvk::makeImageViewCreateInfo(image.image, densityCreateInfo);
+    m_densityGridTexture =
         m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-    m_reservoirTmpInfoBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_reservoirTmpInfoBuffer.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
+    m_debug.setObjectName(m_densityGridTexture.image, "densityGrid");
   }
 
-  // m_reservoirTmpWeightBuffer
+  // m_densityBricksTexture, a single empty brick without a VDB
   {
-    nvvk::Image image = m_alloc.createImage(colorCreateInfo);
+    const bool empty = m_densityGrid.brickExtinction.empty();
+    const std::vector<nvmath::vec2f> emptyBrick{nvmath::vec2f(0.0f)};
+    const std::vector<nvmath::vec2f>& bricks =
+        empty ? emptyBrick : m_densityGrid.brickExtinction;
+    VkExtent3D extent{1, 1, 1};
+    if (!empty) {
+      extent = VkExtent3D{uint32_t(m_densityGrid.brickResolution.x),
+                          uint32_t(m_densityGrid.brickResolution.y),
+                          uint32_t(m_densityGrid.brickResolution.z)};
+    }
+    auto bricksCreateInfo =
+        nvvk::makeImage3DCreateInfo(extent, VK_FORMAT_R32G32_SFLOAT);
+    nvvk::Image image = m_uploader.createImage(
+        bricks.size() * sizeof(nvmath::vec2f), bricks.data(),
+        bricksCreateInfo);
     VkImageViewCreateInfo ivInfo =
-        nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-    m_reservoirTmpWeightBuffer =
+        nvvk::makeImageViewCreateInfo(image.image, bricksCreateInfo);
+    m_densityBricksTexture =
         m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-    m_reservoirTmpWeightBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_reservoirTmpWeightBuffer.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
+    m_debug.setObjectName(m_densityBricksTexture.image, "densityBricks");
   }
 
-  // m_storageImage
+  // m_blueNoiseTexture, the rotation of the low-discrepancy candidates
   {
-    nvvk::Image image = m_alloc.createImage(colorCreateInfo);
+    if (m_lowDiscrepancyTables.blueNoise.empty()) {
+      m_lowDiscrepancyTables = generateLowDiscrepancyTables();
+    }
+    const LowDiscrepancyTables& tables = m_lowDiscrepancyTables;
+    auto blueNoiseCreateInfo = nvvk::makeImage3DCreateInfo(
+        VkExtent3D{tables.blueNoiseSize, tables.blueNoiseSize,
+                   tables.blueNoiseSlices},
+        VK_FORMAT_R8_UINT);
+    nvvk::Image image = m_uploader.createImage(
+        tables.blueNoise.size(), tables.blueNoise.data(), blueNoiseCreateInfo);
     VkImageViewCreateInfo ivInfo =
-        nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-    m_storageImage = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-    m_storageImage.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    nvvk::cmdBarrierImageLayout(cmdBuf, m_storageImage.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_GENERAL);
+        nvvk::makeImageViewCreateInfo(image.image, blueNoiseCreateInfo);
+    m_blueNoiseTexture =
+        m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
+    m_debug.setObjectName(m_blueNoiseTexture.image, "blueNoise");
   }
 
+  m_uploader.finish();
   cmdBufGet.submitAndWait(cmdBuf);
-  m_alloc.finalizeAndReleaseStaging();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -767,13 +1114,9 @@ void Renderer::createRestirBuffer() {
 // - Offset for texture
 //
 void Renderer::createObjDescriptionBuffer() {
-  nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
-
-  auto cmdBuf = cmdGen.createCommandBuffer();
-  m_bObjDesc  = m_alloc.createBuffer(cmdBuf, m_objDesc,
-                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-  cmdGen.submitAndWait(cmdBuf);
-  m_alloc.finalizeAndReleaseStaging();
+  m_bObjDesc =
+      m_uploader.createBuffer(m_objDesc, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_uploader.finish();
   m_debug.setObjectName(m_bObjDesc.buffer, "ObjDescs");
 }
 
@@ -782,6 +1125,7 @@ void Renderer::createObjDescriptionBuffer() {
 //
 void Renderer::createTextureImages(const VkCommandBuffer& cmdBuf,
                                    const std::vector<std::string>& textures) {
+  MemoryCategoryScope geometry(m_memAlloc, MemoryCategory::eGeometry);
   VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
   samplerCreateInfo.minFilter  = VK_FILTER_LINEAR;
   samplerCreateInfo.magFilter  = VK_FILTER_LINEAR;
@@ -861,6 +1205,10 @@ void Renderer::createTextureImages(const VkCommandBuffer& cmdBuf,
 // Destroying all allocations
 //
 void Renderer::destroyResources() {
+  // no frame in flight reads the uniforms anymore
+  m_frameRing.waitAll([&](uint32_t slot) {
+    vkWaitForFences(m_device, 1, &m_frameFences[slot], VK_TRUE, UINT64_MAX);
+  });
 #ifdef USE_RT_PIPELINE
   vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
@@ -868,7 +1216,10 @@ void Renderer::destroyResources() {
   vkDestroyDescriptorPool(m_device, m_descPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_descSetLayout, nullptr);
 
-  m_alloc.destroy(m_bGlobals);
+  for (nvvk::Buffer& buffer : m_bGlobals) {
+    m_alloc.unmap(buffer);
+    m_alloc.destroy(buffer);
+  }
 
 #ifdef USE_GLTF
   m_alloc.destroy(m_gltfVertices);
@@ -919,6 +1270,10 @@ void Renderer::destroyResources() {
 
   // #VKRay
   m_rtBuilder.destroy();
+  for (nvvk::AccelKHR& blas : m_volumeBlas) {
+    m_alloc.destroy(blas);
+  }
+  m_alloc.destroy(m_volumeScratchBuffer);
 #ifdef USE_RT_PIPELINE
   vkDestroyPipeline(m_device, m_rtPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_rtPipelineLayout, nullptr);
@@ -937,8 +1292,10 @@ void Renderer::destroyResources() {
   // restir uniform buffer
   vkDestroyDescriptorPool(m_device, m_restirUniformDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_restirUniformDescSetLayout, nullptr);
-  if (m_restirUniformBuffer.buffer != VK_NULL_HANDLE)
-    m_alloc.destroy(m_restirUniformBuffer);
+  for (nvvk::Buffer& buffer : m_restirUniformBuffers) {
+    m_alloc.unmap(buffer);
+    m_alloc.destroy(buffer);
+  }
 
   // ReSTIR lights
   vkDestroyDescriptorPool(m_device, m_lightDescPool, nullptr);
@@ -946,21 +1303,28 @@ void Renderer::destroyResources() {
   m_alloc.destroy(m_ptLightsBuffer);
   m_alloc.destroy(m_aliasTableBuffer);
   m_alloc.destroy(m_triangleLightsBuffer);
+  m_alloc.destroy(m_environmentTexture);
+  m_alloc.destroy(m_environmentAliasTableBuffer);
 
   // reservoirs
   vkDestroyDescriptorPool(m_device, m_restirDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_restirDescSetLayout, nullptr);
-  for (auto& t : m_reservoirInfoBuffers) {
-    m_alloc.destroy(t);
-  }
-  for (auto& t : m_reservoirWeightBuffers) {
+  for (auto& t : m_reservoirBuffers) {
     m_alloc.destroy(t);
   }
-  m_alloc.destroy(m_reservoirTmpInfoBuffer);
-  m_alloc.destroy(m_reservoirTmpWeightBuffer);
+  m_alloc.destroy(m_reservoirTmpBuffer);
+  m_alloc.destroy(m_visibilityCache);
+  m_alloc.destroy(m_densityGridTexture);
+  m_alloc.destroy(m_densityBricksTexture);
+  m_alloc.destroy(m_blueNoiseTexture);
 
   // storage images
   m_alloc.destroy(m_storageImage);
+  for (nvvk::MemHandle block : m_transientBlocks) {
+    m_alloc.getMemoryAllocator()->freeMemory(block);
+  }
+  m_transientBlocks.clear();
+  m_imageAliases.clear();
   vkDestroyPipeline(m_device, m_restirPostPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_restirPostPipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_restirPostDescPool, nullptr);
@@ -968,6 +1332,7 @@ void Renderer::destroyResources() {
 
   // ReSTIR passes
   m_restirPass.destroy();
+  m_temporalReusePass.destroy();
   m_spatialReusePass.destroy();
 #endif
 
@@ -976,7 +1341,34 @@ void Renderer::destroyResources() {
     gBuf.destroy();
   }
 
+  // frame slots
+  for (VkFence fence : m_frameFences) {
+    vkDestroyFence(m_device, fence, nullptr);
+  }
+
+  // headless targets
+  m_alloc.destroy(m_headlessColor);
+  vkDestroyFramebuffer(m_device, m_headlessFramebuffer, nullptr);
+  for (nvvk::Buffer& buffer : m_readbackBuffers) {
+    m_alloc.unmap(buffer);
+    m_alloc.destroy(buffer);
+  }
+  for (VkFence fence : m_headlessFences) {
+    vkDestroyFence(m_device, fence, nullptr);
+  }
+  if (!m_headlessCmdBufs.empty()) {
+    vkFreeCommandBuffers(m_device, m_cmdPool,
+                         static_cast<uint32_t>(m_headlessCmdBufs.size()),
+                         m_headlessCmdBufs.data());
+  }
+
+  m_uploader.destroy();
+  if (!m_pipelineCacheFile.empty()) {
+    savePipelineCache();  // destroyed by AppBaseVk
+  }
   m_alloc.deinit();
+  logMemoryBudget(m_memAlloc.budget());
+  m_memAlloc.deinit();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -994,7 +1386,7 @@ void Renderer::rasterize(const VkCommandBuffer& cmdBuf) {
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
                     m_graphicsPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          m_pipelineLayout, 0, 1, &m_descSet, 0, nullptr);
+                          m_pipelineLayout, 0, 1, &getDescSet(), 0, nullptr);
 
   auto nbInst = static_cast<uint32_t>(m_instances.size() -
                                       1);  // Remove the implicit object
@@ -1134,7 +1526,7 @@ void Renderer::createPostPipeline() {
       nvh::loadFile("spv/post.frag.spv", true, defaultSearchPaths, true),
       VK_SHADER_STAGE_FRAGMENT_BIT);
   pipelineGenerator.rasterizationState.cullMode = VK_CULL_MODE_NONE;
-  m_postPipeline = pipelineGenerator.createPipeline();
+  m_postPipeline = pipelineGenerator.createPipeline(m_pipelineCache);
   m_debug.setObjectName(m_postPipeline, "post");
 }
 
@@ -1216,7 +1608,7 @@ void Renderer::createRestirPostPipeline() {
       nvh::loadFile("spv/restir_post.frag.spv", true, defaultSearchPaths, true),
       VK_SHADER_STAGE_FRAGMENT_BIT);
   pipelineGenerator.rasterizationState.cullMode = VK_CULL_MODE_NONE;
-  m_restirPostPipeline = pipelineGenerator.createPipeline();
+  m_restirPostPipeline = pipelineGenerator.createPipeline(m_pipelineCache);
   m_debug.setObjectName(m_restirPostPipeline, "RestirPost");
 }
 
@@ -1245,6 +1637,7 @@ void Renderer::drawPost(VkCommandBuffer cmdBuf) {
 // Draw a full screen quad with the attached image
 //
 void Renderer::restirDrawPost(VkCommandBuffer cmdBuf) {
+  PROFILE_GPU_SCOPE(cmdBuf, "restirPost");
   m_debug.beginLabel(cmdBuf, "restirPost");
 
   setViewport(cmdBuf);
@@ -1252,7 +1645,7 @@ void Renderer::restirDrawPost(VkCommandBuffer cmdBuf) {
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
                     m_restirPostPipeline);
   std::vector<VkDescriptorSet> descriptorSets = {
-      m_restirUniformDescSet, m_lightDescSet,
+      getRestirUniformDescSet(), m_lightDescSet,
       m_restirDescSets[getCurrentFrameIdx()], m_restirPostDescSet};
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
                           m_restirPostPipelineLayout, 0,
@@ -1263,6 +1656,64 @@ void Renderer::restirDrawPost(VkCommandBuffer cmdBuf) {
   m_debug.endLabel(cmdBuf);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Declares what each ReSTIR pass reads and writes; the graph places the
+// barriers, also against the previous frame's passes
+//
+void Renderer::addRestirPasses(RenderGraph& graph,
+                               const nvmath::vec4f& clearColor,
+                               RenderGraph::RecordFunction post) {
+  const uint32_t frameIdx = getCurrentFrameIdx();
+  const uint32_t prevIdx  = (static_config::kNumGBuffers + frameIdx - 1) %
+                           static_config::kNumGBuffers;
+  // every storage image stays in the general layout; images sharing memory
+  // are one resource
+  const auto importImage = [&](const nvvk::Texture& texture) {
+    const auto alias = m_imageAliases.find(texture.image);
+    return graph.importImage(
+        alias != m_imageAliases.end() ? alias->second : texture.image,
+        VK_IMAGE_LAYOUT_GENERAL);
+  };
+  const nvvk::Texture gBuffer     = m_gBuffers[frameIdx].getPackedTexture();
+  const nvvk::Texture prevGBuffer = m_gBuffers[prevIdx].getPackedTexture();
+  RestirFrameResources resources;
+  resources.gBuffer         = importImage(gBuffer);
+  resources.prevGBuffer     = importImage(prevGBuffer);
+  resources.reservoirs      = importImage(m_reservoirBuffers[frameIdx]);
+  resources.prevReservoirs  = importImage(m_reservoirBuffers[prevIdx]);
+  resources.tmpReservoirs   = importImage(m_reservoirTmpBuffer);
+  resources.visibilityCache = importImage(m_visibilityCache);
+  resources.storageImage    = importImage(m_storageImage);
+
+  const std::vector<PushConstantSpatialReuse> dispatches =
+      m_spatialReusePass.dispatches();
+  const std::vector<std::vector<ResourceUse>> uses =
+      restirFrameUses(resources, dispatches);
+  const VkDescriptorSet restirDescSet = getRestirDescSet();
+  // the uniforms of the frame slot being recorded
+  const VkDescriptorSet descSet        = getDescSet();
+  const VkDescriptorSet uniformDescSet = getRestirUniformDescSet();
+
+  graph.addPass("restir", uses[0], [=](const VkCommandBuffer& cmdBuf) {
+    m_restirPass.run(cmdBuf, m_rtDescSet, descSet, uniformDescSet,
+                     m_lightDescSet, restirDescSet, clearColor);
+  });
+  graph.addPass("temporalReuse", uses[1], [=](const VkCommandBuffer& cmdBuf) {
+    m_temporalReusePass.run(cmdBuf, m_rtDescSet, descSet, uniformDescSet,
+                            m_lightDescSet, restirDescSet);
+  });
+  for (size_t i = 0; i < dispatches.size(); ++i) {
+    const PushConstantSpatialReuse pushC = dispatches[i];
+    graph.addPass("spatialReuse", uses[2 + i],
+                  [=](const VkCommandBuffer& cmdBuf) {
+                    m_spatialReusePass.run(cmdBuf, m_rtDescSet, descSet,
+                                           uniformDescSet, m_lightDescSet,
+                                           restirDescSet, pushC);
+                  });
+  }
+  graph.addPass("restirPost", uses.back(), std::move(post));
+}
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -1274,7 +1725,8 @@ void Renderer::initRayTracing() {
   // Requesting ray tracing properties
   VkPhysicalDeviceProperties2 prop2{
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
-  prop2.pNext = &m_rtProperties;
+  prop2.pNext          = &m_rtProperties;
+  m_rtProperties.pNext = &m_asProperties;
   vkGetPhysicalDeviceProperties2(m_physicalDevice, &prop2);
 
   m_rtBuilder.setup(m_device, &m_alloc, m_graphicsQueueIndex);
@@ -1371,9 +1823,10 @@ nvvk::RaytracingBuilderKHR::BlasInput Renderer::gltfToGeometryKHR(
 }
 
 //--------------------------------------------------------------------------------------------------
-// Returning the ray tracing geometry used for the BLAS, containing all spheres
+// Returning the ray tracing geometry used for the BLAS, containing the spheres
+// [first, first + count)
 //
-auto Renderer::sphereToVkGeometryKHR() {
+auto Renderer::sphereToVkGeometryKHR(uint32_t first, uint32_t count) {
   VkDeviceAddress dataAddress =
       nvvk::getBufferDeviceAddress(m_device, m_spheresAabbBuffer.buffer);
 
@@ -1392,8 +1845,8 @@ auto Renderer::sphereToVkGeometryKHR() {
 
   VkAccelerationStructureBuildRangeInfoKHR offset{};
   offset.firstVertex     = 0;
-  offset.primitiveCount  = (uint32_t)m_spheres.size();  // Nb aabb
-  offset.primitiveOffset = 0;
+  offset.primitiveCount  = count;  // Nb aabb
+  offset.primitiveOffset = first * static_cast<uint32_t>(sizeof(Aabb));
   offset.transformOffset = 0;
 
   nvvk::RaytracingBuilderKHR::BlasInput input;
@@ -1423,27 +1876,48 @@ void Renderer::createVDBBuffer() {
   nvmath::vec3f translation{-2.5, 0.5f, 0};
   nvmath::vec3f translation2{1.0f, 0.0f, 0};
 
-  uint32_t nbSpheres = static_cast<uint32_t>(vdb->AllPoints.size());
+  // the buffers of the points and the density grid in what geometry has
+  // left, at a lower detail when the whole VDB does not fit
+  MemoryCategoryScope geometry(m_memAlloc, MemoryCategory::eGeometry);
+  constexpr VkDeviceSize kBytesPerPoint = sizeof(Sphere) + sizeof(Aabb) +
+                                          sizeof(int) + sizeof(MaterialObj) +
+                                          sizeof(GltfMaterials);
+  const uint32_t nbPoints = static_cast<uint32_t>(vdb->AllPoints.size());
+  const VolumeLod lod     = chooseVolumeLod(
+      nbPoints, kBytesPerPoint, static_config::kDensityGridResolution,
+      m_memAlloc.budget().available(MemoryCategory::eGeometry));
+  if (lod.gridResolution < static_config::kDensityGridResolution ||
+      lod.pointStride > 1) {
+    spdlog::warn("VDB over the geometry budget: grid of {}, 1 point in {}",
+                 lod.gridResolution, lod.pointStride);
+  }
+  m_vdbPointStride = lod.pointStride;
+  const auto point = [&](size_t i) -> const vDat& {
+    return vdb->AllPoints[i * lod.pointStride];
+  };
+
+  uint32_t nbSpheres = (nbPoints + lod.pointStride - 1) / lod.pointStride;
   // nbSpheres = 1000;
   m_spheres.resize(nbSpheres);
   for (size_t i = 0; i < nbSpheres; i++) {
     Sphere s;
-    s.center =
-        scaleMatrix * nvmath::vec3f(vdb->AllPoints[i].x, vdb->AllPoints[i].y,
-                                    vdb->AllPoints[i].z);
+    s.center = scaleMatrix * nvmath::vec3f(point(i).x, point(i).y, point(i).z);
     s.center += translation;
     s.radius          = 0.005;
-    nvmath::vec3f vel = nvmath::vec3f(
-        vdb->AllPoints[i].vx, vdb->AllPoints[i].vy, vdb->AllPoints[i].vz);
+    nvmath::vec3f vel = nvmath::vec3f(point(i).vx, point(i).vy, point(i).vz);
     m_spheres[i] = std::move(s);
   }
+  m_densityGrid = createDensityGrid(
+      m_spheres, static_config::kVolumeMaxExtinction, lod.gridResolution);
+  spdlog::info("Splatted {} VDB points into a {}x{}x{} density grid",
+               nbSpheres, m_densityGrid.resolution.x,
+               m_densityGrid.resolution.y, m_densityGrid.resolution.z);
 #ifdef USE_ANIMATION
   int sphereAnimate = nbSpheres / 10;
   m_spheresVelocity.resize(nbSpheres);
   for (size_t i = 0; i < sphereAnimate; i++) {
     Velocity v;
-    v.velocity = nvmath::vec3f(vdb->AllPoints[i].vx, vdb->AllPoints[i].vy,
-                               vdb->AllPoints[i].vz);
+    v.velocity = nvmath::vec3f(point(i).vx, point(i).vy, point(i).vz);
 
     // s.acceleration = nvmath::vec3f(0.f, -9.8f, 0.f);  // gravity
     m_spheresVelocity[i] = std::move(v);
@@ -1482,8 +1956,7 @@ void Renderer::createVDBBuffer() {
   materials.reserve(nbSpheres);
   for (size_t i = 0; i < m_spheres.size(); ++i) {
     MaterialObj mat;
-    mat.diffuse = nvmath::vec3f(vdb->AllPoints[i].cx, vdb->AllPoints[i].cy,
-                                vdb->AllPoints[i].cz);
+    mat.diffuse = nvmath::vec3f(point(i).cx, point(i).cy, point(i).cz);
     materials.emplace_back(mat);
   }
 
@@ -1492,8 +1965,7 @@ void Renderer::createVDBBuffer() {
     // Create Material for Sphere
     GltfMaterials spheremat;
     spheremat.pbrBaseColorFactor = nvmath::normalize(
-        nvmath::vec4(vdb->AllPoints[i].cx, vdb->AllPoints[i].cy,
-                     vdb->AllPoints[i].cz, 1));       // Main Color
+        nvmath::vec4(point(i).cx, point(i).cy, point(i).cz, 1));  // Main Color
     spheremat.pbrBaseColorTexture         = 0.0001f;  // For mettalic Color
     spheremat.pbrMetallicFactor           = 0.0001f;  // For mettalic factor
     spheremat.pbrRoughnessFactor          = 0.9;
@@ -1540,23 +2012,21 @@ void Renderer::createVDBBuffer() {
       VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
   using vkBU = VkBufferUsageFlagBits;
-  nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
-  auto cmdBuf         = genCmdBuf.createCommandBuffer();
-  m_spheresBuffer     = m_alloc.createBuffer(cmdBuf, m_spheres,
-                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-  m_spheresAabbBuffer = m_alloc.createBuffer(cmdBuf, aabbs, rayTracingFlags);
-  m_spheresMatIndexBuffer = m_alloc.createBuffer(
-      cmdBuf, matIdx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
-  m_spheresMatColorBuffer = m_alloc.createBuffer(
-      cmdBuf, materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
-  m_sphereMaterialsBuffer = m_alloc.createBuffer(
-      cmdBuf, m_sphereMaterials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  m_spheresBuffer =
+      m_uploader.createBuffer(m_spheres, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_spheresAabbBuffer     = m_uploader.createBuffer(aabbs, rayTracingFlags);
+  m_spheresMatIndexBuffer = m_uploader.createBuffer(
+      matIdx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  m_spheresMatColorBuffer = m_uploader.createBuffer(
+      materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  m_sphereMaterialsBuffer = m_uploader.createBuffer(
+      m_sphereMaterials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
 
 #ifdef USE_ANIMATION
-  m_spheresVelocityBuffer = m_alloc.createBuffer(
-      cmdBuf, m_spheresVelocity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+  m_spheresVelocityBuffer = m_uploader.createBuffer(
+      m_spheresVelocity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
 #endif
-  genCmdBuf.submitAndWait(cmdBuf);
+  m_uploader.finish();
 
   // Debug information
   m_debug.setObjectName(m_spheresBuffer.buffer, "spheres");
@@ -1578,16 +2048,59 @@ void Renderer::createVDBBuffer() {
   instance.objIndex  = static_cast<uint32_t>(m_objModel.size());
   m_instances.emplace_back(instance);
 
+  // the BLAS chunks of the spheres, the moving ones updated by the animation
+  std::vector<nvmath::vec3f> velocities;
+#ifdef USE_ANIMATION
+  velocities.reserve(m_spheresVelocity.size());
+  for (const Velocity& v : m_spheresVelocity) {
+    velocities.push_back(v.velocity);
+  }
+#endif
+  m_volumeChunks.create(m_spheres, std::move(velocities), VOLUME_CHUNK_SPHERES,
+                        static_config::kVolumeRebuildCostRatio);
+
   spdlog::info("VDB Buffer created");
 }
 
+//--------------------------------------------------------------------------------------------------
+// Loading an equirectangular HDR environment map, uploaded together with the
+// other ReSTIR lights in `createRestirLights`
+//
+void Renderer::loadEnvironmentMap(const std::string& filename) {
+  std::optional<EnvironmentMap> map = ::loadEnvironmentMap(filename);
+  if (!map) {
+    spdlog::warn("Rendering without environment map");
+    return;
+  }
+  m_environmentMap = std::move(*map);
+  spdlog::info("Loaded environment map of size {}x{}", m_environmentMap.width,
+               m_environmentMap.height);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Loading the blue noise of the low-discrepancy candidates from an asset of
+// `--write-ld-tables`; `createRestirBuffer` generates it otherwise
+//
+void Renderer::loadLowDiscrepancyTables(const std::string& filename) {
+  std::optional<LowDiscrepancyTables> tables =
+      ::loadLowDiscrepancyTables(filename);
+  if (!tables || tables->blueNoise.empty()) {
+    spdlog::warn("Generating the low-discrepancy tables instead");
+    return;
+  }
+  m_lowDiscrepancyTables = std::move(*tables);
+  spdlog::info("Loaded {} blue-noise slices of {}x{}",
+               m_lowDiscrepancyTables.blueNoiseSlices,
+               m_lowDiscrepancyTables.blueNoiseSize,
+               m_lowDiscrepancyTables.blueNoiseSize);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Creating ReSTIR Point Lights
 //
 void Renderer::createRestirLights() {
+  MemoryCategoryScope geometry(m_memAlloc, MemoryCategory::eGeometry);
   // Create the buffers on Device and copy vertices, indices and materials
-  nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
-  VkCommandBuffer cmdBuf  = cmdBufGet.createCommandBuffer();
   VkBufferUsageFlags flag = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
   if (m_pointLights.empty()) {
@@ -1617,12 +2130,13 @@ void Renderer::createRestirLights() {
   if (SingletonManager::GetVDBLoader().IsVDBLoaded()) {
     vdb = SingletonManager::GetVDBLoader().GetPtr();
 
-    uint32_t nbSpheres = static_cast<uint32_t>(vdb->AllPoints.size());
+    // the points kept in m_spheres
+    uint32_t nbSpheres = static_cast<uint32_t>(m_spheres.size());
     for (int i = 0; i < nbSpheres; i++) {
       if (lightCounter > 1000) {
         break;
       }
-      if (vdb->AllPoints[i].temp > 275) {
+      if (vdb->AllPoints[i * m_vdbPointStride].temp > 275) {
         lightCounter++;
         PointLight currLight;
         currLight.pos                = m_spheres[i].center;
@@ -1641,7 +2155,6 @@ void Renderer::createRestirLights() {
 
   if (m_triangleLights.empty()) {
     // triangle lights are only created with a GLTF scene
-    // m_triangleLights = collectTriangleLights(gltfScene);
     spdlog::warn(
         "No triangle lights are populated in GLTF scene. Adding one dummy "
         "triangle light...");
@@ -1662,23 +2175,56 @@ void Renderer::createRestirLights() {
   }
   std::vector<AliasTableCell> aliasTable = createAliasTable(pdf);
   m_aliasTableCount  = static_cast<uint32_t>(aliasTable.size());
-  m_aliasTableBuffer = m_alloc.createBuffer(cmdBuf, aliasTable, flag);
+  m_aliasTableBuffer = m_uploader.createBuffer(aliasTable, flag);
   spdlog::debug("Created aliasTableBuffer");
 
   // create point light buffers
   if (m_pointLights.size() > 0) {
-    m_ptLightsBuffer = m_alloc.createBuffer(cmdBuf, m_pointLights, flag);
+    m_ptLightsBuffer = m_uploader.createBuffer(m_pointLights, flag);
     spdlog::debug("Created pointLightsBuffer");
   }
 
   if (m_triangleLights.size() > 0) {
-    m_triangleLightsBuffer =
-        m_alloc.createBuffer(cmdBuf, m_triangleLights, flag);
+    m_triangleLightsBuffer = m_uploader.createBuffer(m_triangleLights, flag);
   }
   spdlog::debug("Created triangleLightsBuffer");
 
-  cmdBufGet.submitAndWait(cmdBuf);
-  m_alloc.finalizeAndReleaseStaging();
+  // environment map and its alias table, a black 1x1 map keeps the descriptor
+  // set valid when there is none
+  {
+    EnvironmentMap dummy;
+    dummy.width  = 1;
+    dummy.height = 1;
+    dummy.pixels = {nvmath::vec4f(0.0f)};
+    const EnvironmentMap& map =
+        m_environmentMap.empty() ? dummy : m_environmentMap;
+
+    VkSamplerCreateInfo samplerCreateInfo{
+        VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    samplerCreateInfo.minFilter    = VK_FILTER_NEAREST;
+    samplerCreateInfo.magFilter    = VK_FILTER_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+    const VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    auto imageCreateInfo  = nvvk::makeImage2DCreateInfo(
+        VkExtent2D{map.width, map.height}, format);
+    nvvk::Image image = m_uploader.createImage(
+        map.pixels.size() * sizeof(nvmath::vec4f), map.pixels.data(),
+        imageCreateInfo);
+    VkImageViewCreateInfo ivInfo =
+        nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
+    m_environmentTexture =
+        m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
+
+    std::vector<AliasTableCell> environmentAliasTable =
+        createEnvironmentAliasTable(map);
+    m_environmentAliasTableBuffer =
+        m_uploader.createBuffer(environmentAliasTable, flag);
+  }
+  spdlog::debug("Created environment map");
+
+  m_uploader.finish();
 
   // debug information
   if (m_pointLights.size() > 0) {
@@ -1688,6 +2234,9 @@ void Renderer::createRestirLights() {
     m_debug.setObjectName(m_triangleLightsBuffer.buffer, "triangleLights");
   }
   m_debug.setObjectName(m_aliasTableBuffer.buffer, "aliasTable");
+  m_debug.setObjectName(m_environmentTexture.image, "environmentMap");
+  m_debug.setObjectName(m_environmentAliasTableBuffer.buffer,
+                        "environmentAliasTable");
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1695,6 +2244,8 @@ void Renderer::createRestirLights() {
 //
 void Renderer::createBottomLevelAS() {
   // BLAS - Storing each primitive in a geometry
+  MemoryCategoryScope accelerationStructures(
+      m_memAlloc, MemoryCategory::eAccelerationStructures);
 
 #ifdef USE_GLTF
   const auto gltfScene = SingletonManager::GetGLTFLoader().getGLTFScene();
@@ -1713,31 +2264,183 @@ void Renderer::createBottomLevelAS() {
   }
 #endif
 
-  // Spheres
-#ifdef USE_VDB
-  {
-    auto blas = sphereToVkGeometryKHR();
-    allBlas.emplace_back(blas);
-  }
-#endif  // USE_VDB
-
   m_rtBuilder.buildBlas(
       allBlas, VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR |
                    VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR);
+
+  // Spheres
+#ifdef USE_VDB
+  createVolumeBlas();
+#endif  // USE_VDB
   spdlog::info("Created BLAS for ray tracing");
 }
 
+//--------------------------------------------------------------------------------------------------
+// A BLAS per chunk of the VDB spheres, built here and updated by
+// `animationObject`. The scratch buffer holds a build per moving chunk
+//
+void Renderer::createVolumeBlas() {
+  const uint32_t chunks = m_volumeChunks.chunkCount();
+  if (chunks == 0) {
+    return;
+  }
+  MemoryCategoryScope accelerationStructures(
+      m_memAlloc, MemoryCategory::eAccelerationStructures);
+
+  VkDeviceSize scratchSize = 0;
+  m_volumeBlasInputs.reserve(chunks);
+  m_volumeBlas.reserve(chunks);
+  for (uint32_t c = 0; c < chunks; ++c) {
+    const VolumeChunk& chunk = m_volumeChunks.chunk(c);
+    m_volumeBlasInputs.push_back(
+        sphereToVkGeometryKHR(chunk.first, chunk.count));
+
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
+    buildInfo.type          = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+    buildInfo.flags         = kVolumeBlasFlags;
+    buildInfo.mode          = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    buildInfo.geometryCount = 1;
+    buildInfo.pGeometries   = m_volumeBlasInputs.back().asGeometry.data();
+    VkAccelerationStructureBuildSizesInfoKHR sizeInfo{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
+    vkGetAccelerationStructureBuildSizesKHR(
+        m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo,
+        &chunk.count, &sizeInfo);
+    scratchSize = std::max({scratchSize, sizeInfo.buildScratchSize,
+                            sizeInfo.updateScratchSize});
+
+    VkAccelerationStructureCreateInfoKHR createInfo{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+    createInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+    createInfo.size = sizeInfo.accelerationStructureSize;
+    m_volumeBlas.push_back(m_alloc.createAcceleration(createInfo));
+    m_debug.setObjectName(m_volumeBlas.back().accel,
+                          "volumeChunk" + std::to_string(c));
+  }
+
+  const VkDeviceSize scratchAlignment =
+      m_asProperties.minAccelerationStructureScratchOffsetAlignment;
+
+  m_volumeScratchStride = nvh::align_up(scratchSize, scratchAlignment);
+  m_volumeScratchSlots  = std::min(
+      chunks, std::max(m_volumeChunks.movingChunks(), kVolumeBuildBatch));
+  m_volumeScratchBuffer = m_alloc.createBuffer(
+      m_volumeScratchStride * m_volumeScratchSlots,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  m_debug.setObjectName(m_volumeScratchBuffer.buffer, "volumeScratch");
+
+  nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+  VkCommandBuffer cmdBuf = genCmdBuf.createCommandBuffer();
+  cmdBuildVolumeBlas(cmdBuf,
+                     std::vector<ChunkUpdate>(chunks, ChunkUpdate::eRebuild));
+  genCmdBuf.submitAndWait(cmdBuf);
+  spdlog::info("Created {} BLAS of {} volume spheres, {} moving", chunks,
+               VOLUME_CHUNK_SPHERES, m_volumeChunks.movingChunks());
+}
+
+//--------------------------------------------------------------------------------------------------
+// Records the builds of the volume chunks: from scratch for a rebuild, from
+// their last build for a refit, at most m_volumeScratchSlots at once
+//
+void Renderer::cmdBuildVolumeBlas(VkCommandBuffer cmdBuf,
+                                  const std::vector<ChunkUpdate>& updates) {
+  const VkDeviceAddress scratchAddress =
+      nvvk::getBufferDeviceAddress(m_device, m_volumeScratchBuffer.buffer);
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos;
+  std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> ranges;
+  const auto flush = [&]() {
+    if (buildInfos.empty()) {
+      return;
+    }
+    vkCmdBuildAccelerationStructuresKHR(
+        cmdBuf, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(),
+        ranges.data());
+    // the next builds reuse the scratch buffer
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR |
+                            VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    vkCmdPipelineBarrier(
+        cmdBuf, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier,
+        0, nullptr, 0, nullptr);
+    buildInfos.clear();
+    ranges.clear();
+  };
+
+  for (uint32_t c = 0; c < m_volumeBlas.size(); ++c) {
+    if (updates[c] == ChunkUpdate::eNone) {
+      continue;
+    }
+    const auto& input = m_volumeBlasInputs[c];
+    const bool refit  = updates[c] == ChunkUpdate::eRefit;
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
+    buildInfo.type  = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+    buildInfo.flags = kVolumeBlasFlags;
+    buildInfo.mode  = refit ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR
+                            : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    // a refit keeps the tree of the last build and updates it in place
+    buildInfo.srcAccelerationStructure =
+        refit ? m_volumeBlas[c].accel : VK_NULL_HANDLE;
+    buildInfo.dstAccelerationStructure = m_volumeBlas[c].accel;
+    buildInfo.geometryCount            = 1;
+    buildInfo.pGeometries              = input.asGeometry.data();
+    // a scratch slot per build of the batch
+    buildInfo.scratchData.deviceAddress =
+        scratchAddress + buildInfos.size() * m_volumeScratchStride;
+    buildInfos.push_back(buildInfo);
+    ranges.push_back(input.asBuildOffsetInfo.data());
+    if (buildInfos.size() == m_volumeScratchSlots) {
+      flush();
+    }
+  }
+  flush();
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 //
 void Renderer::createTopLevelAS() {
+  MemoryCategoryScope accelerationStructures(
+      m_memAlloc, MemoryCategory::eAccelerationStructures);
 #ifdef USE_GLTF
   const auto gltfScene = SingletonManager::GetGLTFLoader().getGLTFScene();
+  tlas.reserve(gltfScene.m_nodes.size() + m_volumeBlas.size());
+#else
+  tlas.reserve(m_objModel.size() + m_volumeBlas.size());
+#endif
+
+  // The chunks of the implicit objects first, gl_InstanceID being the chunk
+  // in VOLUME_SPHERE_INDEX
 #ifdef USE_VDB
-  tlas.reserve(gltfScene.m_nodes.size() + 1);
+  for (const nvvk::AccelKHR& blas : m_volumeBlas) {
+    VkAccelerationStructureInstanceKHR rayInst{};
+    rayInst.transform =
+        nvvk::toTransformMatrixKHR(nvmath::mat4f(1));  // (identity)
+#ifdef USE_GLTF
+    rayInst.instanceCustomIndex =
+        static_cast<uint32_t>(gltfScene.m_primMeshes.size());
 #else
-  tlas.reserve(gltfScene.m_nodes.size());
+    rayInst.instanceCustomIndex = static_cast<uint32_t>(
+        m_objModel.size());  // nbObj == last object == implicit
+#endif
+    VkAccelerationStructureDeviceAddressInfoKHR addressInfo{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
+    addressInfo.accelerationStructure = blas.accel;
+    rayInst.accelerationStructureReference =
+        vkGetAccelerationStructureDeviceAddressKHR(m_device, &addressInfo);
+    rayInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+    rayInst.mask  = INSTANCE_MASK_VOLUME;  // hit if rayMask & mask != 0
+    rayInst.instanceShaderBindingTableRecordOffset =
+        1;  // We will use the same hit group for all objects
+    tlas.emplace_back(rayInst);
+  }
 #endif  // USE_VDB
+
+#ifdef USE_GLTF
   for (auto& node : gltfScene.m_nodes) {
     VkAccelerationStructureInstanceKHR rayInst;
     rayInst.transform = nvvk::toTransformMatrixKHR(node.worldMatrix);
@@ -1746,17 +2449,12 @@ void Renderer::createTopLevelAS() {
     rayInst.accelerationStructureReference =
         m_rtBuilder.getBlasDeviceAddress(node.primMesh);
     rayInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-    rayInst.mask  = 0xFF;  //  Only be hit if rayMask & instance.mask != 0
+    rayInst.mask  = INSTANCE_MASK_SURFACE;  // hit if rayMask & mask != 0
     rayInst.instanceShaderBindingTableRecordOffset =
         0;  // We will use the same hit group for all objects
     tlas.emplace_back(rayInst);
   }
 #else
-#ifdef USE_VDB
-  tlas.reserve(m_objModel.size() + 1);
-#else
-  tlas.reserve(m_objModel.size());
-#endif
   for (size_t i = 0; i < m_objModel.size(); i++) {
     const auto& inst = m_instances[i];
 
@@ -1767,37 +2465,12 @@ void Renderer::createTopLevelAS() {
     rayInst.accelerationStructureReference =
         m_rtBuilder.getBlasDeviceAddress(inst.objIndex);
     rayInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-    rayInst.mask  = 0xFF;  //  Only be hit if rayMask & instance.mask != 0
+    rayInst.mask  = INSTANCE_MASK_SURFACE;  // hit if rayMask & mask != 0
     rayInst.instanceShaderBindingTableRecordOffset =
         0;  // We will use the same hit group for all objects
     tlas.emplace_back(rayInst);
   }
 #endif
-  // Add the blas containing all implicit objects
-#ifdef USE_VDB
-  {
-    SphereBlasID = gltfScene.m_primMeshes.size();
-    VkAccelerationStructureInstanceKHR rayInst{};
-    rayInst.transform =
-        nvvk::toTransformMatrixKHR(nvmath::mat4f(1));  // (identity)
-#ifdef USE_GLTF
-    rayInst.instanceCustomIndex =
-        static_cast<uint32_t>(gltfScene.m_primMeshes.size());
-    rayInst.accelerationStructureReference = m_rtBuilder.getBlasDeviceAddress(
-        static_cast<uint32_t>(gltfScene.m_primMeshes.size()));
-#else
-    rayInst.instanceCustomIndex = static_cast<uint32_t>(
-        m_objModel.size());  // nbObj == last object == implicit
-    rayInst.accelerationStructureReference = m_rtBuilder.getBlasDeviceAddress(
-        static_cast<uint32_t>(m_objModel.size()));
-#endif
-    rayInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-    rayInst.mask  = 0xFF;  //  Only be hit if rayMask & instance.mask != 0
-    rayInst.instanceShaderBindingTableRecordOffset =
-        1;  // We will use the same hit group for all objects
-    tlas.emplace_back(rayInst);
-  }
-#endif  // USE_VDB
 
   m_rtBuilder.buildTlas(
       tlas, VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR |
@@ -1863,6 +2536,13 @@ void Renderer::createLightDescriptorSet() {
       LightBindings::eAliasTable, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
       VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR |
           VK_SHADER_STAGE_COMPUTE_BIT);
+  m_lightDescSetLayoutBind.addBinding(
+      LightBindings::eEnvironmentMap, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      1, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR |
+             VK_SHADER_STAGE_COMPUTE_BIT);
+  m_lightDescSetLayoutBind.addBinding(
+      LightBindings::eEnvironmentAliasTable, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      1, VK_SHADER_STAGE_RAYGEN_BIT_KHR);
 
   m_lightDescSetLayout = m_lightDescSetLayoutBind.createLayout(m_device);
   m_lightDescPool      = m_lightDescSetLayoutBind.createPool(m_device);
@@ -1887,6 +2567,16 @@ void Renderer::createLightDescriptorSet() {
   writes.emplace_back(m_lightDescSetLayoutBind.makeWrite(
       m_lightDescSet, LightBindings::eAliasTable, &dbialiasTable));
 
+  writes.emplace_back(m_lightDescSetLayoutBind.makeWrite(
+      m_lightDescSet, LightBindings::eEnvironmentMap,
+      &m_environmentTexture.descriptor));
+
+  VkDescriptorBufferInfo dbiEnvironmentAliasTable{
+      m_environmentAliasTableBuffer.buffer, 0, VK_WHOLE_SIZE};
+  writes.emplace_back(m_lightDescSetLayoutBind.makeWrite(
+      m_lightDescSet, LightBindings::eEnvironmentAliasTable,
+      &dbiEnvironmentAliasTable));
+
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()),
                          writes.data(), 0, nullptr);
   spdlog::info("Created ReSTIR Light descriptor set");
@@ -1902,63 +2592,38 @@ void Renderer::createRestirDescriptorSet() {
   m_restirDescPool = nvvk::createDescriptorPool(m_device, poolSizes, maxSets);
 
   m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::eFrameWorldPosition, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+      RestirBindings::eFrameGBuffer, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
       VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
           VK_SHADER_STAGE_COMPUTE_BIT);
   m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::eFrameAlbedo, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+      RestirBindings::ePrevFrameGBuffer, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
       VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
           VK_SHADER_STAGE_COMPUTE_BIT);
   m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::eFrameNormal, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+      RestirBindings::eReservoirs, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
       VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
           VK_SHADER_STAGE_COMPUTE_BIT);
   m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::eFrameMaterialProps, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+      RestirBindings::ePrevReservoirs, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
       VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
           VK_SHADER_STAGE_COMPUTE_BIT);
-  m_restirDescSetLayoutBind.addBinding(RestirBindings::ePrevFrameWorldPosition,
-                                       VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-                                       VK_SHADER_STAGE_RAYGEN_BIT_KHR |
-                                           VK_SHADER_STAGE_FRAGMENT_BIT |
-                                           VK_SHADER_STAGE_COMPUTE_BIT);
   m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::ePrevFrameAlbedo, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+      RestirBindings::eTmpReservoirs, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
       VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
           VK_SHADER_STAGE_COMPUTE_BIT);
-  m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::ePrevFrameNormal, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
-          VK_SHADER_STAGE_COMPUTE_BIT);
-  m_restirDescSetLayoutBind.addBinding(RestirBindings::ePrevFrameMaterialProps,
+  m_restirDescSetLayoutBind.addBinding(RestirBindings::eVisibilityCache,
                                        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-                                       VK_SHADER_STAGE_RAYGEN_BIT_KHR |
-                                           VK_SHADER_STAGE_FRAGMENT_BIT |
-                                           VK_SHADER_STAGE_COMPUTE_BIT);
-  m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::eReservoirsInfo, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
-          VK_SHADER_STAGE_COMPUTE_BIT);
+                                       VK_SHADER_STAGE_RAYGEN_BIT_KHR);
   m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::eReservoirWeights, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
-          VK_SHADER_STAGE_COMPUTE_BIT);
+      RestirBindings::eDensityGrid, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      1, VK_SHADER_STAGE_RAYGEN_BIT_KHR);
   m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::ePrevReservoirInfo, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
-          VK_SHADER_STAGE_COMPUTE_BIT);
+      RestirBindings::eDensityBricks,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+      VK_SHADER_STAGE_RAYGEN_BIT_KHR);
   m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::ePrevReservoirWeight, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
-          VK_SHADER_STAGE_COMPUTE_BIT);
-  m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::eTmpReservoirInfo, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
-          VK_SHADER_STAGE_COMPUTE_BIT);
-  m_restirDescSetLayoutBind.addBinding(
-      RestirBindings::eTmpReservoirWeight, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
-      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_FRAGMENT_BIT |
-          VK_SHADER_STAGE_COMPUTE_BIT);
+      RestirBindings::eBlueNoise, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+      VK_SHADER_STAGE_RAYGEN_BIT_KHR);
   // TODO: investigate whether we bind this to fragment shader
   m_restirDescSetLayoutBind.addBinding(
       RestirBindings::eStorageImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
@@ -1984,27 +2649,11 @@ void Renderer::updateRestirDescriptorSet() {
                                         static_config::kNumGBuffers];
 
     writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::eFrameWorldPosition,
-        &buf.getWorldPosTexture().descriptor));
-    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::eFrameAlbedo, &buf.getAlbedoTexture().descriptor));
-    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::eFrameNormal, &buf.getNormalTexture().descriptor));
-    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::eFrameMaterialProps,
-        &buf.getMaterialPropertiesTexture().descriptor));
-    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::ePrevFrameWorldPosition,
-        &bufprev.getWorldPosTexture().descriptor));
-    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::ePrevFrameAlbedo,
-        &bufprev.getAlbedoTexture().descriptor));
+        set, RestirBindings::eFrameGBuffer,
+        &buf.getPackedTexture().descriptor));
     writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::ePrevFrameNormal,
-        &bufprev.getNormalTexture().descriptor));
-    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::ePrevFrameMaterialProps,
-        &bufprev.getMaterialPropertiesTexture().descriptor));
+        set, RestirBindings::ePrevFrameGBuffer,
+        &bufprev.getPackedTexture().descriptor));
 
     // VkDescriptorImageInfo imgInfo{
     //    {}, m_storageImage.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
@@ -2012,27 +2661,24 @@ void Renderer::updateRestirDescriptorSet() {
     //    set, RestirBindings::eStorageImage, &imgInfo));
 
     writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::eReservoirsInfo,
-        &m_reservoirInfoBuffers[i].descriptor));
-    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::eReservoirWeights,
-        &m_reservoirWeightBuffers[i].descriptor));
+        set, RestirBindings::eReservoirs, &m_reservoirBuffers[i].descriptor));
     writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::ePrevReservoirInfo,
-        &m_reservoirInfoBuffers[(static_config::kNumGBuffers + i - 1) %
-                                static_config::kNumGBuffers]
+        set, RestirBindings::ePrevReservoirs,
+        &m_reservoirBuffers[(static_config::kNumGBuffers + i - 1) %
+                            static_config::kNumGBuffers]
              .descriptor));
     writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::ePrevReservoirWeight,
-        &m_reservoirWeightBuffers[(static_config::kNumGBuffers + i - 1) %
-                                  static_config::kNumGBuffers]
-             .descriptor));
+        set, RestirBindings::eTmpReservoirs,
+        &m_reservoirTmpBuffer.descriptor));
+    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
+        set, RestirBindings::eVisibilityCache, &m_visibilityCache.descriptor));
+    writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
+        set, RestirBindings::eDensityGrid, &m_densityGridTexture.descriptor));
     writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::eTmpReservoirInfo,
-        &m_reservoirTmpInfoBuffer.descriptor));
+        set, RestirBindings::eDensityBricks,
+        &m_densityBricksTexture.descriptor));
     writes.emplace_back(m_restirDescSetLayoutBind.makeWrite(
-        set, RestirBindings::eTmpReservoirWeight,
-        &m_reservoirTmpWeightBuffer.descriptor));
+        set, RestirBindings::eBlueNoise, &m_blueNoiseTexture.descriptor));
   }
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()),
                          writes.data(), 0, nullptr);
@@ -2187,8 +2833,8 @@ void Renderer::createRtPipeline() {
   rayPipelineInfo.maxPipelineRayRecursionDepth = 2;  // Ray depth
   rayPipelineInfo.layout                       = m_rtPipelineLayout;
 
-  vkCreateRayTracingPipelinesKHR(m_device, {}, {}, 1, &rayPipelineInfo, nullptr,
-                                 &m_rtPipeline);
+  vkCreateRayTracingPipelinesKHR(m_device, {}, m_pipelineCache, 1,
+                                 &rayPipelineInfo, nullptr, &m_rtPipeline);
 
   for (auto& s : stages) vkDestroyShaderModule(m_device, s.module, nullptr);
   spdlog::info("Created ray tracing pipeline");
@@ -2292,7 +2938,7 @@ void Renderer::raytrace(const VkCommandBuffer& cmdBuf,
   m_pcRay.lightIntensity = m_pcRaster.lightIntensity;
   m_pcRay.lightType      = m_pcRaster.lightType;
 
-  std::vector<VkDescriptorSet> descSets{m_rtDescSet, m_descSet};
+  std::vector<VkDescriptorSet> descSets{m_rtDescSet, getDescSet()};
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
                     m_rtPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
@@ -2316,26 +2962,86 @@ void Renderer::raytrace(const VkCommandBuffer& cmdBuf,
 void Renderer::createRestirPipeline() {
   m_restirPass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex,
                      &m_alloc);
-  m_restirPass.createRenderPass(m_size);
-  m_restirPass.createPipeline(m_rtDescSetLayout, m_descSetLayout,
-                              m_restirUniformDescSetLayout,
-                              m_lightDescSetLayout, m_restirDescSetLayout);
+  m_restirPass.createRenderPass(getRenderExtent());
+  m_restirPass.createPipeline(
+      m_rtDescSetLayout, m_descSetLayout, m_restirUniformDescSetLayout,
+      m_lightDescSetLayout, m_restirDescSetLayout, m_pipelineCache);
   spdlog::info("Created ReSTIR pass pipeline");
 }
 
+//--------------------------------------------------------------------------------------------------
+// Create Temporal Reuse pipeline
+//
+void Renderer::createTemporalReusePipeline() {
+  m_temporalReusePass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex,
+                            &m_alloc);
+  m_temporalReusePass.createRenderPass(getRenderExtent());
+  m_temporalReusePass.createPipeline(
+      m_rtDescSetLayout, m_descSetLayout, m_restirUniformDescSetLayout,
+      m_lightDescSetLayout, m_restirDescSetLayout, m_pipelineCache);
+  spdlog::info("Created Temporal Reuse pass pipeline");
+}
+
 //--------------------------------------------------------------------------------------------------
 // Create Spatial Reuse pipeline
 //
 void Renderer::createSpatialReusePipeline() {
   m_spatialReusePass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex,
                            &m_alloc);
-  m_spatialReusePass.createRenderPass(m_size);
+  m_spatialReusePass.createRenderPass(getRenderExtent());
+  m_spatialReusePass.setIterations(static_config::kSpatialReuseIterations);
   m_spatialReusePass.createPipeline(
       m_rtDescSetLayout, m_descSetLayout, m_restirUniformDescSetLayout,
-      m_lightDescSetLayout, m_restirDescSetLayout);
+      m_lightDescSetLayout, m_restirDescSetLayout, m_pipelineCache);
   spdlog::info("Created Spatial Reuse pass pipeline");
 }
 
+//--------------------------------------------------------------------------------------------------
+// Create the ReSTIR pipelines on worker threads; they only share the
+// pipeline cache, which is internally synchronized
+//
+void Renderer::createRestirPipelines() {
+  const auto start = std::chrono::steady_clock::now();
+  const std::array<std::function<void()>, 4> creators = {
+      [this] { createRestirPipeline(); },
+      [this] { createTemporalReusePipeline(); },
+      [this] { createSpatialReusePipeline(); },
+      [this] { createRestirPostPipeline(); }};
+  parallelBatches(
+      creators.size(),
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          creators[i]();
+        }
+      },
+      1);
+  m_restirPass.createShaderBindingTable();
+  spdlog::info("Created the ReSTIR pipelines in {} ms",
+               std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count());
+}
+
+//--------------------------------------------------------------------------------------------------
+// Recreates the temporal and spatial reuse pipelines with `tile` as their
+// local size; waits for the device
+//
+void Renderer::setReuseTile(const WorkgroupSize& tile) {
+  vkDeviceWaitIdle(m_device);
+  m_temporalReusePass.destroy();
+  m_spatialReusePass.destroy();
+  m_temporalReusePass.setTile(tile);
+  m_spatialReusePass.setTile(tile);
+  createTemporalReusePipeline();
+  createSpatialReusePipeline();
+}
+
+VkExtent2D Renderer::getRenderExtent() const {
+  const nvmath::vec2ui size = renderScaleSize(
+      nvmath::vec2ui(m_size.width, m_size.height), static_config::kRenderScale);
+  return VkExtent2D{size.x, size.y};
+}
+
 void Renderer::createRestirUniformBuffer() {
   const float aspectRatio    = m_size.width / static_cast<float>(m_size.height);
   m_restirUniforms.debugMode = 0;
@@ -2343,7 +3049,47 @@ void Renderer::createRestirUniformBuffer() {
   m_restirUniforms.screenSize = nvmath::vec2ui(m_size.width, m_size.height);
   m_restirUniforms.flags      = RESTIR_VISIBILITY_REUSE_FLAG |
                            RESTIR_TEMPORAL_REUSE_FLAG |
-                           RESTIR_SPATIAL_REUSE_FLAG;   // const
+                           RESTIR_SPATIAL_REUSE_FLAG |
+                           RESTIR_LOW_DISCREPANCY_FLAG;  // const
+  if (!m_environmentMap.empty()) {
+    m_restirUniforms.flags |= USE_ENVIRONMENT_FLAG;
+  }
+  if (static_config::kMisReuse) {
+    m_restirUniforms.flags |= RESTIR_MIS_REUSE_FLAG;
+  }
+  if (static_config::kVisibilityCache) {
+    m_restirUniforms.flags |= RESTIR_VISIBILITY_CACHE_FLAG;
+  }
+  // the cleared cache holds epoch 0
+  m_restirUniforms.visibilityCacheEpoch  = 1;
+  m_restirUniforms.visibilityCacheMaxAge =
+      static_config::kVisibilityCacheMaxAge;
+  m_restirUniforms.renderScale = static_config::kRenderScale;
+  // the medium needs the grid of a loaded VDB
+  if (static_config::kVolumetric && !m_densityGrid.extinction.empty()) {
+    m_restirUniforms.flags |= RESTIR_VOLUME_FLAG;
+#ifdef USE_ANIMATION
+    // the grid is splatted from the spheres once, at load, and animationObject
+    // skips the chunks it cannot see
+    spdlog::warn("USE_ANIMATION has no effect on the volumetric medium, which "
+                 "stays as loaded; set kVolumetric to false to animate the "
+                 "spheres");
+#endif
+  }
+  m_restirUniforms.volumeBoundsMin  = nvmath::vec4f(m_densityGrid.boundsMin, 1);
+  m_restirUniforms.volumeBoundsMax  = nvmath::vec4f(m_densityGrid.boundsMax, 1);
+  m_restirUniforms.volumeAlbedo     = nvmath::vec4f(
+      nvmath::vec3f(static_config::kVolumeAlbedo), 1.0f);
+  m_restirUniforms.volumeMajorant   = m_densityGrid.majorant;
+  m_restirUniforms.volumeAnisotropy = static_config::kVolumeAnisotropy;
+  m_restirUniforms.transmittanceEstimator =
+      static_config::kTransmittanceEstimator;
+  m_restirUniforms.phaseModel       = static_config::kPhaseModel;
+  m_restirUniforms.phaseAnisotropy2 = static_config::kPhaseAnisotropy2;
+  m_restirUniforms.phaseBlend       = static_config::kPhaseBlend;
+  m_restirUniforms.phaseDraineAlpha = static_config::kPhaseDraineAlpha;
+  m_restirUniforms.renderSize  = nvmath::vec2ui(getRenderExtent().width,
+                                                getRenderExtent().height);
   m_restirUniforms.spatialNeighbors        = 4;         // const
   m_restirUniforms.spatialRadius           = 30.0f;     // const
   m_restirUniforms.initialLightSampleCount = (1 << 6);  // const
@@ -2356,29 +3102,50 @@ void Renderer::createRestirUniformBuffer() {
   m_restirUniforms.environmentalPower            = 1.0;  // don't need
   m_restirUniforms.fireflyClampThreshold         = 2.0;  // don't need
   m_restirUniforms.temporalSampleCountMultiplier = 20;   // const
+  m_restirUniforms.frameIndex                    = 0;
   m_restirUniforms.currCamPos                    = CameraManip.getCamera().eye;
   m_restirUniforms.currFrameProjectionViewMatrix =
       nvmath::perspectiveVK(CameraManip.getFov(), aspectRatio, 0.1f, 1000.0f) *
       CameraManip.getMatrix();
+  m_restirUniforms.currFrameViewInverse =
+      nvmath::invert(CameraManip.getMatrix());
+  m_restirUniforms.currFrameProjectionInverse = nvmath::invert(
+      nvmath::perspectiveVK(CameraManip.getFov(), aspectRatio, 0.1f, 1000.0f));
   m_restirUniforms.prevCamPos = CameraManip.getCamera().eye;
   m_restirUniforms.prevFrameProjectionViewMatrix =
-      nvmath::perspectiveVK(CameraManip.getFov(), aspectRatio, 0.1f, 1000.0f) *
-      CameraManip.getMatrix();
-
-  m_restirUniformBuffer = m_alloc.createBuffer(
-      sizeof(RestirUniforms),
-      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  m_debug.setObjectName(m_restirUniformBuffer.buffer, "restirUniformBuffer");
+      m_restirUniforms.currFrameProjectionViewMatrix;
+  m_restirUniforms.prevFrameViewInverse = m_restirUniforms.currFrameViewInverse;
+  m_restirUniforms.prevFrameProjectionInverse =
+      m_restirUniforms.currFrameProjectionInverse;
+
+  // one per frame slot, host visible and mapped as the camera matrices
+  m_restirUniformBuffers.resize(m_frameRing.slots());
+  m_restirUniformData.resize(m_frameRing.slots());
+  for (uint32_t slot = 0; slot < m_frameRing.slots(); ++slot) {
+    m_restirUniformBuffers[slot] = m_alloc.createBuffer(
+        sizeof(RestirUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_debug.setObjectName(m_restirUniformBuffers[slot].buffer,
+                          "restirUniformBuffer" + std::to_string(slot));
+    m_restirUniformData[slot] =
+        static_cast<RestirUniforms*>(m_alloc.map(m_restirUniformBuffers[slot]));
+    *m_restirUniformData[slot] = m_restirUniforms;
+  }
   spdlog::info("Created ReSTIR uniform buffer");
 }
 
-void Renderer::updateRestirUniformBuffer(const VkCommandBuffer& cmdBuf) {
+void Renderer::updateRestirUniformBuffer() {
   // Prepare new UBO contents on host.
   m_restirUniforms.prevCamPos = m_restirUniforms.currCamPos;
   m_restirUniforms.prevFrameProjectionViewMatrix =
       m_restirUniforms.currFrameProjectionViewMatrix;
+  m_restirUniforms.prevFrameViewInverse = m_restirUniforms.currFrameViewInverse;
+  m_restirUniforms.prevFrameProjectionInverse =
+      m_restirUniforms.currFrameProjectionInverse;
   m_restirUniforms.screenSize = nvmath::vec2ui(m_size.width, m_size.height);
+  m_restirUniforms.renderSize = nvmath::vec2ui(getRenderExtent().width,
+                                               getRenderExtent().height);
 
   const float aspectRatio = m_size.width / static_cast<float>(m_size.height);
   const auto& view        = CameraManip.getMatrix();
@@ -2388,40 +3155,13 @@ void Renderer::updateRestirUniformBuffer(const VkCommandBuffer& cmdBuf) {
   // perspectiveVK).
   m_restirUniforms.currCamPos                    = CameraManip.getCamera().eye;
   m_restirUniforms.currFrameProjectionViewMatrix = proj * view;
+  // the primary rays are reconstructed exactly as restir.rgen traces them
+  m_restirUniforms.currFrameViewInverse       = nvmath::invert(view);
+  m_restirUniforms.currFrameProjectionInverse = nvmath::invert(proj);
+  m_restirUniforms.frameIndex++;
 
-  // UBO on the device, and what stages access it.
-  VkBuffer restirVkBuffer      = m_restirUniformBuffer.buffer;
-  auto restirUniformUsageMasks = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
-                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
-                                 VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
-
-  // Ensure that the modified UBO is not visible to previous frames.
-  VkBufferMemoryBarrier beforeBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
-  beforeBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  beforeBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  beforeBarrier.buffer        = restirVkBuffer;
-  beforeBarrier.offset        = 0;
-  beforeBarrier.size          = sizeof(m_restirUniforms);
-  vkCmdPipelineBarrier(cmdBuf, restirUniformUsageMasks,
-                       VK_PIPELINE_STAGE_TRANSFER_BIT,
-                       VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 1,
-                       &beforeBarrier, 0, nullptr);
-
-  // Schedule the host-to-device upload. (m_restirUniforms is copied into the
-  // cmd buffer so it is okay to deallocate when the function returns).
-  vkCmdUpdateBuffer(cmdBuf, m_restirUniformBuffer.buffer, 0,
-                    sizeof(RestirUniforms), &m_restirUniforms);
-
-  // Making sure the updated UBO will be visible.
-  VkBufferMemoryBarrier afterBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
-  afterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  afterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  afterBarrier.buffer        = restirVkBuffer;
-  afterBarrier.offset        = 0;
-  afterBarrier.size          = sizeof(m_restirUniforms);
-  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                       restirUniformUsageMasks, VK_DEPENDENCY_DEVICE_GROUP_BIT,
-                       0, nullptr, 1, &afterBarrier, 0, nullptr);
+  // the buffer of the current frame slot, no frame in flight reads it
+  *m_restirUniformData[m_frameRing.current()] = m_restirUniforms;
 }
 
 void Renderer::createRestirUniformDescriptorSet() {
@@ -2432,20 +3172,26 @@ void Renderer::createRestirUniformDescriptorSet() {
           VK_SHADER_STAGE_MISS_BIT_KHR);
   m_restirUniformDescSetLayout =
       m_restirUniformDescSetLayoutBind.createLayout(m_device);
-  m_restirUniformDescPool =
-      m_restirUniformDescSetLayoutBind.createPool(m_device);
-  m_restirUniformDescSet = nvvk::allocateDescriptorSet(
-      m_device, m_restirUniformDescPool, m_restirUniformDescSetLayout);
+  m_restirUniformDescPool = m_restirUniformDescSetLayoutBind.createPool(
+      m_device, m_frameRing.slots());
+  nvvk::allocateDescriptorSets(m_device, m_restirUniformDescPool,
+                               m_restirUniformDescSetLayout,
+                               m_frameRing.slots(), m_restirUniformDescSets);
 }
 
 void Renderer::updateRestirUniformDescriptorSet() {
   std::vector<VkWriteDescriptorSet> writes;
 
-  // Camera matrices and scene description
-  VkDescriptorBufferInfo dbiUnif{m_restirUniformBuffer.buffer, 0,
-                                 VK_WHOLE_SIZE};
-  writes.emplace_back(m_restirUniformDescSetLayoutBind.makeWrite(
-      m_restirUniformDescSet, RestirUniformBindings::eUniform, &dbiUnif));
+  // the uniforms of each frame slot
+  std::vector<VkDescriptorBufferInfo> dbiUnif;
+  for (const nvvk::Buffer& buffer : m_restirUniformBuffers) {
+    dbiUnif.push_back({buffer.buffer, 0, VK_WHOLE_SIZE});
+  }
+  for (uint32_t slot = 0; slot < m_frameRing.slots(); ++slot) {
+    writes.emplace_back(m_restirUniformDescSetLayoutBind.makeWrite(
+        m_restirUniformDescSets[slot], RestirUniformBindings::eUniform,
+        &dbiUnif[slot]));
+  }
 
   // Writing the information
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()),
@@ -2460,12 +3206,19 @@ void Renderer::updateFrame() {
   const auto& m  = CameraManip.getMatrix();
   const auto fov = CameraManip.getFov();
 
-  if (memcmp(&refCamMatrix.a00, &m.a00, sizeof(nvmath::mat4f)) != 0 ||
-      refFov != fov) {
+  const bool cameraMoved =
+      memcmp(&refCamMatrix.a00, &m.a00, sizeof(nvmath::mat4f)) != 0 ||
+      refFov != fov;
+  if (cameraMoved) {
     resetFrame();
     refCamMatrix = m;
     refFov       = fov;
   }
+  // cached visibility stays valid in world space, but a moving camera shifts
+  // the shading points inside their cells, so entries are refreshed sooner
+  m_restirUniforms.visibilityCacheMaxAge =
+      cameraMoved ? static_config::kVisibilityCacheMaxAgeMoving
+                  : static_config::kVisibilityCacheMaxAge;
   m_pcRestirPost.frame++;
 }
 
@@ -2530,7 +3283,8 @@ void Renderer::createCompPipelines() {
       nvh::loadFile("spv/anim.comp.spv", true, defaultSearchPaths, true),
       VK_SHADER_STAGE_COMPUTE_BIT);
 
-  vkCreateComputePipelines(m_device, {}, 1, &computePipelineCreateInfo, nullptr,
+  vkCreateComputePipelines(m_device, m_pipelineCache, 1,
+                           &computePipelineCreateInfo, nullptr,
                            &m_compPipeline);
 
   updateCompDescriptors(m_spheresAabbBuffer, m_spheresBuffer);
@@ -2540,19 +3294,12 @@ void Renderer::createCompPipelines() {
 }
 
 //--------------------------------------------------------------------------------------------------
-// Animating the sphere vertices using a compute shader
+// Animating the sphere vertices using a compute shader, over the chunks of
+// spheres that move only, then refitting or rebuilding their BLAS. The medium
+// of RESTIR_VOLUME_FLAG is the density grid splatted at load, and its rays
+// never see the chunk instances, so nothing moves in that mode
 //
 void Renderer::animationObject(float t1) {
-  // const uint32_t sphereId =
-  //    1;  // Get from where we are loading spheres, HArd code for now
-
-  nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
-  VkCommandBuffer cmdBuf = genCmdBuf.createCommandBuffer();
-
-  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_compPipeline);
-  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
-                          m_compPipelineLayout, 0, 1, &m_compDescSet, 0,
-                          nullptr);
   float deltaT;
   if (t1 < t0) {
     deltaT = t1;
@@ -2560,28 +3307,55 @@ void Renderer::animationObject(float t1) {
     deltaT = t1 - t0;
   }
   t0 = t1;
-  CompPushConstant abc{deltaT, m_spheres.size()};
-  // CompPushConstant abc{t1, 9920};
-  vkCmdPushConstants(cmdBuf, m_compPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
-                     0, sizeof(CompPushConstant), &abc);
+  if ((m_restirUniforms.flags & RESTIR_VOLUME_FLAG) != 0) {
+    return;
+  }
+  const std::vector<ChunkUpdate>& updates = m_volumeChunks.advance(deltaT);
+  if (std::all_of(updates.begin(), updates.end(), [](ChunkUpdate update) {
+        return update == ChunkUpdate::eNone;
+      })) {
+    return;
+  }
 
-  // int height = WORKGROUP_SIZE;
-  // int width = m_spheres.size()/ (1024 * 512) + 1;
+  nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+  VkCommandBuffer cmdBuf = genCmdBuf.createCommandBuffer();
 
-  int total = m_spheres.size();
-  int width = std::ceil(total / 1024);
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_compPipeline);
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_compPipelineLayout, 0, 1, &m_compDescSet, 0,
+                          nullptr);
+  // a dispatch per run of consecutive moving chunks
+  for (uint32_t c = 0; c < updates.size();) {
+    if (updates[c] == ChunkUpdate::eNone) {
+      ++c;
+      continue;
+    }
+    const uint32_t first = m_volumeChunks.chunk(c).first;
+    uint32_t count       = 0;
+    for (; c < updates.size() && updates[c] != ChunkUpdate::eNone; ++c) {
+      count += m_volumeChunks.chunk(c).count;
+    }
+    CompPushConstant abc{deltaT, static_cast<int>(count),
+                         static_cast<int>(first)};
+    vkCmdPushConstants(cmdBuf, m_compPipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CompPushConstant),
+                       &abc);
+    const DispatchGroups groups = dispatchGroups(count, 1, 1, kAnimationGroup);
+    vkCmdDispatch(cmdBuf, groups.x, groups.y, groups.z);
+  }
 
-  vkCmdDispatch(cmdBuf, width, 1,
-                1);  // size of sphere is the size we need
+  // the moved AABBs are the input of the BLAS builds
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+  cmdBuildVolumeBlas(cmdBuf, updates);
 
   genCmdBuf.submitAndWait(cmdBuf);
-  m_rtBuilder.updateBlas(
-      SphereBlasID, allBlas[SphereBlasID],
-      VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR |
-          VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR);
-
-  VkAccelerationStructureInstanceKHR& tinst = tlas[SphereBlasID];
-  tinst.transform = nvvk::toTransformMatrixKHR(nvmath::mat4f(1));
+  // moved geometry invalidates every cached shadow ray
+  ++m_restirUniforms.visibilityCacheEpoch;
   m_rtBuilder.buildTlas(
       tlas,
       VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR |
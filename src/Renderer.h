@@ -19,17 +19,29 @@
 
 #pragma once
 
+#include <unordered_map>
+
 #include "GBuffer.hpp"
 #include "SingletonManager.hpp"
+#include "TlsfMemAllocator.hpp"
+#include "UploadManager.hpp"
 #include "config/static_config.hpp"
 #include "nvvk/appbase_vk.hpp"
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
-#include "nvvk/memallocator_dma_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
+#include "passes/renderGraph.h"
 #include "passes/restirPass.h"
 #include "passes/spatialReusePass.h"
+#include "passes/temporalReusePass.h"
 #include "shaders/host_device.h"
+#include "utils/batch_render.hpp"
+#include "utils/dispatch.hpp"
+#include "utils/environment_map.hpp"
+#include "utils/frame_ring.hpp"
+#include "utils/low_discrepancy.hpp"
+#include "utils/volume.hpp"
+#include "utils/volume_chunks.hpp"
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
 
@@ -61,19 +73,44 @@ public:
     uint32_t objIndex{0};     // Model index reference
   };
 
+  // Before `setup`, whether VK_EXT_memory_budget is enabled on the device
+  void setMemoryBudgetSupported(bool supported) {
+    m_hasMemoryBudget = supported;
+  }
   void setup(const VkInstance& instance, const VkDevice& device,
              const VkPhysicalDevice& physicalDevice,
              uint32_t queueFamily) override;
+  void setupUploads(const VkQueue& transferQueue, uint32_t transferQueueIndex);
+  void createPipelineCache(const std::string& filename);
+  void savePipelineCache() const;
+
+  // #Headless - offscreen targets read back per slot, see
+  // utils/batch_render.hpp
+  void setupHeadless(uint32_t width, uint32_t height);
+  void createRenderPass() override;
+  void createHeadlessTargets(uint32_t slots);
+  VkCommandBuffer beginHeadlessFrame(uint32_t slot);
+  void endHeadlessFrame(uint32_t slot);
+  void readHeadlessFrame(uint32_t slot, BatchImage& image) const;
+  VkFramebuffer getHeadlessFramebuffer() { return m_headlessFramebuffer; }
+
+  // #FrameRing - uniforms and descriptor sets per frame in flight, see
+  // utils/frame_ring.hpp
+  void createFrameFences();
+  uint32_t beginFrameSlot();
+  void endFrameSlot();
+
   void createDescriptorSetLayout();
   void createGraphicsPipeline();
   void loadModel(const std::string& filename,
                  nvmath::mat4f transform = nvmath::mat4f(1));
   void updateDescriptorSet();
+  void updateDescriptorSet(uint32_t slot);
   void createUniformBuffer();
   void createObjDescriptionBuffer();
   void createTextureImages(const VkCommandBuffer& cmdBuf,
                            const std::vector<std::string>& textures);
-  void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
+  void updateUniformBuffer();
   void onResize(int /*w*/, int /*h*/) override;
   void destroyResources();
   void rasterize(const VkCommandBuffer& cmdBuff);
@@ -89,6 +126,9 @@ public:
   void initRayTracing();
   auto objectToVkGeometryKHR(const ObjModel& model);
   void createBottomLevelAS();
+  void createVolumeBlas();
+  void cmdBuildVolumeBlas(VkCommandBuffer cmdBuf,
+                          const std::vector<ChunkUpdate>& updates);
   void createTopLevelAS();
   void createRtDescriptorSet();
   void updateRtDescriptorSet();
@@ -100,15 +140,17 @@ public:
   void loadGLTFModel(const std::string& filename);
   void createGLTFBuffer();
   void createVDBBuffer();
-  auto sphereToVkGeometryKHR();
+  auto sphereToVkGeometryKHR(uint32_t first, uint32_t count);
 
   // restir lights
+  void loadEnvironmentMap(const std::string& filename);
+  void loadLowDiscrepancyTables(const std::string& filename);
   void createRestirLights();
   void createLightDescriptorSet();
 
   // restir uniform buffers
   void createRestirUniformBuffer();
-  void updateRestirUniformBuffer(const VkCommandBuffer& cmdBuf);
+  void updateRestirUniformBuffer();
   void createRestirUniformDescriptorSet();
   void updateRestirUniformDescriptorSet();
 
@@ -118,13 +160,22 @@ public:
   void updateRestirDescriptorSet();
 
   void createRestirPipeline();
+  void createTemporalReusePipeline();
   void createSpatialReusePipeline();
+  void createRestirPipelines();  // all the above and the post one, in parallel
+  void setReuseTile(const WorkgroupSize& tile);
+  // size of the reservoir grid, see shaders/headers/renderScale.glsl
+  VkExtent2D getRenderExtent() const;
 
   // Post descriptor set for ReSTIR
   void createRestirPostDescriptor();
   void updateRestirPostDescriptorSet();
   void createRestirPostPipeline();
   void restirDrawPost(VkCommandBuffer cmdBuf);
+  // adds the ReSTIR passes of the frame and `post`, which draws the post
+  // render pass, to `graph`
+  void addRestirPasses(RenderGraph& graph, const nvmath::vec4f& clearColor,
+                       RenderGraph::RecordFunction post);
 
   // GBuffers
   void createGBuffers();
@@ -144,10 +195,13 @@ public:
   VkRenderPass& getOffscreenRenderPass() { return m_offscreenRenderPass; }
   VkFramebuffer& getOffscreenFrameBuffer() { return m_offscreenFramebuffer; }
   RestirPass& getRestirPass() { return m_restirPass; }
+  TemporalReusePass& getTemporalReusePass() { return m_temporalReusePass; }
   SpatialReusePass& getSpatialReusePass() { return m_spatialReusePass; }
-  VkDescriptorSet& getDescSet() { return m_descSet; }
+  VkDescriptorSet& getDescSet() { return m_descSets[m_frameRing.current()]; }
   VkDescriptorSet& getRtDescSet() { return m_rtDescSet; }
-  VkDescriptorSet& getRestirUniformDescSet() { return m_restirUniformDescSet; }
+  VkDescriptorSet& getRestirUniformDescSet() {
+    return m_restirUniformDescSets[m_frameRing.current()];
+  }
   VkDescriptorSet& getLightDescSet() { return m_lightDescSet; }
   std::vector<VkDescriptorSet>& getRestirDescSets() { return m_restirDescSets; }
   VkDescriptorSet& getRestirDescSet() {
@@ -187,9 +241,16 @@ private:
   std::vector<VkAccelerationStructureInstanceKHR> tlas;
   std::vector<nvvk::RaytracingBuilderKHR::BlasInput> allBlas;
 
-  int SphereBlasID;
+  // VDB spheres, a BLAS per chunk; the chunk instances come first in `tlas`
+  VolumeChunks m_volumeChunks;
+  std::vector<nvvk::RaytracingBuilderKHR::BlasInput> m_volumeBlasInputs;
+  std::vector<nvvk::AccelKHR> m_volumeBlas;
+  nvvk::Buffer m_volumeScratchBuffer;  // a slot per chunk built at once
+  VkDeviceSize m_volumeScratchStride{0};
+  uint32_t m_volumeScratchSlots{0};
 
-  nvvk::Buffer m_bGlobals;  // Device-Host of the camera matrices
+  std::vector<nvvk::Buffer> m_bGlobals;  // camera matrices per frame slot
+  std::vector<GlobalUniforms*> m_globalsData;  // mapped m_bGlobals
   nvvk::Buffer m_bObjDesc;  // Device buffer of the OBJ descriptions
 
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
@@ -206,8 +267,13 @@ private:
   nvvk::Buffer m_gltfPrimLookup;
   std::vector<nvvk::Texture> m_gltfTextures;
 
-  nvvk::ResourceAllocatorDma
+  TlsfMemAllocator m_memAlloc;  // Device memory of m_alloc, by category
+  bool m_hasMemoryBudget{false};
+  bool m_headless{false};  // setupHeadless instead of createSwapchain
+  nvvk::ResourceAllocator
       m_alloc;  // Allocator for buffer, images, acceleration structures
+  UploadManager m_uploader;  // Scene uploads on the transfer queue
+  std::string m_pipelineCacheFile;  // m_pipelineCache of AppBaseVk on exit
   nvvk::DebugUtil m_debug;  // Utility to name objects
 
   VkPipeline m_postPipeline{VK_NULL_HANDLE};
@@ -216,11 +282,20 @@ private:
   VkFramebuffer m_offscreenFramebuffer{VK_NULL_HANDLE};
   nvvk::Texture m_offscreenColor;  // output img buffer from RtPipeline
   nvvk::Texture m_offscreenDepth;
+  // target of the post render pass without a swapchain
+  nvvk::Texture m_headlessColor;
+  VkFramebuffer m_headlessFramebuffer{VK_NULL_HANDLE};
+  std::vector<VkCommandBuffer> m_headlessCmdBufs;  // per readback slot
+  std::vector<VkFence> m_headlessFences;
+  std::vector<nvvk::Buffer> m_readbackBuffers;
+  std::vector<const float*> m_readbackData;  // mapped m_readbackBuffers
   VkFormat m_offscreenColorFormat{VK_FORMAT_R32G32B32A32_SFLOAT};
   VkFormat m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};
 
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtProperties{
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
+  VkPhysicalDeviceAccelerationStructurePropertiesKHR m_asProperties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR};
   nvvk::RaytracingBuilderKHR m_rtBuilder;
 
   std::vector<VkRayTracingShaderGroupCreateInfoKHR> m_rtShaderGroups;
@@ -233,11 +308,13 @@ private:
 
   // pass
   RestirPass m_restirPass;
+  TemporalReusePass m_temporalReusePass;
   SpatialReusePass m_spatialReusePass;
 
   // restir uniforms
   RestirUniforms m_restirUniforms;
-  nvvk::Buffer m_restirUniformBuffer;
+  std::vector<nvvk::Buffer> m_restirUniformBuffers;  // per frame slot
+  std::vector<RestirUniforms*> m_restirUniformData;  // mapped
 
   // restir lights
   std::vector<PointLight> m_pointLights;
@@ -246,15 +323,27 @@ private:
   nvvk::Buffer m_ptLightsBuffer;
   nvvk::Buffer m_triangleLightsBuffer;
   nvvk::Buffer m_aliasTableBuffer;
+  EnvironmentMap m_environmentMap;  // empty unless `loadEnvironmentMap`
+  nvvk::Texture m_environmentTexture;
+  nvvk::Buffer m_environmentAliasTableBuffer;
 
   // restir reservoirs
-  std::vector<nvvk::Texture> m_reservoirInfoBuffers;
-  std::vector<nvvk::Texture> m_reservoirWeightBuffers;
-  nvvk::Texture m_reservoirTmpInfoBuffer;
-  nvvk::Texture m_reservoirTmpWeightBuffer;
+  std::vector<nvvk::Texture> m_reservoirBuffers;  // rgba32ui, packed
+  nvvk::Texture m_reservoirTmpBuffer;
+  nvvk::Texture m_visibilityCache;  // see headers/visibilityCache.glsl
+  DensityGrid m_densityGrid;         // empty without a VDB
+  nvvk::Texture m_densityGridTexture;
+  nvvk::Texture m_densityBricksTexture;  // min and max extinction per brick
+  // generated by `createRestirBuffer` unless `loadLowDiscrepancyTables`
+  LowDiscrepancyTables m_lowDiscrepancyTables;
+  nvvk::Texture m_blueNoiseTexture;
   // TODO: output img buffer from `Restir`Pipeline
   //  may have to combine it with m_offscreenColor
   nvvk::Texture m_storageImage;
+  // memory blocks of the reservoirs, visibility cache and storage image, and
+  // the first image of the block of each image sharing one
+  std::vector<nvvk::MemHandle> m_transientBlocks;
+  std::unordered_map<VkImage, VkImage> m_imageAliases;
 
   // restir post pipelines
   VkPipeline m_restirPostPipeline{VK_NULL_HANDLE};
@@ -263,7 +352,7 @@ private:
   nvvk::DescriptorSetBindings m_descSetLayoutBind;
   VkDescriptorPool m_descPool{VK_NULL_HANDLE};
   VkDescriptorSetLayout m_descSetLayout{VK_NULL_HANDLE};
-  VkDescriptorSet m_descSet{VK_NULL_HANDLE};
+  std::vector<VkDescriptorSet> m_descSets;  // per frame slot
 
   nvvk::DescriptorSetBindings m_postDescSetLayoutBind;
   VkDescriptorPool m_postDescPool{VK_NULL_HANDLE};
@@ -293,7 +382,12 @@ private:
   nvvk::DescriptorSetBindings m_restirUniformDescSetLayoutBind;
   VkDescriptorPool m_restirUniformDescPool{VK_NULL_HANDLE};
   VkDescriptorSetLayout m_restirUniformDescSetLayout{VK_NULL_HANDLE};
-  VkDescriptorSet m_restirUniformDescSet{VK_NULL_HANDLE};
+  std::vector<VkDescriptorSet> m_restirUniformDescSets;  // per frame slot
+
+  // frames in flight, each slot guarded by the fence of its last frame
+  FrameRing m_frameRing{
+      static_cast<uint32_t>(static_config::kMaxFrameInFlight)};
+  std::vector<VkFence> m_frameFences;
 
   // shader binding tables
   nvvk::Buffer m_rtSBTBuffer;
@@ -309,6 +403,7 @@ private:
   PushConstantRestir m_pcRestirPost{0.f, 0.f, 0.f, 0, 1};
 
   std::vector<Sphere> m_spheres;         // All spheres
+  uint32_t m_vdbPointStride{1};          // VDB points per sphere kept
   nvvk::Buffer m_spheresBuffer;          // Buffer holding the spheres
   nvvk::Buffer m_spheresAabbBuffer;      // Buffer of all Aabb
   nvvk::Buffer m_spheresMatColorBuffer;  // Multiple materials
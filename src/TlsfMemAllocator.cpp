@@ -0,0 +1,319 @@
+#include "TlsfMemAllocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "spdlog/spdlog.h"
+
+void TlsfMemAllocator::init(VkDevice device, VkPhysicalDevice physicalDevice,
+                            bool hasMemoryBudget) {
+  m_device          = device;
+  m_physicalDevice  = physicalDevice;
+  m_hasMemoryBudget = hasMemoryBudget;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+  const VkDeviceSize total = deviceLocalBudget(queryHeapBudgets());
+  m_budget.setTotal(total);
+  spdlog::info("Device memory budget of {:.1f} MiB{}",
+               total / (1024.0 * 1024.0),
+               hasMemoryBudget ? "" : ", without VK_EXT_memory_budget");
+}
+
+void TlsfMemAllocator::deinit() {
+  for (const std::unique_ptr<Pool>& pool : m_pools) {
+    releaseEmptyBlocks(*pool);
+    const TlsfStats stats = pool->ranges.stats();
+    if (stats.used > 0) {
+      spdlog::warn("{} bytes of memory type {} still allocated", stats.used,
+                   pool->memoryType);
+    }
+    for (size_t i = 0; i < pool->blocks.size(); ++i) {
+      if (pool->mapped[i] != nullptr) {
+        vkUnmapMemory(m_device, pool->blocks[i]);
+      }
+      if (pool->blocks[i] != VK_NULL_HANDLE) {
+        vkFreeMemory(m_device, pool->blocks[i], nullptr);
+      }
+    }
+  }
+  m_pools.clear();
+  m_device = VK_NULL_HANDLE;
+}
+
+std::vector<HeapBudget> TlsfMemAllocator::queryHeapBudgets() const {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2 properties{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+  if (m_hasMemoryBudget) {
+    properties.pNext = &budgetProperties;
+  }
+  vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &properties);
+
+  const VkPhysicalDeviceMemoryProperties& memory = properties.memoryProperties;
+  std::vector<HeapBudget> heaps(memory.memoryHeapCount);
+  for (uint32_t i = 0; i < memory.memoryHeapCount; ++i) {
+    heaps[i].size        = memory.memoryHeaps[i].size;
+    heaps[i].deviceLocal = (memory.memoryHeaps[i].flags &
+                            VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    if (m_hasMemoryBudget) {
+      heaps[i].budget = budgetProperties.heapBudget[i];
+      heaps[i].usage  = budgetProperties.heapUsage[i];
+    } else {
+      // the driver and the other processes keep part of the heap
+      heaps[i].budget = heaps[i].size / 5 * 4;
+      heaps[i].usage  = 0;
+    }
+  }
+  return heaps;
+}
+
+std::optional<MemoryCategory> TlsfMemAllocator::setCategory(
+    std::optional<MemoryCategory> category) {
+  const std::optional<MemoryCategory> previous = m_category;
+  m_category                                   = category;
+  return previous;
+}
+
+std::vector<TlsfMemAllocator::DefragmentationMove>
+TlsfMemAllocator::planDefragmentation(uint32_t maxMoves) {
+  std::vector<DefragmentationMove> moves;
+  for (const std::unique_ptr<Pool>& pool : m_pools) {
+    if (moves.size() >= maxMoves) {
+      break;
+    }
+    const uint32_t left = maxMoves - static_cast<uint32_t>(moves.size());
+    for (const TlsfMove& move : pool->ranges.planDefragmentation(left)) {
+      DefragmentationMove planned;
+      planned.handle = pool->owners[move.from.node];
+      planned.from   = {pool->blocks[move.from.block], move.from.offset,
+                        move.from.size};
+      planned.to = {pool->blocks[move.to.block], move.to.offset, move.to.size};
+      planned.target = move.to;
+      moves.push_back(planned);
+    }
+  }
+  return moves;
+}
+
+void TlsfMemAllocator::commitMoves(
+    const std::vector<DefragmentationMove>& moves) {
+  for (const DefragmentationMove& move : moves) {
+    Allocation* allocation = static_cast<Allocation*>(move.handle);
+    Pool& pool             = *allocation->pool;
+    pool.ranges.free(allocation->range.node);
+    pool.owners[allocation->range.node] = nullptr;
+
+    allocation->range  = move.target;
+    allocation->memory = pool.blocks[move.target.block];
+    allocation->offset = move.target.offset;
+    allocation->mapped = pool.mapped[move.target.block] != nullptr
+                             ? pool.mapped[move.target.block] +
+                                   move.target.offset
+                             : nullptr;
+    pool.owners[move.target.node] = allocation;
+  }
+  releaseEmptyBlocks();
+}
+
+void TlsfMemAllocator::releaseEmptyBlocks() {
+  for (const std::unique_ptr<Pool>& pool : m_pools) {
+    releaseEmptyBlocks(*pool);
+  }
+}
+
+nvvk::MemHandle TlsfMemAllocator::allocMemory(
+    const nvvk::MemAllocateInfo& allocInfo, VkResult* pResult) {
+  const VkMemoryRequirements& requirements = allocInfo.getMemoryRequirements();
+  const uint32_t memoryType =
+      nvvk::getMemoryType(m_memoryProperties, requirements.memoryTypeBits,
+                          allocInfo.getMemoryProperties());
+  VkResult result = memoryType == ~0u ? VK_ERROR_FEATURE_NOT_PRESENT
+                                      : VK_SUCCESS;
+  const bool hostVisible = result == VK_SUCCESS &&
+                           (m_memoryProperties.memoryTypes[memoryType]
+                                .propertyFlags &
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+  const bool dedicated = allocInfo.getDedicatedBuffer() != VK_NULL_HANDLE ||
+                         allocInfo.getDedicatedImage() != VK_NULL_HANDLE ||
+                         allocInfo.getExportable() ||
+                         requirements.size > kBlockSize / 2;
+
+  auto allocation = std::make_unique<Allocation>();
+  allocation->size     = requirements.size;
+  allocation->category = categoryOf(allocInfo);
+  if (result == VK_SUCCESS && dedicated) {
+    nvvk::BakedAllocateInfo baked;
+    nvvk::fillBakedAllocateInfo(m_memoryProperties, allocInfo, baked);
+    result = vkAllocateMemory(m_device, &baked.memAllocInfo, nullptr,
+                              &allocation->memory);
+    if (result == VK_SUCCESS && hostVisible) {
+      result = vkMapMemory(m_device, allocation->memory, 0, VK_WHOLE_SIZE, 0,
+                           reinterpret_cast<void**>(&allocation->mapped));
+    }
+  } else if (result == VK_SUCCESS) {
+    Pool& pool = poolOf(memoryType, allocInfo.getTilingOptimal(),
+                        allocInfo.getAllocationFlags());
+    std::optional<TlsfAllocation> range =
+        pool.ranges.allocate(requirements.size, requirements.alignment);
+    if (!range) {
+      result = addBlock(pool);
+      if (result == VK_SUCCESS) {
+        range = pool.ranges.allocate(requirements.size, requirements.alignment);
+      }
+    }
+    if (range) {
+      allocation->pool   = &pool;
+      allocation->range  = *range;
+      allocation->memory = pool.blocks[range->block];
+      allocation->offset = range->offset;
+      if (pool.mapped[range->block] != nullptr) {
+        allocation->mapped = pool.mapped[range->block] + range->offset;
+      }
+      if (pool.owners.size() <= range->node) {
+        pool.owners.resize(range->node + 1, nullptr);
+      }
+      pool.owners[range->node] = allocation.get();
+    }
+  }
+
+  if (pResult != nullptr) {
+    *pResult = result;
+  }
+  if (result != VK_SUCCESS) {
+    spdlog::error("Failed to allocate {} bytes of {}: {}", requirements.size,
+                  memoryCategoryName(allocation->category),
+                  static_cast<int>(result));
+    if (allocation->memory != VK_NULL_HANDLE && allocation->pool == nullptr) {
+      vkFreeMemory(m_device, allocation->memory, nullptr);
+    }
+    return nullptr;
+  }
+  charge(allocation->category, allocation->size);
+  return allocation.release();
+}
+
+void TlsfMemAllocator::freeMemory(nvvk::MemHandle memHandle) {
+  if (memHandle == nullptr) {
+    return;
+  }
+  Allocation* allocation = static_cast<Allocation*>(memHandle);
+  m_budget.release(allocation->category, allocation->size);
+  if (allocation->pool != nullptr) {
+    allocation->pool->ranges.free(allocation->range.node);
+    allocation->pool->owners[allocation->range.node] = nullptr;
+  } else {
+    if (allocation->mapped != nullptr) {
+      vkUnmapMemory(m_device, allocation->memory);
+    }
+    vkFreeMemory(m_device, allocation->memory, nullptr);
+  }
+  delete allocation;
+}
+
+nvvk::MemAllocator::MemInfo TlsfMemAllocator::getMemoryInfo(
+    nvvk::MemHandle memHandle) const {
+  const Allocation* allocation = static_cast<const Allocation*>(memHandle);
+  return {allocation->memory, allocation->offset, allocation->size};
+}
+
+void* TlsfMemAllocator::map(nvvk::MemHandle memHandle, VkDeviceSize offset,
+                            VkDeviceSize /*size*/, VkResult* pResult) {
+  const Allocation* allocation = static_cast<const Allocation*>(memHandle);
+  if (pResult != nullptr) {
+    *pResult = allocation->mapped != nullptr ? VK_SUCCESS
+                                             : VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  return allocation->mapped != nullptr ? allocation->mapped + offset
+                                       : nullptr;
+}
+
+void TlsfMemAllocator::unmap(nvvk::MemHandle /*memHandle*/) {
+  // host visible memory stays mapped until it is freed
+}
+
+TlsfMemAllocator::Pool& TlsfMemAllocator::poolOf(uint32_t memoryType,
+                                                 bool tilingOptimal,
+                                                 VkMemoryAllocateFlags flags) {
+  for (const std::unique_ptr<Pool>& pool : m_pools) {
+    if (pool->memoryType == memoryType &&
+        pool->tilingOptimal == tilingOptimal && pool->flags == flags) {
+      return *pool;
+    }
+  }
+  m_pools.push_back(std::make_unique<Pool>());
+  Pool& pool         = *m_pools.back();
+  pool.memoryType    = memoryType;
+  pool.tilingOptimal = tilingOptimal;
+  pool.flags         = flags;
+  return pool;
+}
+
+VkResult TlsfMemAllocator::addBlock(Pool& pool) {
+  VkMemoryAllocateFlagsInfo flagsInfo{
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO};
+  flagsInfo.flags = pool.flags;
+  VkMemoryAllocateInfo allocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocateInfo.pNext           = pool.flags != 0 ? &flagsInfo : nullptr;
+  allocateInfo.allocationSize  = kBlockSize;
+  allocateInfo.memoryTypeIndex = pool.memoryType;
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkResult result = vkAllocateMemory(m_device, &allocateInfo, nullptr, &memory);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+  void* mapped = nullptr;
+  if ((m_memoryProperties.memoryTypes[pool.memoryType].propertyFlags &
+       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+    result = vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    if (result != VK_SUCCESS) {
+      vkFreeMemory(m_device, memory, nullptr);
+      return result;
+    }
+  }
+
+  const uint32_t block = pool.ranges.addBlock(kBlockSize);
+  assert(block == pool.blocks.size());
+  (void)block;
+  pool.blocks.push_back(memory);
+  pool.mapped.push_back(static_cast<uint8_t*>(mapped));
+  return VK_SUCCESS;
+}
+
+void TlsfMemAllocator::releaseEmptyBlocks(Pool& pool) {
+  for (uint32_t block : pool.ranges.releaseEmptyBlocks()) {
+    if (pool.mapped[block] != nullptr) {
+      vkUnmapMemory(m_device, pool.blocks[block]);
+    }
+    vkFreeMemory(m_device, pool.blocks[block], nullptr);
+    pool.blocks[block] = VK_NULL_HANDLE;
+    pool.mapped[block] = nullptr;
+  }
+}
+
+MemoryCategory TlsfMemAllocator::categoryOf(
+    const nvvk::MemAllocateInfo& allocInfo) const {
+  if ((allocInfo.getMemoryProperties() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) !=
+      0) {
+    return MemoryCategory::eStaging;
+  }
+  if (m_category) {
+    return *m_category;
+  }
+  if (allocInfo.getTilingOptimal()) {
+    return MemoryCategory::eFrameImages;
+  }
+  return MemoryCategory::eGeometry;
+}
+
+void TlsfMemAllocator::charge(MemoryCategory category, VkDeviceSize bytes) {
+  const uint32_t i = static_cast<uint32_t>(category);
+  if (!m_budget.charge(category, bytes) && !m_overBudgetReported[i]) {
+    m_overBudgetReported[i] = true;
+    spdlog::warn("{} over its budget: {:.1f} MiB used of {:.1f} MiB",
+                 memoryCategoryName(category),
+                 m_budget.used(category) / (1024.0 * 1024.0),
+                 m_budget.limit(category) / (1024.0 * 1024.0));
+  }
+}
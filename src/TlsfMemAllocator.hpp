@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "nvvk/memallocator_vk.hpp"
+#include "utils/memory_budget.hpp"
+#include "utils/tlsf_allocator.hpp"
+
+// Device memory of nvvk::ResourceAllocator, sub-allocated with TLSF (see
+// `utils/tlsf_allocator.hpp`) from blocks of kBlockSize bytes, a pool of
+// blocks per memory type, allocation flags and tiling so that linear and
+// optimal resources never share a page. Large resources and the ones
+// requiring it get dedicated memory. Host visible memory stays mapped.
+//
+// Every allocation is charged to a category of `utils/memory_budget.hpp`:
+// staging for host visible memory, else the one of the innermost
+// MemoryCategoryScope, else frame images for optimal images and geometry for
+// the rest. The budget is the one of VK_EXT_memory_budget at `init`.
+class TlsfMemAllocator : public nvvk::MemAllocator {
+public:
+  static constexpr VkDeviceSize kBlockSize = 64ull << 20;
+
+  struct DefragmentationMove {
+    nvvk::MemHandle handle;
+    MemInfo from;
+    MemInfo to;
+    TlsfAllocation target;  // reserved until `commitMoves`
+  };
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice,
+            bool hasMemoryBudget);
+  /// Frees the blocks, once every allocation was freed
+  void deinit();
+
+  /// Per heap, the budget of VK_EXT_memory_budget or 80% of its size
+  [[nodiscard]] std::vector<HeapBudget> queryHeapBudgets() const;
+
+  [[nodiscard]] const MemoryBudget& budget() const { return m_budget; }
+
+  /// Category of the following device-local allocations, nothing to infer
+  /// it; returns the previous one
+  std::optional<MemoryCategory> setCategory(
+      std::optional<MemoryCategory> category);
+
+  /// Up to `maxMoves` allocations out of the emptiest block of each pool.
+  /// The caller copies their content to `to`, binds new resources there,
+  /// then calls `commitMoves`; the handles must stay allocated meanwhile
+  [[nodiscard]] std::vector<DefragmentationMove> planDefragmentation(
+      uint32_t maxMoves);
+  /// The handles of `moves` now refer to their new ranges; frees the blocks
+  /// left empty
+  void commitMoves(const std::vector<DefragmentationMove>& moves);
+
+  /// Frees the blocks without allocations
+  void releaseEmptyBlocks();
+
+  nvvk::MemHandle allocMemory(const nvvk::MemAllocateInfo& allocInfo,
+                              VkResult* pResult = nullptr) override;
+  void freeMemory(nvvk::MemHandle memHandle) override;
+  MemInfo getMemoryInfo(nvvk::MemHandle memHandle) const override;
+  void* map(nvvk::MemHandle memHandle, VkDeviceSize offset = 0,
+            VkDeviceSize size = VK_WHOLE_SIZE,
+            VkResult* pResult = nullptr) override;
+  void unmap(nvvk::MemHandle memHandle) override;
+  VkDevice getDevice() const override { return m_device; }
+  VkPhysicalDevice getPhysicalDevice() const override {
+    return m_physicalDevice;
+  }
+
+private:
+  struct Allocation;
+
+  struct Pool {
+    uint32_t memoryType;
+    bool tilingOptimal;
+    VkMemoryAllocateFlags flags;
+    TlsfAllocator ranges;
+    std::vector<VkDeviceMemory> blocks;  // by block index of `ranges`
+    std::vector<uint8_t*> mapped;
+    std::vector<Allocation*> owners;  // by node of `ranges`
+  };
+
+  struct Allocation : public nvvk::MemHandleBase {
+    Pool* pool{nullptr};  // null when dedicated
+    TlsfAllocation range{};
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};
+    uint8_t* mapped{nullptr};
+    MemoryCategory category{MemoryCategory::eGeometry};
+  };
+
+  Pool& poolOf(uint32_t memoryType, bool tilingOptimal,
+               VkMemoryAllocateFlags flags);
+  VkResult addBlock(Pool& pool);
+  void releaseEmptyBlocks(Pool& pool);
+  MemoryCategory categoryOf(const nvvk::MemAllocateInfo& allocInfo) const;
+  void charge(MemoryCategory category, VkDeviceSize bytes);
+
+  VkDevice m_device{VK_NULL_HANDLE};
+  VkPhysicalDevice m_physicalDevice{VK_NULL_HANDLE};
+  VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+  bool m_hasMemoryBudget{false};
+
+  std::vector<std::unique_ptr<Pool>> m_pools;  // stable for the allocations
+  MemoryBudget m_budget;
+  std::optional<MemoryCategory> m_category;
+  std::array<bool, kMemoryCategories> m_overBudgetReported{};
+};
+
+// Charges the allocations of its lifetime to `category`
+class MemoryCategoryScope {
+public:
+  MemoryCategoryScope(TlsfMemAllocator& allocator, MemoryCategory category)
+      : m_allocator(allocator), m_previous(allocator.setCategory(category)) {}
+  ~MemoryCategoryScope() { m_allocator.setCategory(m_previous); }
+  MemoryCategoryScope(const MemoryCategoryScope&)            = delete;
+  MemoryCategoryScope& operator=(const MemoryCategoryScope&) = delete;
+
+private:
+  TlsfMemAllocator& m_allocator;
+  std::optional<MemoryCategory> m_previous;
+};
@@ -0,0 +1,263 @@
+#include "UploadManager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "nvvk/buffers_vk.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+void imageBarrier(const VkCommandBuffer& cmdBuf, VkImage image,
+                  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                  VkPipelineStageFlags dstStage, VkAccessFlags dstAccess,
+                  VkImageLayout oldLayout, VkImageLayout newLayout) {
+  VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.srcAccessMask       = srcAccess;
+  barrier.dstAccessMask       = dstAccess;
+  barrier.oldLayout           = oldLayout;
+  barrier.newLayout           = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image               = image;
+  barrier.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(cmdBuf, srcStage, dstStage, 0, 0, nullptr, 0, nullptr,
+                       1, &barrier);
+}
+
+}  // namespace
+
+void UploadManager::setup(VkDevice device, nvvk::ResourceAllocator* allocator,
+                          VkQueue transferQueue, uint32_t transferQueueIndex,
+                          VkQueue graphicsQueue, uint32_t graphicsQueueIndex,
+                          VkDeviceSize capacity) {
+  m_device          = device;
+  m_allocator       = allocator;
+  m_transferQueue   = transferQueue;
+  m_graphicsQueue   = graphicsQueue;
+  m_queueIndices[0] = transferQueueIndex;
+  m_queueIndices[1] = graphicsQueueIndex;
+
+  m_ring    = StagingRing(capacity);
+  m_staging = m_allocator->createBuffer(
+      capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_mapped = static_cast<uint8_t*>(m_allocator->map(m_staging));
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = transferQueueIndex;
+  vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_cmdPool);
+
+  VkSemaphoreTypeCreateInfo typeInfo{
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  VkSemaphoreCreateInfo semaphoreInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  semaphoreInfo.pNext = &typeInfo;
+  vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timeline);
+
+  spdlog::info("Uploading through a {} MiB staging ring on queue family {}",
+               capacity >> 20, transferQueueIndex);
+}
+
+nvvk::Buffer UploadManager::createBuffer(VkDeviceSize size, const void* data,
+                                         VkBufferUsageFlags usage) {
+  VkBufferCreateInfo info = nvvk::makeBufferCreateInfo(size, usage);
+  shareWithGraphics(info.sharingMode, info.queueFamilyIndexCount,
+                    info.pQueueFamilyIndices);
+  nvvk::Buffer buffer = m_allocator->createBuffer(info);
+
+  copy(size, data, 4, 1,
+       [&](const VkCommandBuffer& cmdBuf, VkDeviceSize stagingOffset,
+           VkDeviceSize dataOffset, VkDeviceSize chunk) {
+         const VkBufferCopy region{stagingOffset, dataOffset, chunk};
+         vkCmdCopyBuffer(cmdBuf, m_staging.buffer, buffer.buffer, 1, &region);
+       });
+  return buffer;
+}
+
+nvvk::Image UploadManager::createImage(VkDeviceSize size, const void* data,
+                                       const VkImageCreateInfo& info,
+                                       VkImageLayout layout) {
+  VkImageCreateInfo createInfo = info;
+  createInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  shareWithGraphics(createInfo.sharingMode, createInfo.queueFamilyIndexCount,
+                    createInfo.pQueueFamilyIndices);
+  nvvk::Image image = m_allocator->createImage(createInfo);
+
+  const VkExtent3D extent     = info.extent;
+  const VkDeviceSize rows     = VkDeviceSize(extent.height) * extent.depth;
+  const VkDeviceSize texel    = size / (rows * extent.width);
+  const VkDeviceSize rowBytes = texel * extent.width;
+
+  imageBarrier(commandBuffer(), image.image, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+               0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+               VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  // chunks of whole rows, one region per slice they cover
+  copy(size, data, std::lcm<VkDeviceSize>(texel, 4), rowBytes,
+       [&](const VkCommandBuffer& cmdBuf, VkDeviceSize stagingOffset,
+           VkDeviceSize dataOffset, VkDeviceSize chunk) {
+         std::vector<VkBufferImageCopy> regions;
+         const VkDeviceSize end = (dataOffset + chunk) / rowBytes;
+         for (VkDeviceSize row = dataOffset / rowBytes; row < end;) {
+           const VkDeviceSize y     = row % extent.height;
+           const VkDeviceSize count = std::min(end - row, extent.height - y);
+           VkBufferImageCopy region{};
+           region.bufferOffset = stagingOffset + row * rowBytes - dataOffset;
+           region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+           region.imageOffset = {0, int32_t(y), int32_t(row / extent.height)};
+           region.imageExtent = {extent.width, uint32_t(count), 1};
+           regions.push_back(region);
+           row += count;
+         }
+         vkCmdCopyBufferToImage(cmdBuf, m_staging.buffer, image.image,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                uint32_t(regions.size()), regions.data());
+       });
+  // made visible to the graphics queue by the semaphore wait of `finish`
+  imageBarrier(commandBuffer(), image.image, VK_PIPELINE_STAGE_TRANSFER_BIT,
+               VK_ACCESS_TRANSFER_WRITE_BIT,
+               VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout);
+  return image;
+}
+
+void UploadManager::finish() {
+  submit();
+  release(false);
+  if (m_graphicsWaited == m_submitted) {
+    return;
+  }
+  const VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkTimelineSemaphoreSubmitInfo timelineInfo{
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+  timelineInfo.waitSemaphoreValueCount = 1;
+  timelineInfo.pWaitSemaphoreValues    = &m_submitted;
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.pNext              = &timelineInfo;
+  submitInfo.waitSemaphoreCount = 1;
+  submitInfo.pWaitSemaphores    = &m_timeline;
+  submitInfo.pWaitDstStageMask  = &stage;
+  vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+  m_graphicsWaited = m_submitted;
+}
+
+void UploadManager::destroy() {
+  if (m_device == VK_NULL_HANDLE) {
+    return;
+  }
+  submit();
+  VkSemaphoreWaitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores    = &m_timeline;
+  waitInfo.pValues        = &m_submitted;
+  vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX);
+  release(false);
+
+  vkDestroySemaphore(m_device, m_timeline, nullptr);
+  vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+  m_allocator->unmap(m_staging);
+  m_allocator->destroy(m_staging);
+  m_device = VK_NULL_HANDLE;
+}
+
+void UploadManager::copy(VkDeviceSize size, const void* data,
+                         VkDeviceSize alignment, VkDeviceSize granularity,
+                         const RecordCopy& record) {
+  const VkDeviceSize maxChunk =
+      std::max(m_ring.maxChunk() / granularity * granularity, granularity);
+  for (VkDeviceSize done = 0; done < size;) {
+    const VkDeviceSize chunk = std::min(size - done, maxChunk);
+    const std::optional<VkDeviceSize> offset =
+        m_ring.allocate(chunk, alignment);
+    if (!offset) {
+      if (!m_ring.hasOpenAllocations() && !m_ring.oldestPending()) {
+        spdlog::error("Upload chunk of {} bytes does not fit the staging ring",
+                      chunk);
+        return;
+      }
+      // the ring wrapped onto copies in flight
+      submit();
+      release(true);
+      continue;
+    }
+    std::memcpy(m_mapped + *offset, static_cast<const uint8_t*>(data) + done,
+                chunk);
+    record(commandBuffer(), *offset, done, chunk);
+    done += chunk;
+  }
+}
+
+VkCommandBuffer UploadManager::commandBuffer() {
+  if (m_cmdBuf == VK_NULL_HANDLE) {
+    VkCommandBufferAllocateInfo allocInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    allocInfo.commandPool        = m_cmdPool;
+    allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    vkAllocateCommandBuffers(m_device, &allocInfo, &m_cmdBuf);
+    VkCommandBufferBeginInfo beginInfo{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(m_cmdBuf, &beginInfo);
+  }
+  return m_cmdBuf;
+}
+
+void UploadManager::submit() {
+  if (m_cmdBuf == VK_NULL_HANDLE) {
+    return;
+  }
+  vkEndCommandBuffer(m_cmdBuf);
+  m_ring.close(++m_submitted);
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues    = &m_submitted;
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.pNext                = &timelineInfo;
+  submitInfo.commandBufferCount   = 1;
+  submitInfo.pCommandBuffers      = &m_cmdBuf;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores    = &m_timeline;
+  vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE);
+
+  m_inFlight.push_back({m_submitted, m_cmdBuf});
+  m_cmdBuf = VK_NULL_HANDLE;
+}
+
+void UploadManager::release(bool wait) {
+  const std::optional<uint64_t> pending = m_ring.oldestPending();
+  if (wait && pending) {
+    VkSemaphoreWaitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores    = &m_timeline;
+    waitInfo.pValues        = &*pending;
+    vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX);
+  }
+  uint64_t completed = 0;
+  vkGetSemaphoreCounterValue(m_device, m_timeline, &completed);
+  m_ring.release(completed);
+
+  auto done = std::partition(m_inFlight.begin(), m_inFlight.end(),
+                             [&](const Submission& submission) {
+                               return submission.value > completed;
+                             });
+  for (auto it = done; it != m_inFlight.end(); ++it) {
+    vkFreeCommandBuffers(m_device, m_cmdPool, 1, &it->cmdBuf);
+  }
+  m_inFlight.erase(done, m_inFlight.end());
+}
+
+void UploadManager::shareWithGraphics(VkSharingMode& sharingMode,
+                                      uint32_t& count,
+                                      const uint32_t*& indices) const {
+  if (m_queueIndices[0] != m_queueIndices[1]) {
+    sharingMode = VK_SHARING_MODE_CONCURRENT;
+    count       = 2;
+    indices     = m_queueIndices;
+  }
+}
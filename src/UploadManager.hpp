@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "nvvk/resourceallocator_vk.hpp"
+#include "utils/staging_ring.hpp"
+
+// Uploads buffers and images through a persistent staging buffer used as a
+// ring (see `utils/staging_ring.hpp`), on the transfer queue. The copies are
+// batched into one submission until the ring is full or `finish` is called,
+// and a timeline semaphore tells which parts of the ring the device has read,
+// so the host only waits when the ring wraps onto copies still in flight.
+// The destinations are shared by the transfer and graphics queue families,
+// so no ownership transfer is needed.
+class UploadManager {
+public:
+  static constexpr VkDeviceSize kDefaultCapacity = 64ull << 20;
+
+  void setup(VkDevice device, nvvk::ResourceAllocator* allocator,
+             VkQueue transferQueue, uint32_t transferQueueIndex,
+             VkQueue graphicsQueue, uint32_t graphicsQueueIndex,
+             VkDeviceSize capacity = kDefaultCapacity);
+
+  /// Device-local buffer holding `size` bytes of `data`
+  nvvk::Buffer createBuffer(VkDeviceSize size, const void* data,
+                            VkBufferUsageFlags usage);
+
+  template <typename T>
+  nvvk::Buffer createBuffer(const std::vector<T>& data,
+                            VkBufferUsageFlags usage) {
+    return createBuffer(sizeof(T) * data.size(), data.data(), usage);
+  }
+
+  /// Image of a single mip level holding `data`, tightly packed, left in
+  /// `layout`
+  nvvk::Image createImage(
+      VkDeviceSize size, const void* data, const VkImageCreateInfo& info,
+      VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  /// Submits the pending copies and makes the graphics queue wait for all
+  /// the uploads, without waiting on the host
+  void finish();
+
+  /// Waits for the uploads and frees the staging buffer
+  void destroy();
+
+private:
+  using RecordCopy = std::function<void(const VkCommandBuffer& cmdBuf,
+                                        VkDeviceSize stagingOffset,
+                                        VkDeviceSize dataOffset,
+                                        VkDeviceSize size)>;
+
+  struct Submission {
+    uint64_t value;
+    VkCommandBuffer cmdBuf;
+  };
+
+  // copies `data` into the ring in chunks of at most `maxChunk` bytes, each
+  // a multiple of `granularity`, and records their copies
+  void copy(VkDeviceSize size, const void* data, VkDeviceSize alignment,
+            VkDeviceSize granularity, const RecordCopy& record);
+  VkCommandBuffer commandBuffer();
+  void submit();
+  void release(bool wait);
+  void shareWithGraphics(VkSharingMode& sharingMode, uint32_t& count,
+                         const uint32_t*& indices) const;
+
+  VkDevice m_device{VK_NULL_HANDLE};
+  nvvk::ResourceAllocator* m_allocator{nullptr};
+  VkQueue m_transferQueue{VK_NULL_HANDLE};
+  VkQueue m_graphicsQueue{VK_NULL_HANDLE};
+  uint32_t m_queueIndices[2];  // transfer and graphics families
+
+  StagingRing m_ring;
+  nvvk::Buffer m_staging;
+  uint8_t* m_mapped{nullptr};
+
+  VkCommandPool m_cmdPool{VK_NULL_HANDLE};
+  VkCommandBuffer m_cmdBuf{VK_NULL_HANDLE};  // being recorded
+  std::vector<Submission> m_inFlight;
+  VkSemaphore m_timeline{VK_NULL_HANDLE};
+  uint64_t m_submitted{0};
+  uint64_t m_graphicsWaited{0};
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -8,6 +9,8 @@
 //#define USE_RT_PIPELINE
  #define USE_RESTIR_PIPELINE
 // #define USE_ANIMATION
+// #define USE_ENVIRONMENT
+ #define USE_PROFILER
 
 namespace static_config {
 
@@ -25,6 +28,39 @@ extern const bool kIgnorePointLight;
 extern const uint32_t kNumPointLightGenerates;
 
 constexpr size_t kNumGBuffers = 2;
+// dispatches of spatialReuse.comp per frame
+constexpr uint32_t kSpatialReuseIterations = 1;
+// temporal and spatial reuse with balance heuristic MIS weights instead of the
+// Z normalization, see RESTIR_MIS_REUSE_FLAG
+constexpr bool kMisReuse = false;
+// shadow rays of restir.rgen are reused from the per-pixel visibility cache
+// for up to this many frames, fewer while the camera moves
+constexpr bool kVisibilityCache                = true;
+constexpr uint32_t kVisibilityCacheMaxAge       = 16;
+constexpr uint32_t kVisibilityCacheMaxAgeMoving = 2;
+// RENDER_SCALE_* of shaders/host_device.h: reservoirs are generated and reused
+// for one pixel per block and upsampled to the screen by restir_post.frag
+constexpr int kRenderScale = 0;  // RENDER_SCALE_FULL
+// with a VDB loaded, its points are splatted into a density grid and rendered
+// as a participating medium instead of opaque spheres, see RESTIR_VOLUME_FLAG;
+// the grid is not rebuilt as they move, so USE_ANIMATION needs it false
+constexpr bool kVolumetric           = true;
+constexpr int kDensityGridResolution = 128;    // voxels along the longest axis
+constexpr float kVolumeMaxExtinction = 20.0f;  // sigma_t of the densest voxel
+constexpr float kVolumeAlbedo        = 0.8f;
+constexpr float kVolumeAnisotropy    = 0.3f;  // g, of the first lobe if two
+// PHASE_* of shaders/headers/phase.glsl and the parameters of the double lobe
+// and Draine models
+constexpr int kPhaseModel         = 0;  // PHASE_HENYEY_GREENSTEIN
+constexpr float kPhaseAnisotropy2 = -0.3f;
+constexpr float kPhaseBlend       = 0.8f;
+constexpr float kPhaseDraineAlpha = 1.0f;
+// TRANSMITTANCE_* of the shadow rays through the medium; ratio tracking has
+// the lowest variance per unit time in `--benchmark-transmittance`
+constexpr int kTransmittanceEstimator = 1;  // TRANSMITTANCE_RATIO_TRACKING
+// the animation refits the BLAS of the volume chunks whose spheres moved, and
+// rebuilds one once the SAH cost of its refit tree grew by this ratio
+constexpr float kVolumeRebuildCostRatio = 1.5f;
 
 }  // namespace static_config
 
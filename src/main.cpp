@@ -21,9 +21,12 @@
 // pipeline If you are new to ImGui, see examples/README.txt and documentation
 // at the top of imgui.cpp.
 
+#include <algorithm>
 #include <array>
 #include <filesystem>
+#include <optional>
 
+#include "GpuProfiler.hpp"
 #include "Renderer.h"
 #include "SingletonManager.hpp"
 #include "backends/imgui_impl_glfw.h"
@@ -36,6 +39,29 @@
 #include "nvpsystem.hpp"
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/context_vk.hpp"
+#include "spdlog/spdlog.h"
+#include "utils/barrier_planner.hpp"
+#include "utils/batch_render.hpp"
+#include "utils/dispatch.hpp"
+#include "utils/environment_map.hpp"
+#include "utils/frame_ring.hpp"
+#include "utils/low_discrepancy.hpp"
+#include "utils/memory_budget.hpp"
+#include "utils/packing.hpp"
+#include "utils/phase.hpp"
+#include "utils/phat_batch.hpp"
+#include "utils/pipeline_cache.hpp"
+#include "utils/profiler.hpp"
+#include "utils/rng.hpp"
+#include "utils/sampling_benchmark.hpp"
+#include "utils/staging_ring.hpp"
+#include "utils/tlsf_allocator.hpp"
+#include "utils/transient_allocator.hpp"
+#include "utils/transmittance.hpp"
+#include "utils/upsampling.hpp"
+#include "utils/validation.hpp"
+#include "utils/volume.hpp"
+#include "utils/volume_chunks.hpp"
 
 namespace fs = std::filesystem;
 
@@ -50,8 +76,11 @@ const std::string vdb_filename = "fire.vdb";
 const fs::path asset_dir = fs::path(PROJECT_DIRECTORY) / fs::path("assets");
 const std::string file   = (asset_dir / vdb_filename).string();
 
-const std::string gltf_sponza  = "media/gltf/Sponza/glTF/Sponza.gltf";
-const std::string gltf_cornell = "media/gltf/cornellBox/cornellBox.gltf";
+const std::string gltf_sponza     = "media/gltf/Sponza/glTF/Sponza.gltf";
+const std::string gltf_cornell    = "media/gltf/cornellBox/cornellBox.gltf";
+const std::string environment_map = "media/textures/environment.hdr";
+// optional, see --write-ld-tables
+const std::string ld_tables       = "media/textures/ld_tables.bin";
 
 // GLFW Callback functions
 static void onErrorCallback(int error, const char* description) {
@@ -72,6 +101,15 @@ void renderUI(Renderer& renderer) {
                        0.f, 150.f);
   }
   ImGui::Text("Nb Spheres and Cubes: %llu", renderer.getSpheres().size());
+#ifdef USE_PROFILER
+  if (ImGui::CollapsingHeader("Profiler")) {
+    ImGui::Text("%-18s %8s %8s %8s", "scope", "mean us", "p50 us", "p99 us");
+    for (const ProfileStats& scope : Profiler::global().stats()) {
+      ImGui::Text("%s %-14s %8.1f %8.1f %8.1f", scope.gpu ? "gpu" : "cpu",
+                  scope.name.c_str(), scope.mean, scope.p50, scope.p99);
+    }
+  }
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -79,33 +117,332 @@ void renderUI(Renderer& renderer) {
 //////////////////////////////////////////////////////////////////////////
 static int const SAMPLE_WIDTH  = 1280;
 static int const SAMPLE_HEIGHT = 720;
+static uint32_t const BATCH_SLOTS = 3;  // headless frames in flight
+
+//--------------------------------------------------------------------------------------------------
+// Records the frame into `cmdBuf`; the tone mapped image ends in `framebuffer`
+// of the base render pass, with the UI on top when `drawGui`. `frameSlot` is
+// the frame in flight whose timestamp queries the device profiler reuses
+//
+void recordFrame(Renderer& renderer, RenderGraph& restirGraph,
+                 const VkCommandBuffer& cmdBuf,
+                 const VkFramebuffer& framebuffer, uint32_t frameSlot,
+                 const nvmath::vec4f& clearColor, bool useRaytracer,
+                 bool drawGui) {
+  UNUSED(restirGraph);
+  UNUSED(useRaytracer);
+  UNUSED(frameSlot);
+
+  PROFILE_SCOPE("record");
+#ifdef USE_PROFILER
+  GpuProfiler::global().beginFrame(cmdBuf, frameSlot);
+#endif
+  PROFILE_GPU_SCOPE(cmdBuf, "frame");
+
+  // Updating camera buffer, in the uniforms of the current frame slot
+  renderer.updateUniformBuffer();
+  renderer.updateRestirUniformBuffer();
+
+  // Clearing screen
+  std::array<VkClearValue, 2> clearValues{};
+  clearValues[0].color = {
+      {clearColor[0], clearColor[1], clearColor[2], clearColor[3]}};
+  clearValues[1].depthStencil = {1.0f, 0};
+
+  renderer.updateFrame();
+
+#ifdef USE_RT_PIPELINE
+  // Offscreen render pass
+  {
+    VkRenderPassBeginInfo offscreenRenderPassBeginInfo{
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+    offscreenRenderPassBeginInfo.clearValueCount = 2;
+    offscreenRenderPassBeginInfo.pClearValues    = clearValues.data();
+    offscreenRenderPassBeginInfo.renderPass = renderer.getOffscreenRenderPass();
+    offscreenRenderPassBeginInfo.framebuffer =
+        renderer.getOffscreenFrameBuffer();
+    offscreenRenderPassBeginInfo.renderArea = {{0, 0}, renderer.getSize()};
+
+    // Rendering Scene
+    if (useRaytracer) {
+      renderer.raytrace(cmdBuf, clearColor);
+    } else {
+      vkCmdBeginRenderPass(cmdBuf, &offscreenRenderPassBeginInfo,
+                           VK_SUBPASS_CONTENTS_INLINE);
+      renderer.rasterize(cmdBuf);
+      vkCmdEndRenderPass(cmdBuf);
+    }
+  }
+
+  // Ray Tracing Pipeline post processing
+  // 2nd rendering pass: tone mapper, UI
+  {
+    VkRenderPassBeginInfo postRenderPassBeginInfo{
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+    postRenderPassBeginInfo.clearValueCount = 2;
+    postRenderPassBeginInfo.pClearValues    = clearValues.data();
+    postRenderPassBeginInfo.renderPass      = renderer.getRenderPass();
+    postRenderPassBeginInfo.framebuffer     = framebuffer;
+    postRenderPassBeginInfo.renderArea      = {{0, 0}, renderer.getSize()};
+
+    // Rendering tonemapper
+    vkCmdBeginRenderPass(cmdBuf, &postRenderPassBeginInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    renderer.drawPost(cmdBuf);
+    // Rendering UI
+    if (drawGui) {
+      ImGui::Render();
+      ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuf);
+    }
+    vkCmdEndRenderPass(cmdBuf);
+  }
+#endif
+#ifdef USE_RESTIR_PIPELINE
+  // restir passes, then post processing: tone mapper, UI
+  renderer.addRestirPasses(
+      restirGraph, clearColor, [&](const VkCommandBuffer& cmdBuf) {
+        VkRenderPassBeginInfo restirPostRenderPassBeginInfo{
+            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+        restirPostRenderPassBeginInfo.clearValueCount = 2;
+        restirPostRenderPassBeginInfo.pClearValues    = clearValues.data();
+        restirPostRenderPassBeginInfo.renderPass  = renderer.getRenderPass();
+        restirPostRenderPassBeginInfo.framebuffer = framebuffer;
+        restirPostRenderPassBeginInfo.renderArea = {{0, 0},
+                                                    renderer.getSize()};
+
+        // Rendering tonemapper
+        vkCmdBeginRenderPass(cmdBuf, &restirPostRenderPassBeginInfo,
+                             VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdPushConstants(cmdBuf, renderer.getRestirPostPipelineLayout(),
+                           VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                           sizeof(PushConstantRestir),
+                           renderer.getRestirPostPipelinePC());
+        renderer.restirDrawPost(cmdBuf);
+        // Rendering UI
+        if (drawGui) {
+          ImGui::Render();
+          ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuf);
+        }
+        vkCmdEndRenderPass(cmdBuf);
+      });
+  restirGraph.execute(cmdBuf);
+#endif
+
+  if (renderer.getRestirPostPipelinePC()->frame > 10) {
+    renderer.getRestirPostPipelinePC()->initialize = 0;
+  }
+}
+
+#ifdef USE_PROFILER
+//--------------------------------------------------------------------------------------------------
+// Renders the frames of `options` without writing them with each tile shape
+// the device supports, and reads the device time of the reuse passes from
+// the profiler
+//
+std::vector<TileTiming> sweepReuseTiles(Renderer& renderer,
+                                        const BatchOptions& options,
+                                        const BatchRenderBackend& backend) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(renderer.getPhysicalDevice(), &properties);
+  const VkPhysicalDeviceLimits& limits = properties.limits;
+  const VkExtent2D extent              = renderer.getRenderExtent();
+
+  std::vector<TileTiming> timings;
+  for (const WorkgroupSize& tile : imageTileShapes()) {
+    if (!isWorkgroupSizeSupported(
+            tile,
+            {limits.maxComputeWorkGroupSize[0],
+             limits.maxComputeWorkGroupSize[1],
+             limits.maxComputeWorkGroupSize[2]},
+            limits.maxComputeWorkGroupInvocations)) {
+      continue;
+    }
+    renderer.setReuseTile(tile);
+    GpuProfiler::global().collectAll();
+    Profiler::global().clear();
+    runBatchRender(options, backend,
+                   [](const std::string&, const BatchImage&) { return true; });
+    vkDeviceWaitIdle(renderer.getDevice());
+    GpuProfiler::global().collectAll();
+
+    TileTiming timing{tile,
+                      idleInvocations(extent.width, extent.height, 1, tile),
+                      0.0, 0.0};
+    for (const ProfileStats& scope : Profiler::global().stats()) {
+      if (scope.gpu && scope.name == "temporalReuse") {
+        timing.temporalReuse = scope.mean;
+      } else if (scope.gpu && scope.name == "spatialReuse") {
+        timing.spatialReuse = scope.mean;
+      }
+    }
+    timings.push_back(timing);
+  }
+  return timings;
+}
+#endif
 
 //--------------------------------------------------------------------------------------------------
 // Application Entry
 //
 int main(int argc, char** argv) {
-  UNUSED(argc);
+  // offline tools that need neither a window nor a Vulkan device
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--benchmark-sampling") {
+      logCandidateConvergence(benchmarkCandidateConvergence());
+      return 0;
+    }
+    if (arg == "--benchmark-phat") {
+      logPHatBenchmark(benchmarkPHatBatch());
+      return 0;
+    }
+    if (arg == "--validate-rng") {
+      return reportValidationChecks(validateRng());
+    }
+    if (arg == "--validate-phat") {
+      return reportValidationChecks(validatePHatBatch());
+    }
+    if (arg == "--validate-environment") {
+      return reportValidationChecks(validateEnvironmentSampling());
+    }
+    if (arg == "--benchmark-temporal") {
+      logTemporalReuse(benchmarkTemporalReuse());
+      return 0;
+    }
+    if (arg == "--validate-temporal") {
+      return reportValidationChecks(validateTemporalReuse());
+    }
+    if (arg == "--benchmark-spatial") {
+      logSpatialReuse(benchmarkSpatialReuse());
+      return 0;
+    }
+    if (arg == "--validate-spatial") {
+      return reportValidationChecks(validateSpatialReuse());
+    }
+    if (arg == "--benchmark-reservoir-size") {
+      logReservoirSize(benchmarkReservoirSize());
+      return 0;
+    }
+    if (arg == "--benchmark-visibility-cache") {
+      logVisibilityCache(benchmarkVisibilityCache());
+      return 0;
+    }
+    if (arg == "--benchmark-transmittance") {
+      logTransmittance(benchmarkTransmittance());
+      return 0;
+    }
+    if (arg == "--validate-packing") {
+      return reportValidationChecks(validatePacking());
+    }
+    if (arg == "--validate-upsampling") {
+      const std::vector<UpsamplingResult> results = validateUpsampling();
+      logUpsampling(results);
+      return isUpsamplingValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-volume") {
+      const std::vector<VolumeValidationResult> results = validateVolume();
+      logVolume(results);
+      return isVolumeValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-phase") {
+      const std::vector<PhaseValidationResult> results = validatePhase();
+      logPhase(results);
+      return isPhaseValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-barriers") {
+      const std::vector<BarrierValidationResult> results = validateBarriers();
+      logBarriers(results);
+      return isBarrierPlanValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-aliasing") {
+      const std::vector<TransientValidationResult> results =
+          validateTransientPacking();
+      logTransientPacking(results);
+      return isTransientPackingValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-batch-render") {
+      return reportValidationChecks(validateBatchRender());
+    }
+    if (arg == "--validate-pipeline-cache") {
+      const std::vector<PipelineCacheValidationResult> results =
+          validatePipelineCacheFiles();
+      logPipelineCacheFiles(results);
+      return isPipelineCacheFileValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-dispatch") {
+      return reportValidationChecks(validateDispatch());
+    }
+    if (arg == "--validate-frame-ring") {
+      const std::vector<FrameRingValidationResult> results =
+          validateFrameRing();
+      logFrameRing(results);
+      return isFrameRingValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-profiler") {
+      return reportValidationChecks(validateProfiler());
+    }
+    if (arg == "--validate-staging-ring") {
+      const std::vector<StagingValidationResult> results =
+          validateStagingRing();
+      logStagingRing(results);
+      return isStagingRingValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-tlsf") {
+      const std::vector<TlsfValidationResult> results = validateTlsf();
+      logTlsf(results);
+      return isTlsfValid(results) ? 0 : 1;
+    }
+    if (arg == "--validate-memory-budget") {
+      return reportValidationChecks(validateMemoryBudget());
+    }
+    if (arg == "--validate-volume-chunks") {
+      const std::vector<VolumeChunksValidationResult> results =
+          validateVolumeChunks();
+      logVolumeChunks(results);
+      return isVolumeChunksValid(results) ? 0 : 1;
+    }
+    if (arg == "--write-ld-tables" && i + 1 < argc) {
+      return saveLowDiscrepancyTables(argv[i + 1],
+                                      generateLowDiscrepancyTables())
+                 ? 0
+                 : 1;
+    }
+  }
 
-  // Setup GLFW window
-  glfwSetErrorCallback(onErrorCallback);
-  if (!glfwInit()) {
-    return 1;
+  // image sequences without a window, see utils/batch_render.hpp
+  const std::vector<std::string> args(argv + 1, argv + argc);
+  std::optional<BatchOptions> batch;
+  if (std::find(args.begin(), args.end(), "--headless") != args.end()) {
+    batch = parseBatchOptions(args);
+    if (!batch) {
+      return 1;
+    }
+  }
+  const bool headless = batch.has_value();
+
+  GLFWwindow* window = nullptr;
+  if (!headless) {
+    // Setup GLFW window
+    glfwSetErrorCallback(onErrorCallback);
+    if (!glfwInit()) {
+      return 1;
+    }
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    window = glfwCreateWindow(SAMPLE_WIDTH, SAMPLE_HEIGHT, PROJECT_NAME,
+                              nullptr, nullptr);
+
+    // Setup Vulkan
+    if (!glfwVulkanSupported()) {
+      printf("GLFW: Vulkan Not Supported\n");
+      return 1;
+    }
   }
-  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  GLFWwindow* window = glfwCreateWindow(SAMPLE_WIDTH, SAMPLE_HEIGHT,
-                                        PROJECT_NAME, nullptr, nullptr);
 
   // Setup camera
   CameraManip.setWindowSize(SAMPLE_WIDTH, SAMPLE_HEIGHT);
   CameraManip.setLookat(nvmath::vec3f(1, 1, 1), nvmath::vec3f(0, 1, 0),
                         nvmath::vec3f(0, 1, 0));
 
-  // Setup Vulkan
-  if (!glfwVulkanSupported()) {
-    printf("GLFW: Vulkan Not Supported\n");
-    return 1;
-  }
-
   // setup some basic things for the sample, logging file for example
   NVPSystem system(PROJECT_NAME);
 
@@ -116,17 +453,19 @@ int main(int argc, char** argv) {
       std::string(PROJECT_NAME),
   };
 
-  // Vulkan required extensions
-  assert(glfwVulkanSupported() == 1);
-  uint32_t count{0};
-  auto reqExtensions = glfwGetRequiredInstanceExtensions(&count);
-
   // Requesting Vulkan extensions and layers
   nvvk::ContextCreateInfo contextInfo;
   contextInfo.setVersion(1, 2);
-  // Adding required extensions (surface, win32, linux, ..)
-  for (uint32_t ext_id = 0; ext_id < count; ext_id++) {
-    contextInfo.addInstanceExtension(reqExtensions[ext_id]);
+  if (!headless) {
+    // Vulkan required extensions
+    assert(glfwVulkanSupported() == 1);
+    uint32_t count{0};
+    auto reqExtensions = glfwGetRequiredInstanceExtensions(&count);
+
+    // Adding required extensions (surface, win32, linux, ..)
+    for (uint32_t ext_id = 0; ext_id < count; ext_id++) {
+      contextInfo.addInstanceExtension(reqExtensions[ext_id]);
+    }
   }
 
   contextInfo.addInstanceLayer("VK_LAYER_LUNARG_monitor",
@@ -134,19 +473,23 @@ int main(int argc, char** argv) {
   contextInfo.addInstanceExtension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
                                    true);  // Allow debug names
 
-  contextInfo.addInstanceExtension(VK_KHR_SURFACE_EXTENSION_NAME);
+  if (!headless) {
+    contextInfo.addInstanceExtension(VK_KHR_SURFACE_EXTENSION_NAME);
 #ifdef WIN32
-  contextInfo.addInstanceExtension(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+    contextInfo.addInstanceExtension(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #else
-  contextInfo.addInstanceExtension(VK_KHR_XLIB_SURFACE_EXTENSION_NAME);
-  contextInfo.addInstanceExtension(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+    contextInfo.addInstanceExtension(VK_KHR_XLIB_SURFACE_EXTENSION_NAME);
+    contextInfo.addInstanceExtension(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #endif
+  }
   contextInfo.addInstanceExtension(
       VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
-  contextInfo.addDeviceExtension(
-      VK_KHR_SWAPCHAIN_EXTENSION_NAME);  // Enabling ability to present,
-                                         // rendering
+  if (!headless) {
+    contextInfo.addDeviceExtension(
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME);  // Enabling ability to present
+                                           // rendering
+  }
 
   // #VKRay: Activate the ray tracing extension
   VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeature{
@@ -175,6 +518,13 @@ int main(int argc, char** argv) {
   contextInfo.addDeviceExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
   contextInfo.addDeviceExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
   contextInfo.addDeviceExtension(VK_KHR_SHADER_CLOCK_EXTENSION_NAME);
+  // vkCmdPipelineBarrier2 of the render graph
+  VkPhysicalDeviceSynchronization2FeaturesKHR sync2Feature{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+                                 false, &sync2Feature);
+  // budget of the device memory heaps for this process
+  contextInfo.addDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, true);
 
   // Creating Vulkan base application
   nvvk::Context vkctx{};
@@ -191,20 +541,43 @@ int main(int argc, char** argv) {
   // Create example
   Renderer renderer;
 
-  // Window need to be opened to get the surface on which to draw
-  const VkSurfaceKHR surface = renderer.getVkSurface(vkctx.m_instance, window);
-  vkctx.setGCTQueueWithPresent(surface);
+  VkSurfaceKHR surface = VK_NULL_HANDLE;
+  if (!headless) {
+    // Window need to be opened to get the surface on which to draw
+    surface = renderer.getVkSurface(vkctx.m_instance, window);
+    vkctx.setGCTQueueWithPresent(surface);
+  }
 
+  renderer.setMemoryBudgetSupported(
+      vkctx.hasDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
   renderer.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice,
                  vkctx.m_queueGCT.familyIndex);
-  renderer.createSwapchain(surface, SAMPLE_WIDTH, SAMPLE_HEIGHT);
+  renderer.setupUploads(vkctx.m_queueT.queue, vkctx.m_queueT.familyIndex);
+  renderer.createPipelineCache(NVPSystem::exePath() + "pipelines.cache");
+  if (headless) {
+    renderer.setupHeadless(batch->width, batch->height);
+  } else {
+    renderer.createSwapchain(surface, SAMPLE_WIDTH, SAMPLE_HEIGHT);
+  }
   // global things, handled by AppBase
   renderer.createDepthBuffer();
   renderer.createRenderPass();
-  renderer.createFrameBuffers();
-
-  // Setup Imgui
-  renderer.initGUI(0);  // Using sub-pass 0
+  renderer.createFrameFences();
+  if (headless) {
+    renderer.createHeadlessTargets(BATCH_SLOTS);
+  } else {
+    renderer.createFrameBuffers();
+
+    // Setup Imgui
+    renderer.initGUI(0);  // Using sub-pass 0
+  }
+#ifdef USE_PROFILER
+  GpuProfiler::global().setup(
+      renderer.getDevice(), renderer.getPhysicalDevice(),
+      vkctx.m_queueGCT.familyIndex,
+      headless ? BATCH_SLOTS
+               : static_cast<uint32_t>(renderer.getFramebuffers().size()));
+#endif
 
 #ifdef USE_GLTF
   renderer.loadGLTFModel(nvh::findFile(gltf_sponza, defaultSearchPaths, true));
@@ -219,7 +592,8 @@ int main(int argc, char** argv) {
 #endif
 
 #ifdef USE_VDB
-  SingletonManager::GetVDBLoader().Load(file);
+  SingletonManager::GetVDBLoader().Load(
+      headless && !batch->volume.empty() ? batch->volume : file);
   renderer.createVDBBuffer();
 #endif  // USE_VDB
 
@@ -252,6 +626,14 @@ int main(int argc, char** argv) {
 #ifdef USE_RESTIR_PIPELINE
   // # ReSTIR pipeline toggle
   // restir lights
+#ifdef USE_ENVIRONMENT
+  renderer.loadEnvironmentMap(
+      nvh::findFile(environment_map, defaultSearchPaths, true));
+#endif
+  const std::string ldTablesFile = nvh::findFile(ld_tables, defaultSearchPaths);
+  if (!ldTablesFile.empty()) {
+    renderer.loadLowDiscrepancyTables(ldTablesFile);
+  }
   renderer.createRestirLights();
   renderer.createLightDescriptorSet();
 
@@ -268,39 +650,88 @@ int main(int argc, char** argv) {
   renderer.createRestirPostDescriptor();
   renderer.updateRestirPostDescriptorSet();
 
-  renderer.createRestirPipeline();  // Binding rtDescSetLayout, descSetLayout,
-                                    // uniformDescSetLayout, lightDescSetLayout,
-                                    // restirDescSetLayout
-  renderer
-      .createSpatialReusePipeline();  // Binding rtDescSetLayout, descSetLayout,
-                                      // uniformDescSetLayout,
-                                      // lightDescSetLayout, restirDescSetLayout
-  renderer.createRestirPostPipeline();  // Push Constant PushConstantRestirPost
-                                        // Binding m_restirUniformDescSetLayout,
-                                        // m_lightDescSetLayout,
-                                        // m_restirDescSetLayout,
-                                        // m_restirPostDescSetLayout
+  // ReSTIR, temporal and spatial reuse: Binding rtDescSetLayout,
+  // descSetLayout, uniformDescSetLayout, lightDescSetLayout,
+  // restirDescSetLayout. Post: Push Constant PushConstantRestirPost, Binding
+  // m_restirUniformDescSetLayout, m_lightDescSetLayout, m_restirDescSetLayout,
+  // m_restirPostDescSetLayout
+  renderer.createRestirPipelines();
   renderer.updateRestirDescriptorSet();
 #endif
 
+  // orders the restir passes, see Renderer::addRestirPasses
+  RenderGraph restirGraph;
+#ifdef USE_RESTIR_PIPELINE
+  restirGraph.setup(renderer.getDevice());
+#endif
+
   nvmath::vec4f clearColor = nvmath::vec4f(1, 1, 1, 1.00f);
   bool useRaytracer        = true;
 
-  renderer.setupGlfwCallbacks(window);
-  ImGui_ImplGlfw_InitForVulkan(window, true);
-
 #ifdef USE_ANIMATION
   // #VK_compute
   renderer.createCompDescriptors();
   renderer.createCompPipelines();
 #endif
 
+  if (headless) {
+    BatchRenderBackend backend;
+    backend.slots  = BATCH_SLOTS;
+    backend.render = [&](uint32_t frame, uint32_t slot) {
+      PROFILE_SCOPE("render");
+#ifdef USE_ANIMATION
+      renderer.animationObject(static_cast<float>(frame) / batch->fps);
+#endif
+      renderer.beginFrameSlot();
+      const VkCommandBuffer cmdBuf = renderer.beginHeadlessFrame(slot);
+      recordFrame(renderer, restirGraph, cmdBuf,
+                  renderer.getHeadlessFramebuffer(), slot, clearColor,
+                  useRaytracer, false);
+      renderer.endHeadlessFrame(slot);
+      renderer.endFrameSlot();
+      renderer.updateGBufferFrameIdx();
+    };
+    backend.readback = [&](uint32_t slot, BatchImage& image) {
+      renderer.readHeadlessFrame(slot, image);
+    };
+    if (batch->tileSweep) {
+#ifdef USE_PROFILER
+      logTileSweep(sweepReuseTiles(renderer, *batch, backend));
+#else
+      spdlog::error("The tile sweep needs USE_PROFILER to time the passes");
+#endif
+    } else {
+      logBatchRender(runBatchRender(
+          *batch, backend,
+          [&](const std::string& filename, const BatchImage& image) {
+            return writeBatchImage(*batch, filename, image);
+          }));
+    }
+
+    vkDeviceWaitIdle(renderer.getDevice());
+#ifdef USE_PROFILER
+    GpuProfiler::global().collectAll();
+    GpuProfiler::global().destroy();
+    logProfileStats(Profiler::global().stats());
+    Profiler::global().writeChromeTrace(
+        (fs::path(batch->output) / "trace.json").string());
+#endif
+    renderer.destroyResources();
+    renderer.destroy();
+    vkctx.deinit();
+    return 0;
+  }
+
+  renderer.setupGlfwCallbacks(window);
+  ImGui_ImplGlfw_InitForVulkan(window, true);
+
   auto start = std::chrono::system_clock::now();
 
   // Main loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
     if (renderer.isMinimized()) continue;
+    PROFILE_SCOPE("frame");
 
     // Start the Dear ImGui frame
     ImGui_ImplGlfw_NewFrame();
@@ -330,7 +761,11 @@ int main(int argc, char** argv) {
 #endif
 
     // Start rendering the scene
-    renderer.prepareFrame();
+    {
+      PROFILE_SCOPE("prepareFrame");
+      renderer.prepareFrame();
+      renderer.beginFrameSlot();
+    }
 
     // Start command buffer of this frame
     auto curFrame                 = renderer.getCurFrame();
@@ -341,115 +776,25 @@ int main(int argc, char** argv) {
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     vkBeginCommandBuffer(cmdBuf, &beginInfo);
 
-    // Updating camera buffer
-    renderer.updateUniformBuffer(cmdBuf);
-    renderer.updateRestirUniformBuffer(cmdBuf);
-
-    // Clearing screen
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {
-        {clearColor[0], clearColor[1], clearColor[2], clearColor[3]}};
-    clearValues[1].depthStencil = {1.0f, 0};
-
-    renderer.updateFrame();
-
-#ifdef USE_RT_PIPELINE
-    // Offscreen render pass
-    {
-      VkRenderPassBeginInfo offscreenRenderPassBeginInfo{
-          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-      offscreenRenderPassBeginInfo.clearValueCount = 2;
-      offscreenRenderPassBeginInfo.pClearValues    = clearValues.data();
-      offscreenRenderPassBeginInfo.renderPass =
-          renderer.getOffscreenRenderPass();
-      offscreenRenderPassBeginInfo.framebuffer =
-          renderer.getOffscreenFrameBuffer();
-      offscreenRenderPassBeginInfo.renderArea = {{0, 0}, renderer.getSize()};
-
-      // Rendering Scene
-      if (useRaytracer) {
-        renderer.raytrace(cmdBuf, clearColor);
-      } else {
-        vkCmdBeginRenderPass(cmdBuf, &offscreenRenderPassBeginInfo,
-                             VK_SUBPASS_CONTENTS_INLINE);
-        renderer.rasterize(cmdBuf);
-        vkCmdEndRenderPass(cmdBuf);
-      }
-    }
-
-    // Ray Tracing Pipeline post processing
-    // 2nd rendering pass: tone mapper, UI
-    {
-      VkRenderPassBeginInfo postRenderPassBeginInfo{
-          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-      postRenderPassBeginInfo.clearValueCount = 2;
-      postRenderPassBeginInfo.pClearValues    = clearValues.data();
-      postRenderPassBeginInfo.renderPass      = renderer.getRenderPass();
-      postRenderPassBeginInfo.framebuffer =
-          renderer.getFramebuffers()[curFrame];
-      postRenderPassBeginInfo.renderArea = {{0, 0}, renderer.getSize()};
-
-      // Rendering tonemapper
-      vkCmdBeginRenderPass(cmdBuf, &postRenderPassBeginInfo,
-                           VK_SUBPASS_CONTENTS_INLINE);
-      renderer.drawPost(cmdBuf);
-      // Rendering UI
-      ImGui::Render();
-      ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuf);
-      vkCmdEndRenderPass(cmdBuf);
-    }
-#endif
-#ifdef USE_RESTIR_PIPELINE
-    // restir pass
-    {
-      renderer.getRestirPass().run(
-          cmdBuf, renderer.getRtDescSet(), renderer.getDescSet(),
-          renderer.getRestirUniformDescSet(), renderer.getLightDescSet(),
-          renderer.getRestirDescSet(), clearColor);
-      renderer.getSpatialReusePass().run(
-          cmdBuf, renderer.getRtDescSet(), renderer.getDescSet(),
-          renderer.getRestirUniformDescSet(), renderer.getLightDescSet(),
-          renderer.getRestirDescSet());
-    }
-
-    // Restir Pipeline post processing
-    {
-      VkRenderPassBeginInfo restirPostRenderPassBeginInfo{
-          VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-      restirPostRenderPassBeginInfo.clearValueCount = 2;
-      restirPostRenderPassBeginInfo.pClearValues    = clearValues.data();
-      restirPostRenderPassBeginInfo.renderPass      = renderer.getRenderPass();
-      restirPostRenderPassBeginInfo.framebuffer =
-          renderer.getFramebuffers()[curFrame];
-      restirPostRenderPassBeginInfo.renderArea = {{0, 0}, renderer.getSize()};
-
-      // Rendering tonemapper
-      vkCmdBeginRenderPass(cmdBuf, &restirPostRenderPassBeginInfo,
-                           VK_SUBPASS_CONTENTS_INLINE);
-      vkCmdPushConstants(cmdBuf, renderer.getRestirPostPipelineLayout(),
-                         VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                         sizeof(PushConstantRestir),
-                         renderer.getRestirPostPipelinePC());
-      renderer.restirDrawPost(cmdBuf);
-      // Rendering UI
-      ImGui::Render();
-      ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuf);
-      vkCmdEndRenderPass(cmdBuf);
-    }
-#endif
-
-    if (renderer.getRestirPostPipelinePC()->frame > 10) {
-      renderer.getRestirPostPipelinePC()->initialize = 0;
-    }
+    recordFrame(renderer, restirGraph, cmdBuf,
+                renderer.getFramebuffers()[curFrame], curFrame, clearColor,
+                useRaytracer, true);
 
     // Submit for display
     vkEndCommandBuffer(cmdBuf);
     renderer.submitFrame();
+    renderer.endFrameSlot();
     renderer.updateGBufferFrameIdx();
   }
 
   // Cleanup
   vkDeviceWaitIdle(renderer.getDevice());
+#ifdef USE_PROFILER
+  GpuProfiler::global().collectAll();
+  GpuProfiler::global().destroy();
+  logProfileStats(Profiler::global().stats());
+  Profiler::global().writeChromeTrace(NVPSystem::exePath() + "trace.json");
+#endif
 
   renderer.destroyResources();
   renderer.destroy();
@@ -0,0 +1,97 @@
+#include "renderGraph.h"
+
+#include <algorithm>
+
+uint32_t RenderGraph::importImage(VkImage image, VkImageLayout layout,
+                                  VkImageAspectFlags aspect) {
+  auto it = std::find_if(
+      m_resources.begin(), m_resources.end(),
+      [&](const Resource& resource) { return resource.image == image; });
+  if (it != m_resources.end()) {
+    return static_cast<uint32_t>(it - m_resources.begin());
+  }
+  m_resources.push_back({image, VK_NULL_HANDLE, aspect});
+  return m_planner.addResource(true, layout);
+}
+
+uint32_t RenderGraph::importBuffer(VkBuffer buffer) {
+  auto it = std::find_if(
+      m_resources.begin(), m_resources.end(),
+      [&](const Resource& resource) { return resource.buffer == buffer; });
+  if (it != m_resources.end()) {
+    return static_cast<uint32_t>(it - m_resources.begin());
+  }
+  m_resources.push_back({VK_NULL_HANDLE, buffer, 0});
+  return m_planner.addResource(false, VK_IMAGE_LAYOUT_UNDEFINED);
+}
+
+void RenderGraph::addPass(std::string name, std::vector<ResourceUse> uses,
+                          RecordFunction record) {
+  m_passes.push_back({std::move(name), std::move(uses), std::move(record)});
+}
+
+void RenderGraph::execute(const VkCommandBuffer& cmdBuf) {
+  std::vector<std::vector<ResourceUse>> uses;
+  uses.reserve(m_passes.size());
+  for (const Pass& pass : m_passes) {
+    uses.push_back(pass.uses);
+  }
+  const std::vector<TransitionPoint> points = m_planner.plan(uses);
+
+  auto point = points.begin();
+  for (uint32_t i = 0; i < m_passes.size(); ++i) {
+    m_debug.beginLabel(cmdBuf, m_passes[i].name.c_str());
+    if (point != points.end() && point->pass == i) {
+      recordBarriers(cmdBuf, *point++);
+    }
+    m_passes[i].record(cmdBuf);
+    m_debug.endLabel(cmdBuf);
+  }
+  m_passes.clear();
+}
+
+void RenderGraph::reset() {
+  m_planner = BarrierPlanner();
+  m_resources.clear();
+  m_passes.clear();
+}
+
+void RenderGraph::recordBarriers(const VkCommandBuffer& cmdBuf,
+                                 const TransitionPoint& point) {
+  VkMemoryBarrier2KHR memoryBarrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR};
+  std::vector<VkImageMemoryBarrier2KHR> imageBarriers;
+  for (const PlannedBarrier& planned : point.barriers) {
+    if (!planned.isLayoutTransition()) {
+      memoryBarrier.srcStageMask |= planned.srcStages;
+      memoryBarrier.srcAccessMask |= planned.srcAccess;
+      memoryBarrier.dstStageMask |= planned.dstStages;
+      memoryBarrier.dstAccessMask |= planned.dstAccess;
+      continue;
+    }
+    const Resource& resource = m_resources[planned.resource];
+    VkImageMemoryBarrier2KHR barrier{
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR};
+    barrier.srcStageMask        = planned.srcStages;
+    barrier.srcAccessMask       = planned.srcAccess;
+    barrier.dstStageMask        = planned.dstStages;
+    barrier.dstAccessMask       = planned.dstAccess;
+    barrier.oldLayout           = planned.oldLayout;
+    barrier.newLayout           = planned.newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image               = resource.image;
+    barrier.subresourceRange    = {resource.aspect, 0, VK_REMAINING_MIP_LEVELS,
+                                   0, VK_REMAINING_ARRAY_LAYERS};
+    imageBarriers.push_back(barrier);
+  }
+
+  VkDependencyInfoKHR dependency{VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR};
+  if (memoryBarrier.srcStageMask != 0) {
+    dependency.memoryBarrierCount = 1;
+    dependency.pMemoryBarriers    = &memoryBarrier;
+  }
+  dependency.imageMemoryBarrierCount =
+      static_cast<uint32_t>(imageBarriers.size());
+  dependency.pImageMemoryBarriers = imageBarriers.data();
+  vkCmdPipelineBarrier2KHR(cmdBuf, &dependency);
+}
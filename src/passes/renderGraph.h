@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "nvvk/debug_util_vk.hpp"
+#include "utils/barrier_planner.hpp"
+
+// Records passes in declaration order with the barriers planned from the
+// resources each pass declares (see `utils/barrier_planner.hpp`): all the
+// dependencies before a pass go in one vkCmdPipelineBarrier2, as a single
+// global memory barrier plus one image barrier per layout transition.
+// Imported resources keep their state from frame to frame.
+class RenderGraph {
+public:
+  using RecordFunction = std::function<void(const VkCommandBuffer&)>;
+
+  void setup(const VkDevice& device) { m_debug.setup(device); }
+
+  /// Id of `image`, tracked from `layout` the first time it is imported
+  uint32_t importImage(VkImage image, VkImageLayout layout,
+                       VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+  uint32_t importBuffer(VkBuffer buffer);
+
+  void addPass(std::string name, std::vector<ResourceUse> uses,
+               RecordFunction record);
+
+  /// Records the passes added since the last call, then forgets them
+  void execute(const VkCommandBuffer& cmdBuf);
+
+  /// Forgets the resources, e.g. after they are recreated
+  void reset();
+
+private:
+  struct Resource {
+    VkImage image;
+    VkBuffer buffer;
+    VkImageAspectFlags aspect;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<ResourceUse> uses;
+    RecordFunction record;
+  };
+
+  void recordBarriers(const VkCommandBuffer& cmdBuf,
+                      const TransitionPoint& point);
+
+  nvvk::DebugUtil m_debug;
+  BarrierPlanner m_planner;
+  std::vector<Resource> m_resources;  // by planner id
+  std::vector<Pass> m_passes;
+};
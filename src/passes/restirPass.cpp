@@ -1,5 +1,6 @@
 #include "restirPass.h"
 
+#include "GpuProfiler.hpp"
 #include "nvh/fileoperations.hpp"
 #include "nvvk/pipeline_vk.hpp"
 #include "nvvk/renderpasses_vk.hpp"
@@ -14,10 +15,7 @@ void RestirPass::run(const VkCommandBuffer& cmdBuf,
                      const VkDescriptorSet& lightDescSet,
                      const VkDescriptorSet& restirDescSet,
                      const nvmath::vec4f& clearColor) {
-  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                       VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr,
-                       0, nullptr);
+  PROFILE_GPU_SCOPE(cmdBuf, "restir");
 
   // Initializing push constant values
   m_pcRestir.clearColorRed   = clearColor.x;
@@ -61,7 +59,7 @@ void RestirPass::run(const VkCommandBuffer& cmdBuf,
 void RestirPass::setup(const VkDevice& device,
                        const VkPhysicalDevice& physicalDevice,
                        uint32_t graphicsQueueIndex,
-                       nvvk::ResourceAllocatorDma* allocator) {
+                       nvvk::ResourceAllocator* allocator) {
   m_device             = device;
   m_graphicsQueueIndex = graphicsQueueIndex;
   m_physicalDevice     = physicalDevice;
@@ -85,7 +83,8 @@ void RestirPass::createPipeline(
     const VkDescriptorSetLayout& descSetLayout,
     const VkDescriptorSetLayout& uniformDescSetLayout,
     const VkDescriptorSetLayout& lightDescSetLayout,
-    const VkDescriptorSetLayout& restirDescSetLayout) {
+    const VkDescriptorSetLayout& restirDescSetLayout,
+    const VkPipelineCache& pipelineCache) {
   enum StageIndices {
     eRaygen,
     eMiss,
@@ -203,12 +202,10 @@ void RestirPass::createPipeline(
 
   rayPipelineInfo.maxPipelineRayRecursionDepth = 2;  // Ray depth
   rayPipelineInfo.layout                       = m_pipelineLayout;
-  vkCreateRayTracingPipelinesKHR(m_device, {}, {}, 1, &rayPipelineInfo, nullptr,
-                                 &m_pipeline);
+  vkCreateRayTracingPipelinesKHR(m_device, {}, pipelineCache, 1,
+                                 &rayPipelineInfo, nullptr, &m_pipeline);
 
   for (auto& s : stages) vkDestroyShaderModule(m_device, s.module, nullptr);
-
-  createShaderBindingTable();
 }
 
 void RestirPass::createShaderBindingTable() {
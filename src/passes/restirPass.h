@@ -3,7 +3,6 @@
 #include "config/static_config.hpp"
 #include "nvh/alignment.hpp"
 #include "nvh/fileoperations.hpp"
-#include "nvvk/memallocator_dma_vk.hpp"
 #include "nvvk/raytraceKHR_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
 #include "nvvk/shaders_vk.hpp"
@@ -14,7 +13,7 @@ class RestirPass {
 public:
   void setup(const VkDevice& device, const VkPhysicalDevice&,
              uint32_t graphicsQueueIndex,
-             nvvk::ResourceAllocatorDma* allocator);
+             nvvk::ResourceAllocator* allocator);
 
   void createDescriptorSet();
   void createRenderPass(VkExtent2D outputSize);
@@ -22,7 +21,10 @@ public:
                       const VkDescriptorSetLayout& descSetLayout,
                       const VkDescriptorSetLayout& uniformDescSetLayout,
                       const VkDescriptorSetLayout& lightDescSetLayout,
-                      const VkDescriptorSetLayout& restirDescSetLayout);
+                      const VkDescriptorSetLayout& restirDescSetLayout,
+                      const VkPipelineCache& pipelineCache);
+  // allocates, so not with other pipelines being created
+  void createShaderBindingTable();
 
   bool uiSetup(){};
   void run(const VkCommandBuffer& cmdBuf, const VkDescriptorSet& rtDescSet,
@@ -38,7 +40,7 @@ private:
   VkDevice m_device;
   VkPhysicalDevice m_physicalDevice;
   uint32_t m_graphicsQueueIndex;
-  nvvk::ResourceAllocatorDma* m_alloc;
+  nvvk::ResourceAllocator* m_alloc;
   VkExtent2D m_size;
 
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_restirProperties{
@@ -59,6 +61,4 @@ private:
   VkStridedDeviceAddressRegionKHR m_missRegion{};
   VkStridedDeviceAddressRegionKHR m_hitRegion{};
   VkStridedDeviceAddressRegionKHR m_callRegion{};
-
-  void createShaderBindingTable();
 };
\ No newline at end of file
@@ -1,22 +1,28 @@
 #include "spatialReusePass.h"
 
+#include <algorithm>
+
+#include "GpuProfiler.hpp"
 #include "nvh/fileoperations.hpp"
 #include "nvvk/pipeline_vk.hpp"
 #include "nvvk/renderpasses_vk.hpp"
 #include "nvvk/shaders_vk.hpp"
+#include "utils/restir_frame.hpp"
 
 extern std::vector<std::string> defaultSearchPaths;
 
+std::vector<PushConstantSpatialReuse> SpatialReusePass::dispatches() const {
+  return spatialReuseDispatches(m_iterations);
+}
+
 void SpatialReusePass::run(const VkCommandBuffer& cmdBuf,
                            const VkDescriptorSet& rtDescSet,
                            const VkDescriptorSet& descSet,
                            const VkDescriptorSet& uniformDescSet,
                            const VkDescriptorSet& lightDescSet,
-                           const VkDescriptorSet& restirDescSet) {
-  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                       VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr,
-                       0, nullptr);
+                           const VkDescriptorSet& restirDescSet,
+                           const PushConstantSpatialReuse& pushC) {
+  PROFILE_GPU_SCOPE(cmdBuf, "spatialReuse");
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
 
   std::vector<VkDescriptorSet> descriptorSets{
@@ -25,13 +31,17 @@ void SpatialReusePass::run(const VkCommandBuffer& cmdBuf,
                           m_pipelineLayout, 0,
                           static_cast<uint32_t>(descriptorSets.size()),
                           descriptorSets.data(), 0, nullptr);
-  vkCmdDispatch(cmdBuf, m_size.width, m_size.height, 1);
+  vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(PushConstantSpatialReuse), &pushC);
+  const DispatchGroups groups =
+      dispatchGroups(m_size.width, m_size.height, 1, m_tile);
+  vkCmdDispatch(cmdBuf, groups.x, groups.y, groups.z);
 }
 
 void SpatialReusePass::setup(const VkDevice& device,
                              const VkPhysicalDevice& physicalDevice,
                              uint32_t graphicsQueueIndex,
-                             nvvk::ResourceAllocatorDma* allocator) {
+                             nvvk::ResourceAllocator* allocator) {
   m_device             = device;
   m_graphicsQueueIndex = graphicsQueueIndex;
   m_physicalDevice     = physicalDevice;
@@ -47,12 +57,12 @@ void SpatialReusePass::createPipeline(
     const VkDescriptorSetLayout& descSetLayout,
     const VkDescriptorSetLayout& uniformDescSetLayout,
     const VkDescriptorSetLayout& lightDescSetLayout,
-    const VkDescriptorSetLayout& restirDescSetLayout) {
+    const VkDescriptorSetLayout& restirDescSetLayout,
+    const VkPipelineCache& pipelineCache) {
   std::vector<std::string> paths = defaultSearchPaths;
 
-  // pushing time
   VkPushConstantRange push_constants = {VK_SHADER_STAGE_COMPUTE_BIT, 0,
-                                        sizeof(float)};
+                                        sizeof(PushConstantSpatialReuse)};
 
   VkPipelineLayoutCreateInfo layout_info{
       VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
@@ -73,7 +83,9 @@ void SpatialReusePass::createPipeline(
                                   nvh::loadFile("spv/spatialReuse.comp.spv",
                                                 true, defaultSearchPaths, true),
                                   VK_SHADER_STAGE_COMPUTE_BIT);
-  vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1,
+  const WorkgroupSpecialization tile(m_tile);
+  computePipelineCreateInfo.stage.pSpecializationInfo = tile.info();
+  vkCreateComputePipelines(m_device, pipelineCache, 1,
                            &computePipelineCreateInfo, nullptr, &m_pipeline);
 
   vkDestroyShaderModule(m_device, computePipelineCreateInfo.stage.module,
@@ -87,4 +99,7 @@ void SpatialReusePass::destroy() {
     vkDestroyPipeline(m_device, m_pipeline, nullptr);
   if (m_pipelineLayout != VK_NULL_HANDLE)
     vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+  m_renderPass     = VK_NULL_HANDLE;
+  m_pipeline       = VK_NULL_HANDLE;
+  m_pipelineLayout = VK_NULL_HANDLE;
 }
\ No newline at end of file
@@ -2,33 +2,43 @@
 
 #include "nvh/alignment.hpp"
 #include "nvh/fileoperations.hpp"
-#include "nvvk/memallocator_dma_vk.hpp"
 #include "nvvk/raytraceKHR_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
 #include "nvvk/shaders_vk.hpp"
+#include "utils/dispatch.hpp"
 #include "utils/restir_utils.h"
 //#include "GBuffer.hpp"
 
+// Resamples neighbouring reservoirs (`spatialReuse.comp`), reading the
+// temporary reservoirs and leaving the result in the final ones. Each
+// iteration is one dispatch; the render graph synchronizes them.
 class SpatialReusePass {
 public:
   void setup(const VkDevice& device, const VkPhysicalDevice&,
              uint32_t graphicsQueueIndex,
-             nvvk::ResourceAllocatorDma* allocator);
+             nvvk::ResourceAllocator* allocator);
 
   void createDescriptorSet(){};
   void createRenderPass(VkExtent2D outputSize);
+  // local size of the next pipeline, within the device limits
+  void setTile(const WorkgroupSize& tile) { m_tile = tile; }
   void createPipeline(const VkDescriptorSetLayout& rtDescSetLayout,
                       const VkDescriptorSetLayout& descSetLayout,
                       const VkDescriptorSetLayout& uniformDescSetLayout,
                       const VkDescriptorSetLayout& lightDescSetLayout,
-                      const VkDescriptorSetLayout& restirDescSetLayout);
+                      const VkDescriptorSetLayout& restirDescSetLayout,
+                      const VkPipelineCache& pipelineCache);
 
   bool uiSetup(){};
+  void setIterations(uint32_t iterations) { m_iterations = iterations; }
+  // push constants of the dispatches of one frame, in order
+  std::vector<PushConstantSpatialReuse> dispatches() const;
   void run(const VkCommandBuffer& cmdBuf, const VkDescriptorSet& rtDescSet,
            const VkDescriptorSet& descSet,
            const VkDescriptorSet& uniformDescSet,
            const VkDescriptorSet& lightDescSet,
-           const VkDescriptorSet& restirDescSet);
+           const VkDescriptorSet& restirDescSet,
+           const PushConstantSpatialReuse& pushC);
 
   void destroy();
 
@@ -36,8 +46,11 @@ private:
   VkDevice m_device;
   VkPhysicalDevice m_physicalDevice;
   uint32_t m_graphicsQueueIndex;
-  nvvk::ResourceAllocatorDma* m_alloc;
+  nvvk::ResourceAllocator* m_alloc;
   VkExtent2D m_size;
+  uint32_t m_iterations = 1;
+
+  WorkgroupSize m_tile = kImageTile;  // local size of spatialReuse.comp
 
   VkPipelineLayout m_pipelineLayout{VK_NULL_HANDLE};
   VkPipeline m_pipeline{VK_NULL_HANDLE};
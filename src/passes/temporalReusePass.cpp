@@ -0,0 +1,84 @@
+#include "temporalReusePass.h"
+
+#include "GpuProfiler.hpp"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/pipeline_vk.hpp"
+#include "nvvk/shaders_vk.hpp"
+
+extern std::vector<std::string> defaultSearchPaths;
+
+void TemporalReusePass::run(const VkCommandBuffer& cmdBuf,
+                            const VkDescriptorSet& rtDescSet,
+                            const VkDescriptorSet& descSet,
+                            const VkDescriptorSet& uniformDescSet,
+                            const VkDescriptorSet& lightDescSet,
+                            const VkDescriptorSet& restirDescSet) {
+  PROFILE_GPU_SCOPE(cmdBuf, "temporalReuse");
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+
+  std::vector<VkDescriptorSet> descriptorSets{
+      rtDescSet, descSet, uniformDescSet, lightDescSet, restirDescSet};
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_pipelineLayout, 0,
+                          static_cast<uint32_t>(descriptorSets.size()),
+                          descriptorSets.data(), 0, nullptr);
+  const DispatchGroups groups =
+      dispatchGroups(m_size.width, m_size.height, 1, m_tile);
+  vkCmdDispatch(cmdBuf, groups.x, groups.y, groups.z);
+}
+
+void TemporalReusePass::setup(const VkDevice& device,
+                              const VkPhysicalDevice& physicalDevice,
+                              uint32_t graphicsQueueIndex,
+                              nvvk::ResourceAllocator* allocator) {
+  m_device             = device;
+  m_graphicsQueueIndex = graphicsQueueIndex;
+  m_physicalDevice     = physicalDevice;
+  m_alloc              = allocator;
+}
+
+void TemporalReusePass::createRenderPass(VkExtent2D outputSize) {
+  m_size = outputSize;
+}
+
+void TemporalReusePass::createPipeline(
+    const VkDescriptorSetLayout& rtDescSetLayout,
+    const VkDescriptorSetLayout& descSetLayout,
+    const VkDescriptorSetLayout& uniformDescSetLayout,
+    const VkDescriptorSetLayout& lightDescSetLayout,
+    const VkDescriptorSetLayout& restirDescSetLayout,
+    const VkPipelineCache& pipelineCache) {
+  VkPipelineLayoutCreateInfo layout_info{
+      VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  std::vector<VkDescriptorSetLayout> setlayouts{
+      rtDescSetLayout, descSetLayout, uniformDescSetLayout, lightDescSetLayout,
+      restirDescSetLayout};
+  layout_info.setLayoutCount = static_cast<uint32_t>(setlayouts.size());
+  layout_info.pSetLayouts    = setlayouts.data();
+  vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_pipelineLayout);
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo{
+      VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  computePipelineCreateInfo.layout = m_pipelineLayout;
+  computePipelineCreateInfo.stage =
+      nvvk::createShaderStageInfo(m_device,
+                                  nvh::loadFile("spv/temporalReuse.comp.spv",
+                                                true, defaultSearchPaths, true),
+                                  VK_SHADER_STAGE_COMPUTE_BIT);
+  const WorkgroupSpecialization tile(m_tile);
+  computePipelineCreateInfo.stage.pSpecializationInfo = tile.info();
+  vkCreateComputePipelines(m_device, pipelineCache, 1,
+                           &computePipelineCreateInfo, nullptr, &m_pipeline);
+
+  vkDestroyShaderModule(m_device, computePipelineCreateInfo.stage.module,
+                        nullptr);
+}
+
+void TemporalReusePass::destroy() {
+  if (m_pipeline != VK_NULL_HANDLE)
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+  if (m_pipelineLayout != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+  m_pipeline       = VK_NULL_HANDLE;
+  m_pipelineLayout = VK_NULL_HANDLE;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "nvh/alignment.hpp"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/raytraceKHR_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "utils/dispatch.hpp"
+#include "utils/restir_utils.h"
+
+// Merges the previous frame's reservoirs into the initial ones, in place on
+// the temporary reservoirs (`temporalReuse.comp`)
+class TemporalReusePass {
+public:
+  void setup(const VkDevice& device, const VkPhysicalDevice&,
+             uint32_t graphicsQueueIndex,
+             nvvk::ResourceAllocator* allocator);
+
+  void createRenderPass(VkExtent2D outputSize);
+  // local size of the next pipeline, within the device limits
+  void setTile(const WorkgroupSize& tile) { m_tile = tile; }
+  void createPipeline(const VkDescriptorSetLayout& rtDescSetLayout,
+                      const VkDescriptorSetLayout& descSetLayout,
+                      const VkDescriptorSetLayout& uniformDescSetLayout,
+                      const VkDescriptorSetLayout& lightDescSetLayout,
+                      const VkDescriptorSetLayout& restirDescSetLayout,
+                      const VkPipelineCache& pipelineCache);
+
+  void run(const VkCommandBuffer& cmdBuf, const VkDescriptorSet& rtDescSet,
+           const VkDescriptorSet& descSet,
+           const VkDescriptorSet& uniformDescSet,
+           const VkDescriptorSet& lightDescSet,
+           const VkDescriptorSet& restirDescSet);
+
+  void destroy();
+
+private:
+  WorkgroupSize m_tile = kImageTile;  // local size of temporalReuse.comp
+
+  VkDevice m_device;
+  VkPhysicalDevice m_physicalDevice;
+  uint32_t m_graphicsQueueIndex;
+  nvvk::ResourceAllocator* m_alloc;
+  VkExtent2D m_size;
+
+  VkPipelineLayout m_pipelineLayout{VK_NULL_HANDLE};
+  VkPipeline m_pipeline{VK_NULL_HANDLE};
+};
@@ -1,3 +1,6 @@
+#ifndef COMMON_GLSL
+#define COMMON_GLSL 1
+
 #ifndef CPP_FUNCTION
 #define CPP_FUNCTION
 #endif
@@ -5,3 +8,5 @@
 CPP_FUNCTION float luminance(float r, float g, float b) {
   return 0.2126f * r + 0.7152f * g + 0.0722f * b;
 }
+
+#endif  // COMMON_GLSL
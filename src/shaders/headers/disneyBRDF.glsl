@@ -1,29 +1,40 @@
+// Disney BRDF of the surfaces, shared by the shaders and the host (see
+// `utils/shader_functions.hpp`), where `utils/phat_batch.hpp` checks its SIMD
+// transcription of `evaluatePHat` against `disneyBrdfLuminance`.
+
+#ifndef DISNEY_BRDF_GLSL
+#define DISNEY_BRDF_GLSL 1
 
 #include "../host_device.h"
 #include "common.glsl"
 #include "math.glsl"
 
-float schlickFresnel(float cos) {
+#ifndef CPP_FUNCTION
+#define CPP_FUNCTION
+#endif
+
+CPP_FUNCTION float schlickFresnel(float cos) {
   float m  = clamp(1 - cos, 0.0, 1.0);
   float sm = m * m;
   return sm * sm * m;
 }
 
 // Isotropic GTR2
-float GTR2(float NdotH, float a) {
+CPP_FUNCTION float GTR2(float NdotH, float a) {
   float a2 = a * a;
   float t  = 1.0 + (a2 - 1.0) * NdotH * NdotH;
   return a2 / (M_PI * t * t);
 }
 
-float smithG_GGX(float NdotV, float alphaG) {
+CPP_FUNCTION float smithG_GGX(float NdotV, float alphaG) {
   float a = alphaG * alphaG;
   float b = NdotV * NdotV;
   return 1.0 / (abs(NdotV) + max(sqrt(a + b - a * b), 0.0001));
 }
 
-float disneyBrdfDiffuseFactor(float cosIn, float cosOut, float cosInHalf,
-                              float roughness, float metallic) {
+CPP_FUNCTION float disneyBrdfDiffuseFactor(float cosIn, float cosOut,
+                                           float cosInHalf, float roughness,
+                                           float metallic) {
   float fresnelIn        = schlickFresnel(cosIn);
   float fresnelOut       = schlickFresnel(cosOut);
   float fresnelDiffuse90 = 0.5 + 2.0 * cosInHalf * cosInHalf * roughness;
@@ -31,22 +42,23 @@ float disneyBrdfDiffuseFactor(float cosIn, float cosOut, float cosInHalf,
                          mix(1.0, fresnelDiffuse90, fresnelOut);
   return fresnelDiffuse * (1.0f - metallic) / M_PI;
 }
-vec3 disneyBrdfDiffuse(float cosIn, float cosOut, float cosInHalf, vec3 albedo,
-                       float roughness, float metallic) {
+CPP_FUNCTION vec3 disneyBrdfDiffuse(float cosIn, float cosOut, float cosInHalf,
+                                    vec3 albedo, float roughness,
+                                    float metallic) {
   return albedo *
          disneyBrdfDiffuseFactor(cosIn, cosOut, cosInHalf, roughness, metallic);
 }
-float disneyBrdfDiffuseLuminance(float cosIn, float cosOut, float cosInHalf,
-                                 float luminance, float roughness,
-                                 float metallic) {
+CPP_FUNCTION float disneyBrdfDiffuseLuminance(float cosIn, float cosOut,
+                                              float cosInHalf, float luminance,
+                                              float roughness, float metallic) {
   return luminance *
          disneyBrdfDiffuseFactor(cosIn, cosOut, cosInHalf, roughness, metallic);
 }
 
 /// Returns (fresnelInHalf, Gs * Ds)
-vec2 disneyBrdfSpecularFactors(float cosIn, float cosOut, float cosHalf,
-                               float cosInHalf, float roughness,
-                               float metallic) {
+CPP_FUNCTION vec2 disneyBrdfSpecularFactors(float cosIn, float cosOut,
+                                            float cosHalf, float cosInHalf,
+                                            float roughness) {
   // Fresnel specular (Fs)
   float fresnelInHalf = schlickFresnel(cosInHalf);
 
@@ -60,22 +72,23 @@ vec2 disneyBrdfSpecularFactors(float cosIn, float cosOut, float cosHalf,
 
   return vec2(fresnelInHalf, Gs * Ds);
 }
-vec3 disneyBrdfSpecular(float cosIn, float cosOut, float cosHalf,
-                        float cosInHalf, vec3 albedo, float roughness,
-                        float metallic) {
-  vec2 factors = disneyBrdfSpecularFactors(cosIn, cosOut, cosHalf, cosInHalf,
-                                           roughness, metallic);
+CPP_FUNCTION vec3 disneyBrdfSpecular(float cosIn, float cosOut, float cosHalf,
+                                     float cosInHalf, vec3 albedo,
+                                     float roughness, float metallic) {
+  vec2 factors =
+      disneyBrdfSpecularFactors(cosIn, cosOut, cosHalf, cosInHalf, roughness);
 
   vec3 specularColor = mix(vec3(0.04f), albedo, metallic);
   vec3 Fs            = mix(specularColor, vec3(1.0), factors.x);
 
   return Fs * factors.y;
 }
-float disneyBrdfSpecularLuminance(float cosIn, float cosOut, float cosHalf,
-                                  float cosInHalf, float luminance,
-                                  float roughness, float metallic) {
-  vec2 factors = disneyBrdfSpecularFactors(cosIn, cosOut, cosHalf, cosInHalf,
-                                           roughness, metallic);
+CPP_FUNCTION float disneyBrdfSpecularLuminance(float cosIn, float cosOut,
+                                               float cosHalf, float cosInHalf,
+                                               float luminance, float roughness,
+                                               float metallic) {
+  vec2 factors =
+      disneyBrdfSpecularFactors(cosIn, cosOut, cosHalf, cosInHalf, roughness);
 
   float specularLuminance = mix(0.04f, luminance, metallic);
   float Fs                = mix(specularLuminance, 1.0f, factors.x);
@@ -83,8 +96,9 @@ float disneyBrdfSpecularLuminance(float cosIn, float cosOut, float cosHalf,
   return Fs * factors.y;
 }
 
-vec3 disneyBrdfColor(float cosIn, float cosOut, float cosHalf, float cosInHalf,
-                     vec3 albedo, float roughness, float metallic) {
+CPP_FUNCTION vec3 disneyBrdfColor(float cosIn, float cosOut, float cosHalf,
+                                  float cosInHalf, vec3 albedo, float roughness,
+                                  float metallic) {
   if (cosIn < 0.0f) {
     return vec3(0.0f);
   }
@@ -95,9 +109,9 @@ vec3 disneyBrdfColor(float cosIn, float cosOut, float cosHalf, float cosInHalf,
 
   return diffuse + specular;
 }
-float disneyBrdfLuminance(float cosIn, float cosOut, float cosHalf,
-                          float cosInHalf, float albedoLuminance,
-                          float roughness, float metallic) {
+CPP_FUNCTION float disneyBrdfLuminance(float cosIn, float cosOut, float cosHalf,
+                                       float cosInHalf, float albedoLuminance,
+                                       float roughness, float metallic) {
   if (cosIn < 0.0f) {
     return 0.0f;
   }
@@ -108,3 +122,5 @@ float disneyBrdfLuminance(float cosIn, float cosOut, float cosHalf,
 
   return diffuse + specular;
 }
+
+#endif  // DISNEY_BRDF_GLSL
@@ -0,0 +1,39 @@
+// Equirectangular environment lighting, see `utils/environment_map.hpp` for
+// the layout of the map and of its alias table. Shaders including this header
+// declare `environmentMap` in the light descriptor set.
+//
+// On the GPU every pixel of the map is a directional light through its center
+// whose power is the pixel radiance times the pixel's solid angle, so
+// `lightIndex` of a reservoir is simply the pixel index.
+
+#ifndef ENVIRONMENT_GLSL
+#define ENVIRONMENT_GLSL 1
+
+#include "math.glsl"
+
+vec3 environmentUvToDirection(vec2 uv) {
+  float phi   = uv.x * (2.0f * M_PI) - M_PI;
+  float theta = uv.y * M_PI;
+  return vec3(cos(phi) * sin(theta), cos(theta), sin(phi) * sin(theta));
+}
+
+vec2 environmentDirectionToUv(vec3 dir) {
+  float phi   = atan(dir.z, dir.x);
+  float theta = acos(clamp(dir.y, -1.0f, 1.0f));
+  return vec2((phi + M_PI) / (2.0f * M_PI), theta / M_PI);
+}
+
+// Direction through the center of pixel `pixelIndex`, and the pixel radiance
+// scaled by its solid angle
+vec3 environmentPixelLight(uint pixelIndex, out vec3 dir) {
+  uvec2 size = uvec2(textureSize(environmentMap, 0));
+  uvec2 pixel = uvec2(pixelIndex % size.x, pixelIndex / size.x);
+  vec2 uv     = (vec2(pixel) + 0.5f) / vec2(size);
+  dir         = environmentUvToDirection(uv);
+
+  float solidAngle = (2.0f * M_PI / float(size.x)) * (M_PI / float(size.y)) *
+                     sin(uv.y * M_PI);
+  return solidAngle * texelFetch(environmentMap, ivec2(pixel), 0).rgb;
+}
+
+#endif  // ENVIRONMENT_GLSL
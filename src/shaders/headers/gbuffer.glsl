@@ -0,0 +1,81 @@
+// Packed GBuffer, one rgba32ui texel (16 bytes) per pixel, mirrored on the
+// host by `utils/packing.hpp`:
+//   x  distance to the camera along the primary ray, 0 without geometry
+//   y  octahedral normal, snorm16 x 2
+//   z  albedo, unorm8 x 4 (alpha marks emissive surfaces)
+//   w  roughness, metallic, medium flag and anisotropy g * 0.5 + 0.5,
+//      unorm8 x 4
+// The world position is reconstructed from the distance and the primary ray,
+// computed with the same operations as in `restir.rgen`. Requires
+// `GeometryInfo` and `luminance`.
+
+#ifndef GBUFFER_GLSL
+#define GBUFFER_GLSL 1
+
+vec2 signNotZero(vec2 v) {
+  return vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+vec2 encodeOctahedral(vec3 n) {
+  float l1 = abs(n.x) + abs(n.y) + abs(n.z);
+  if (l1 == 0.0f) {
+    return vec2(0.0f);
+  }
+  n /= l1;
+  return n.z >= 0.0f ? n.xy : (1.0f - abs(n.yx)) * signNotZero(n.xy);
+}
+
+vec3 decodeOctahedral(vec2 e) {
+  vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+  if (n.z < 0.0f) {
+    n.xy = (1.0f - abs(n.yx)) * signNotZero(n.xy);
+  }
+  return normalize(n);
+}
+
+// Direction of the primary ray through `pixel`, as traced by `restir.rgen`
+vec3 cameraRayDirection(ivec2 pixel, uvec2 screenSize, mat4 viewInverse,
+                        mat4 projectionInverse) {
+  const vec2 inUV = vec2(pixel) / vec2(screenSize);
+  vec2 d          = inUV * 2.0 - 1.0;
+  vec4 target     = projectionInverse * vec4(d.x, d.y, 1, 1);
+  return (viewInverse * vec4(normalize(target.xyz), 0)).xyz;
+}
+
+uvec4 packGBuffer(in GeometryInfo gInfo, float depth) {
+  vec4 material = vec4(gInfo.roughness, gInfo.metallic,
+                       gInfo.inMedium ? 1.0f : 0.0f,
+                       gInfo.anisotropy * 0.5f + 0.5f);
+  return uvec4(floatBitsToUint(depth),
+               packSnorm2x16(encodeOctahedral(gInfo.normal)),
+               packUnorm4x8(gInfo.albedo), packUnorm4x8(material));
+}
+
+bool gBufferHasGeometry(uvec4 texel) {
+  return uintBitsToFloat(texel.x) > 0.0f;
+}
+
+GeometryInfo unpackGBuffer(uvec4 texel, ivec2 pixel, uvec2 screenSize,
+                           vec3 camPos, mat4 viewInverse,
+                           mat4 projectionInverse) {
+  vec3 origin = (viewInverse * vec4(0, 0, 0, 1)).xyz;
+  vec3 dir =
+      cameraRayDirection(pixel, screenSize, viewInverse, projectionInverse);
+
+  GeometryInfo gInfo;
+  gInfo.camPos           = camPos;
+  gInfo.worldPos         = origin + uintBitsToFloat(texel.x) * dir;
+  gInfo.normal           = decodeOctahedral(unpackSnorm2x16(texel.y));
+  gInfo.albedo           = unpackUnorm4x8(texel.z);
+  vec4 material          = unpackUnorm4x8(texel.w);
+  gInfo.roughness        = material.x;
+  gInfo.metallic         = material.y;
+  gInfo.inMedium         = material.z > 0.5f;
+  gInfo.anisotropy       = material.w * 2.0f - 1.0f;
+  gInfo.emissive         = vec3(0.0f);
+  gInfo.albedoLum  = luminance(gInfo.albedo.r, gInfo.albedo.g, gInfo.albedo.b);
+  gInfo.sampleSeed = 0;
+  return gInfo;
+}
+
+#endif  // GBUFFER_GLSL
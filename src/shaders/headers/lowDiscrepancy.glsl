@@ -0,0 +1,66 @@
+// Owen-scrambled Sobol points shared by the shaders and the host (see
+// `utils/shader_functions.hpp` and `utils/low_discrepancy.hpp`). Follows
+// Burley, "Practical Hash-based Owen Scrambling": only the first two Sobol
+// dimensions are used, higher dimensions are padded with independently
+// shuffled and scrambled 2D sets.
+
+#ifndef LOW_DISCREPANCY_GLSL
+#define LOW_DISCREPANCY_GLSL 1
+
+#ifndef CPP_FUNCTION
+#define CPP_FUNCTION
+#endif
+
+#include "rng.glsl"
+
+CPP_FUNCTION uint ldReverseBits(uint x) {
+  x = ((x >> 1u) & 0x55555555u) | ((x & 0x55555555u) << 1u);
+  x = ((x >> 2u) & 0x33333333u) | ((x & 0x33333333u) << 2u);
+  x = ((x >> 4u) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4u);
+  x = ((x >> 8u) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8u);
+  return (x >> 16u) | (x << 16u);
+}
+
+CPP_FUNCTION uint ldLaineKarrasPermutation(uint x, uint seed) {
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+// Nested uniform (Owen) scramble of a 32-bit fixed-point value
+CPP_FUNCTION uint ldNestedUniformScramble(uint x, uint seed) {
+  return ldReverseBits(ldLaineKarrasPermutation(ldReverseBits(x), seed));
+}
+
+// First Sobol dimension, i.e. the van der Corput sequence
+CPP_FUNCTION uint ldSobolDim0(uint index) { return ldReverseBits(index); }
+
+// Second Sobol dimension; its direction numbers follow v ^= v >> 1
+CPP_FUNCTION uint ldSobolDim1(uint index) {
+  uint result = 0u;
+  uint v      = 0x80000000u;
+  for (uint bits = index; bits != 0u; bits >>= 1u) {
+    if ((bits & 1u) != 0u) {
+      result ^= v;
+    }
+    v ^= v >> 1u;
+  }
+  return result;
+}
+
+// `index`-th point of the Owen-scrambled Sobol set identified by `seed`.
+// `dimensionPair` selects an independent 2D set for the same seed.
+CPP_FUNCTION vec2 ldOwenSobol2D(uint index, uint seed, uint dimensionPair) {
+  uint setSeed  = rngHash(seed ^ rngHash(dimensionPair));
+  uint shuffled = ldNestedUniformScramble(index, rngHash(setSeed));
+  uint x =
+      ldNestedUniformScramble(ldSobolDim0(shuffled), rngHash(setSeed + 1u));
+  uint y =
+      ldNestedUniformScramble(ldSobolDim1(shuffled), rngHash(setSeed + 2u));
+  return vec2(rngToFloat(x), rngToFloat(y));
+}
+
+#endif  // LOW_DISCREPANCY_GLSL
@@ -1,2 +1,7 @@
-#define M_PI   3.1415926535897932384626433832795
+// <cmath> defines both on the host, to the same values
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+#ifndef M_1_PI
 #define M_1_PI 0.318309886183790671538
+#endif
@@ -0,0 +1,178 @@
+// Phase functions of the participating medium, shared by the shaders and the
+// host (see `utils/shader_functions.hpp`). `cosTheta` is the cosine between
+// wo, toward the viewer, and wi, toward the light, so that g > 0 scatters
+// forward; the phase functions are normalized over the sphere of directions.
+//   PHASE_HENYEY_GREENSTEIN         one lobe of anisotropy g
+//   PHASE_DOUBLE_HENYEY_GREENSTEIN  blend * HG(g) + (1 - blend) * HG(g2),
+//                                   e.g. a forward and a back lobe
+//   PHASE_DRAINE                    HG(g) * (1 + alpha * cos^2), normalized;
+//                                   alpha = 1 gives Cornette-Shanks
+// `phaseEval` is also the pdf of `phaseSample`, which draws wi exactly.
+// `phaseLuminance` is the fast path of the ReSTIR target functions, as
+// `disneyBrdfLuminance` for surfaces: the albedo luminance times the phase
+// function with every Henyey-Greenstein lobe replaced by its Schlick
+// approximation, which needs no square root and is normalized as well (up to
+// a few percent for Draine, which keeps the normalization of HG).
+// See Draine, "Scattering by Interstellar Dust Grains", and Jendersie and
+// d'Eon, "An Approximate Mie Scattering Function for Fog and Cloud Rendering".
+
+#ifndef PHASE_GLSL
+#define PHASE_GLSL 1
+
+#ifndef CPP_FUNCTION
+#define CPP_FUNCTION
+#endif
+
+#define PHASE_INV_4PI 0.0795774715459476679f
+#define PHASE_2PI     6.28318530717958647692f
+
+#define PHASE_HENYEY_GREENSTEIN        0
+#define PHASE_DOUBLE_HENYEY_GREENSTEIN 1
+#define PHASE_DRAINE                   2
+
+// below this |g| the lobes are sampled as isotropic
+#define PHASE_ISOTROPIC_EPSILON 1e-3f
+
+struct PhaseFunction {
+  int model;    // PHASE_*
+  float g;      // anisotropy, of the first lobe for the double lobe
+  float g2;     // anisotropy of the second lobe
+  float blend;  // weight of the first lobe
+  float alpha;  // Draine alpha
+};
+
+CPP_FUNCTION float phaseHenyeyGreenstein(float cosTheta, float g) {
+  float denom = 1.0f + g * g + 2.0f * g * cosTheta;
+  return PHASE_INV_4PI * (1.0f - g * g) / (denom * sqrt(denom));
+}
+
+// Schlick's rational fit of Henyey-Greenstein; the fit of k overshoots 1 just
+// below g = 1, so it is kept inside (-1, 1)
+CPP_FUNCTION float phaseSchlick(float cosTheta, float g) {
+  float k     = 1.55f * g - 0.55f * g * g * g;
+  k           = k > 0.99f ? 0.99f : (k < -0.99f ? -0.99f : k);
+  float denom = 1.0f + k * cosTheta;
+  return PHASE_INV_4PI * (1.0f - k * k) / (denom * denom);
+}
+
+// 1 / mean of 1 + alpha * cos^2 over HG(g)
+CPP_FUNCTION float draineNormalization(float g, float alpha) {
+  return 1.0f / (1.0f + alpha * (1.0f + 2.0f * g * g) / 3.0f);
+}
+
+CPP_FUNCTION float phaseDraine(float cosTheta, float g, float alpha) {
+  return phaseHenyeyGreenstein(cosTheta, g) *
+         (1.0f + alpha * cosTheta * cosTheta) * draineNormalization(g, alpha);
+}
+
+CPP_FUNCTION float phaseEval(PhaseFunction phase, float cosTheta) {
+  if (phase.model == PHASE_DOUBLE_HENYEY_GREENSTEIN) {
+    return phase.blend * phaseHenyeyGreenstein(cosTheta, phase.g) +
+           (1.0f - phase.blend) * phaseHenyeyGreenstein(cosTheta, phase.g2);
+  }
+  if (phase.model == PHASE_DRAINE) {
+    return phaseDraine(cosTheta, phase.g, phase.alpha);
+  }
+  return phaseHenyeyGreenstein(cosTheta, phase.g);
+}
+
+CPP_FUNCTION float phasePdf(PhaseFunction phase, float cosTheta) {
+  return phaseEval(phase, cosTheta);
+}
+
+CPP_FUNCTION float phaseLuminance(PhaseFunction phase, float cosTheta,
+                                  float albedoLum) {
+  float value = phaseSchlick(cosTheta, phase.g);
+  if (phase.model == PHASE_DOUBLE_HENYEY_GREENSTEIN) {
+    value = phase.blend * value +
+            (1.0f - phase.blend) * phaseSchlick(cosTheta, phase.g2);
+  } else if (phase.model == PHASE_DRAINE) {
+    // the mean of cos^2 over Schlick's fit differs a little from HG's; the
+    // target only needs to be close
+    value *= (1.0f + phase.alpha * cosTheta * cosTheta) *
+             draineNormalization(phase.g, phase.alpha);
+  }
+  return albedoLum * value;
+}
+
+// Cosine mu between the propagation directions, -cosTheta, drawn from HG(g)
+// for the uniform number `u`
+CPP_FUNCTION float sampleHenyeyGreensteinMu(float u, float g) {
+  if (g * g < PHASE_ISOTROPIC_EPSILON * PHASE_ISOTROPIC_EPSILON) {
+    return 2.0f * u - 1.0f;
+  }
+  float sqrTerm = (1.0f - g * g) / (1.0f - g + 2.0f * g * u);
+  return (1.0f + g * g - sqrTerm * sqrTerm) / (2.0f * g);
+}
+
+// Cumulative distribution of mu under the Draine phase function, from
+// the closed-form moments of HG written without the 1 / g poles
+CPP_FUNCTION float draineCdf(float mu, float g, float alpha) {
+  if (g * g < PHASE_ISOTROPIC_EPSILON * PHASE_ISOTROPIC_EPSILON) {
+    return (mu + 1.0f + alpha * (mu * mu * mu + 1.0f) / 3.0f) /
+           (2.0f + 2.0f * alpha / 3.0f);
+  }
+  float b  = 1.0f + g * g;
+  float s0 = 1.0f + g;                        // sqrt(b - 2g mu) at mu = -1
+  float s1 = sqrt(b - 2.0f * g * mu);         // at mu
+  float d  = 2.0f * (1.0f + mu) / (s0 + s1);  // (s0 - s1) / g
+  // integrals from -1 to mu of (b - 2g t)^-3/2 and t^2 (b - 2g t)^-3/2
+  float moment0 = d / (s0 * s1);
+  float moment2 = d / (4.0f * g * g) *
+                  (b * b / (s0 * s1) - 2.0f * b +
+                   (s0 * s0 + s0 * s1 + s1 * s1) / 3.0f);
+  return 0.5f * (1.0f - g * g) * (moment0 + alpha * moment2) *
+         draineNormalization(g, alpha);
+}
+
+// Inverts `draineCdf` with safeguarded Newton steps from the HG sample,
+// which is exact for alpha = 0
+CPP_FUNCTION float sampleDraineMu(float u, float g, float alpha) {
+  float mu = sampleHenyeyGreensteinMu(u, g);
+  float lo = -1.0f;
+  float hi = 1.0f;
+  for (int i = 0; i < 8; ++i) {
+    float f = draineCdf(mu, g, alpha) - u;
+    if (f > 0.0f) {
+      hi = mu;
+    } else {
+      lo = mu;
+    }
+    float next = mu - f / (PHASE_2PI * phaseDraine(-mu, g, alpha));
+    mu         = next > lo && next < hi ? next : 0.5f * (lo + hi);
+  }
+  return mu;
+}
+
+// cosTheta of a wi drawn proportionally to the phase function
+CPP_FUNCTION float phaseSampleCosTheta(PhaseFunction phase, float u) {
+  if (phase.model == PHASE_DOUBLE_HENYEY_GREENSTEIN) {
+    if (u < phase.blend) {
+      return -sampleHenyeyGreensteinMu(u / phase.blend, phase.g);
+    }
+    return -sampleHenyeyGreensteinMu(
+        (u - phase.blend) / (1.0f - phase.blend), phase.g2);
+  }
+  if (phase.model == PHASE_DRAINE) {
+    return -sampleDraineMu(u, phase.g, phase.alpha);
+  }
+  return -sampleHenyeyGreensteinMu(u, phase.g);
+}
+
+// Direction toward the light for the unit `wo` toward the viewer; its pdf
+// per solid angle is `phasePdf`
+CPP_FUNCTION vec3 phaseSample(PhaseFunction phase, vec3 wo, vec2 u) {
+  float cosTheta = phaseSampleCosTheta(phase, u.x);
+  float sin2     = 1.0f - cosTheta * cosTheta;
+  float sinTheta = sin2 > 0.0f ? sqrt(sin2) : 0.0f;
+  float phi      = PHASE_2PI * u.y;
+  // orthonormal basis around wo (Duff et al.)
+  float s = wo.z >= 0.0f ? 1.0f : -1.0f;
+  float a = -1.0f / (s + wo.z);
+  float c = wo.x * wo.y * a;
+  vec3 t  = vec3(1.0f + s * wo.x * wo.x * a, s * c, -s * wo.x);
+  vec3 b  = vec3(c, s + wo.y * wo.y * a, -wo.y);
+  return sinTheta * cos(phi) * t + sinTheta * sin(phi) * b + cosTheta * wo;
+}
+
+#endif  // PHASE_GLSL
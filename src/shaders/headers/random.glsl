@@ -29,6 +29,7 @@
 #define RANDOM_GLSL 1
 
 #include "host_device.h"
+#include "rng.glsl"
 
 #define RAND_PCG   1
 #define RAND_LCG   2
@@ -0,0 +1,66 @@
+// Reduced-rate ReSTIR, mirrored on the host by `utils/upsampling.hpp`. With
+// `renderScale` other than RENDER_SCALE_FULL the reservoirs form a grid of
+// `renderSize` texels, each covering a block of the screen:
+//   RENDER_SCALE_HALF          2 x 2 pixels
+//   RENDER_SCALE_QUARTER       4 x 4 pixels
+//   RENDER_SCALE_CHECKERBOARD  2 x 1 pixels, alternating between rows
+// Only one pixel of a block, rotating every frame, is shaded by `restir.rgen`
+// and the reuse passes; the GBuffer stays at full resolution and
+// `restir_post.frag` fills the other pixels with a joint-bilateral upsampler.
+
+#ifndef RENDER_SCALE_GLSL
+#define RENDER_SCALE_GLSL 1
+
+// relative depth difference and normal exponent of the bilateral weights
+#define RENDER_SCALE_DEPTH_SIGMA  0.05f
+#define RENDER_SCALE_NORMAL_POWER 32.0f
+#define RENDER_SCALE_MIN_WEIGHT   1e-4f
+
+ivec2 renderScaleBlockSize(int renderScale) {
+  switch (renderScale) {
+    case RENDER_SCALE_HALF:
+      return ivec2(2, 2);
+    case RENDER_SCALE_QUARTER:
+      return ivec2(4, 4);
+    case RENDER_SCALE_CHECKERBOARD:
+      return ivec2(2, 1);
+  }
+  return ivec2(1, 1);
+}
+
+// The pixel shaded for reservoir texel `coord` in frame `frameIndex`; the
+// offset inside the block walks the block in raster order, shifted by one
+// per row so that neighbouring rows differ (a checkerboard for 2 x 1 blocks)
+ivec2 renderScalePixel(ivec2 coord, int renderScale, uint frameIndex,
+                       uvec2 screenSize) {
+  ivec2 block = renderScaleBlockSize(renderScale);
+  uint width  = uint(block.x);
+  uint offset = (frameIndex + uint(coord.y)) % (width * uint(block.y));
+  ivec2 pixel = coord * block + ivec2(offset % width, offset / width);
+  return min(pixel, ivec2(screenSize) - 1);
+}
+
+// The reservoir texel whose block contains `pixel`
+ivec2 renderScaleCoord(ivec2 pixel, int renderScale) {
+  return pixel / renderScaleBlockSize(renderScale);
+}
+
+// Tent around the shaded pixel `shaded`, four blocks wide with a radius of
+// two, so that every pixel sees several shaded pixels on its own surface
+float renderScaleSpatialWeight(ivec2 pixel, ivec2 shaded, int renderScale) {
+  ivec2 block = renderScaleBlockSize(renderScale);
+  vec2 radius = vec2(2 * max(block.x, block.y));
+  vec2 tent   = max(vec2(0.0f), 1.0f - abs(vec2(pixel - shaded)) / radius);
+  return tent.x * tent.y;
+}
+
+float renderScaleBilateralWeight(float depth, vec3 normal, float shadedDepth,
+                                 vec3 shadedNormal) {
+  float depthWeight =
+      exp(-abs(depth - shadedDepth) / (RENDER_SCALE_DEPTH_SIGMA * depth));
+  float normalWeight = pow(max(dot(normal, shadedNormal), 0.0f),
+                           RENDER_SCALE_NORMAL_POWER);
+  return depthWeight * normalWeight;
+}
+
+#endif  // RENDER_SCALE_GLSL
@@ -1,30 +1,40 @@
 // these structs are not supposed to be seen by the cpu
 #include "restirUtils.glsl"
 
-Reservoir unpackReservoirStruct(vec4 reservoirInfo, vec4 reservoirWeight) {
+// Packed reservoir, one rgba32ui texel (16 bytes) per pixel in each of the
+// RESERVOIR_SIZE layers of the reservoir images, mirrored on the host by
+// `utils/packing.hpp`:
+//   x  light index in the low 30 bits, light kind in the high 2
+//   y  sample seed
+//   z  w as a float
+//   w  M saturated to 16 bits, half-precision pHat in the high 16 bits
+// sumWeights is not stored: it is only needed to keep streaming into the
+// reservoir, which then continues from pHat * w * M like any combined one.
+
+#define RESERVOIR_LIGHT_INDEX_BITS 30
+#define RESERVOIR_MAX_HALF         65504.0f
+
+Reservoir unpackReservoirStruct(uvec4 texel) {
   Reservoir res;
-  res.numStreamSamples = floatBitsToUint(reservoirInfo.x);
-  res.lightIndex       = floatBitsToUint(reservoirInfo.y);
-  res.lightKind        = floatBitsToInt(reservoirInfo.z);
-  res.sampleSeed       = floatBitsToUint(reservoirInfo.w);
-
-  res.pHat       = reservoirWeight.x;
-  res.sumWeights = reservoirWeight.y;
-  res.w          = reservoirWeight.z;
-
+  res.lightIndex       = texel.x & ((1u << RESERVOIR_LIGHT_INDEX_BITS) - 1u);
+  res.lightKind        = int(texel.x >> RESERVOIR_LIGHT_INDEX_BITS);
+  res.sampleSeed       = texel.y;
+  res.w                = uintBitsToFloat(texel.z);
+  res.numStreamSamples = texel.w & 0xFFFFu;
+  res.pHat             = unpackHalf2x16(texel.w >> 16).x;
+  // a pHat below the half range cannot be renormalized any more
+  if (res.pHat == 0.0f) {
+    res.w = 0.0f;
+  }
+  res.sumWeights = res.pHat * res.w * float(res.numStreamSamples);
   return res;
 }
 
-void packReservoirStruct(Reservoir res, out vec4 reservoirInfo,
-                         out vec4 reservoirWeight) {
-  reservoirInfo.x = uintBitsToFloat(res.numStreamSamples);
-  reservoirInfo.y = uintBitsToFloat(res.lightIndex);
-  reservoirInfo.z = intBitsToFloat(res.lightKind);
-  reservoirInfo.w = uintBitsToFloat(res.sampleSeed);
-
-  reservoirWeight.x = res.pHat;
-  reservoirWeight.y = res.sumWeights;
-  reservoirWeight.z = res.w;
+uvec4 packReservoirStruct(Reservoir res) {
+  uint kind = uint(res.lightKind) << RESERVOIR_LIGHT_INDEX_BITS;
+  uint pHat = packHalf2x16(vec2(min(res.pHat, RESERVOIR_MAX_HALF), 0.0f));
+  return uvec4(res.lightIndex | kind, res.sampleSeed, floatBitsToUint(res.w),
+               min(res.numStreamSamples, 0xFFFFu) | (pHat << 16));
 }
 
 void updateReservoir(inout Reservoir res, uint lightIdx, int lightKind,
@@ -42,15 +52,29 @@ void updateReservoir(inout Reservoir res, uint lightIdx, int lightKind,
   }
 }
 
-void addSampleToReservoir(inout Reservoir res, uint lightIdx, int lightKind,
-                          float lightPdf, vec3 lightPos, in GeometryInfo gInfo,
-                          inout uint seed) {
+// Streams one candidate into the RESERVOIR_SIZE reservoirs of a pixel: the
+// target is evaluated once and every reservoir makes its own replacement
+// decision, so they end up holding different lights
+void addSampleToReservoirs(inout Reservoir res[RESERVOIR_SIZE], uint lightIdx,
+                           int lightKind, float lightPdf, vec3 lightPos,
+                           in GeometryInfo gInfo, inout uint seed) {
   float pHat   = evaluatePHat(lightIdx, lightKind, gInfo);
   float weight = pHat / lightPdf;
-  res.numStreamSamples += 1;
-  float w = (res.sumWeights + weight) / (res.numStreamSamples * pHat);
-  updateReservoir(res, lightIdx, lightKind, weight, pHat, w, lightPos, seed,
-                  gInfo.sampleSeed);
+  for (int i = 0; i < RESERVOIR_SIZE; ++i) {
+    res[i].numStreamSamples += 1;
+    float w =
+        (res[i].sumWeights + weight) / (res[i].numStreamSamples * pHat);
+    updateReservoir(res[i], lightIdx, lightKind, weight, pHat, w, lightPos,
+                    seed, gInfo.sampleSeed);
+  }
+}
+
+// Contribution weight once the candidate stream has ended; the w set on
+// replacement only accounts for the candidates up to the selected one
+void finalizeReservoir(inout Reservoir res) {
+  res.w = res.pHat > 0.0f
+              ? res.sumWeights / (res.numStreamSamples * res.pHat)
+              : 0.0f;
 }
 
 void combineReservoirs(inout Reservoir self, Reservoir other,
@@ -58,15 +82,21 @@ void combineReservoirs(inout Reservoir self, Reservoir other,
                        inout uint seed) {
   uint Z = self.numStreamSamples;
 
+  // triangle light samples are regenerated from the seed of their reservoir
+  GeometryInfo selfInfo  = gInfo;
+  GeometryInfo otherInfo = otherGInfo;
+
   self.numStreamSamples += other.numStreamSamples;
-  float pHat   = evaluatePHat(other.lightIndex, other.lightKind, gInfo);
+  selfInfo.sampleSeed = other.sampleSeed;
+  float pHat   = evaluatePHat(other.lightIndex, other.lightKind, selfInfo);
   float weight = pHat * other.w * other.numStreamSamples;
   if (weight > 0.0f) {
     updateReservoir(self, other.lightIndex, other.lightKind, weight, pHat,
                     other.w, other.lightPos, seed, other.sampleSeed);
   }
 
-  pHat = evaluatePHat(self.lightIndex, self.lightKind, otherGInfo);
+  otherInfo.sampleSeed = self.sampleSeed;
+  pHat = evaluatePHat(self.lightIndex, self.lightKind, otherInfo);
   if (pHat > 0.0f) {
     Z += other.numStreamSamples;
   }
@@ -89,6 +119,47 @@ void combineReservoirs(inout Reservoir self, Reservoir other, float pHat,
   }
 }
 
+// Generalized balance heuristic reuse (RESTIR_MIS_REUSE_FLAG). The sample y_i
+// of reservoir i is resampled with m_i(y_i) pHat(y_i) W_i, where
+//   m_i(y) = M_i pHat_i(y) / sum_j M_j pHat_j(y)
+// over the targets pHat_j of all combined reservoirs. The weights sum to one
+// for every sample, so the result is unbiased without a Z or 1 / M
+// normalization. `pHat` is the target of the sample at the shading point,
+// which is also one of the terms of the MIS denominator.
+void streamMisSample(inout Reservoir res, Reservoir other, float misWeight,
+                     float pHat, inout uint seed) {
+  res.numStreamSamples += other.numStreamSamples;
+  float weight = misWeight * pHat * other.w;
+  if (weight > 0.0f) {
+    updateReservoir(res, other.lightIndex, other.lightKind, weight, pHat,
+                    other.w, other.lightPos, seed, other.sampleSeed);
+  }
+}
+
+void finalizeMisReservoir(inout Reservoir res) {
+  res.w = res.pHat > 0.0f ? res.sumWeights / res.pHat : 0.0f;
+}
+
+// m_i for a reservoir with `numSamples` and own target `pHat`, given the sum
+// of M_j pHat_j over all combined reservoirs
+float balanceHeuristic(uint numSamples, float pHat, float sum) {
+  return sum > 0.0f ? numSamples * pHat / sum : 0.0f;
+}
+
+// a neighbouring or previous sample is only reused when its surface is close
+// to the current one; scatter points, whose normals face the camera, only
+// reuse scatter points
+#define REUSE_DEPTH_THRESHOLD  0.1f  // relative camera distance
+#define REUSE_NORMAL_THRESHOLD 0.5f  // cosine between the normals
+
+bool isSimilarSurface(in GeometryInfo gInfo, in GeometryInfo otherGInfo) {
+  float depth      = length(gInfo.worldPos - gInfo.camPos);
+  float otherDepth = length(otherGInfo.worldPos - otherGInfo.camPos);
+  return gInfo.inMedium == otherGInfo.inMedium &&
+         abs(depth - otherDepth) <= REUSE_DEPTH_THRESHOLD * depth &&
+         dot(gInfo.normal, otherGInfo.normal) >= REUSE_NORMAL_THRESHOLD;
+}
+
 Reservoir newReservoir() {
   Reservoir result;
   result.sumWeights       = 0.0f;
@@ -98,66 +169,3 @@ Reservoir newReservoir() {
 
   return result;
 }
-
-// void updateReservoirAt(inout Reservoir res, int i, float weight, vec3
-// position,
-//                        vec4 normal, float emissionLum, uint lightIdx,
-//                        int lightKind, float pHat, float w, float sumPHat,
-//                        inout uint seed) {
-//   res.samples[i].sumWeights += weight;
-//   float replacePossibility = weight / res.samples[i].sumWeights;
-//   if (rnd(seed) < replacePossibility) {
-//     res.samples[i].position_emissionLum = vec4(position, emissionLum);
-//     res.samples[i].normal               = normal;
-//     res.samples[i].lightIndex           = lightIdx;
-//     res.samples[i].lightKind            = lightKind;
-//     res.samples[i].pHat                 = pHat;
-//     res.samples[i].w                    = w;
-//     res.samples[i].sumPHat += sumPHat;
-//   }
-// }
-
-// void addSampleToReservoir(inout Reservoir res, vec3 position, vec4 normal,
-//                           float emissionLum, uint lightIdx, int lightKind,
-//                           float pHat, float sampleP, inout uint seed) {
-//   float weight = pHat / sampleP;
-//   res.numStreamSamples += 1;
-
-//   for (int i = 0; i < RESERVOIR_SIZE; ++i) {
-//     float w =
-//         (res.samples[i].sumWeights + weight) / (res.numStreamSamples * pHat);
-//     updateReservoirAt(res, i, weight, position, normal, emissionLum,
-//     lightIdx,
-//                       lightKind, pHat, w, pHat, seed);
-//   }
-// }
-
-// void combineReservoirs(inout Reservoir self, Reservoir other,
-//                        float pHat[RESERVOIR_SIZE], inout uint seed) {
-//   self.numStreamSamples += other.numStreamSamples;
-
-//   for (int i = 0; i < RESERVOIR_SIZE; ++i) {
-//     float weight = pHat[i] * other.samples[i].w * other.numStreamSamples;
-//     if (weight > 0.0f) {
-//       updateReservoirAt(
-//           self, i, weight, other.samples[i].position_emissionLum.xyz,
-//           other.samples[i].normal, other.samples[i].position_emissionLum.w,
-//           other.samples[i].lightIndex, other.samples[i].lightKind, pHat[i],
-//           other.samples[i].sumPHat, other.samples[i].w, seed);
-//     }
-//     if (self.samples[i].w > 0.0f) {
-//       self.samples[i].w = self.samples[i].sumWeights /
-//                           (self.numStreamSamples * self.samples[i].pHat);
-//     }
-//   }
-// }
-
-// Reservoir newReservoir() {
-//   Reservoir result;
-//   for (int i = 0; i < RESERVOIR_SIZE; ++i) {
-//     result.samples[i].sumWeights = 0.0f;
-//     result.samples[i].sumPHat    = 0.0f;
-//   }
-//   result.numStreamSamples = 0;
-//   return result;
-// }
@@ -1,43 +1,39 @@
 #include "../host_device.h"
 #include "../structs/light.glsl"
 #include "disneyBRDF.glsl"
+#include "environment.glsl"
+#include "phase.glsl"
 #include "../structs/restirStructs.glsl"
 
+// instance name of the RestirUniforms block of the including shader
+#ifndef RESTIR_UNIFORMS
+#define RESTIR_UNIFORMS restirUniform
+#endif
+
 float luminance(vec3 v) {
   return dot(v, vec3(0.212671f, 0.715160f, 0.072169f));
 }
 
+// Phase function of the medium at a scatter point, whose g comes from the
+// GBuffer
+PhaseFunction mediumPhase(in GeometryInfo gInfo) {
+  return PhaseFunction(RESTIR_UNIFORMS.phaseModel, gInfo.anisotropy,
+                       RESTIR_UNIFORMS.phaseAnisotropy2,
+                       RESTIR_UNIFORMS.phaseBlend,
+                       RESTIR_UNIFORMS.phaseDraineAlpha);
+}
+
 vec3 getTrianglePoint(float r1, float r2, vec3 p1, vec3 p2, vec3 p3) {
   float sqrt_r1 = sqrt(r1);
   return (1.0 - sqrt_r1) * p1 + (sqrt_r1 * (1.0 - r2)) * p2 +
          (r2 * sqrt_r1) * p3;
 }
 
-// vec4 EnvironmentSample(uint selected_idx, vec3 to_light) {
-//   uvec2 tsize = textureSize(environmentalTexture, 0);
-//   uint width  = tsize.x;
-//   uint height = tsize.y;
-
-//   uint px = selected_idx % width;
-//   uint py = selected_idx / width;
-//   // py = height - py - 1;
-//   const float dw    = 1.0f / float(width);
-//   const float dh    = 1.0f / float(height);
-//   const float u     = float(px) * dw;
-//   const float phi   = (u + 0.5f * dw) * (2.0f * M_PI) - M_PI;
-//   const float v     = float(py) * dh;
-//   const float theta = (v + 0.5f * dh) * M_PI;
-
-//   to_light = vec3(cos(phi) * sin(theta), cos(theta), sin(phi) * sin(theta));
-
-//   return texture(environmentalTexture, vec2(u, 1.0f - v));
-// }
-
 float evaluatePHat(uint lightIdx, int lightKind, in GeometryInfo gInfo) {
   vec3 wi;
   float emissionLum;
-  float LdotN = 1.0;
-  uint seed   = gInfo.sampleSeed;
+  vec3 lightNormal = vec3(0.0f);
+  uint seed        = gInfo.sampleSeed;
   if (lightKind == LIGHT_KIND_POINT) {
     PointLight light = pointLights.lights[lightIdx];
     wi               = light.pos.xyz - gInfo.worldPos;
@@ -48,20 +44,27 @@ float evaluatePHat(uint lightIdx, int lightKind, in GeometryInfo gInfo) {
                                            light.p2.xyz, light.p3.xyz);
     wi                  = lightSamplePos - gInfo.worldPos;
     emissionLum         = light.emission_luminance.w;
-    vec3 normal         = light.normalArea.xyz;
-    LdotN               = dot(normal, wi);
-  } /* else if (lightKind == LIGHT_KIND_ENVIRONMENT) {
-    vec4 col =
-        1.0f / uniforms.environmentalPower * EnvironmentSample(lightIdx, wi);
-    emissionLum = 1.0f / uniforms.environmentalPower * col.a;
-  } */
-  if (dot(wi, gInfo.normal) < 0.0f) {
-    return 0.0f;
+    lightNormal         = light.normalArea.xyz;
+  } else if (lightKind == LIGHT_KIND_ENVIRONMENT) {
+    emissionLum = luminance(environmentPixelLight(lightIdx, wi));
   }
 
   float sqrDist = dot(wi, wi);
   wi /= sqrt(sqrDist);
   vec3 wo = normalize(vec3(gInfo.camPos) - gInfo.worldPos);
+  // taken after normalizing wi; emitters are double-sided, as in the light
+  // sampling pdf of restir.rgen
+  float LdotN = lightKind == LIGHT_KIND_TRIANGLE ? abs(dot(lightNormal, wi))
+                                                 : 1.0f;
+  // scatter points have no hemisphere, sigma_s is left out as a constant
+  if (gInfo.inMedium) {
+    return emissionLum *
+           phaseLuminance(mediumPhase(gInfo), dot(wo, wi), gInfo.albedoLum) *
+           LdotN / sqrDist;
+  }
+  if (dot(wi, gInfo.normal) < 0.0f) {
+    return 0.0f;
+  }
 
   float cosIn     = dot(gInfo.normal, wi);
   float cosOut    = dot(gInfo.normal, wo);
@@ -80,8 +83,8 @@ float evaluatePHat(uint lightIdx, int lightKind, in GeometryInfo gInfo) {
 vec3 evaluatePHatFull(uint lightIdx, int lightKind, in GeometryInfo gInfo) {
   vec3 wi;
   vec3 emission;
-  float LdotN = 1.0;
-  uint seed   = gInfo.sampleSeed;
+  vec3 lightNormal = vec3(0.0f);
+  uint seed        = gInfo.sampleSeed;
   if (lightKind == LIGHT_KIND_POINT) {
     PointLight light = pointLights.lights[lightIdx];
     wi               = light.pos.xyz - gInfo.worldPos;
@@ -92,20 +95,24 @@ vec3 evaluatePHatFull(uint lightIdx, int lightKind, in GeometryInfo gInfo) {
                                            light.p2.xyz, light.p3.xyz);
     wi                  = lightSamplePos - gInfo.worldPos;
     emission            = light.emission_luminance.xyz;
-    vec3 normal         = light.normalArea.xyz;
-    LdotN               = dot(normal, wi);
-  } /* else if (lightKind == LIGHT_KIND_ENVIRONMENT) {
-    emission = 1.0f / uniforms.environmentalPower *
-               EnvironmentSample(lightIdx, wi).xyz;
-  } */
-
-  if (dot(wi, gInfo.normal) < 0.0f) {
-    return vec3(0.0f);
+    lightNormal         = light.normalArea.xyz;
+  } else if (lightKind == LIGHT_KIND_ENVIRONMENT) {
+    emission = environmentPixelLight(lightIdx, wi);
   }
 
   float sqrDist = dot(wi, wi);
   wi /= sqrt(sqrDist);
   vec3 wo = normalize(vec3(gInfo.camPos) - gInfo.worldPos);
+  // as in evaluatePHat
+  float LdotN = lightKind == LIGHT_KIND_TRIANGLE ? abs(dot(lightNormal, wi))
+                                                 : 1.0f;
+  if (gInfo.inMedium) {
+    return emission * gInfo.albedo.xyz *
+           phaseEval(mediumPhase(gInfo), dot(wo, wi)) * LdotN / sqrDist;
+  }
+  if (dot(wi, gInfo.normal) < 0.0f) {
+    return vec3(0.0f);
+  }
 
   float cosIn     = dot(gInfo.normal, wi);
   float cosOut    = dot(gInfo.normal, wo);
@@ -0,0 +1,67 @@
+// Counter-based random numbers shared by the shaders and the host (see
+// `utils/shader_functions.hpp`). Every value is a pure function of a key and a
+// counter, so a pixel's random stream depends only on (pixel, frame index,
+// pass) and never on execution order or timing.
+
+#ifndef RNG_GLSL
+#define RNG_GLSL 1
+
+#ifndef CPP_FUNCTION
+#define CPP_FUNCTION
+#endif
+
+// Passes that draw random numbers within one frame; each gets its own stream
+#define RNG_PASS_INITIAL_SAMPLING 0
+#define RNG_PASS_SPATIAL_REUSE    1
+#define RNG_PASS_TEMPORAL_REUSE   2
+#define RNG_PASS_SHADING          3
+#define RNG_PASS_HOST             4
+#define RNG_PASS_VOLUME           5
+
+// PCG hash, see Jarzynski and Olano, "Hash Functions for GPU Rendering"
+CPP_FUNCTION uint rngHash(uint v) {
+  uint state = v * 747796405u + 2891336453u;
+  uint word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+// Builds the key of a random stream from a 4D counter with two rounds of pcg4d
+CPP_FUNCTION uint rngKey(uint x, uint y, uint frameIndex, uint passIndex) {
+  uint a = x * 1664525u + 1013904223u;
+  uint b = y * 1664525u + 1013904223u;
+  uint c = frameIndex * 1664525u + 1013904223u;
+  uint d = passIndex * 1664525u + 1013904223u;
+
+  a += b * d;
+  b += c * a;
+  c += a * b;
+  d += b * c;
+
+  a ^= a >> 16u;
+  b ^= b >> 16u;
+  c ^= c >> 16u;
+  d ^= d >> 16u;
+
+  a += b * d;
+  b += c * a;
+  c += a * b;
+  d += b * c;
+
+  return a ^ b ^ c ^ d;
+}
+
+// The `counter`-th random word of the stream identified by `key`
+CPP_FUNCTION uint rngAt(uint key, uint counter) {
+  return rngHash(rngHash(counter) + key);
+}
+
+// Maps a random word to a float in [0, 1) using its upper 24 bits
+CPP_FUNCTION float rngToFloat(uint word) {
+  return float(word >> 8u) * (1.0f / 16777216.0f);
+}
+
+CPP_FUNCTION float rngUniformAt(uint key, uint counter) {
+  return rngToFloat(rngAt(key, counter));
+}
+
+#endif  // RNG_GLSL
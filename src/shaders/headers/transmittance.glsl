@@ -0,0 +1,76 @@
+// Building blocks of the transmittance estimators, shared by the shaders and
+// the host (see `utils/shader_functions.hpp`). The tracking loops live in
+// volume.glsl and its host mirror `utils/transmittance.hpp`; both walk the
+// bricks of the density grid and call these per brick, with the minimum and
+// maximum extinction of the brick as its control and majorant.
+//   TRANSMITTANCE_DELTA_TRACKING           binary, 1 until a real collision
+//   TRANSMITTANCE_RATIO_TRACKING           product of the null-collision
+//                                          probabilities 1 - sigma / majorant
+//   TRANSMITTANCE_RESIDUAL_RATIO_TRACKING  exp(-control * d) times ratio
+//                                          tracking of the residual
+//                                          sigma - control
+//   TRANSMITTANCE_NEXT_FLIGHT              ratio tracking that also adds the
+//                                          probability of the next flight
+//                                          leaving the brick at every vertex
+// See Novák et al., "Residual Ratio Tracking for Estimating Attenuation in
+// Participating Media", and "Monte Carlo Methods for Volumetric Light
+// Transport Simulation".
+
+#ifndef TRANSMITTANCE_GLSL
+#define TRANSMITTANCE_GLSL 1
+
+#ifndef CPP_FUNCTION
+#define CPP_FUNCTION
+#endif
+
+// below this weight the ratio estimators play Russian roulette
+#define TRANSMITTANCE_ROULETTE_THRESHOLD 0.1f
+
+// distance to the next tentative collision for the uniform number `u`
+CPP_FUNCTION float sampleFreeFlight(float u, float majorant) {
+  return -log(1.0f - u) / majorant;
+}
+
+CPP_FUNCTION float ratioTrackingWeight(float extinction, float majorant) {
+  return 1.0f - extinction / majorant;
+}
+
+// Control extinction of a brick, from its range. The midpoint would minimize
+// the residual majorant, but its weights in [0, 2] compound over the
+// collisions; the minimum keeps the residual positive and the weights in
+// [0, 1], so the maximum only enters through residualMajorant
+CPP_FUNCTION float controlExtinction(float minExtinction) {
+  return minExtinction;
+}
+
+// Bound of |sigma - control| over the brick
+CPP_FUNCTION float residualMajorant(float minExtinction, float maxExtinction,
+                                    float control) {
+  float above = maxExtinction - control;
+  float below = control - minExtinction;
+  return above > below ? above : below;
+}
+
+// In [0, 1] with the minimum as control
+CPP_FUNCTION float residualRatioWeight(float extinction, float control,
+                                       float majorant) {
+  return 1.0f - (extinction - control) / majorant;
+}
+
+// Probability of the next flight from `t` passing `tEnd`
+CPP_FUNCTION float nextFlightProbability(float majorant, float t,
+                                         float tEnd) {
+  return exp(-majorant * (tEnd - t));
+}
+
+// Russian roulette on a small running estimate; unbiased for uniform `u`
+CPP_FUNCTION float rouletteTransmittance(float transmittance, float u) {
+  if (transmittance >= TRANSMITTANCE_ROULETTE_THRESHOLD) {
+    return transmittance;
+  }
+  return u * TRANSMITTANCE_ROULETTE_THRESHOLD < transmittance
+             ? TRANSMITTANCE_ROULETTE_THRESHOLD
+             : 0.0f;
+}
+
+#endif  // TRANSMITTANCE_GLSL
@@ -0,0 +1,67 @@
+// Per-pixel cache of shadow-ray results, one rgba32ui texel per pixel in each
+// of the RESERVOIR_SIZE layers of `visibilityCache`, mirrored on the host by
+// `utils/visibility_cache.hpp`:
+//   x  light index and kind, packed as in reservoir.glsl, hashed with the
+//      sample seed for triangle lights
+//   y  hash of the quantized shading position
+//   z  frame index of the shadow ray
+//   w  cache epoch << 1 | visible
+// An entry answers a lookup for the same light and position cell while it is
+// at most `visibilityCacheMaxAge` frames old and the renderer has not bumped
+// `visibilityCacheEpoch`, which it does whenever geometry moves. Shaders
+// including this header declare `visibilityCache` and `restirUniform`.
+
+#ifndef VISIBILITY_CACHE_GLSL
+#define VISIBILITY_CACHE_GLSL 1
+
+// edge of a position cell relative to the camera distance, rounded down to a
+// power of two so that slightly different depths share their cells
+#define VISIBILITY_CACHE_CELL_SCALE (1.0f / 256.0f)
+
+// The sample seed picks the point on a triangle light, so it is part of the
+// key: one shadow ray per triangle would bias its penumbra towards whichever
+// point was traced first. Temporal reuse keeps the seed of a static shot, so
+// those still hit.
+uint visibilityCacheLightKey(uint lightIndex, int lightKind, uint sampleSeed) {
+  uint key = lightIndex | (uint(lightKind) << RESERVOIR_LIGHT_INDEX_BITS);
+  return lightKind == LIGHT_KIND_TRIANGLE ? rngHash(key ^ rngHash(sampleSeed))
+                                          : key;
+}
+
+uint visibilityCachePositionKey(vec3 worldPos, float depth) {
+  int level  = int(floor(log2(max(depth * VISIBILITY_CACHE_CELL_SCALE,
+                                  1e-6f))));
+  ivec3 cell = ivec3(floor(worldPos / exp2(float(level))));
+  uint key   = rngHash(uint(cell.x) + rngHash(uint(level)));
+  key        = rngHash(uint(cell.y) + key);
+  return rngHash(uint(cell.z) + key);
+}
+
+bool isVisibilityCacheHit(uvec4 entry, uint lightKey, uint positionKey) {
+  return entry.x == lightKey && entry.y == positionKey &&
+         (entry.w >> 1) == (restirUniform.visibilityCacheEpoch & 0x7FFFFFFFu) &&
+         restirUniform.frameIndex - entry.z <=
+             restirUniform.visibilityCacheMaxAge;
+}
+
+// Looks through the entries of all layers of the pixel
+bool lookupVisibility(ivec2 coord, uint lightKey, uint positionKey,
+                      out bool shadowed) {
+  for (int r = 0; r < RESERVOIR_SIZE; ++r) {
+    uvec4 entry = imageLoad(visibilityCache, ivec3(coord, r));
+    if (isVisibilityCacheHit(entry, lightKey, positionKey)) {
+      shadowed = (entry.w & 1u) == 0u;
+      return true;
+    }
+  }
+  return false;
+}
+
+void storeVisibility(ivec2 coord, int layer, uint lightKey, uint positionKey,
+                     bool shadowed) {
+  uint stamp = (restirUniform.visibilityCacheEpoch << 1) | (shadowed ? 0u : 1u);
+  imageStore(visibilityCache, ivec3(coord, layer),
+             uvec4(lightKey, positionKey, restirUniform.frameIndex, stamp));
+}
+
+#endif  // VISIBILITY_CACHE_GLSL
@@ -0,0 +1,170 @@
+// Participating medium of RESTIR_VOLUME_FLAG, mirrored on the host by
+// `utils/volume.hpp`. The extinction coefficient sigma_t is stored per voxel
+// in `densityGrid` (nearest-voxel lookup) over the box [boundsMin, boundsMax];
+// the single-scattering albedo and the Henyey-Greenstein anisotropy are
+// constant. Distances are sampled with delta tracking against the majorant of
+// the grid, so a collision is a real scattering event with probability
+// proportional to the in-scattered radiance weight sigma_s * T. Shadow rays
+// estimate the fractional transmittance instead, brick by brick against the
+// minimum and maximum extinction of each brick in `densityBricks` (see
+// transmittance.glsl). Shaders including this header declare `densityGrid`
+// and `densityBricks` and include random.glsl.
+
+#ifndef VOLUME_GLSL
+#define VOLUME_GLSL 1
+
+#include "transmittance.glsl"
+
+bool intersectVolumeBounds(vec3 origin, vec3 dir, vec3 boundsMin,
+                           vec3 boundsMax, out float tEnter, out float tExit) {
+  vec3 invDir = 1.0f / dir;
+  vec3 t0     = (boundsMin - origin) * invDir;
+  vec3 t1     = (boundsMax - origin) * invDir;
+  vec3 tNear  = min(t0, t1);
+  vec3 tFar   = max(t0, t1);
+  tEnter      = max(max(tNear.x, tNear.y), max(tNear.z, 0.0f));
+  tExit       = min(min(tFar.x, tFar.y), tFar.z);
+  return tEnter < tExit;
+}
+
+float volumeExtinction(vec3 p, vec3 boundsMin, vec3 boundsMax) {
+  ivec3 size  = textureSize(densityGrid, 0);
+  vec3 uvw    = (p - boundsMin) / (boundsMax - boundsMin);
+  ivec3 voxel = clamp(ivec3(uvw * vec3(size)), ivec3(0), size - 1);
+  return texelFetch(densityGrid, voxel, 0).r;
+}
+
+// Samples a collision along the ray before `tMax`; false if the ray leaves
+// the medium first
+bool deltaTrack(vec3 origin, vec3 dir, float tMax, vec3 boundsMin,
+                vec3 boundsMax, float majorant, inout uint seed, out float t) {
+  float tExit;
+  t = 0.0f;
+  if (majorant <= 0.0f ||
+      !intersectVolumeBounds(origin, dir, boundsMin, boundsMax, t, tExit)) {
+    return false;
+  }
+  tExit = min(tExit, tMax);
+  while (true) {
+    t -= log(1.0f - rnd(seed)) / majorant;
+    if (t >= tExit) {
+      return false;
+    }
+    if (rnd(seed) * majorant <
+        volumeExtinction(origin + t * dir, boundsMin, boundsMax)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Multiplies `transmittance` by the estimate over [t0, t1), which lies in one
+// brick whose extinction spans `range`
+void trackBrick(vec3 origin, vec3 dir, float t0, float t1, vec2 range,
+                int estimator, vec3 boundsMin, vec3 boundsMax,
+                inout float transmittance, inout uint seed) {
+  if (estimator == TRANSMITTANCE_RESIDUAL_RATIO_TRACKING) {
+    float control  = controlExtinction(range.x);
+    float majorant = residualMajorant(range.x, range.y, control);
+    transmittance *= exp(-control * (t1 - t0));
+    if (majorant <= 0.0f) {
+      return;
+    }
+    float t = t0;
+    while (true) {
+      t += sampleFreeFlight(rnd(seed), majorant);
+      if (t >= t1 || transmittance == 0.0f) {
+        return;
+      }
+      transmittance *= residualRatioWeight(
+          volumeExtinction(origin + t * dir, boundsMin, boundsMax), control,
+          majorant);
+      transmittance = rouletteTransmittance(transmittance, rnd(seed));
+    }
+  }
+
+  float majorant = range.y;
+  if (estimator == TRANSMITTANCE_NEXT_FLIGHT) {
+    float weight = 1.0f;
+    float sum    = 0.0f;
+    float t      = t0;
+    while (weight != 0.0f) {
+      sum += weight * nextFlightProbability(majorant, t, t1);
+      t += sampleFreeFlight(rnd(seed), majorant);
+      if (t >= t1) {
+        break;
+      }
+      weight *= ratioTrackingWeight(
+          volumeExtinction(origin + t * dir, boundsMin, boundsMax), majorant);
+    }
+    transmittance *= sum;
+    return;
+  }
+
+  float t = t0;
+  while (true) {
+    t += sampleFreeFlight(rnd(seed), majorant);
+    if (t >= t1 || transmittance == 0.0f) {
+      return;
+    }
+    float extinction = volumeExtinction(origin + t * dir, boundsMin, boundsMax);
+    if (estimator == TRANSMITTANCE_DELTA_TRACKING) {
+      if (rnd(seed) * majorant < extinction) {
+        transmittance = 0.0f;
+      }
+    } else {
+      transmittance *= ratioTrackingWeight(extinction, majorant);
+      transmittance = rouletteTransmittance(transmittance, rnd(seed));
+    }
+  }
+}
+
+// Transmittance along the ray up to `tMax` with the TRANSMITTANCE_*
+// `estimator`; walks the bricks in order (Amanatides and Woo) and skips the
+// empty ones
+float estimateTransmittance(vec3 origin, vec3 dir, float tMax, vec3 boundsMin,
+                            vec3 boundsMax, int estimator, inout uint seed) {
+  float tEnter, tExit;
+  if (!intersectVolumeBounds(origin, dir, boundsMin, boundsMax, tEnter,
+                             tExit)) {
+    return 1.0f;
+  }
+  tExit = min(tExit, tMax);
+
+  ivec3 size    = textureSize(densityBricks, 0);
+  vec3 cellSize = (boundsMax - boundsMin) / vec3(size);
+  ivec3 brick   = clamp(ivec3((origin + tEnter * dir - boundsMin) / cellSize),
+                        ivec3(0), size - 1);
+  ivec3 step    = ivec3(sign(dir));
+  vec3 boundary = boundsMin + vec3(brick + max(step, ivec3(0))) * cellSize;
+  vec3 tNext    = vec3(1e30f);
+  vec3 tDelta   = vec3(1e30f);
+  for (int a = 0; a < 3; ++a) {
+    if (step[a] != 0) {
+      tNext[a]  = (boundary[a] - origin[a]) / dir[a];
+      tDelta[a] = cellSize[a] / abs(dir[a]);
+    }
+  }
+
+  float transmittance = 1.0f;
+  float t             = tEnter;
+  while (t < tExit && transmittance > 0.0f) {
+    int a = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2)
+                              : (tNext.y < tNext.z ? 1 : 2);
+    float tEnd = min(tNext[a], tExit);
+    vec2 range = texelFetch(densityBricks, brick, 0).rg;
+    if (tEnd > t && range.y > 0.0f) {
+      trackBrick(origin, dir, t, tEnd, range, estimator, boundsMin, boundsMax,
+                 transmittance, seed);
+    }
+    t = tEnd;
+    brick[a] += step[a];
+    tNext[a] += tDelta[a];
+    if (brick[a] < 0 || brick[a] >= size[a]) {
+      break;
+    }
+  }
+  return transmittance;
+}
+
+#endif  // VOLUME_GLSL
@@ -64,9 +64,11 @@ START_BINDING(RtxBindings)
 END_BINDING();
 
 START_BINDING(LightBindings) // m_lightDescSetLayoutBind
- ePointLights    = 0,
- eTriangleLights = 1,
- eAliasTable     = 2
+ ePointLights           = 0,
+ eTriangleLights        = 1,
+ eAliasTable            = 2,
+ eEnvironmentMap        = 3,  // equirectangular radiance, rgba32f
+ eEnvironmentAliasTable = 4   // see utils/environment_map.hpp
 END_BINDING();
 
 START_BINDING(RestirUniformBindings)
@@ -74,23 +76,18 @@ START_BINDING(RestirUniformBindings)
 END_BINDING();
 
 START_BINDING(RestirBindings)
- eFrameWorldPosition      = 0,
- eFrameAlbedo             = 1,
- eFrameNormal             = 2,
- eFrameMaterialProps      = 3,
- ePrevFrameWorldPosition  = 4,
- ePrevFrameAlbedo         = 5,
- ePrevFrameNormal         = 6,
- ePrevFrameMaterialProps  = 7,
- eReservoirsInfo          = 8,
- eReservoirWeights        = 9,
- ePrevReservoirInfo       = 10,
- ePrevReservoirWeight     = 11,
- eTmpReservoirInfo        = 12,
- eTmpReservoirWeight      = 13,
- eStorageImage            = 14,
- eOutImageGBuffer         = 15,
- eOutImagePrevGBuffer     = 16
+ eFrameGBuffer        = 0,  // rgba32ui, see headers/gbuffer.glsl
+ ePrevFrameGBuffer    = 1,
+ eReservoirs          = 2,  // rgba32ui, see headers/reservoir.glsl
+ ePrevReservoirs      = 3,
+ eTmpReservoirs       = 4,
+ eStorageImage        = 5,
+ eOutImageGBuffer     = 6,
+ eOutImagePrevGBuffer = 7,
+ eVisibilityCache     = 8,  // rgba32ui, see headers/visibilityCache.glsl
+ eDensityGrid         = 9,  // r32f 3D extinction, see headers/volume.glsl
+ eDensityBricks       = 10, // rg32f 3D min and max extinction per brick
+ eBlueNoise           = 11  // r8ui 3D, a blue-noise tile per slice
 END_BINDING();
 // clang-format on
 
@@ -144,6 +141,13 @@ struct PushConstantRestir {
   alignas(4) int initialize;
 };
 
+// one dispatch of spatialReuse.comp
+struct PushConstantSpatialReuse {
+  alignas(4) uint iteration;
+  alignas(4) int readTemporary;  // else reads the final reservoirs
+  alignas(4) int copyOnly;
+};
+
 struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for
                // device
 {
@@ -216,14 +220,37 @@ struct RestirUniforms {  // m_restirUniformDescSetLayoutBind
   alignas(4) int temporalSampleCountMultiplier;
 
   alignas(8) uvec2 screenSize;
+  alignas(8) uvec2 renderSize;  // reservoir grid, see headers/renderScale.glsl
   alignas(16) vec4 currCamPos;
-  alignas(64) mat4 currFrameProjectionViewMatrix;
+  // std140 aligns matrices to 16 bytes, unlike the 64 used elsewhere
+  alignas(16) mat4 currFrameProjectionViewMatrix;
+  alignas(16) mat4 currFrameViewInverse;
+  alignas(16) mat4 currFrameProjectionInverse;
   alignas(16) vec4 prevCamPos;
-  alignas(64) mat4 prevFrameProjectionViewMatrix;
+  alignas(16) mat4 prevFrameProjectionViewMatrix;
+  alignas(16) mat4 prevFrameViewInverse;
+  alignas(16) mat4 prevFrameProjectionInverse;
 
   alignas(4) int flags;
   alignas(4) int debugMode;
   alignas(4) float gamma;
+  alignas(4) uint frameIndex;  // never reset, seeds the per-frame RNG streams
+  alignas(4) uint visibilityCacheEpoch;   // bumped when geometry moves
+  alignas(4) uint visibilityCacheMaxAge;  // in frames
+  alignas(4) int renderScale;             // RENDER_SCALE_*
+
+  // participating medium of RESTIR_VOLUME_FLAG, see headers/volume.glsl
+  alignas(16) vec4 volumeBoundsMin;
+  alignas(16) vec4 volumeBoundsMax;
+  alignas(16) vec4 volumeAlbedo;          // single-scattering albedo
+  alignas(4) float volumeMajorant;        // max extinction of the density grid
+  alignas(4) float volumeAnisotropy;      // g, of the first lobe if two
+  alignas(4) int transmittanceEstimator;  // TRANSMITTANCE_*
+  // phase function, see headers/phase.glsl
+  alignas(4) int phaseModel;          // PHASE_*
+  alignas(4) float phaseAnisotropy2;  // g of the second lobe
+  alignas(4) float phaseBlend;        // weight of the first lobe
+  alignas(4) float phaseDraineAlpha;
 };
 
 #else
@@ -268,6 +295,12 @@ struct PushConstantRestir {
   int initialize;
 };
 
+struct PushConstantSpatialReuse {
+  uint iteration;
+  int readTemporary;
+  int copyOnly;
+};
+
 struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for
                // device
 {
@@ -340,14 +373,34 @@ struct RestirUniforms {  // m_restirUniformDescSetLayoutBind
   int temporalSampleCountMultiplier;
 
   uvec2 screenSize;
+  uvec2 renderSize;  // reservoir grid, see headers/renderScale.glsl
   vec4 currCamPos;
   mat4 currFrameProjectionViewMatrix;
+  mat4 currFrameViewInverse;
+  mat4 currFrameProjectionInverse;
   vec4 prevCamPos;
   mat4 prevFrameProjectionViewMatrix;
+  mat4 prevFrameViewInverse;
+  mat4 prevFrameProjectionInverse;
 
   int flags;
   int debugMode;
   float gamma;
+  uint frameIndex;  // never reset, seeds the per-frame RNG streams
+  uint visibilityCacheEpoch;   // bumped when geometry moves
+  uint visibilityCacheMaxAge;  // in frames
+  int renderScale;             // RENDER_SCALE_*
+
+  vec4 volumeBoundsMin;
+  vec4 volumeBoundsMax;
+  vec4 volumeAlbedo;
+  float volumeMajorant;
+  float volumeAnisotropy;
+  int transmittanceEstimator;
+  int phaseModel;
+  float phaseAnisotropy2;
+  float phaseBlend;
+  float phaseDraineAlpha;
 };
 
 #endif
@@ -373,6 +426,7 @@ struct Aabb {
 struct CompPushConstant {
   float time;
   int size;
+  int first;  // sphere, the dispatch covers [first, first + size)
 };
 
 #ifdef __cplusplus
@@ -428,5 +482,35 @@ struct GltfMaterials {
 #define RESTIR_TEMPORAL_REUSE_FLAG   (1 << 1)
 #define RESTIR_SPATIAL_REUSE_FLAG    (1 << 2)
 #define USE_ENVIRONMENT_FLAG         (1 << 3)
+#define RESTIR_LOW_DISCREPANCY_FLAG  (1 << 4)
+#define RESTIR_MIS_REUSE_FLAG        (1 << 5)
+#define RESTIR_VISIBILITY_CACHE_FLAG (1 << 6)
+#define RESTIR_VOLUME_FLAG           (1 << 7)
+
+// TLAS instance masks; the VDB instance is the participating medium when
+// RESTIR_VOLUME_FLAG is set, rays of that mode only see the surfaces
+#define INSTANCE_MASK_SURFACE 0x01
+#define INSTANCE_MASK_VOLUME  0x02
+
+// spheres per BLAS of the VDB volume, see utils/volume_chunks.hpp
+#define VOLUME_CHUNK_SPHERES 16384
+
+// shadow-ray transmittance of the medium, see headers/transmittance.glsl
+#define TRANSMITTANCE_DELTA_TRACKING          0
+#define TRANSMITTANCE_RATIO_TRACKING          1
+#define TRANSMITTANCE_RESIDUAL_RATIO_TRACKING 2
+#define TRANSMITTANCE_NEXT_FLIGHT             3
+
+// rate of reservoir generation and reuse, see headers/renderScale.glsl
+#define RENDER_SCALE_FULL         0
+#define RENDER_SCALE_HALF         1
+#define RENDER_SCALE_QUARTER      2
+#define RENDER_SCALE_CHECKERBOARD 3
+
+// independent reservoirs per pixel, one layer of the reservoir images each;
+// they share the candidates of restir.rgen and are averaged when shading
+#ifndef RESERVOIR_SIZE
+#define RESERVOIR_SIZE 1
+#endif
 
 #endif
\ No newline at end of file
@@ -17,6 +17,11 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+// Sphere hit by the volume: the instances of its chunks, one BLAS of
+// VOLUME_CHUNK_SPHERES spheres each, come first in the TLAS
+#define VOLUME_SPHERE_INDEX \
+  (gl_InstanceID * VOLUME_CHUNK_SPHERES + gl_PrimitiveID)
+
 struct hitPayload {
   vec3 hitValue;
 };
@@ -20,20 +20,12 @@ layout(set = 1, binding = eTriangleLights, scalar) buffer TriangleLights {
   TriangleLight lights[];
 }
 triangleLights;
-// layout(set = 1, binding = B_ENVIRONMENTAL_MAP) uniform sampler2D
-// environmentalTexture;
-
-layout(set = 2, binding = eFrameAlbedo, rgba32f) uniform image2D frameAlbedo;
-layout(set = 2, binding = eFrameNormal, rgba32f) uniform image2D frameNormal;
-layout(set = 2, binding = eFrameMaterialProps,
-       rgba32f) uniform image2D frameRoughnessMetallic;
-layout(set = 2, binding = eFrameWorldPosition,
-       rgba32f) uniform image2D frameWorldPosition;
-
-layout(set = 2, binding = eReservoirsInfo,
-       rgba32f) uniform image2D reservoirInfoBuf;
-layout(set = 2, binding = eReservoirWeights,
-       rgba32f) uniform image2D reservoirWeightBuf;
+layout(set = 1, binding = eEnvironmentMap) uniform sampler2D environmentMap;
+
+layout(set = 2, binding = eFrameGBuffer,
+       rgba32ui) uniform uimage2D frameGBuffer;
+layout(set = 2, binding = eReservoirs,
+       rgba32ui) uniform uimage2DArray reservoirs;
 layout(set = 3, binding = 0, rgba32f) uniform image2D resultImage;
 
 layout(location = 0) in vec2 inUv;
@@ -41,7 +33,10 @@ layout(location = 0) in vec2 inUv;
 layout(location = 0) out vec3 outColor;
 
 #include "headers/random.glsl"
+#define RESTIR_UNIFORMS uniforms
 #include "headers/reservoir.glsl"
+#include "headers/gbuffer.glsl"
+#include "headers/renderScale.glsl"
 
 #define PI 3.1415926
 
@@ -54,31 +49,89 @@ layout(push_constant) uniform Constants {
 }
 pushC;
 
-void main() {
-  ivec2 coordImage = ivec2(gl_FragCoord.xy);
+GeometryInfo loadGeometryInfo(ivec2 pixel) {
+  return unpackGBuffer(imageLoad(frameGBuffer, pixel), pixel,
+                       uniforms.screenSize, uniforms.currCamPos.xyz,
+                       uniforms.currFrameViewInverse,
+                       uniforms.currFrameProjectionInverse);
+}
 
-  GeometryInfo gInfo;
-  gInfo.albedo           = imageLoad(frameAlbedo, coordImage);
-  gInfo.normal           = imageLoad(frameNormal, coordImage).xyz;
-  gInfo.worldPos         = imageLoad(frameWorldPosition, coordImage).xyz;
-  vec2 roughnessMetallic = imageLoad(frameRoughnessMetallic, coordImage).xy;
-  gInfo.roughness        = roughnessMetallic.x;
-  gInfo.metallic         = roughnessMetallic.y;
-  gInfo.camPos           = uniforms.currCamPos.xyz;
+// Radiance at `gInfo` from the reservoirs of texel `coord`; every reservoir is
+// an estimate of the direct light on its own
+vec3 shadeReservoirs(ivec2 coord, GeometryInfo gInfo) {
+  vec3 radiance = vec3(0.0f);
+  for (int r = 0; r < RESERVOIR_SIZE; ++r) {
+    Reservoir res =
+        unpackReservoirStruct(imageLoad(reservoirs, ivec3(coord, r)));
+    gInfo.sampleSeed = res.sampleSeed;
+
+    vec3 pHat = evaluatePHatFull(res.lightIndex, res.lightKind, gInfo);
+    radiance += pHat * res.w;
+  }
+  return radiance / float(RESERVOIR_SIZE);
+}
 
-  outColor = vec3(0.0f);
+// Joint-bilateral upsampling of the shaded pixels of the reservoir grid
+// around `pixel`, guided by the full resolution GBuffer; falls back to the
+// spatial weights alone where no neighbour lies on a similar surface
+vec3 upsampleRadiance(ivec2 pixel) {
+  uvec4 texel = imageLoad(frameGBuffer, pixel);
+  if (!gBufferHasGeometry(texel)) {
+    return vec3(0.0f);
+  }
+  float depth = uintBitsToFloat(texel.x);
+  vec3 normal = decodeOctahedral(unpackSnorm2x16(texel.y));
+
+  ivec2 center    = renderScaleCoord(pixel, uniforms.renderScale);
+  vec3 sum        = vec3(0.0f);
+  vec3 spatialSum = vec3(0.0f);
+  float weight = 0.0f, spatialWeight = 0.0f;
+  for (int dy = -1; dy <= 1; ++dy) {
+    for (int dx = -1; dx <= 1; ++dx) {
+      ivec2 coord = center + ivec2(dx, dy);
+      if (any(lessThan(coord, ivec2(0))) ||
+          any(greaterThanEqual(coord, ivec2(uniforms.renderSize)))) {
+        continue;
+      }
+      ivec2 shaded = renderScalePixel(coord, uniforms.renderScale,
+                                      uniforms.frameIndex, uniforms.screenSize);
+      float ws = renderScaleSpatialWeight(pixel, shaded, uniforms.renderScale);
+      uvec4 shadedTexel = imageLoad(frameGBuffer, shaded);
+      if (ws <= 0.0f || !gBufferHasGeometry(shadedTexel)) {
+        continue;
+      }
+      float shadedDepth = uintBitsToFloat(shadedTexel.x);
+      vec3 shadedNormal = decodeOctahedral(unpackSnorm2x16(shadedTexel.y));
+      float wb = ws * renderScaleBilateralWeight(depth, normal, shadedDepth,
+                                                 shadedNormal);
+      vec3 radiance = shadeReservoirs(coord, loadGeometryInfo(shaded));
+      sum += wb * radiance;
+      weight += wb;
+      spatialSum += ws * radiance;
+      spatialWeight += ws;
+    }
+  }
+  if (weight > RENDER_SCALE_MIN_WEIGHT) {
+    return sum / weight;
+  }
+  return spatialWeight > 0.0f ? spatialSum / spatialWeight : vec3(0.0f);
+}
 
-  uvec2 pixelCoord = uvec2(gl_FragCoord.xy);
+void main() {
+  ivec2 coordImage = ivec2(gl_FragCoord.xy);
 
-  vec4 reservoirInfo   = imageLoad(reservoirInfoBuf, coordImage);
-  vec4 reservoirWeight = imageLoad(reservoirWeightBuf, coordImage);
-  Reservoir res        = unpackReservoirStruct(reservoirInfo, reservoirWeight);
-  gInfo.sampleSeed     = res.sampleSeed;
+  uvec4 texel        = imageLoad(frameGBuffer, coordImage);
+  GeometryInfo gInfo = loadGeometryInfo(coordImage);
 
-  uint lightIndex = res.lightIndex;
-  int lightKind   = res.lightKind;
-  vec3 pHat       = evaluatePHatFull(lightIndex, lightKind, gInfo);
-  outColor += pHat * res.w;
+  // without geometry the texel rebuilds worldPos == camPos, and restir.rgen
+  // leaves the reservoirs of the pixel unwritten
+  if (!gBufferHasGeometry(texel)) {
+    outColor = vec3(0.0f);
+  } else if (uniforms.renderScale == RENDER_SCALE_FULL) {
+    outColor = shadeReservoirs(coordImage, gInfo);
+  } else {
+    outColor = upsampleRadiance(coordImage);
+  }
   if (gInfo.albedo.w > 0.5f) {
     outColor = gInfo.albedo.xyz;
   }
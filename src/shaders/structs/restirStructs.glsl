@@ -8,6 +8,8 @@ struct GeometryInfo {
   float roughness;
   float metallic;
   uint sampleSeed;
+  bool inMedium;     // scatter point of RESTIR_VOLUME_FLAG, normal faces wo
+  float anisotropy;  // g of the phase function of the medium
 };
 
 struct Reservoir {
@@ -26,3 +28,7 @@ struct Reservoir {
 #define RESTIR_TEMPORAL_REUSE_FLAG   (1 << 1)
 #define RESTIR_SPATIAL_REUSE_FLAG    (1 << 2)
 #define USE_ENVIRONMENT_FLAG         (1 << 3)
+#define RESTIR_LOW_DISCREPANCY_FLAG  (1 << 4)
+#define RESTIR_MIS_REUSE_FLAG        (1 << 5)
+#define RESTIR_VISIBILITY_CACHE_FLAG (1 << 6)
+#define RESTIR_VOLUME_FLAG           (1 << 7)
@@ -0,0 +1,522 @@
+#include "utils/barrier_planner.hpp"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+#include "utils/restir_frame.hpp"
+#include "utils/rng.hpp"
+
+namespace {
+
+constexpr VkAccessFlags2KHR kReadAccess =
+    VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR |
+    VK_ACCESS_2_SHADER_SAMPLED_READ_BIT_KHR |
+    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR |
+    VK_ACCESS_2_TRANSFER_READ_BIT_KHR;
+constexpr VkAccessFlags2KHR kWriteAccess =
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+
+bool contains(VkFlags64 flags, VkFlags64 subset) {
+  return (flags & subset) == subset;
+}
+
+// one entry per resource, the uses of a pass merged in declaration order
+template <typename IsImage>
+std::vector<std::pair<uint32_t, UsageInfo>> mergeUses(
+    const std::vector<ResourceUse>& uses, const IsImage& isImage) {
+  std::vector<std::pair<uint32_t, UsageInfo>> merged;
+  for (const ResourceUse& use : uses) {
+    const UsageInfo info = usageInfo(use.usage);
+    auto it              = std::find_if(
+        merged.begin(), merged.end(),
+        [&](const auto& entry) { return entry.first == use.resource; });
+    if (it == merged.end()) {
+      merged.emplace_back(use.resource, info);
+      continue;
+    }
+    if (isImage(use.resource) && it->second.layout != info.layout) {
+      spdlog::error("Resource {} is used in two layouts by one pass",
+                    use.resource);
+    }
+    it->second.stages |= info.stages;
+    it->second.access |= info.access;
+    it->second.writes = it->second.writes || info.writes;
+  }
+  return merged;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Brute-force checker: for every resource, orders each use and layout
+// transition after the accesses since the previous transition by following
+// the dependency chains of all the planned barriers
+//
+
+struct Scope {
+  VkPipelineStageFlags2KHR stages;
+  VkAccessFlags2KHR access;
+};
+
+// what is ordered after, and made visible from, one access
+struct Reach {
+  VkPipelineStageFlags2KHR stages = 0;  // dst stages of the chained barriers
+  bool available                  = false;
+  std::vector<Scope> visible;
+};
+
+struct Event {
+  uint32_t pass;
+  bool transition;  // before `pass`, else a use by it
+  VkPipelineStageFlags2KHR stages;
+  VkAccessFlags2KHR writeAccess;
+  bool writes;
+  Reach reach;
+};
+
+// applies the barriers recorded together at one transition point; they do
+// not chain with each other
+void advance(Event& event, const std::vector<PlannedBarrier>& barriers) {
+  VkPipelineStageFlags2KHR stages = 0;
+  bool available                  = false;
+  for (const PlannedBarrier& barrier : barriers) {
+    const bool direct = contains(barrier.srcStages, event.stages);
+    if (!direct && !(event.reach.stages & barrier.srcStages)) {
+      continue;
+    }
+    stages |= barrier.dstStages;
+    const bool makesAvailable =
+        direct && contains(barrier.srcAccess, event.writeAccess);
+    if (event.reach.available || makesAvailable) {
+      event.reach.visible.push_back({barrier.dstStages, barrier.dstAccess});
+    }
+    available = available || makesAvailable;
+  }
+  event.reach.stages |= stages;
+  event.reach.available = event.reach.available || available;
+}
+
+bool isVisible(const Reach& reach, const Scope& scope) {
+  return std::any_of(
+      reach.visible.begin(), reach.visible.end(), [&](const Scope& visible) {
+        return contains(visible.stages, scope.stages) &&
+               contains(visible.access, scope.access);
+      });
+}
+
+struct CheckCounts {
+  uint32_t hazards   = 0;
+  uint32_t uncovered = 0;
+};
+
+CheckCounts checkPlan(const std::vector<std::vector<ResourceUse>>& passes,
+                      const std::vector<TransitionPoint>& points,
+                      const std::vector<bool>& isImage,
+                      std::vector<VkImageLayout> layouts) {
+  CheckCounts counts;
+  const auto pointAt = [&](uint32_t pass) -> const TransitionPoint* {
+    auto it = std::find_if(
+        points.begin(), points.end(),
+        [&](const TransitionPoint& point) { return point.pass == pass; });
+    return it == points.end() ? nullptr : &*it;
+  };
+
+  for (uint32_t resource = 0; resource < isImage.size(); ++resource) {
+    std::vector<Event> events;  // since the last layout transition
+    // orders a use or transition of `scope` after every event
+    const auto check = [&](const Scope& scope, bool writes) {
+      for (const Event& event : events) {
+        const bool readAfterWrite =
+            event.writes && (scope.access & kReadAccess);
+        if (!event.writes && !writes) {
+          continue;
+        }
+        ++counts.hazards;
+        bool covered = contains(event.reach.stages, scope.stages);
+        if (event.writes) {
+          covered = covered && event.reach.available;
+        }
+        if (readAfterWrite) {
+          covered = covered && isVisible(event.reach,
+                                         {scope.stages,
+                                          scope.access & kReadAccess});
+        }
+        counts.uncovered += covered ? 0 : 1;
+      }
+    };
+
+    for (uint32_t pass = 0; pass < passes.size(); ++pass) {
+      if (const TransitionPoint* point = pointAt(pass)) {
+        for (const PlannedBarrier& barrier : point->barriers) {
+          if (barrier.resource != resource || !barrier.isLayoutTransition()) {
+            continue;
+          }
+          if (barrier.oldLayout != layouts[resource]) {
+            ++counts.uncovered;
+          }
+          layouts[resource] = barrier.newLayout;
+          // the transition must follow the accesses in its first scope
+          for (const Event& event : events) {
+            ++counts.hazards;
+            const bool direct = contains(barrier.srcStages, event.stages);
+            const bool ordered =
+                direct || (event.reach.stages & barrier.srcStages);
+            const bool available =
+                event.reach.available || !event.writes ||
+                (direct && contains(barrier.srcAccess, event.writeAccess));
+            counts.uncovered += ordered && available ? 0 : 1;
+          }
+          events.clear();
+          Event transition{pass, true, barrier.dstStages, 0, true, {}};
+          transition.reach.stages    = barrier.dstStages;
+          transition.reach.available = true;
+          transition.reach.visible.push_back(
+              {barrier.dstStages, barrier.dstAccess});
+          events.push_back(transition);
+        }
+        for (Event& event : events) {
+          if (event.transition && event.pass == pass) {
+            continue;
+          }
+          advance(event, point->barriers);
+        }
+      }
+
+      for (const auto& [id, info] : mergeUses(
+               passes[pass], [&](uint32_t id) { return isImage[id]; })) {
+        if (id != resource) {
+          continue;
+        }
+        if (isImage[resource] && info.layout != layouts[resource]) {
+          ++counts.uncovered;
+        }
+        check({info.stages, info.access}, info.writes);
+        events.push_back({pass, false, info.stages,
+                          info.access & kWriteAccess, info.writes, {}});
+      }
+    }
+  }
+  return counts;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Scenarios
+//
+
+class Scenario {
+public:
+  explicit Scenario(std::string name) { m_result.scenario = std::move(name); }
+
+  uint32_t addResource(bool isImage, VkImageLayout layout) {
+    m_isImage.push_back(isImage);
+    m_layouts.push_back(layout);
+    return m_planner.addResource(isImage, layout);
+  }
+
+  /// Plans the passes of one frame after the previous frames
+  void addFrame(const std::vector<std::vector<ResourceUse>>& passes) {
+    const uint32_t first = uint32_t(m_passes.size());
+    for (TransitionPoint& point : m_planner.plan(passes)) {
+      point.pass += first;
+      m_points.push_back(std::move(point));
+    }
+    m_passes.insert(m_passes.end(), passes.begin(), passes.end());
+  }
+
+  BarrierValidationResult finish() {
+    m_result.passes           = uint32_t(m_passes.size());
+    m_result.transitionPoints = uint32_t(m_points.size());
+    for (const auto& pass : m_passes) {
+      m_result.uses += uint32_t(pass.size());
+    }
+    for (const TransitionPoint& point : m_points) {
+      m_result.barriers += uint32_t(point.barriers.size());
+      m_result.layoutTransitions += uint32_t(std::count_if(
+          point.barriers.begin(), point.barriers.end(),
+          [](const PlannedBarrier& b) { return b.isLayoutTransition(); }));
+    }
+    const CheckCounts counts =
+        checkPlan(m_passes, m_points, m_isImage, m_layouts);
+    m_result.hazards   = counts.hazards;
+    m_result.uncovered = counts.uncovered;
+    return m_result;
+  }
+
+private:
+  BarrierValidationResult m_result{};
+  BarrierPlanner m_planner;
+  std::vector<bool> m_isImage;
+  std::vector<VkImageLayout> m_layouts;
+  std::vector<std::vector<ResourceUse>> m_passes;
+  std::vector<TransitionPoint> m_points;
+};
+
+// the ReSTIR frame of main.cpp, see Renderer::addRestirPasses
+BarrierValidationResult restirScenario(uint32_t spatialIterations,
+                                       uint32_t numFrames,
+                                       bool aliasReservoirs = false) {
+  Scenario scenario(fmt::format("ReSTIR, {} spatial{}", spatialIterations,
+                                aliasReservoirs ? ", aliased" : ""));
+  const uint32_t gBuffers[2] = {
+      scenario.addResource(true, VK_IMAGE_LAYOUT_GENERAL),
+      scenario.addResource(true, VK_IMAGE_LAYOUT_GENERAL)};
+  // as Renderer::createRestirBuffer, which places both in the same memory
+  const uint32_t reservoir =
+      scenario.addResource(true, VK_IMAGE_LAYOUT_GENERAL);
+  const uint32_t reservoirs[2] = {
+      reservoir, aliasReservoirs
+                     ? reservoir
+                     : scenario.addResource(true, VK_IMAGE_LAYOUT_GENERAL)};
+  const uint32_t tmp = scenario.addResource(true, VK_IMAGE_LAYOUT_GENERAL);
+  const uint32_t visibility =
+      scenario.addResource(true, VK_IMAGE_LAYOUT_GENERAL);
+  const uint32_t storage = scenario.addResource(true, VK_IMAGE_LAYOUT_GENERAL);
+
+  for (uint32_t frame = 0; frame < numFrames; ++frame) {
+    scenario.addFrame(restirFrameUses(
+        restirFrameResources(gBuffers, reservoirs, tmp, visibility, storage,
+                             frame),
+        spatialReuseDispatches(spatialIterations)));
+  }
+  return scenario.finish();
+}
+
+// an image moving between storage, sampled, attachment and transfer layouts
+BarrierValidationResult layoutScenario() {
+  Scenario scenario("layouts");
+  const uint32_t image = scenario.addResource(true, VK_IMAGE_LAYOUT_UNDEFINED);
+  const uint32_t buffer =
+      scenario.addResource(false, VK_IMAGE_LAYOUT_UNDEFINED);
+  using U = ResourceUsage;
+  scenario.addFrame({
+      {{image, U::eComputeStorageWrite}, {buffer, U::eComputeStorageWrite}},
+      {{image, U::eFragmentSampled}, {buffer, U::eFragmentStorageRead}},
+      {{image, U::eRayTracingSampled}, {buffer, U::eRayTracingStorageRead}},
+      {{image, U::eTransferRead}},
+      {{image, U::eColorAttachment}, {buffer, U::eTransferWrite}},
+      {{image, U::eComputeStorageReadWrite}, {buffer, U::eComputeStorageRead}},
+  });
+  return scenario.finish();
+}
+
+BarrierValidationResult randomScenario(uint32_t numSequences, uint32_t seed) {
+  constexpr uint32_t kResources = 5, kPasses = 8, kFrames = 2;
+  constexpr uint32_t kUsages = uint32_t(ResourceUsage::eTransferWrite) + 1;
+
+  BarrierValidationResult total{"random", 0, 0, 0, 0, 0, 0, 0};
+  for (uint32_t sequence = 0; sequence < numSequences; ++sequence) {
+    const uint32_t key = hostRngKey(seed, sequence + 1);
+    uint32_t counter   = 0;
+    const auto draw    = [&](uint32_t n) {
+      uint32_t word;
+      generateRandomWords(key, counter++, &word, 1);
+      return word % n;
+    };
+
+    Scenario scenario("random");
+    for (uint32_t r = 0; r < kResources; ++r) {
+      scenario.addResource(r < 3, r == 0 ? VK_IMAGE_LAYOUT_UNDEFINED
+                                         : VK_IMAGE_LAYOUT_GENERAL);
+    }
+    for (uint32_t frame = 0; frame < kFrames; ++frame) {
+      std::vector<std::vector<ResourceUse>> passes(kPasses);
+      for (auto& pass : passes) {
+        for (uint32_t u = 1 + draw(3); u > 0; --u) {
+          const uint32_t resource = draw(kResources);
+          ResourceUsage usage     = ResourceUsage(draw(kUsages));
+          // a pass uses one resource in one layout
+          const auto same = std::find_if(
+              pass.begin(), pass.end(),
+              [&](const ResourceUse& use) { return use.resource == resource; });
+          if (same != pass.end() && resource < 3 &&
+              usageInfo(same->usage).layout != usageInfo(usage).layout) {
+            usage = same->usage;
+          }
+          pass.push_back({resource, usage});
+        }
+      }
+      scenario.addFrame(passes);
+    }
+
+    const BarrierValidationResult result = scenario.finish();
+    total.passes += result.passes;
+    total.uses += result.uses;
+    total.transitionPoints += result.transitionPoints;
+    total.barriers += result.barriers;
+    total.layoutTransitions += result.layoutTransitions;
+    total.hazards += result.hazards;
+    total.uncovered += result.uncovered;
+  }
+  return total;
+}
+
+}  // namespace
+
+UsageInfo usageInfo(ResourceUsage usage) {
+  constexpr VkPipelineStageFlags2KHR rayTracing =
+      VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
+  constexpr VkPipelineStageFlags2KHR compute =
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+  constexpr VkPipelineStageFlags2KHR fragment =
+      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR;
+  constexpr VkAccessFlags2KHR read  = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+  constexpr VkAccessFlags2KHR write = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+  constexpr VkAccessFlags2KHR sampled = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT_KHR;
+  constexpr VkImageLayout general     = VK_IMAGE_LAYOUT_GENERAL;
+  constexpr VkImageLayout readOnly = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  switch (usage) {
+    case ResourceUsage::eRayTracingStorageRead:
+      return {rayTracing, read, general, false};
+    case ResourceUsage::eRayTracingStorageWrite:
+      return {rayTracing, write, general, true};
+    case ResourceUsage::eRayTracingStorageReadWrite:
+      return {rayTracing, read | write, general, true};
+    case ResourceUsage::eRayTracingSampled:
+      return {rayTracing, sampled, readOnly, false};
+    case ResourceUsage::eComputeStorageRead:
+      return {compute, read, general, false};
+    case ResourceUsage::eComputeStorageWrite:
+      return {compute, write, general, true};
+    case ResourceUsage::eComputeStorageReadWrite:
+      return {compute, read | write, general, true};
+    case ResourceUsage::eComputeSampled:
+      return {compute, sampled, readOnly, false};
+    case ResourceUsage::eFragmentStorageRead:
+      return {fragment, read, general, false};
+    case ResourceUsage::eFragmentStorageReadWrite:
+      return {fragment, read | write, general, true};
+    case ResourceUsage::eFragmentSampled:
+      return {fragment, sampled, readOnly, false};
+    case ResourceUsage::eColorAttachment:
+      return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+              VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR |
+                  VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+    case ResourceUsage::eTransferRead:
+      return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+              VK_ACCESS_2_TRANSFER_READ_BIT_KHR,
+              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+    case ResourceUsage::eTransferWrite:
+      return {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR,
+              VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+  }
+  return {VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR,
+          VK_ACCESS_2_MEMORY_READ_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR,
+          general, true};
+}
+
+uint32_t BarrierPlanner::addResource(bool isImage, VkImageLayout layout) {
+  m_states.push_back({isImage, isImage ? layout : VK_IMAGE_LAYOUT_UNDEFINED,
+                      0, 0, 0, {}});
+  return uint32_t(m_states.size() - 1);
+}
+
+void BarrierPlanner::resetResource(uint32_t resource, VkImageLayout layout) {
+  State& state = m_states[resource];
+  state        = {state.isImage,
+                  state.isImage ? layout : VK_IMAGE_LAYOUT_UNDEFINED,
+                  0,
+                  0,
+                  0,
+                  {}};
+}
+
+std::vector<TransitionPoint> BarrierPlanner::plan(
+    const std::vector<std::vector<ResourceUse>>& passes) {
+  std::vector<TransitionPoint> points;
+  for (uint32_t pass = 0; pass < passes.size(); ++pass) {
+    TransitionPoint point{pass, {}};
+    const auto isImage = [&](uint32_t id) { return m_states[id].isImage; };
+    for (const auto& [resource, info] : mergeUses(passes[pass], isImage)) {
+      State& state                   = m_states[resource];
+      const VkAccessFlags2KHR reads  = info.access & kReadAccess;
+      const VkAccessFlags2KHR writes = info.access & kWriteAccess;
+      const VkImageLayout oldLayout  = state.layout;
+      const VkImageLayout newLayout = state.isImage ? info.layout : oldLayout;
+      PlannedBarrier barrier{resource, 0, 0, info.stages, 0, oldLayout,
+                             newLayout};
+
+      if (barrier.isLayoutTransition()) {
+        // the transition writes the whole image
+        barrier.srcStages = state.writeStages | state.readStages;
+        barrier.srcAccess = state.writeAccess;
+        barrier.dstAccess = info.access;
+        point.barriers.push_back(barrier);
+        if (info.writes) {
+          state = {state.isImage, newLayout, info.stages, writes, 0, {}};
+        } else {
+          state = {state.isImage, newLayout,   info.stages,
+                   0,             info.stages, {{info.stages, info.access}}};
+        }
+        continue;
+      }
+
+      const bool visible = std::any_of(
+          state.visible.begin(), state.visible.end(),
+          [&](const VisibleScope& scope) {
+            return contains(scope.stages, info.stages) &&
+                   contains(scope.access, reads);
+          });
+      if (reads && state.writeStages && !visible) {
+        barrier.srcStages |= state.writeStages;
+        barrier.srcAccess |= state.writeAccess;
+        barrier.dstAccess |= reads;
+      }
+      if (info.writes && state.readStages) {
+        // the reads followed the last write, which is available
+        barrier.srcStages |= state.readStages;
+      } else if (info.writes && state.writeStages) {
+        barrier.srcStages |= state.writeStages;
+        barrier.srcAccess |= state.writeAccess;
+        barrier.dstAccess |= writes;
+      }
+      if (barrier.srcStages) {
+        point.barriers.push_back(barrier);
+      }
+
+      if (info.writes) {
+        state = {state.isImage, state.layout, info.stages, writes, 0, {}};
+      } else {
+        state.readStages |= info.stages;
+        if (barrier.srcStages) {
+          state.visible.push_back({info.stages, reads});
+        }
+      }
+    }
+    if (!point.barriers.empty()) {
+      points.push_back(std::move(point));
+    }
+  }
+  return points;
+}
+
+std::vector<BarrierValidationResult> validateBarriers(
+    uint32_t randomSequences, uint32_t seed) {
+  return {restirScenario(1, 4),
+          restirScenario(2, 4),
+          restirScenario(4, 4),
+          restirScenario(2, 4, true),
+          layoutScenario(),
+          randomScenario(randomSequences, seed)};
+}
+
+bool isBarrierPlanValid(const std::vector<BarrierValidationResult>& results) {
+  return std::all_of(results.begin(), results.end(),
+                     [](const BarrierValidationResult& result) {
+                       return result.uncovered == 0;
+                     });
+}
+
+void logBarriers(const std::vector<BarrierValidationResult>& results) {
+  spdlog::info("{:>26} {:>7} {:>6} {:>7} {:>8} {:>7} {:>8} {:>9}",
+               "scenario", "passes", "uses", "points", "barriers", "layouts",
+               "hazards", "uncovered");
+  for (const BarrierValidationResult& result : results) {
+    spdlog::info("{:>26} {:>7} {:>6} {:>7} {:>8} {:>7} {:>8} {:>9}",
+                 result.scenario, result.passes, result.uses,
+                 result.transitionPoints, result.barriers,
+                 result.layoutTransitions, result.hazards, result.uncovered);
+  }
+}
@@ -0,0 +1,143 @@
+#ifndef __VOLUME_RESTIR_UTILS_BARRIER_PLANNER_HPP__
+#define __VOLUME_RESTIR_UTILS_BARRIER_PLANNER_HPP__
+
+/**
+ * @file barrier_planner.hpp
+ *
+ * @brief Synchronization planning of `passes/renderGraph.h`, from the stage,
+ * access and layout enums of the uses alone.
+ *
+ *  Passes declare how they use each image or buffer; the planner keeps, per
+ *  resource, the stages and accesses of the last write, the stages that read
+ *  it since, the (stage, access) pairs the write is visible to and the image
+ *  layout, and emits before each pass only the dependencies its uses need:
+ *    read after write      src = writing stages and write access, unless
+ *                          the write is already visible to the read
+ *    write after write     src = writing stages and write access
+ *    write after read      src = reading stages, execution only
+ *    layout transition     src = writing and reading stages, old -> new
+ *  The states persist from one `plan` to the next, so the dependencies on the
+ *  previous frame (e.g. its reservoirs read by the temporal reuse) are planned
+ *  at the first pass that needs them.
+ *
+ *  `validateBarriers` replays the ReSTIR frame, spatial reuse iterations and
+ *  random pass sequences against a brute-force hazard checker which follows
+ *  the dependency chains through every planned barrier.
+ */
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class ResourceUsage {
+  eRayTracingStorageRead,
+  eRayTracingStorageWrite,
+  eRayTracingStorageReadWrite,
+  eRayTracingSampled,
+  eComputeStorageRead,
+  eComputeStorageWrite,
+  eComputeStorageReadWrite,
+  eComputeSampled,
+  eFragmentStorageRead,
+  eFragmentStorageReadWrite,
+  eFragmentSampled,
+  eColorAttachment,
+  eTransferRead,
+  eTransferWrite,
+};
+
+struct UsageInfo {
+  VkPipelineStageFlags2KHR stages;
+  VkAccessFlags2KHR access;
+  VkImageLayout layout;  // of images
+  bool writes;
+};
+
+[[nodiscard]] UsageInfo usageInfo(ResourceUsage usage);
+
+struct ResourceUse {
+  uint32_t resource;
+  ResourceUsage usage;
+};
+
+/// Dependency on one resource; images change layout when `oldLayout` and
+/// `newLayout` differ
+struct PlannedBarrier {
+  uint32_t resource;
+  VkPipelineStageFlags2KHR srcStages;
+  VkAccessFlags2KHR srcAccess;
+  VkPipelineStageFlags2KHR dstStages;
+  VkAccessFlags2KHR dstAccess;
+  VkImageLayout oldLayout;
+  VkImageLayout newLayout;
+
+  bool isLayoutTransition() const { return oldLayout != newLayout; }
+};
+
+/// Dependencies recorded together, by one vkCmdPipelineBarrier2, before
+/// the pass `pass`
+struct TransitionPoint {
+  uint32_t pass;
+  std::vector<PlannedBarrier> barriers;
+};
+
+class BarrierPlanner {
+public:
+  /// Tracks a new resource, never written yet; `layout` is ignored for
+  /// buffers
+  uint32_t addResource(bool isImage, VkImageLayout layout);
+
+  /// Forgets the accesses to `resource`, e.g. after waiting for the device
+  void resetResource(uint32_t resource, VkImageLayout layout);
+
+  /// Plans the passes, given as their uses, after the ones of the previous
+  /// calls
+  [[nodiscard]] std::vector<TransitionPoint> plan(
+      const std::vector<std::vector<ResourceUse>>& passes);
+
+  VkImageLayout layout(uint32_t resource) const {
+    return m_states[resource].layout;
+  }
+  size_t resourceCount() const { return m_states.size(); }
+
+private:
+  struct VisibleScope {
+    VkPipelineStageFlags2KHR stages;
+    VkAccessFlags2KHR access;
+  };
+
+  struct State {
+    bool isImage;
+    VkImageLayout layout;
+    VkPipelineStageFlags2KHR writeStages;
+    VkAccessFlags2KHR writeAccess;
+    VkPipelineStageFlags2KHR readStages;  // since the last write
+    std::vector<VisibleScope> visible;    // of the last write
+  };
+
+  std::vector<State> m_states;
+};
+
+struct BarrierValidationResult {
+  std::string scenario;
+  uint32_t passes;
+  uint32_t uses;
+  uint32_t transitionPoints;
+  uint32_t barriers;
+  uint32_t layoutTransitions;
+  uint32_t hazards;    // pairs of uses which must be ordered
+  uint32_t uncovered;  // of the hazards, and of mismatched layouts
+};
+
+[[nodiscard]] std::vector<BarrierValidationResult> validateBarriers(
+    uint32_t randomSequences = 256, uint32_t seed = 0);
+
+/// False if a hazard of any scenario is not covered by the planned barriers
+[[nodiscard]] bool isBarrierPlanValid(
+    const std::vector<BarrierValidationResult>& results);
+
+void logBarriers(const std::vector<BarrierValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_BARRIER_PLANNER_HPP__ */
@@ -0,0 +1,560 @@
+#include "utils/batch_render.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+#include "stb_image_write.h"
+#include "utils/profiler.hpp"
+
+namespace {
+
+bool parseUnsigned(const std::string& text, uint32_t& value) {
+  if (text.empty() || text[0] < '0' || text[0] > '9') {
+    return false;
+  }
+  char* end                     = nullptr;
+  const unsigned long long read = std::strtoull(text.c_str(), &end, 10);
+  if (*end != '\0' || read > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  value = uint32_t(read);
+  return true;
+}
+
+bool parseFloat(const std::string& text, float& value) {
+  if (text.empty()) {
+    return false;
+  }
+  char* end        = nullptr;
+  const float read = std::strtof(text.c_str(), &end);
+  if (*end != '\0' || !std::isfinite(read)) {
+    return false;
+  }
+  value = read;
+  return true;
+}
+
+const char* formatExtension(BatchImageFormat format) {
+  return format == BatchImageFormat::eExr ? "exr" : "png";
+}
+
+// little endian, as OpenEXR stores everything
+class ByteWriter {
+public:
+  void u8(uint8_t value) { m_bytes.push_back(char(value)); }
+  void i32(int32_t value) { raw(&value, 4); }
+  void u64(uint64_t value) { raw(&value, 8); }
+  void f32(float value) { raw(&value, 4); }
+  void text(const std::string& value) {
+    m_bytes.append(value);
+    m_bytes.push_back('\0');
+  }
+  void attribute(const std::string& name, const std::string& type,
+                 const ByteWriter& value) {
+    text(name);
+    text(type);
+    i32(int32_t(value.m_bytes.size()));
+    m_bytes.append(value.m_bytes);
+  }
+
+  void put(size_t offset, uint64_t value) {
+    std::memcpy(&m_bytes[offset], &value, 8);
+  }
+  [[nodiscard]] size_t size() const { return m_bytes.size(); }
+  [[nodiscard]] const std::string& bytes() const { return m_bytes; }
+
+private:
+  void raw(const void* value, size_t size) {
+    m_bytes.append(static_cast<const char*>(value), size);
+  }
+
+  std::string m_bytes;
+};
+
+std::string describe(const BatchOptions& options) {
+  return fmt::format("{} frames {}x{} {} to {}{}", options.frames,
+                     options.width, options.height,
+                     formatExtension(options.format), options.output,
+                     options.tileSweep ? ", sweeping tiles" : "");
+}
+
+// the frames of the stub backend: noise that fades out, so that frames
+// converge like accumulated ones
+BatchImage syntheticFrame(uint32_t frame) {
+  BatchImage image{8, 4, std::vector<float>(8 * 4 * 4)};
+  for (size_t i = 0; i < image.rgba.size(); ++i) {
+    uint32_t hash = uint32_t(i) * 747796405u + frame * 2891336453u;
+    hash          = ((hash >> ((hash >> 28) + 4)) ^ hash) * 277803737u;
+    const float noise = float((hash >> 22) ^ hash) / 4294967296.f - 0.5f;
+    image.rgba[i]     = i % 4 == 3 ? 1.f : 0.5f + noise / float(frame + 1);
+  }
+  return image;
+}
+
+std::string readFile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+}
+
+uint32_t readBigEndian(const std::string& bytes, size_t offset) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    value = value << 8 | uint8_t(bytes[offset + i]);
+  }
+  return value;
+}
+
+int32_t readLittleEndian(const std::string& bytes, size_t offset) {
+  int32_t value;
+  std::memcpy(&value, &bytes[offset], 4);
+  return value;
+}
+
+// "png 4x3" from the IHDR chunk
+std::string describePng(const std::string& bytes) {
+  if (bytes.size() < 24 || bytes.compare(0, 8, "\x89PNG\r\n\x1a\n") != 0 ||
+      bytes.compare(12, 4, "IHDR") != 0) {
+    return "not a png";
+  }
+  return fmt::format("png {}x{}", readBigEndian(bytes, 16),
+                     readBigEndian(bytes, 20));
+}
+
+// "exr 4x3, 0.25" from the data window and the red channel of the first
+// pixel; the channels are stored in the order A, B, G, R
+std::string describeExr(const std::string& bytes) {
+  if (bytes.size() < 8 || readLittleEndian(bytes, 0) != 20000630) {
+    return "not an exr";
+  }
+  int32_t width  = 0;
+  int32_t height = 0;
+  size_t offset  = 8;
+  while (offset < bytes.size() && bytes[offset] != '\0') {
+    const size_t nameEnd = bytes.find('\0', offset);
+    const size_t typeEnd = bytes.find('\0', nameEnd + 1);
+    if (typeEnd == std::string::npos || typeEnd + 5 > bytes.size()) {
+      return "truncated exr";
+    }
+    const size_t size = size_t(readLittleEndian(bytes, typeEnd + 1));
+    const size_t data = typeEnd + 5;
+    if (bytes.compare(offset, nameEnd - offset, "dataWindow") == 0 &&
+        data + 16 <= bytes.size()) {
+      width  = readLittleEndian(bytes, data + 8) + 1;
+      height = readLittleEndian(bytes, data + 12) + 1;
+    }
+    offset = data + size;
+  }
+  // the table of scanline offsets follows the header, and the first scanline
+  // starts with its y and size
+  uint64_t firstLine = 0;
+  if (offset + 9 <= bytes.size()) {
+    std::memcpy(&firstLine, &bytes[offset + 1], 8);
+  }
+  const size_t red = firstLine + 8 + 3 * size_t(width) * 4;
+  if (firstLine == 0 || red + 4 > bytes.size()) {
+    return "truncated exr";
+  }
+  float value;
+  std::memcpy(&value, &bytes[red], 4);
+  return fmt::format("exr {}x{}, {}", width, height, value);
+}
+
+}  // namespace
+
+std::optional<BatchOptions> parseBatchOptions(
+    const std::vector<std::string>& args) {
+  BatchOptions options;
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string& arg = args[i];
+    if (arg == "--headless") {
+      continue;
+    }
+    if (arg == "--tile-sweep") {
+      options.tileSweep = true;
+      continue;
+    }
+    if (i + 1 == args.size()) {
+      spdlog::error("Missing value of {}", arg);
+      return std::nullopt;
+    }
+    const std::string& value = args[++i];
+    bool valid               = false;
+    if (arg == "--frames") {
+      valid = parseUnsigned(value, options.frames) && options.frames > 0;
+    } else if (arg == "--converge") {
+      valid = parseFloat(value, options.convergence) &&
+              options.convergence >= 0.f;
+    } else if (arg == "--fps") {
+      valid = parseFloat(value, options.fps) && options.fps > 0.f;
+    } else if (arg == "--size") {
+      const size_t x = value.find('x');
+      valid          = x != std::string::npos &&
+              parseUnsigned(value.substr(0, x), options.width) &&
+              parseUnsigned(value.substr(x + 1), options.height) &&
+              options.width > 0 && options.height > 0;
+    } else if (arg == "--format") {
+      valid          = value == "png" || value == "exr";
+      options.format = value == "exr" ? BatchImageFormat::eExr
+                                      : BatchImageFormat::ePng;
+    } else if (arg == "--output") {
+      valid          = !value.empty();
+      options.output = value;
+    } else if (arg == "--volume") {
+      valid          = !value.empty();
+      options.volume = value;
+    } else {
+      spdlog::error("Unknown headless option {}", arg);
+      return std::nullopt;
+    }
+    if (!valid) {
+      spdlog::error("Invalid value {} of {}", value, arg);
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+
+float imageDifference(const BatchImage& a, const BatchImage& b) {
+  if (a.rgba.size() != b.rgba.size()) {
+    return std::numeric_limits<float>::infinity();
+  }
+  double difference = 0.0;
+  double total      = 0.0;
+  for (size_t i = 0; i < a.rgba.size(); ++i) {
+    if (i % 4 != 3) {
+      difference += std::abs(a.rgba[i] - b.rgba[i]);
+      total += std::abs(b.rgba[i]);
+    }
+  }
+  return float(difference / std::max(total, 1e-12));
+}
+
+std::string batchFramePath(const BatchOptions& options, uint32_t frame) {
+  const std::string name =
+      fmt::format("frame_{:04}.{}", frame, formatExtension(options.format));
+  return (std::filesystem::path(options.output) / name).string();
+}
+
+bool writePng(const std::string& filename, const BatchImage& image) {
+  std::vector<uint8_t> pixels(image.rgba.size());
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = uint8_t(std::clamp(image.rgba[i], 0.f, 1.f) * 255.f + 0.5f);
+  }
+  return stbi_write_png(filename.c_str(), int(image.width), int(image.height),
+                        4, pixels.data(), int(image.width) * 4) != 0;
+}
+
+bool writeExr(const std::string& filename, const BatchImage& image) {
+  const int32_t width  = int32_t(image.width);
+  const int32_t height = int32_t(image.height);
+
+  ByteWriter file;
+  file.i32(20000630);  // magic number
+  file.i32(2);         // version 2, single part scanline file
+
+  ByteWriter channels;
+  for (const char* name : {"A", "B", "G", "R"}) {
+    channels.text(name);
+    channels.i32(2);  // FLOAT
+    channels.i32(0);  // pLinear and reserved
+    channels.i32(1);  // x and y sampling
+    channels.i32(1);
+  }
+  channels.u8(0);
+  ByteWriter compression;
+  compression.u8(0);  // NO_COMPRESSION, one scanline per block
+  ByteWriter window;
+  window.i32(0);
+  window.i32(0);
+  window.i32(width - 1);
+  window.i32(height - 1);
+  ByteWriter lineOrder;
+  lineOrder.u8(0);  // INCREASING_Y
+  ByteWriter one;
+  one.f32(1.f);
+  ByteWriter center;
+  center.f32(0.f);
+  center.f32(0.f);
+
+  file.attribute("channels", "chlist", channels);
+  file.attribute("compression", "compression", compression);
+  file.attribute("dataWindow", "box2i", window);
+  file.attribute("displayWindow", "box2i", window);
+  file.attribute("lineOrder", "lineOrder", lineOrder);
+  file.attribute("pixelAspectRatio", "float", one);
+  file.attribute("screenWindowCenter", "v2f", center);
+  file.attribute("screenWindowWidth", "float", one);
+  file.u8(0);
+
+  const size_t table = file.size();
+  for (int32_t y = 0; y < height; ++y) {
+    file.u64(0);
+  }
+  for (int32_t y = 0; y < height; ++y) {
+    file.put(table + size_t(y) * 8, file.size());
+    file.i32(y);
+    file.i32(width * 4 * 4);
+    for (const size_t channel : {3, 2, 1, 0}) {
+      for (int32_t x = 0; x < width; ++x) {
+        file.f32(image.rgba[(size_t(y) * width + x) * 4 + channel]);
+      }
+    }
+  }
+
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  out.write(file.bytes().data(), file.bytes().size());
+  return bool(out);
+}
+
+bool writeBatchImage(const BatchOptions& options, const std::string& filename,
+                     const BatchImage& image) {
+  return options.format == BatchImageFormat::eExr ? writeExr(filename, image)
+                                                  : writePng(filename, image);
+}
+
+BatchRenderStats runBatchRender(const BatchOptions& options,
+                                const BatchRenderBackend& backend,
+                                const BatchImageWriter& write) {
+  const auto start = std::chrono::steady_clock::now();
+  BatchRenderStats stats;
+  std::error_code error;
+  std::filesystem::create_directories(options.output, error);
+  if (error) {
+    spdlog::error("Cannot create {}: {}", options.output, error.message());
+    return stats;
+  }
+
+  const uint32_t slots = std::max(1u, backend.slots);
+  std::mutex mutex;
+  std::condition_variable changed;
+  uint32_t submitted = 0;  // frames given to the backend
+  uint32_t readBack  = 0;  // frames whose slot is free again
+  bool done          = false;
+  std::optional<uint32_t> converged;
+
+  std::thread worker([&]() {
+    BatchImage previous;
+    BatchImage image;
+    for (uint32_t frame = 0;; ++frame) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return submitted > frame || done; });
+        if (submitted <= frame) {
+          return;
+        }
+      }
+      {
+        PROFILE_SCOPE("readback");
+        backend.readback(frame % slots, image);
+      }
+      bool skip;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        readBack = frame + 1;
+        skip     = converged.has_value();
+      }
+      changed.notify_all();
+      if (skip) {
+        continue;
+      }
+      if (options.convergence > 0.f && frame > 0 &&
+          imageDifference(image, previous) < options.convergence) {
+        std::lock_guard<std::mutex> lock(mutex);
+        converged = frame;
+      }
+      PROFILE_SCOPE("write");
+      if (write(batchFramePath(options, frame), image)) {
+        ++stats.written;
+      } else {
+        spdlog::error("Failed writing {}", batchFramePath(options, frame));
+        ++stats.failed;
+      }
+      std::swap(previous, image);
+    }
+  });
+
+  for (uint32_t frame = 0; frame < options.frames; ++frame) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (readBack + slots <= frame) {
+        ++stats.slotWaits;
+        changed.wait(lock, [&]() {
+          return readBack + slots > frame || converged.has_value();
+        });
+      }
+      if (converged) {
+        break;
+      }
+    }
+    backend.render(frame, frame % slots);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      submitted = frame + 1;
+    }
+    changed.notify_all();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  changed.notify_all();
+  worker.join();
+
+  stats.rendered       = submitted;
+  stats.convergedFrame = converged;
+  stats.seconds        = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  return stats;
+}
+
+void logBatchRender(const BatchRenderStats& stats) {
+  spdlog::info("Rendered {} frames in {:.1f} s, wrote {}, {} failed",
+               stats.rendered, stats.seconds, stats.written, stats.failed);
+  if (stats.convergedFrame) {
+    spdlog::info("Converged at frame {}", *stats.convergedFrame);
+  }
+  spdlog::info("{} frames waited for a readback slot", stats.slotWaits);
+}
+
+std::vector<ValidationCheck> validateBatchRender() {
+  std::vector<ValidationCheck> results;
+  const auto parse = [&](std::string scenario, std::string expected,
+                         const std::vector<std::string>& args) {
+    const std::optional<BatchOptions> options = parseBatchOptions(args);
+    results.push_back({std::move(scenario), std::move(expected),
+                       options ? describe(*options) : "invalid"});
+  };
+  parse("defaults", "1 frames 1280x720 png to frames", {"--headless"});
+  parse("all options", "240 frames 640x360 exr to out",
+        {"--headless", "--frames", "240", "--converge", "0.001", "--fps", "24",
+         "--size", "640x360", "--format", "exr", "--output", "out", "--volume",
+         "smoke.vdb"});
+  parse("tile sweep", "16 frames 1280x720 png to frames, sweeping tiles",
+        {"--headless", "--tile-sweep", "--frames", "16"});
+  parse("missing value", "invalid", {"--headless", "--frames"});
+  parse("no frames", "invalid", {"--headless", "--frames", "0"});
+  parse("not a number", "invalid", {"--headless", "--frames", "ten"});
+  parse("negative", "invalid", {"--headless", "--frames", "-3"});
+  parse("no height", "invalid", {"--headless", "--size", "640"});
+  parse("format", "invalid", {"--headless", "--format", "jpg"});
+  parse("threshold", "invalid", {"--headless", "--converge", "-1"});
+  parse("unknown", "invalid", {"--headless", "--frame", "3"});
+
+  const std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "volume_restir_batch_render";
+  BatchOptions options;
+  options.output = directory.string();
+
+  // host images for the slots, and what the writer saw
+  struct Stub {
+    std::vector<BatchImage> slots;
+    std::atomic<uint32_t> readBack{0};
+    uint32_t inFlight = 0;  // most frames rendered and not read back
+    std::thread::id renderThread;
+    std::vector<std::string> written;
+    bool writtenOnRenderThread = false;
+  };
+  const auto run = [&](Stub& stub, uint32_t slots,
+                       std::chrono::milliseconds writeTime) {
+    stub.slots.resize(slots);
+    stub.renderThread = std::this_thread::get_id();  // runBatchRender's
+    BatchRenderBackend backend;
+    backend.slots  = slots;
+    backend.render = [&](uint32_t frame, uint32_t slot) {
+      stub.inFlight    = std::max(stub.inFlight, frame + 1 - stub.readBack);
+      stub.slots[slot] = syntheticFrame(frame);
+    };
+    backend.readback = [&](uint32_t slot, BatchImage& image) {
+      image = stub.slots[slot];
+      ++stub.readBack;
+    };
+    return runBatchRender(
+        options, backend,
+        [&](const std::string& filename, const BatchImage&) {
+          std::this_thread::sleep_for(writeTime);
+          stub.writtenOnRenderThread |=
+              std::this_thread::get_id() == stub.renderThread;
+          stub.written.push_back(
+              std::filesystem::path(filename).filename().string());
+          return true;
+        });
+  };
+  const auto describeWritten = [&](const Stub& stub) {
+    for (uint32_t frame = 0; frame < stub.written.size(); ++frame) {
+      if (stub.written[frame] !=
+          std::filesystem::path(batchFramePath(options, frame)).filename()) {
+        return fmt::format("{} written out of order", stub.written.size());
+      }
+    }
+    return fmt::format("{} written in order", stub.written.size());
+  };
+
+  {
+    Stub stub;
+    options.frames = 10;
+    run(stub, 3, std::chrono::milliseconds(0));
+    results.push_back({"fixed frames", "10 written in order",
+                       describeWritten(stub)});
+  }
+  {
+    Stub stub;
+    options.frames      = 1000;
+    options.convergence = 0.02f;
+    uint32_t expected   = 1;
+    while (imageDifference(syntheticFrame(expected),
+                           syntheticFrame(expected - 1)) >=
+           options.convergence) {
+      ++expected;
+    }
+    const BatchRenderStats stats = run(stub, 3, std::chrono::milliseconds(0));
+    results.push_back(
+        {"converged",
+         fmt::format("stops at {}, {} written in order", expected,
+                     expected + 1),
+         fmt::format("stops at {}, {}", stats.convergedFrame.value_or(0),
+                     describeWritten(stub))});
+    options.convergence = 0.f;
+  }
+  {
+    // frames are rendered into every slot while one is written, and not
+    // into more
+    Stub stub;
+    options.frames = 12;
+    run(stub, 3, std::chrono::milliseconds(2));
+    results.push_back(
+        {"slow writes", "12 written in order on the worker, 3 in flight",
+         fmt::format("{} on the {}, {} in flight", describeWritten(stub),
+                     stub.writtenOnRenderThread ? "render thread" : "worker",
+                     stub.inFlight)});
+  }
+
+  std::filesystem::create_directories(directory);
+  BatchImage image{4, 3, std::vector<float>(4 * 3 * 4, 1.f)};
+  image.rgba[0] = 0.25f;
+  const std::string png = (directory / "image.png").string();
+  const std::string exr = (directory / "image.exr").string();
+  results.push_back({"png", "png 4x3",
+                     writePng(png, image) ? describePng(readFile(png))
+                                          : "not written"});
+  results.push_back({"exr", "exr 4x3, 0.25",
+                     writeExr(exr, image) ? describeExr(readFile(exr))
+                                          : "not written"});
+
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+  return results;
+}
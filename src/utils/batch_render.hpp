@@ -0,0 +1,100 @@
+#ifndef __VOLUME_RESTIR_UTILS_BATCH_RENDER_HPP__
+#define __VOLUME_RESTIR_UTILS_BATCH_RENDER_HPP__
+
+/**
+ * @file batch_render.hpp
+ *
+ * @brief Headless rendering of image sequences: command line, scheduling of
+ * the frames and image files.
+ *
+ *  Frames are rendered into a few readback slots used round robin. A worker
+ *  thread waits for the copy of each frame into its slot, frees the slot and
+ *  then writes the image, so the render loop only waits when every slot
+ *  still holds a frame that was not read back. Rendering stops after the
+ *  requested number of frames, or at the first frame whose relative change
+ *  to the previous one is below the convergence threshold; frames rendered
+ *  past that one are read back but not written.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "utils/validation.hpp"
+
+enum class BatchImageFormat { ePng, eExr };
+
+struct BatchOptions {
+  uint32_t width  = 1280;
+  uint32_t height = 720;
+  uint32_t frames = 1;
+  float convergence = 0.f;  // relative change between frames, 0 to disable
+  float fps         = 30.f;  // time step of the animation
+  BatchImageFormat format = BatchImageFormat::ePng;
+  std::string output = "frames";  // directory of the images
+  std::string volume;             // VDB file, the default one when empty
+  // times the reuse passes with each tile shape instead of writing images,
+  // see utils/dispatch.hpp
+  bool tileSweep = false;
+};
+
+/// Options of `args` following `--headless`, nothing if one is invalid
+[[nodiscard]] std::optional<BatchOptions> parseBatchOptions(
+    const std::vector<std::string>& args);
+
+struct BatchImage {
+  uint32_t width  = 0;
+  uint32_t height = 0;
+  std::vector<float> rgba;  // rows from the top
+};
+
+/// Mean absolute difference of the colors of `a` and `b`, relative to the
+/// mean of `b`
+[[nodiscard]] float imageDifference(const BatchImage& a, const BatchImage& b);
+
+/// frames/frame_0042.png
+[[nodiscard]] std::string batchFramePath(const BatchOptions& options,
+                                         uint32_t frame);
+
+/// 8-bit PNG of the clamped colors
+bool writePng(const std::string& filename, const BatchImage& image);
+/// Scanline OpenEXR of 32-bit float RGBA without compression
+bool writeExr(const std::string& filename, const BatchImage& image);
+/// By the format of `options`
+bool writeBatchImage(const BatchOptions& options, const std::string& filename,
+                     const BatchImage& image);
+
+struct BatchRenderBackend {
+  uint32_t slots = 2;
+  // renders `frame` and copies it into `slot`, without waiting for the copy
+  std::function<void(uint32_t frame, uint32_t slot)> render;
+  // waits for the copy into `slot` and reads it, on the worker thread
+  std::function<void(uint32_t slot, BatchImage& image)> readback;
+};
+
+using BatchImageWriter =
+    std::function<bool(const std::string& filename, const BatchImage& image)>;
+
+struct BatchRenderStats {
+  uint32_t rendered = 0;
+  uint32_t written  = 0;
+  uint32_t failed   = 0;  // images that could not be written
+  std::optional<uint32_t> convergedFrame;
+  uint32_t slotWaits = 0;  // frames that waited for a free slot
+  double seconds     = 0.0;
+};
+
+/// Renders the frames of `options` with `backend`, writing them with `write`
+BatchRenderStats runBatchRender(const BatchOptions& options,
+                                const BatchRenderBackend& backend,
+                                const BatchImageWriter& write);
+
+void logBatchRender(const BatchRenderStats& stats);
+
+/// Parses command lines and runs the scheduling with a backend that renders
+/// synthetic images on the host, writing to the temporary directory
+[[nodiscard]] std::vector<ValidationCheck> validateBatchRender();
+
+#endif /* __VOLUME_RESTIR_UTILS_BATCH_RENDER_HPP__ */
@@ -0,0 +1,67 @@
+#include "utils/cpu_features.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+struct CpuFeatures {
+  bool avx2;
+  bool avx512f;
+};
+
+CpuFeatures queryCpuFeatures() {
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return {false, false};
+  }
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx     = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx) {
+    return {false, false};
+  }
+  // XMM and YMM state, then opmask and both halves of ZMM0-31 as well
+  const unsigned long long xcr0 = _xgetbv(0);
+  const bool ymmState           = (xcr0 & 0x6) == 0x6;
+  const bool zmmState           = (xcr0 & 0xe6) == 0xe6;
+
+  __cpuidex(info, 7, 0);
+  return {ymmState && (info[1] & (1 << 5)) != 0,
+          zmmState && (info[1] & (1 << 16)) != 0};
+}
+
+const CpuFeatures& cpuFeatures() {
+  static const CpuFeatures features = queryCpuFeatures();
+  return features;
+}
+#endif
+
+}  // namespace
+
+bool cpuSupportsAvx2() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  // also checks that the OS saves the YMM registers
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return cpuFeatures().avx2;
+#else
+  return false;
+#endif
+}
+
+bool cpuSupportsAvx512f() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") != 0;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return cpuFeatures().avx512f;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,22 @@
+#ifndef __VOLUME_RESTIR_UTILS_CPU_FEATURES_HPP__
+#define __VOLUME_RESTIR_UTILS_CPU_FEATURES_HPP__
+
+/**
+ * @file cpu_features.hpp
+ *
+ * @brief Instruction sets of the host CPU, for the kernels that are compiled
+ * for a wider instruction set than the rest of the program.
+ *
+ *  Those kernels live in translation units of their own, built with the flags
+ *  `src/CMakeLists.txt` sets for them, and their callers only enter them when
+ *  the CPU and the operating system support the instruction set (the OS has
+ *  to save the wider registers on context switches).
+ */
+
+/// AVX2 instructions and the 256-bit register state
+[[nodiscard]] bool cpuSupportsAvx2();
+
+/// AVX-512 foundation instructions and the 512-bit register state
+[[nodiscard]] bool cpuSupportsAvx512f();
+
+#endif /* __VOLUME_RESTIR_UTILS_CPU_FEATURES_HPP__ */
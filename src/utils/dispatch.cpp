@@ -0,0 +1,127 @@
+#include "utils/dispatch.hpp"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+uint32_t divideRoundingUp(uint32_t count, uint32_t divisor) {
+  return count / divisor + (count % divisor != 0 ? 1 : 0);
+}
+
+}  // namespace
+
+DispatchGroups dispatchGroups(uint32_t width, uint32_t height, uint32_t depth,
+                              const WorkgroupSize& local) {
+  return {divideRoundingUp(width, local.x), divideRoundingUp(height, local.y),
+          divideRoundingUp(depth, local.z)};
+}
+
+uint64_t idleInvocations(uint32_t width, uint32_t height, uint32_t depth,
+                         const WorkgroupSize& local) {
+  const DispatchGroups groups = dispatchGroups(width, height, depth, local);
+  return uint64_t(groups.x) * groups.y * groups.z * local.invocations() -
+         uint64_t(width) * height * depth;
+}
+
+std::vector<WorkgroupSize> imageTileShapes() {
+  return {kImageTile, {16, 4, 1},  {4, 16, 1},  {32, 2, 1}, {64, 1, 1},
+          {16, 8, 1}, {8, 16, 1},  {32, 4, 1},  {16, 16, 1}, {32, 8, 1},
+          {8, 32, 1}, {32, 16, 1}, {32, 32, 1}};
+}
+
+bool isWorkgroupSizeSupported(const WorkgroupSize& size,
+                              const std::array<uint32_t, 3>& maxSize,
+                              uint32_t maxInvocations) {
+  return size.x <= maxSize[0] && size.y <= maxSize[1] &&
+         size.z <= maxSize[2] && size.invocations() <= maxInvocations;
+}
+
+std::string workgroupSizeName(const WorkgroupSize& size) {
+  return size.z == 1 ? fmt::format("{}x{}", size.x, size.y)
+                     : fmt::format("{}x{}x{}", size.x, size.y, size.z);
+}
+
+WorkgroupSpecialization::WorkgroupSpecialization(const WorkgroupSize& size)
+    : m_data{size.x, size.y} {
+  for (uint32_t i = 0; i < m_entries.size(); ++i) {
+    m_entries[i] = {i, static_cast<uint32_t>(i * sizeof(uint32_t)),
+                    sizeof(uint32_t)};
+  }
+  m_info = {static_cast<uint32_t>(m_entries.size()), m_entries.data(),
+            sizeof(m_data), m_data.data()};
+}
+
+void logTileSweep(const std::vector<TileTiming>& timings) {
+  spdlog::info("{:>8} {:>10} {:>14} {:>14}", "tile", "idle", "temporal us",
+               "spatial us");
+  const TileTiming* fastest = nullptr;
+  for (const TileTiming& timing : timings) {
+    spdlog::info("{:>8} {:>10} {:>14.1f} {:>14.1f}",
+                 workgroupSizeName(timing.tile), timing.idleInvocations,
+                 timing.temporalReuse, timing.spatialReuse);
+    if (fastest == nullptr ||
+        timing.temporalReuse + timing.spatialReuse <
+            fastest->temporalReuse + fastest->spatialReuse) {
+      fastest = &timing;
+    }
+  }
+  if (fastest != nullptr) {
+    spdlog::info("Fastest tile {}", workgroupSizeName(fastest->tile));
+  }
+}
+
+std::vector<ValidationCheck> validateDispatch() {
+  std::vector<ValidationCheck> results;
+  const auto describe = [](uint32_t width, uint32_t height,
+                           const WorkgroupSize& local) {
+    const DispatchGroups groups = dispatchGroups(width, height, 1, local);
+    return fmt::format("{}x{}x{} groups, {} idle", groups.x, groups.y,
+                       groups.z, idleInvocations(width, height, 1, local));
+  };
+
+  results.push_back({"image", "160x90x1 groups, 0 idle",
+                     describe(1280, 720, kImageTile)});
+  // 1281 * 721 invocations in 161 * 91 groups of 64
+  results.push_back({"partial tiles", "161x91x1 groups, 14063 idle",
+                     describe(1281, 721, kImageTile)});
+  results.push_back({"wide tile", "40x180x1 groups, 0 idle",
+                     describe(1280, 720, {32, 4, 1})});
+  // fewer spheres than a group still need one
+  results.push_back({"spheres", "1x1x1 groups, 24 idle",
+                     describe(1000, 1, kAnimationGroup)});
+  results.push_back({"spheres, full group", "2x1x1 groups, 0 idle",
+                     describe(2048, 1, kAnimationGroup)});
+  results.push_back({"spheres, one more", "3x1x1 groups, 1023 idle",
+                     describe(2049, 1, kAnimationGroup)});
+  results.push_back({"empty", "0x0x1 groups, 0 idle",
+                     describe(0, 0, kImageTile)});
+  {
+    // the minimum limits of the specification
+    std::string supported;
+    for (const WorkgroupSize& tile : imageTileShapes()) {
+      if (isWorkgroupSizeSupported(tile, {128, 128, 64}, 128)) {
+        supported += (supported.empty() ? "" : " ") + workgroupSizeName(tile);
+      }
+    }
+    results.push_back({"minimum limits",
+                       "8x8 16x4 4x16 32x2 64x1 16x8 8x16 32x4", supported});
+  }
+  {
+    const WorkgroupSpecialization specialization({16, 4, 1});
+    const VkSpecializationInfo& info = *specialization.info();
+    std::string observed = fmt::format(
+        "{} entries, {} bytes:", info.mapEntryCount, info.dataSize);
+    for (uint32_t i = 0; i < info.mapEntryCount; ++i) {
+      const VkSpecializationMapEntry& entry = info.pMapEntries[i];
+      uint32_t value;
+      std::copy_n(static_cast<const uint8_t*>(info.pData) + entry.offset,
+                  sizeof(value), reinterpret_cast<uint8_t*>(&value));
+      observed += fmt::format(" id {} = {}", entry.constantID, value);
+    }
+    results.push_back(
+        {"specialization", "2 entries, 8 bytes: id 0 = 16 id 1 = 4", observed});
+  }
+  return results;
+}
@@ -0,0 +1,99 @@
+#ifndef __VOLUME_RESTIR_UTILS_DISPATCH_HPP__
+#define __VOLUME_RESTIR_UTILS_DISPATCH_HPP__
+
+/**
+ * @file dispatch.hpp
+ *
+ * @brief Workgroup counts of compute dispatches from the local size the
+ * shader declares, the tile shapes of the image passes and their
+ * specialization.
+ *
+ *  Every dispatch covers its domain with whole workgroups, so the last
+ *  row and column of groups may run idle invocations that the shader bounds
+ *  check discards. The image passes (`temporalReuse.comp`,
+ *  `spatialReuse.comp`) take their local size from the specialization
+ *  constants 0 and 1, so their tile shape can change without recompiling
+ *  the shaders; `--headless --tile-sweep` times them with each shape.
+ */
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils/validation.hpp"
+
+struct WorkgroupSize {
+  uint32_t x = 1;
+  uint32_t y = 1;
+  uint32_t z = 1;
+
+  [[nodiscard]] uint32_t invocations() const { return x * y * z; }
+};
+
+/// Default tile of the image passes
+constexpr WorkgroupSize kImageTile{8, 8, 1};
+/// Local size of anim.comp, one invocation per sphere
+constexpr WorkgroupSize kAnimationGroup{1024, 1, 1};
+
+struct DispatchGroups {
+  uint32_t x;
+  uint32_t y;
+  uint32_t z;
+};
+
+/// Fewest groups of `local` covering `width` x `height` x `depth`
+/// invocations
+[[nodiscard]] DispatchGroups dispatchGroups(uint32_t width, uint32_t height,
+                                            uint32_t depth,
+                                            const WorkgroupSize& local);
+
+/// Invocations of the groups falling outside of the domain
+[[nodiscard]] uint64_t idleInvocations(uint32_t width, uint32_t height,
+                                       uint32_t depth,
+                                       const WorkgroupSize& local);
+
+/// Candidate 2D tiles of the image passes, `kImageTile` first
+[[nodiscard]] std::vector<WorkgroupSize> imageTileShapes();
+
+/// Within maxComputeWorkGroupSize and maxComputeWorkGroupInvocations
+[[nodiscard]] bool isWorkgroupSizeSupported(
+    const WorkgroupSize& size, const std::array<uint32_t, 3>& maxSize,
+    uint32_t maxInvocations);
+
+[[nodiscard]] std::string workgroupSizeName(const WorkgroupSize& size);
+
+/// Specialization of the local size of a shader declaring
+/// `local_size_x_id = 0, local_size_y_id = 1`; not copyable, since `info`
+/// points into it
+class WorkgroupSpecialization {
+public:
+  explicit WorkgroupSpecialization(const WorkgroupSize& size);
+  WorkgroupSpecialization(const WorkgroupSpecialization&) = delete;
+  WorkgroupSpecialization& operator=(const WorkgroupSpecialization&) = delete;
+
+  [[nodiscard]] const VkSpecializationInfo* info() const { return &m_info; }
+
+private:
+  std::array<uint32_t, 2> m_data;
+  std::array<VkSpecializationMapEntry, 2> m_entries;
+  VkSpecializationInfo m_info;
+};
+
+struct TileTiming {
+  WorkgroupSize tile;
+  uint64_t idleInvocations;  // of one dispatch
+  double temporalReuse;      // mean device microseconds, 0 when not timed
+  double spatialReuse;
+};
+
+/// Table of the sweep and the fastest tile
+void logTileSweep(const std::vector<TileTiming>& timings);
+
+/// Group counts of image and buffer domains, idle invocations, the device
+/// limits and the specialization data
+[[nodiscard]] std::vector<ValidationCheck> validateDispatch();
+
+#endif /* __VOLUME_RESTIR_UTILS_DISPATCH_HPP__ */
@@ -0,0 +1,246 @@
+#include "utils/environment_map.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "spdlog/spdlog.h"
+#include "stb_image.h"
+#include "utils/parallel.hpp"
+#include "utils/restir_utils.h"
+#include "utils/rng.hpp"
+#include "utils/shader_functions.hpp"
+
+namespace {
+
+constexpr float kPi = 3.14159265358979323846f;
+
+float rowSinTheta(uint32_t row, uint32_t height) {
+  return std::sin(kPi * (row + 0.5f) / float(height));
+}
+
+/// Alias table lookup with a single uniform number: the integer part picks
+/// the column, the fractional part decides between the column and its alias
+uint32_t sampleAliasTable(const AliasTableCell* cells, uint32_t count,
+                          float u) {
+  const float scaled    = u * float(count);
+  const uint32_t column = std::min(uint32_t(scaled), count - 1);
+  const AliasTableCell& cell = cells[column];
+  return cell.prob > scaled - float(column) ? column
+                                            : static_cast<uint32_t>(cell.alias);
+}
+
+float pixelPdf(const EnvironmentMap& map,
+               const std::vector<AliasTableCell>& aliasTable, uint32_t row,
+               uint32_t column) {
+  return aliasTable[row].pdf *
+         aliasTable[map.height + row * map.width + column].pdf;
+}
+
+/// Converts a pdf over the unit square of the map into solid angle measure
+float toSolidAngle(const EnvironmentMap& map, float pdf, float sinTheta) {
+  if (sinTheta <= 0.0f) {
+    return 0.0f;
+  }
+  return pdf * float(map.width) * float(map.height) /
+         (2.0f * kPi * kPi * sinTheta);
+}
+
+/// Luminance rising along phi and towards the zenith, a small sun and a black
+/// row below the horizon
+EnvironmentMap syntheticEnvironmentMap(uint32_t blackRow) {
+  EnvironmentMap map;
+  map.width  = 64;
+  map.height = 32;
+  map.pixels.resize(size_t(map.width) * map.height);
+  for (uint32_t row = 0; row < map.height; ++row) {
+    for (uint32_t x = 0; x < map.width; ++x) {
+      float value = (0.2f + x / float(map.width)) *
+                    (1.0f + float(map.height - row) / float(map.height));
+      if (x >= 40 && x < 43 && row >= 6 && row < 8) {
+        value = 200.0f;
+      }
+      if (row == blackRow) {
+        value = 0.0f;
+      }
+      map.pixels[size_t(row) * map.width + x] =
+          nvmath::vec4f(value, value, value, 1.0f);
+    }
+  }
+  return map;
+}
+
+}  // namespace
+
+std::optional<EnvironmentMap> loadEnvironmentMap(const std::string& filename) {
+  spdlog::info("Loading environment map from: {}", filename);
+  int width, height, channels;
+  float* data = stbi_loadf(filename.c_str(), &width, &height, &channels,
+                           STBI_rgb_alpha);
+  if (!data) {
+    spdlog::error("Error whilst loading environment map: {}",
+                  stbi_failure_reason());
+    return std::nullopt;
+  }
+
+  EnvironmentMap map;
+  map.width  = static_cast<uint32_t>(width);
+  map.height = static_cast<uint32_t>(height);
+  map.pixels.resize(size_t(width) * height);
+  for (size_t i = 0; i < map.pixels.size(); ++i) {
+    map.pixels[i] = nvmath::vec4f(data[4 * i], data[4 * i + 1],
+                                  data[4 * i + 2], 1.0f);
+  }
+  stbi_image_free(data);
+  return map;
+}
+
+std::vector<AliasTableCell> createEnvironmentAliasTable(
+    const EnvironmentMap& map) {
+  const uint32_t width  = map.width;
+  const uint32_t height = map.height;
+  std::vector<AliasTableCell> result(height + size_t(height) * width);
+  std::vector<float> rowWeights(height, 0.0f);
+
+  // conditional tables; sin(theta) is constant along a row and cancels out
+  parallelBatches(
+      height,
+      [&](size_t begin, size_t end) {
+        std::vector<float> weights(width);
+        for (size_t row = begin; row < end; ++row) {
+          float sum = 0.0f;
+          for (uint32_t x = 0; x < width; ++x) {
+            const nvmath::vec4f& p = map.pixels[row * width + x];
+            weights[x] = std::max(0.0f, shader::luminance(p.x, p.y, p.z));
+            sum += weights[x];
+          }
+          if (sum <= 0.0f) {
+            // never selected by the marginal table, but must stay finite
+            std::fill(weights.begin(), weights.end(), 1.0f);
+          }
+          rowWeights[row] = sum * rowSinTheta(uint32_t(row), height);
+
+          const std::vector<AliasTableCell> conditional =
+              createAliasTable(weights);
+          std::copy(conditional.begin(), conditional.end(),
+                    result.begin() + height + row * width);
+        }
+      },
+      16);
+
+  if (std::all_of(rowWeights.begin(), rowWeights.end(),
+                  [](float w) { return w <= 0.0f; })) {
+    spdlog::warn("Environment map is black; sampling it uniformly");
+    for (uint32_t row = 0; row < height; ++row) {
+      rowWeights[row] = rowSinTheta(row, height);
+    }
+  }
+  const std::vector<AliasTableCell> marginal = createAliasTable(rowWeights);
+  std::copy(marginal.begin(), marginal.end(), result.begin());
+  return result;
+}
+
+EnvironmentSample sampleEnvironment(
+    const EnvironmentMap& map, const std::vector<AliasTableCell>& aliasTable,
+    const nvmath::vec4f& u) {
+  const uint32_t row = sampleAliasTable(aliasTable.data(), map.height, u.x);
+  const uint32_t column = sampleAliasTable(
+      aliasTable.data() + map.height + size_t(row) * map.width, map.width, u.y);
+
+  const float phi   = 2.0f * kPi * (column + u.z) / float(map.width) - kPi;
+  const float theta = kPi * (row + u.w) / float(map.height);
+  const float sinTheta = std::sin(theta);
+
+  EnvironmentSample sample;
+  sample.direction = nvmath::vec3f(std::cos(phi) * sinTheta, std::cos(theta),
+                                   std::sin(phi) * sinTheta);
+  const nvmath::vec4f& pixel = map.pixels[size_t(row) * map.width + column];
+  sample.radiance = nvmath::vec3f(pixel.x, pixel.y, pixel.z);
+  sample.pdf =
+      toSolidAngle(map, pixelPdf(map, aliasTable, row, column), sinTheta);
+  return sample;
+}
+
+float environmentPdf(const EnvironmentMap& map,
+                     const std::vector<AliasTableCell>& aliasTable,
+                     const nvmath::vec3f& direction) {
+  // not acos(y), which loses sin(theta) and with it the pdf near the poles
+  const float sinTheta = std::sqrt(direction.x * direction.x +
+                                   direction.z * direction.z);
+  const float theta    = std::atan2(sinTheta, direction.y);
+  const float phi      = std::atan2(direction.z, direction.x);
+
+  const float u = (phi + kPi) / (2.0f * kPi);
+  const float v = theta / kPi;
+  const uint32_t column =
+      std::min(uint32_t(std::max(u, 0.0f) * map.width), map.width - 1);
+  const uint32_t row =
+      std::min(uint32_t(std::max(v, 0.0f) * map.height), map.height - 1);
+  return toSolidAngle(map, pixelPdf(map, aliasTable, row, column), sinTheta);
+}
+
+std::vector<ValidationCheck> validateEnvironmentSampling(uint32_t numSamples) {
+  constexpr uint32_t kBlackRow = 20;
+  const EnvironmentMap map = syntheticEnvironmentMap(kBlackRow);
+  const std::vector<AliasTableCell> aliasTable =
+      createEnvironmentAliasTable(map);
+
+  std::vector<float> u(size_t(numSamples) * 4);
+  generateUniformFloats(hostRngKey(29, 0), 0, u.data(), u.size());
+
+  // The position inside the pixel keeps off its edges, where the direction
+  // may round into the neighbouring pixel and its different pdf
+  const auto inside = [](float x) { return 1e-3f + x * (1.0f - 2e-3f); };
+  float deviation    = 0.0f;
+  uint32_t blackHits = 0;
+  for (uint32_t i = 0; i < numSamples; ++i) {
+    const float* ui = &u[size_t(i) * 4];
+    const EnvironmentSample sample = sampleEnvironment(
+        map, aliasTable,
+        nvmath::vec4f(ui[0], ui[1], inside(ui[2]), inside(ui[3])));
+    const float pdf = environmentPdf(map, aliasTable, sample.direction);
+    deviation = std::max(deviation, std::abs(sample.pdf - pdf) /
+                                         std::max(sample.pdf, pdf));
+    if (sample.radiance.x == 0.0f) {
+      ++blackHits;
+    }
+  }
+
+  // Integral over the sphere, one jittered direction per cell of equal solid
+  // angle in (cos(theta), phi)
+  const uint32_t cells = 512;
+  std::vector<float> jitter(size_t(cells) * cells * 2);
+  generateUniformFloats(hostRngKey(29, 1), 0, jitter.data(), jitter.size());
+  double integral = 0.0;
+  for (uint32_t i = 0; i < cells; ++i) {
+    for (uint32_t j = 0; j < cells; ++j) {
+      const float* cell = &jitter[(size_t(i) * cells + j) * 2];
+      const float cosTheta = 1.0f - 2.0f * (i + cell[0]) / float(cells);
+      const float sinTheta =
+          std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+      const float phi = 2.0f * kPi * (j + cell[1]) / float(cells) - kPi;
+      integral += environmentPdf(
+          map, aliasTable,
+          nvmath::vec3f(std::cos(phi) * sinTheta, cosTheta,
+                        std::sin(phi) * sinTheta));
+    }
+  }
+  integral *= 4.0 * kPi / (double(cells) * cells);
+  spdlog::debug("Environment sampling: largest pdf deviation {:g}, integral {}",
+                deviation, integral);
+
+  const float pdfTolerance       = 1e-5f;
+  const double integralTolerance = 2e-3;
+  const std::string pdfExpected = fmt::format("within {:g}", pdfTolerance);
+  const std::string integralExpected =
+      fmt::format("1 within {:g}", integralTolerance);
+  return {
+      {"sample pdf", pdfExpected,
+       deviation <= pdfTolerance ? pdfExpected
+                                 : fmt::format("off by {:g}", deviation)},
+      {"black row", "0 samples", fmt::format("{} samples", blackHits)},
+      {"pdf over the sphere", integralExpected,
+       std::abs(integral - 1.0) <= integralTolerance
+           ? integralExpected
+           : fmt::format("{:.4f}", integral)},
+  };
+}
@@ -0,0 +1,66 @@
+#ifndef __VOLUME_RESTIR_UTILS_ENVIRONMENT_MAP_HPP__
+#define __VOLUME_RESTIR_UTILS_ENVIRONMENT_MAP_HPP__
+
+/**
+ * @file environment_map.hpp
+ *
+ * @brief Equirectangular HDR environment maps and their importance sampling.
+ *
+ *  Pixel (x, y) covers u = x / width, v = y / height, with direction
+ *  (cos(phi) sin(theta), cos(theta), sin(phi) sin(theta)) for
+ *  phi = 2 pi u - pi and theta = pi v, as in `shaders/headers/environment.glsl`.
+ *
+ *  The alias table has `height` marginal cells over the rows, followed by
+ *  `height * width` cells holding one conditional table per row. Both are
+ *  built over luminance * sin(theta), and `AliasTableCell::pdf` holds the
+ *  normalized row and column probabilities.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "shaders/host_device.h"
+#include "utils/validation.hpp"
+
+struct EnvironmentMap {
+  uint32_t width  = 0;
+  uint32_t height = 0;
+  std::vector<nvmath::vec4f> pixels;  // row-major, row 0 is the zenith
+
+  [[nodiscard]] bool empty() const { return pixels.empty(); }
+};
+
+struct EnvironmentSample {
+  nvmath::vec3f direction;
+  nvmath::vec3f radiance;
+  float pdf;  // solid angle measure
+};
+
+[[nodiscard]] std::optional<EnvironmentMap> loadEnvironmentMap(
+    const std::string& filename);
+
+[[nodiscard]] std::vector<AliasTableCell> createEnvironmentAliasTable(
+    const EnvironmentMap& map);
+
+/// Samples a direction from four uniform numbers in [0, 1): row, column and
+/// the position inside the selected pixel
+[[nodiscard]] EnvironmentSample sampleEnvironment(
+    const EnvironmentMap& map, const std::vector<AliasTableCell>& aliasTable,
+    const nvmath::vec4f& u);
+
+/// Solid angle pdf with which `sampleEnvironment` returns `direction`
+[[nodiscard]] float environmentPdf(
+    const EnvironmentMap& map, const std::vector<AliasTableCell>& aliasTable,
+    const nvmath::vec3f& direction);
+
+/// Sampling of a synthetic map with a sun, a gradient and a black row: the pdf
+/// of every sample against `environmentPdf` of its direction, the samples that
+/// land on the black row and `environmentPdf` integrated over the sphere
+[[nodiscard]] std::vector<ValidationCheck> validateEnvironmentSampling(
+    uint32_t numSamples = 1u << 16);
+
+#endif /* __VOLUME_RESTIR_UTILS_ENVIRONMENT_MAP_HPP__ */
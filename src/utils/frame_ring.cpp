@@ -0,0 +1,126 @@
+#include "utils/frame_ring.hpp"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+#include "utils/rng.hpp"
+
+FrameRing::FrameRing(uint32_t slots)
+    : m_inFlight(std::max(slots, 1u), false),
+      m_current(std::max(slots, 1u) - 1) {}
+
+uint32_t FrameRing::begin(const std::function<void(uint32_t slot)>& wait) {
+  m_current = (m_current + 1) % slots();
+  if (m_inFlight[m_current]) {
+    wait(m_current);
+    m_inFlight[m_current] = false;
+  }
+  return m_current;
+}
+
+void FrameRing::end() { m_inFlight[m_current] = true; }
+
+void FrameRing::waitAll(const std::function<void(uint32_t slot)>& wait) {
+  for (uint32_t slot = 0; slot < slots(); ++slot) {
+    if (m_inFlight[slot]) {
+      wait(slot);
+      m_inFlight[slot] = false;
+    }
+  }
+}
+
+uint32_t FrameRing::inFlight() const {
+  return static_cast<uint32_t>(
+      std::count(m_inFlight.begin(), m_inFlight.end(), true));
+}
+
+namespace {
+
+struct FrameTimes {
+  const char* name;
+  uint32_t slots;
+  double record;   // mean milliseconds on the host
+  double execute;  // and on the device
+};
+
+FrameRingValidationResult replay(const FrameTimes& times, uint32_t frames,
+                                 uint32_t seed) {
+  FrameRingValidationResult result{times.name, times.slots, frames, 0, 0,
+                                   0.0,        0,           0};
+  const uint32_t key = hostRngKey(seed, times.slots);
+  uint32_t counter   = 0;
+  // between half and one and a half times the mean
+  const auto jitter = [&](double mean) {
+    float u;
+    generateUniformFloats(key, counter++, &u, 1);
+    return mean * (0.5 + u);
+  };
+
+  FrameRing ring(times.slots);
+  std::vector<double> completions;  // device time each frame completes at
+  std::vector<int64_t> lastFrame(times.slots, -1);  // submitted in each slot
+  double host      = 0.0;
+  double deviceEnd = 0.0;
+  double serial    = 0.0;
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    const uint32_t slot = ring.begin([&](uint32_t waited) {
+      // as vkWaitForFences on the fence of the slot
+      host = std::max(host, completions[lastFrame[waited]]);
+      ++result.waits;
+    });
+    if (lastFrame[slot] >= 0 && completions[lastFrame[slot]] > host) {
+      ++result.hazardErrors;
+    }
+    lastFrame[slot] = frame;
+
+    const double record  = jitter(times.record);
+    const double execute = jitter(times.execute);
+    serial += record + execute;
+    host += record;
+    deviceEnd = std::max(deviceEnd, host) + execute;
+    completions.push_back(deviceEnd);
+    ring.end();
+
+    const uint32_t running = static_cast<uint32_t>(std::count_if(
+        completions.begin(), completions.end(),
+        [&](double completion) { return completion > host; }));
+    result.maxInFlight = std::max(result.maxInFlight, running);
+    result.boundErrors += running > times.slots ? 1 : 0;
+  }
+  ring.waitAll([&](uint32_t) {});
+  result.boundErrors += ring.inFlight() != 0 ? 1 : 0;
+  result.speedup = serial / deviceEnd;
+  return result;
+}
+
+}  // namespace
+
+std::vector<FrameRingValidationResult> validateFrameRing(uint32_t frames,
+                                                         uint32_t seed) {
+  return {replay({"one slot", 1, 1.0, 1.0}, frames, seed),
+          replay({"balanced", 2, 1.0, 1.0}, frames, seed),
+          replay({"device bound", 2, 0.5, 2.0}, frames, seed),
+          replay({"host bound", 3, 2.0, 0.5}, frames, seed)};
+}
+
+bool isFrameRingValid(const std::vector<FrameRingValidationResult>& results) {
+  return std::all_of(results.begin(), results.end(),
+                     [](const FrameRingValidationResult& result) {
+                       const bool overlapped = result.speedup > 1.05;
+                       return result.hazardErrors == 0 &&
+                              result.boundErrors == 0 &&
+                              overlapped == (result.slots > 1);
+                     });
+}
+
+void logFrameRing(const std::vector<FrameRingValidationResult>& results) {
+  spdlog::info("{:>12} {:>5} {:>6} {:>6} {:>9} {:>7} {:>7} {:>6}", "scenario",
+               "slots", "frames", "waits", "in flight", "speedup", "hazards",
+               "bounds");
+  for (const FrameRingValidationResult& result : results) {
+    spdlog::info("{:>12} {:>5} {:>6} {:>6} {:>9} {:>6.2f}x {:>7} {:>6}",
+                 result.scenario, result.slots, result.frames, result.waits,
+                 result.maxInFlight, result.speedup, result.hazardErrors,
+                 result.boundErrors);
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef __VOLUME_RESTIR_UTILS_FRAME_RING_HPP__
+#define __VOLUME_RESTIR_UTILS_FRAME_RING_HPP__
+
+/**
+ * @file frame_ring.hpp
+ *
+ * @brief Frame slots of the resources the host writes every frame, reused
+ * round robin once the fence of their last frame signaled.
+ *
+ *  Each frame in flight has its own uniform buffers and the descriptor sets
+ *  pointing at them, so the host fills the next frame while the device still
+ *  reads the previous ones. A slot is guarded by the fence of the last frame
+ *  that used it: `begin` waits for it only when that frame was submitted and
+ *  not waited for yet, so the host runs at most `slots` frames ahead of the
+ *  device. The reservoirs stay indexed by the parity of the frame, since
+ *  temporal reuse reads the previous frame's ones anyway.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class FrameRing {
+public:
+  explicit FrameRing(uint32_t slots = 2);
+
+  /// Moves to the next slot and returns it, after `wait` returned for it
+  /// when its last frame is still in flight
+  uint32_t begin(const std::function<void(uint32_t slot)>& wait);
+
+  /// The frame of the current slot was submitted
+  void end();
+
+  /// Waits for every frame in flight, before the resources are destroyed
+  void waitAll(const std::function<void(uint32_t slot)>& wait);
+
+  [[nodiscard]] uint32_t slots() const {
+    return static_cast<uint32_t>(m_inFlight.size());
+  }
+  [[nodiscard]] uint32_t current() const { return m_current; }
+  /// Submitted frames not waited for
+  [[nodiscard]] uint32_t inFlight() const;
+
+private:
+  std::vector<bool> m_inFlight;
+  uint32_t m_current;
+};
+
+struct FrameRingValidationResult {
+  std::string scenario;
+  uint32_t slots;
+  uint32_t frames;
+  uint32_t waits;        // for the fence of a slot
+  uint32_t maxInFlight;  // frames submitted and not completed
+  double speedup;        // over recording and executing one frame at a time
+  uint32_t hazardErrors;  // slots reused while their frame was running
+  uint32_t boundErrors;   // more frames in flight than slots
+};
+
+/// Replays frames recorded by the host and executed by a device with random
+/// durations, the host waiting for the slots as the renderer does
+[[nodiscard]] std::vector<FrameRingValidationResult> validateFrameRing(
+    uint32_t frames = 1000, uint32_t seed = 7);
+
+/// False on a hazard or bound error, or when the frames overlapped with a
+/// single slot or did not with several
+[[nodiscard]] bool isFrameRingValid(
+    const std::vector<FrameRingValidationResult>& results);
+
+void logFrameRing(const std::vector<FrameRingValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_FRAME_RING_HPP__ */
@@ -0,0 +1,320 @@
+#include "utils/low_discrepancy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+#include "spdlog/spdlog.h"
+#include "utils/parallel.hpp"
+#include "utils/rng.hpp"
+#include "utils/shader_functions.hpp"
+
+namespace {
+
+constexpr uint32_t kAssetMagic   = 0x4c445442u;  // "LDTB"
+constexpr uint32_t kAssetVersion = 1;
+
+constexpr float kBlueNoiseSigma   = 1.5f;
+constexpr int kBlueNoiseRadius    = 6;  // the Gaussian is < 1e-3 beyond 4 sigma
+constexpr float kGoldenRatioConj  = 0.61803398875f;
+constexpr float kInitialPointRate = 0.1f;
+
+/**
+ * @brief Toroidal void-and-cluster state: which pixels are set, and the
+ * Gaussian-filtered density of the set pixels at every pixel.
+ */
+class VoidAndCluster {
+public:
+  explicit VoidAndCluster(uint32_t size)
+      : m_size(size),
+        m_radius(std::min(kBlueNoiseRadius, (static_cast<int>(size) - 1) / 2)),
+        m_occupied(size * size, 0),
+        m_energy(size * size, 0.0f) {
+    const int width     = 2 * m_radius + 1;
+    const float falloff = 1.0f / (2.0f * kBlueNoiseSigma * kBlueNoiseSigma);
+    m_kernel.resize(width * width);
+    for (int dy = -m_radius; dy <= m_radius; ++dy) {
+      for (int dx = -m_radius; dx <= m_radius; ++dx) {
+        m_kernel[(dy + m_radius) * width + dx + m_radius] =
+            std::exp(-float(dx * dx + dy * dy) * falloff);
+      }
+    }
+  }
+
+  [[nodiscard]] bool isSet(uint32_t pixel) const { return m_occupied[pixel]; }
+
+  void set(uint32_t pixel, bool value) {
+    if (bool(m_occupied[pixel]) == value) {
+      return;
+    }
+    m_occupied[pixel] = value;
+
+    const float sign = value ? 1.0f : -1.0f;
+    const int size   = static_cast<int>(m_size);
+    const int px     = static_cast<int>(pixel % m_size);
+    const int py     = static_cast<int>(pixel / m_size);
+    const int width  = 2 * m_radius + 1;
+    for (int dy = -m_radius; dy <= m_radius; ++dy) {
+      const int y = (py + dy + size) % size;
+      for (int dx = -m_radius; dx <= m_radius; ++dx) {
+        const int x = (px + dx + size) % size;
+        m_energy[y * size + x] +=
+            sign * m_kernel[(dy + m_radius) * width + dx + m_radius];
+      }
+    }
+  }
+
+  /// Set pixel with the highest density
+  [[nodiscard]] uint32_t tightestCluster() const {
+    uint32_t best    = 0;
+    float bestEnergy = -1.0f;
+    for (uint32_t i = 0; i < m_energy.size(); ++i) {
+      if (m_occupied[i] && m_energy[i] > bestEnergy) {
+        best       = i;
+        bestEnergy = m_energy[i];
+      }
+    }
+    return best;
+  }
+
+  /// Empty pixel with the lowest density
+  [[nodiscard]] uint32_t largestVoid() const {
+    uint32_t best    = 0;
+    float bestEnergy = std::numeric_limits<float>::max();
+    for (uint32_t i = 0; i < m_energy.size(); ++i) {
+      if (!m_occupied[i] && m_energy[i] < bestEnergy) {
+        best       = i;
+        bestEnergy = m_energy[i];
+      }
+    }
+    return best;
+  }
+
+private:
+  uint32_t m_size;
+  int m_radius;
+  std::vector<uint8_t> m_occupied;
+  std::vector<float> m_energy;
+  std::vector<float> m_kernel;
+};
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& file, T& value) {
+  return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+/// Bytes from the read position to the end of the file
+uint64_t remainingBytes(std::ifstream& file) {
+  const std::streampos position = file.tellg();
+  file.seekg(0, std::ios::end);
+  const std::streampos end = file.tellg();
+  file.seekg(position);
+  return end > position ? uint64_t(end - position) : 0;
+}
+
+}  // namespace
+
+std::vector<nvmath::vec2f> generateOwenSobolTable(uint32_t sampleCount,
+                                                  uint32_t dimensionPairs,
+                                                  uint32_t seed) {
+  std::vector<nvmath::vec2f> result(size_t(sampleCount) * dimensionPairs);
+  parallelBatches(result.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      result[i] = shader::ldOwenSobol2D(static_cast<uint32_t>(i % sampleCount),
+                                        seed,
+                                        static_cast<uint32_t>(i / sampleCount));
+    }
+  });
+  return result;
+}
+
+std::vector<uint8_t> generateBlueNoiseTable(uint32_t size, uint32_t slices,
+                                            uint32_t seed) {
+  const uint32_t numPixels = size * size;
+  if (numPixels == 0 || slices == 0) {
+    return {};
+  }
+
+  // initial binary pattern: random points relaxed until the tightest cluster
+  // and the largest void coincide
+  VoidAndCluster pattern(size);
+  const uint32_t key        = hostRngKey(seed, 1);
+  const uint32_t numInitial = std::max<uint32_t>(
+      1, static_cast<uint32_t>(numPixels * kInitialPointRate));
+  for (uint32_t counter = 0, placed = 0; placed < numInitial; ++counter) {
+    const uint32_t pixel = shader::rngAt(key, counter) % numPixels;
+    if (!pattern.isSet(pixel)) {
+      pattern.set(pixel, true);
+      ++placed;
+    }
+  }
+  for (uint32_t iteration = 0; iteration < numPixels; ++iteration) {
+    const uint32_t cluster = pattern.tightestCluster();
+    pattern.set(cluster, false);
+    const uint32_t emptiest = pattern.largestVoid();
+    pattern.set(emptiest, true);
+    if (emptiest == cluster) {
+      break;
+    }
+  }
+
+  std::vector<uint32_t> rank(numPixels, 0);
+
+  // phase 1: rank the initial points by repeatedly removing the tightest
+  // cluster
+  {
+    VoidAndCluster prototype = pattern;
+    for (uint32_t r = numInitial; r-- > 0;) {
+      const uint32_t cluster = prototype.tightestCluster();
+      prototype.set(cluster, false);
+      rank[cluster] = r;
+    }
+  }
+
+  // phase 2: fill the remaining pixels into the largest voids
+  for (uint32_t r = numInitial; r < numPixels; ++r) {
+    const uint32_t emptiest = pattern.largestVoid();
+    pattern.set(emptiest, true);
+    rank[emptiest] = r;
+  }
+
+  std::vector<uint8_t> result(size_t(numPixels) * slices);
+  for (uint32_t slice = 0; slice < slices; ++slice) {
+    const float offset = std::fmod(slice * kGoldenRatioConj, 1.0f);
+    for (uint32_t pixel = 0; pixel < numPixels; ++pixel) {
+      const float value = (rank[pixel] + 0.5f) / float(numPixels) + offset;
+      result[size_t(slice) * numPixels + pixel] = static_cast<uint8_t>(
+          std::min(255.0f, (value - std::floor(value)) * 256.0f));
+    }
+  }
+  return result;
+}
+
+LowDiscrepancyTables generateLowDiscrepancyTables(uint32_t seed,
+                                                  uint32_t sobolSampleCount,
+                                                  uint32_t sobolDimensionPairs,
+                                                  uint32_t blueNoiseSize,
+                                                  uint32_t blueNoiseSlices) {
+  LowDiscrepancyTables tables;
+  tables.seed                = seed;
+  tables.sobolSampleCount    = sobolSampleCount;
+  tables.sobolDimensionPairs = sobolDimensionPairs;
+  tables.blueNoiseSize       = blueNoiseSize;
+  tables.blueNoiseSlices     = blueNoiseSlices;
+  tables.sobol =
+      generateOwenSobolTable(sobolSampleCount, sobolDimensionPairs, seed);
+  tables.blueNoise =
+      generateBlueNoiseTable(blueNoiseSize, blueNoiseSlices, seed);
+  return tables;
+}
+
+nvmath::vec2f blueNoiseRotation(const LowDiscrepancyTables& tables,
+                                uint32_t x, uint32_t y, uint32_t frameIndex) {
+  const uint32_t size  = tables.blueNoiseSize;
+  const size_t slice   = size_t(frameIndex % tables.blueNoiseSlices) * size;
+  const uint32_t fx    = x % size;
+  const uint32_t fy    = y % size;
+  const uint32_t ox    = (fx + size / 2) % size;
+  const uint32_t oy    = (fy + size / 2) % size;
+  const uint8_t first  = tables.blueNoise[(slice + fy) * size + fx];
+  const uint8_t second = tables.blueNoise[(slice + oy) * size + ox];
+  return nvmath::vec2f((first + 0.5f) / 256.0f, (second + 0.5f) / 256.0f);
+}
+
+bool saveLowDiscrepancyTables(const std::string& filename,
+                              const LowDiscrepancyTables& tables) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file) {
+    spdlog::error("Cannot open {} for writing", filename);
+    return false;
+  }
+
+  writeValue(file, kAssetMagic);
+  writeValue(file, kAssetVersion);
+  writeValue(file, tables.seed);
+  writeValue(file, tables.sobolSampleCount);
+  writeValue(file, tables.sobolDimensionPairs);
+  writeValue(file, tables.blueNoiseSize);
+  writeValue(file, tables.blueNoiseSlices);
+  file.write(reinterpret_cast<const char*>(tables.sobol.data()),
+             tables.sobol.size() * sizeof(nvmath::vec2f));
+  file.write(reinterpret_cast<const char*>(tables.blueNoise.data()),
+             tables.blueNoise.size());
+  if (!file) {
+    spdlog::error("Failed writing low-discrepancy tables to {}", filename);
+    return false;
+  }
+  spdlog::info("Wrote low-discrepancy tables to {}", filename);
+  return true;
+}
+
+std::optional<LowDiscrepancyTables> loadLowDiscrepancyTables(
+    const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    spdlog::error("Cannot open low-discrepancy tables {}", filename);
+    return std::nullopt;
+  }
+
+  uint32_t magic = 0, version = 0;
+  LowDiscrepancyTables tables;
+  if (!readValue(file, magic) || !readValue(file, version) ||
+      magic != kAssetMagic || version != kAssetVersion) {
+    spdlog::error("{} is not a version {} low-discrepancy table asset",
+                  filename, kAssetVersion);
+    return std::nullopt;
+  }
+  if (!readValue(file, tables.seed) ||
+      !readValue(file, tables.sobolSampleCount) ||
+      !readValue(file, tables.sobolDimensionPairs) ||
+      !readValue(file, tables.blueNoiseSize) ||
+      !readValue(file, tables.blueNoiseSlices)) {
+    spdlog::error("Truncated low-discrepancy table header in {}", filename);
+    return std::nullopt;
+  }
+
+  // the header sizes the tables, so it must describe exactly the rest of the
+  // file before anything is allocated; the products are checked by division
+  // as they may not fit in 64 bits
+  const uint64_t remaining = remainingBytes(file);
+  const uint64_t sobolCount =
+      uint64_t(tables.sobolSampleCount) * tables.sobolDimensionPairs;
+  bool matches = sobolCount <= remaining / sizeof(nvmath::vec2f);
+  if (matches) {
+    const uint64_t blueNoiseBytes =
+        remaining - sobolCount * sizeof(nvmath::vec2f);
+    const uint64_t tileBytes =
+        uint64_t(tables.blueNoiseSize) * tables.blueNoiseSize;
+    matches = tables.blueNoiseSlices == 0
+                  ? blueNoiseBytes == 0
+                  : tileBytes <= blueNoiseBytes / tables.blueNoiseSlices &&
+                        tileBytes * tables.blueNoiseSlices == blueNoiseBytes;
+  }
+  if (!matches) {
+    spdlog::error(
+        "Low-discrepancy table header in {} does not match its {} bytes of "
+        "data",
+        filename, remaining);
+    return std::nullopt;
+  }
+
+  tables.sobol.resize(size_t(tables.sobolSampleCount) *
+                      tables.sobolDimensionPairs);
+  tables.blueNoise.resize(size_t(tables.blueNoiseSize) * tables.blueNoiseSize *
+                          tables.blueNoiseSlices);
+  file.read(reinterpret_cast<char*>(tables.sobol.data()),
+            tables.sobol.size() * sizeof(nvmath::vec2f));
+  file.read(reinterpret_cast<char*>(tables.blueNoise.data()),
+            tables.blueNoise.size());
+  if (!file) {
+    spdlog::error("Truncated low-discrepancy table data in {}", filename);
+    return std::nullopt;
+  }
+  return tables;
+}
@@ -0,0 +1,69 @@
+#ifndef __VOLUME_RESTIR_UTILS_LOW_DISCREPANCY_HPP__
+#define __VOLUME_RESTIR_UTILS_LOW_DISCREPANCY_HPP__
+
+/**
+ * @file low_discrepancy.hpp
+ *
+ * @brief Precomputed Owen-scrambled Sobol and spatio-temporal blue-noise
+ * tables, plus their compact binary asset format.
+ *
+ *  The Sobol table reproduces `shader::ldOwenSobol2D` exactly, so the tables
+ *  can stand in for the on-the-fly shader evaluation. Blue noise is generated
+ *  with void-and-cluster on a toroidal tile; slices are offset along the
+ *  golden-ratio sequence so every pixel is also well distributed over time.
+ *  `restir.rgen` evaluates the Sobol points on the fly and rotates them per
+ *  pixel by the blue noise, which the renderer loads from the asset of
+ *  `--write-ld-tables` or generates at startup.
+ *
+ *  See reference:
+ *   - Burley, "Practical Hash-based Owen Scrambling", JCGT 2020
+ *   - Ulichney, "The void-and-cluster method for dither array generation"
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct LowDiscrepancyTables {
+  uint32_t seed                = 0;
+  uint32_t sobolSampleCount    = 0;
+  uint32_t sobolDimensionPairs = 0;
+  uint32_t blueNoiseSize       = 0;
+  uint32_t blueNoiseSlices     = 0;
+
+  // sobol[pair * sobolSampleCount + index]
+  std::vector<nvmath::vec2f> sobol;
+  // blueNoise[(slice * blueNoiseSize + y) * blueNoiseSize + x]; value / 256
+  std::vector<uint8_t> blueNoise;
+};
+
+[[nodiscard]] std::vector<nvmath::vec2f> generateOwenSobolTable(
+    uint32_t sampleCount, uint32_t dimensionPairs, uint32_t seed);
+
+[[nodiscard]] std::vector<uint8_t> generateBlueNoiseTable(uint32_t size,
+                                                          uint32_t slices,
+                                                          uint32_t seed);
+
+[[nodiscard]] LowDiscrepancyTables generateLowDiscrepancyTables(
+    uint32_t seed = 0, uint32_t sobolSampleCount = 256,
+    uint32_t sobolDimensionPairs = 4, uint32_t blueNoiseSize = 64,
+    uint32_t blueNoiseSlices = 16);
+
+/// Host mirror of `blueNoiseRotation` in restir.rgen: the rotation of the
+/// low-discrepancy points of pixel (`x`, `y`) in frame `frameIndex`
+[[nodiscard]] nvmath::vec2f blueNoiseRotation(
+    const LowDiscrepancyTables& tables, uint32_t x, uint32_t y,
+    uint32_t frameIndex);
+
+/// Writes the tables as a little-endian binary asset; returns false on failure
+bool saveLowDiscrepancyTables(const std::string& filename,
+                              const LowDiscrepancyTables& tables);
+
+/// Fails without allocating when the header sizes do not match the file
+[[nodiscard]] std::optional<LowDiscrepancyTables> loadLowDiscrepancyTables(
+    const std::string& filename);
+
+#endif /* __VOLUME_RESTIR_UTILS_LOW_DISCREPANCY_HPP__ */
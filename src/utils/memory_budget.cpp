@@ -0,0 +1,152 @@
+#include "utils/memory_budget.hpp"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+const char* memoryCategoryName(MemoryCategory category) {
+  switch (category) {
+    case MemoryCategory::eGeometry:
+      return "geometry";
+    case MemoryCategory::eAccelerationStructures:
+      return "acceleration structures";
+    case MemoryCategory::eFrameImages:
+      return "frame images";
+    case MemoryCategory::eStaging:
+      return "staging";
+  }
+  return "unknown";
+}
+
+VkDeviceSize deviceLocalBudget(const std::vector<HeapBudget>& heaps) {
+  VkDeviceSize budget = 0;
+  for (const HeapBudget& heap : heaps) {
+    if (heap.deviceLocal && heap.budget > heap.usage) {
+      budget += heap.budget - heap.usage;
+    }
+  }
+  return budget;
+}
+
+void MemoryBudget::setTotal(VkDeviceSize total) {
+  for (uint32_t i = 0; i < kMemoryCategories; ++i) {
+    m_limit[i] = static_cast<VkDeviceSize>(double(total) * kShares[i]);
+  }
+}
+
+void MemoryBudget::setLimit(MemoryCategory category, VkDeviceSize limit) {
+  m_limit[index(category)] = limit;
+}
+
+bool MemoryBudget::charge(MemoryCategory category, VkDeviceSize bytes) {
+  const uint32_t i = index(category);
+  m_used[i] += bytes;
+  m_peak[i] = std::max(m_peak[i], m_used[i]);
+  return m_used[i] <= m_limit[i];
+}
+
+void MemoryBudget::release(MemoryCategory category, VkDeviceSize bytes) {
+  const uint32_t i = index(category);
+  m_used[i] -= std::min(bytes, m_used[i]);
+}
+
+VkDeviceSize MemoryBudget::available(MemoryCategory category) const {
+  const uint32_t i = index(category);
+  return m_limit[i] > m_used[i] ? m_limit[i] - m_used[i] : 0;
+}
+
+VkDeviceSize volumeBytes(uint32_t points, VkDeviceSize bytesPerPoint,
+                         const VolumeLod& lod) {
+  const VkDeviceSize kept =
+      (VkDeviceSize(points) + lod.pointStride - 1) / lod.pointStride;
+  // float extinction per voxel, min and max per brick of 8^3 voxels
+  const VkDeviceSize voxels = VkDeviceSize(lod.gridResolution) *
+                              lod.gridResolution * lod.gridResolution;
+  return kept * bytesPerPoint + voxels * sizeof(float) +
+         (voxels / 512 + 1) * 2 * sizeof(float);
+}
+
+VolumeLod chooseVolumeLod(uint32_t points, VkDeviceSize bytesPerPoint,
+                          int maxResolution, VkDeviceSize available) {
+  VolumeLod lod{maxResolution, 1};
+  while (volumeBytes(points, bytesPerPoint, lod) > available &&
+         lod.gridResolution / 2 >= kMinGridResolution) {
+    lod.gridResolution /= 2;
+  }
+  while (volumeBytes(points, bytesPerPoint, lod) > available &&
+         lod.pointStride < points) {
+    lod.pointStride *= 2;
+  }
+  return lod;
+}
+
+void logMemoryBudget(const MemoryBudget& budget) {
+  constexpr double kMiB = 1024.0 * 1024.0;
+  for (uint32_t i = 0; i < kMemoryCategories; ++i) {
+    const MemoryCategory category = static_cast<MemoryCategory>(i);
+    spdlog::info("{:>23}: {:>8.1f} MiB used, {:>8.1f} MiB peak of {:>8.1f} MiB",
+                 memoryCategoryName(category), budget.used(category) / kMiB,
+                 budget.peak(category) / kMiB, budget.limit(category) / kMiB);
+  }
+}
+
+std::vector<ValidationCheck> validateMemoryBudget() {
+  constexpr VkDeviceSize kMiB = 1 << 20;
+  constexpr VkDeviceSize kGiB = 1 << 30;
+  std::vector<ValidationCheck> results;
+  const auto describe = [](const VolumeLod& lod) {
+    return fmt::format("grid {}, 1 point in {}", lod.gridResolution,
+                       lod.pointStride);
+  };
+
+  {
+    MemoryBudget budget;
+    budget.setTotal(1000 * kMiB);
+    std::string observed;
+    for (uint32_t i = 0; i < kMemoryCategories; ++i) {
+      observed += fmt::format("{}{}", i > 0 ? " " : "",
+                              budget.limit(MemoryCategory(i)) / kMiB);
+    }
+    results.push_back({"split", "400 150 350 100", observed});
+  }
+  {
+    MemoryBudget budget;
+    budget.setLimit(MemoryCategory::eGeometry, 100);
+    const bool within       = budget.charge(MemoryCategory::eGeometry, 60);
+    const bool over         = budget.charge(MemoryCategory::eGeometry, 60);
+    const VkDeviceSize full = budget.available(MemoryCategory::eGeometry);
+    budget.release(MemoryCategory::eGeometry, 60);
+    results.push_back(
+        {"charges", "within true, over false, 0 then 40 left, peak 120",
+         fmt::format("within {}, over {}, {} then {} left, peak {}", within,
+                     over, full, budget.available(MemoryCategory::eGeometry),
+                     budget.peak(MemoryCategory::eGeometry))});
+  }
+  {
+    // a device-local heap partly used by others, another one over its
+    // budget and the host heap
+    const std::vector<HeapBudget> heaps = {{8 * kGiB, 6 * kGiB, kGiB, true},
+                                           {kGiB, kGiB / 2, kGiB, true},
+                                           {16 * kGiB, 12 * kGiB, 0, false}};
+    results.push_back({"heaps", "5120 MiB",
+                       fmt::format("{} MiB", deviceLocalBudget(heaps) / kMiB)});
+  }
+
+  // two million points of 100 bytes from a 128 voxel grid
+  constexpr uint32_t kPoints            = 2000000;
+  constexpr VkDeviceSize kBytesPerPoint = 100;
+  results.push_back(
+      {"volume fits", "grid 128, 1 point in 1",
+       describe(chooseVolumeLod(kPoints, kBytesPerPoint, 128, kGiB))});
+  // the points take 191 MiB, the grid at 128 8 MiB, at 64 1 MiB
+  results.push_back(
+      {"volume grid", "grid 64, 1 point in 1",
+       describe(chooseVolumeLod(kPoints, kBytesPerPoint, 128, 196 * kMiB))});
+  results.push_back(
+      {"volume points", "grid 16, 1 point in 4",
+       describe(chooseVolumeLod(kPoints, kBytesPerPoint, 128, 64 * kMiB))});
+  results.push_back(
+      {"volume too big", "grid 16, 1 point in 2097152",
+       describe(chooseVolumeLod(kPoints, kBytesPerPoint, 128, 0))});
+  return results;
+}
@@ -0,0 +1,115 @@
+#ifndef __VOLUME_RESTIR_UTILS_MEMORY_BUDGET_HPP__
+#define __VOLUME_RESTIR_UTILS_MEMORY_BUDGET_HPP__
+
+/**
+ * @file memory_budget.hpp
+ *
+ * @brief Device memory budget of the renderer split between categories of
+ * resources, and the level of detail of the volume that fits in it.
+ *
+ *  The budget is what `VK_EXT_memory_budget` reports for the device-local
+ *  heaps when the renderer starts, or a share of their size without the
+ *  extension. Every allocation of `TlsfMemAllocator` is charged to a
+ *  category; going over the limit of a category is reported, not refused,
+ *  since the heap may still have room. The loaders ask what their category
+ *  has left before allocating large data and lower its detail instead of
+ *  failing: the volume first halves the resolution of its density grid,
+ *  then keeps one point out of two, four, and so on.
+ */
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils/validation.hpp"
+
+enum class MemoryCategory : uint32_t {
+  eGeometry,  // scene buffers, textures and the volume
+  eAccelerationStructures,
+  eFrameImages,  // G-buffers, reservoirs and the other render targets
+  eStaging,      // host visible memory
+};
+constexpr uint32_t kMemoryCategories = 4;
+
+[[nodiscard]] const char* memoryCategoryName(MemoryCategory category);
+
+struct HeapBudget {
+  VkDeviceSize size;
+  VkDeviceSize budget;  // for this process
+  VkDeviceSize usage;   // by this process
+  bool deviceLocal;
+};
+
+/// Budget of the device-local heaps not used yet
+[[nodiscard]] VkDeviceSize deviceLocalBudget(
+    const std::vector<HeapBudget>& heaps);
+
+class MemoryBudget {
+public:
+  /// Shares of the total given to each category
+  static constexpr std::array<double, kMemoryCategories> kShares = {0.4, 0.15,
+                                                                    0.35, 0.1};
+
+  /// Splits `total` bytes between the categories by `kShares`
+  void setTotal(VkDeviceSize total);
+  void setLimit(MemoryCategory category, VkDeviceSize limit);
+
+  /// False when the category goes over its limit
+  bool charge(MemoryCategory category, VkDeviceSize bytes);
+  void release(MemoryCategory category, VkDeviceSize bytes);
+
+  [[nodiscard]] VkDeviceSize used(MemoryCategory category) const {
+    return m_used[index(category)];
+  }
+  [[nodiscard]] VkDeviceSize peak(MemoryCategory category) const {
+    return m_peak[index(category)];
+  }
+  [[nodiscard]] VkDeviceSize limit(MemoryCategory category) const {
+    return m_limit[index(category)];
+  }
+  /// Left under the limit
+  [[nodiscard]] VkDeviceSize available(MemoryCategory category) const;
+
+private:
+  static uint32_t index(MemoryCategory category) {
+    return static_cast<uint32_t>(category);
+  }
+
+  std::array<VkDeviceSize, kMemoryCategories> m_limit{};
+  std::array<VkDeviceSize, kMemoryCategories> m_used{};
+  std::array<VkDeviceSize, kMemoryCategories> m_peak{};
+};
+
+/// Resolution of the density grid along its longest axis, and one point out
+/// of `pointStride` kept
+struct VolumeLod {
+  int gridResolution;
+  uint32_t pointStride;
+};
+
+/// Smallest resolution the grid is lowered to before points are dropped
+constexpr int kMinGridResolution = 16;
+
+/// Upper bound of the device bytes of the volume at `lod`: the buffers of
+/// the points kept, and a cubic grid with its bricks
+[[nodiscard]] VkDeviceSize volumeBytes(uint32_t points,
+                                       VkDeviceSize bytesPerPoint,
+                                       const VolumeLod& lod);
+
+/// Finest level of detail holding in `available` bytes, the coarsest one
+/// when none does
+[[nodiscard]] VolumeLod chooseVolumeLod(uint32_t points,
+                                        VkDeviceSize bytesPerPoint,
+                                        int maxResolution,
+                                        VkDeviceSize available);
+
+void logMemoryBudget(const MemoryBudget& budget);
+
+/// Split and charges of the categories, the budget of heaps and the volume
+/// levels of detail under shrinking budgets
+[[nodiscard]] std::vector<ValidationCheck> validateMemoryBudget();
+
+#endif /* __VOLUME_RESTIR_UTILS_MEMORY_BUDGET_HPP__ */
@@ -0,0 +1,351 @@
+#include "utils/packing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "utils/parallel.hpp"
+#include "utils/rng.hpp"
+
+namespace {
+
+constexpr float kPi = 3.14159265358979323846f;
+
+uint32_t floatBitsToUint(float f) {
+  uint32_t u;
+  std::memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+float uintBitsToFloat(uint32_t u) {
+  float f;
+  std::memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+uint32_t floatToHalf(float f) {
+  const uint32_t bits = floatBitsToUint(f);
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  const uint32_t abs  = bits & 0x7FFFFFFFu;
+  if (abs >= 0x7F800000u) {  // inf and NaN
+    return sign | (abs > 0x7F800000u ? 0x7E00u : 0x7C00u);
+  }
+  if (abs >= 0x477FF000u) {  // rounds past 65504
+    return sign | 0x7C00u;
+  }
+  if (abs < 0x38800000u) {  // below 2^-14, denormal in half
+    return sign | static_cast<uint32_t>(
+                      std::nearbyint(uintBitsToFloat(abs) * 16777216.0f));
+  }
+  uint32_t half = ((((abs >> 23) - 112u) << 10) | ((abs >> 13) & 0x3FFu));
+  const uint32_t rest = abs & 0x1FFFu;
+  if (rest > 0x1000u || (rest == 0x1000u && (half & 1u) != 0)) {
+    ++half;
+  }
+  return sign | half;
+}
+
+float halfToFloat(uint32_t h) {
+  const uint32_t sign     = (h & 0x8000u) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1Fu;
+  const uint32_t mantissa = h & 0x3FFu;
+  if (exponent == 0) {
+    const float value = float(mantissa) / 16777216.0f;
+    return sign != 0 ? -value : value;
+  }
+  if (exponent == 31) {
+    return uintBitsToFloat(sign | 0x7F800000u | (mantissa << 13));
+  }
+  return uintBitsToFloat(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+}
+
+nvmath::vec2f signNotZero(const nvmath::vec2f& v) {
+  return nvmath::vec2f(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// keep in sync with reservoir.glsl
+constexpr uint32_t kLightIndexBits = 30;
+constexpr float kMaxHalf           = 65504.0f;
+
+}  // namespace
+
+uint32_t packUnorm4x8(const nvmath::vec4f& v) {
+  uint32_t result = 0;
+  for (int i = 0; i < 4; ++i) {
+    const float c = std::min(std::max(v[i], 0.0f), 1.0f);
+    result |= static_cast<uint32_t>(std::round(c * 255.0f)) << (8 * i);
+  }
+  return result;
+}
+
+nvmath::vec4f unpackUnorm4x8(uint32_t p) {
+  return nvmath::vec4f(float(p & 0xFFu), float((p >> 8) & 0xFFu),
+                       float((p >> 16) & 0xFFu), float(p >> 24)) /
+         255.0f;
+}
+
+uint32_t packSnorm2x16(const nvmath::vec2f& v) {
+  uint32_t result = 0;
+  for (int i = 0; i < 2; ++i) {
+    const float c = std::min(std::max(v[i], -1.0f), 1.0f);
+    const auto q  = static_cast<int16_t>(std::round(c * 32767.0f));
+    result |= uint32_t(uint16_t(q)) << (16 * i);
+  }
+  return result;
+}
+
+nvmath::vec2f unpackSnorm2x16(uint32_t p) {
+  const auto x = static_cast<int16_t>(p & 0xFFFFu);
+  const auto y = static_cast<int16_t>(p >> 16);
+  return nvmath::vec2f(std::max(x / 32767.0f, -1.0f),
+                       std::max(y / 32767.0f, -1.0f));
+}
+
+uint32_t packHalf2x16(const nvmath::vec2f& v) {
+  return floatToHalf(v.x) | (floatToHalf(v.y) << 16);
+}
+
+nvmath::vec2f unpackHalf2x16(uint32_t p) {
+  return nvmath::vec2f(halfToFloat(p & 0xFFFFu), halfToFloat(p >> 16));
+}
+
+nvmath::vec2f encodeOctahedral(const nvmath::vec3f& n) {
+  const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  if (l1 == 0.0f) {
+    return nvmath::vec2f(0.0f, 0.0f);
+  }
+  const nvmath::vec3f p = n / l1;
+  if (p.z >= 0.0f) {
+    return nvmath::vec2f(p.x, p.y);
+  }
+  const nvmath::vec2f s = signNotZero(nvmath::vec2f(p.x, p.y));
+  return nvmath::vec2f((1.0f - std::abs(p.y)) * s.x,
+                       (1.0f - std::abs(p.x)) * s.y);
+}
+
+nvmath::vec3f decodeOctahedral(const nvmath::vec2f& e) {
+  nvmath::vec3f n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+  if (n.z < 0.0f) {
+    const nvmath::vec2f s = signNotZero(e);
+    n.x = (1.0f - std::abs(e.y)) * s.x;
+    n.y = (1.0f - std::abs(e.x)) * s.y;
+  }
+  return nvmath::normalize(n);
+}
+
+nvmath::vec3f cameraRayDirection(const nvmath::vec2i& pixel,
+                                 const nvmath::vec2ui& screenSize,
+                                 const nvmath::mat4f& viewInverse,
+                                 const nvmath::mat4f& projectionInverse) {
+  const float dx = float(pixel.x) / screenSize.x * 2.0f - 1.0f;
+  const float dy = float(pixel.y) / screenSize.y * 2.0f - 1.0f;
+  const nvmath::vec4f target =
+      projectionInverse * nvmath::vec4f(dx, dy, 1.0f, 1.0f);
+  return nvmath::vec3f(
+      viewInverse *
+      nvmath::vec4f(nvmath::normalize(nvmath::vec3f(target)), 0.0f));
+}
+
+nvmath::vec4ui packGBuffer(const GBufferSample& sample) {
+  return nvmath::vec4ui(
+      floatBitsToUint(sample.depth),
+      packSnorm2x16(encodeOctahedral(sample.normal)),
+      packUnorm4x8(sample.albedo),
+      packUnorm4x8(nvmath::vec4f(sample.roughness, sample.metallic,
+                                 sample.inMedium ? 1.0f : 0.0f,
+                                 sample.anisotropy * 0.5f + 0.5f)));
+}
+
+GBufferSample unpackGBuffer(const nvmath::vec4ui& texel) {
+  GBufferSample sample;
+  sample.depth  = uintBitsToFloat(texel.x);
+  sample.normal = decodeOctahedral(unpackSnorm2x16(texel.y));
+  sample.albedo = unpackUnorm4x8(texel.z);
+  const nvmath::vec4f material = unpackUnorm4x8(texel.w);
+  sample.roughness             = material.x;
+  sample.metallic              = material.y;
+  sample.inMedium              = material.z > 0.5f;
+  sample.anisotropy            = material.w * 2.0f - 1.0f;
+  return sample;
+}
+
+nvmath::vec4ui packReservoir(const HostReservoir& res) {
+  const uint32_t kind = uint32_t(res.lightKind) << kLightIndexBits;
+  const uint32_t pHat =
+      packHalf2x16(nvmath::vec2f(std::min(res.pHat, kMaxHalf), 0.0f));
+  return nvmath::vec4ui(res.lightIndex | kind, res.sampleSeed,
+                        floatBitsToUint(res.w),
+                        std::min(res.numStreamSamples, 0xFFFFu) | (pHat << 16));
+}
+
+HostReservoir unpackReservoir(const nvmath::vec4ui& texel) {
+  HostReservoir res;
+  res.lightIndex       = texel.x & ((1u << kLightIndexBits) - 1u);
+  res.lightKind        = int32_t(texel.x >> kLightIndexBits);
+  res.sampleSeed       = texel.y;
+  res.w                = uintBitsToFloat(texel.z);
+  res.numStreamSamples = texel.w & 0xFFFFu;
+  res.pHat             = unpackHalf2x16(texel.w >> 16).x;
+  if (res.pHat == 0.0f) {
+    res.w = 0.0f;
+  }
+  res.sumWeights = res.pHat * res.w * float(res.numStreamSamples);
+  return res;
+}
+
+PackingRoundTripResult measurePackingRoundTrip(uint32_t numSamples,
+                                               uint32_t seed) {
+  const nvmath::vec2ui screenSize(1920, 1080);
+  const nvmath::mat4f proj = nvmath::perspectiveVK(
+      45.0f, float(screenSize.x) / screenSize.y, 0.1f, 1000.0f);
+
+  struct Errors {
+    float normal = 0.0f, albedo = 0.0f, material = 0.0f, worldPos = 0.0f,
+          pHat = 0.0f;
+    uint32_t reservoirMismatches = 0;
+  };
+  const size_t numBatches = (numSamples + 4095) / 4096;
+  std::vector<Errors> batchErrors(numBatches);
+
+  parallelBatches(
+      numBatches,
+      [&](size_t begin, size_t end) {
+        float u[32];
+        for (size_t batch = begin; batch < end; ++batch) {
+          Errors& errors = batchErrors[batch];
+          const uint32_t key = hostRngKey(seed, uint32_t(batch));
+          const uint32_t first = uint32_t(batch) * 4096;
+          const uint32_t last  = std::min(first + 4096, numSamples);
+          for (uint32_t i = first; i < last; ++i) {
+            generateUniformFloats(key, 32 * (i - first), u, 32);
+
+            // camera and a hit along the primary ray of a random pixel
+            const nvmath::vec3f eye(100.0f * u[0] - 50.0f, 100.0f * u[1],
+                                    100.0f * u[2] - 50.0f);
+            const nvmath::vec3f center(20.0f * u[3] - 10.0f, 0.0f,
+                                       20.0f * u[4] - 10.0f);
+            const nvmath::mat4f view = nvmath::look_at(
+                eye, center, nvmath::vec3f(0.0f, 1.0f, 0.0f));
+            const nvmath::mat4f viewInverse = nvmath::invert(view);
+            const nvmath::mat4f projInverse = nvmath::invert(proj);
+            const nvmath::vec2i pixel(int(u[5] * screenSize.x),
+                                      int(u[6] * screenSize.y));
+            const nvmath::vec3f origin(viewInverse *
+                                       nvmath::vec4f(0.0f, 0.0f, 0.0f, 1.0f));
+            const nvmath::vec3f dir =
+                cameraRayDirection(pixel, screenSize, viewInverse, projInverse);
+            const float t = 0.5f + 500.0f * u[7];
+            const nvmath::vec3f hit = origin + t * dir;
+
+            // a random surface
+            const float cosTheta = 2.0f * u[8] - 1.0f;
+            const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+            const float phi      = 2.0f * kPi * u[9];
+            GBufferSample sample;
+            sample.depth  = nvmath::length(hit - origin);
+            sample.normal = nvmath::vec3f(sinTheta * std::cos(phi),
+                                          sinTheta * std::sin(phi), cosTheta);
+            sample.albedo     = nvmath::vec4f(u[10], u[11], u[12], u[13]);
+            sample.roughness  = u[14];
+            sample.metallic   = u[15];
+            sample.inMedium   = u[22] < 0.5f;
+            sample.anisotropy = 2.0f * u[23] - 1.0f;
+
+            const GBufferSample decoded = unpackGBuffer(packGBuffer(sample));
+            const float cosError = std::min(
+                nvmath::dot(decoded.normal, sample.normal), 1.0f);
+            errors.normal =
+                std::max(errors.normal, std::acos(cosError) * 180.0f / kPi);
+            for (int c = 0; c < 4; ++c) {
+              errors.albedo = std::max(
+                  errors.albedo, std::abs(decoded.albedo[c] - sample.albedo[c]));
+            }
+            errors.material =
+                std::max({errors.material,
+                          std::abs(decoded.roughness - sample.roughness),
+                          std::abs(decoded.metallic - sample.metallic),
+                          std::abs(decoded.anisotropy - sample.anisotropy) *
+                              0.5f});
+            if (decoded.inMedium != sample.inMedium) {
+              errors.material = 1.0f;
+            }
+            const nvmath::vec3f worldPos =
+                origin + decoded.depth * cameraRayDirection(
+                                             pixel, screenSize, viewInverse,
+                                             projInverse);
+            errors.worldPos = std::max(
+                errors.worldPos, nvmath::length(worldPos - hit) / t);
+
+            // reservoir with weights spread over many orders of magnitude
+            HostReservoir res;
+            res.lightIndex       = uint32_t(u[16] * float(1u << 30));
+            res.lightKind        = int32_t(u[17] * 3.0f);
+            res.sampleSeed       = floatBitsToUint(u[18]);
+            res.numStreamSamples = 1 + uint32_t(u[19] * 65534.0f);
+            res.pHat             = std::pow(10.0f, 8.0f * u[20] - 4.0f);
+            res.w                = std::pow(10.0f, 12.0f * u[21] - 6.0f);
+            res.pHat             = std::min(res.pHat, kMaxHalf);
+
+            const HostReservoir unpacked = unpackReservoir(packReservoir(res));
+            errors.reservoirMismatches +=
+                unpacked.lightIndex != res.lightIndex ||
+                unpacked.lightKind != res.lightKind ||
+                unpacked.sampleSeed != res.sampleSeed ||
+                unpacked.numStreamSamples != res.numStreamSamples ||
+                unpacked.w != res.w;
+            errors.pHat = std::max(
+                errors.pHat, std::abs(unpacked.pHat - res.pHat) / res.pHat);
+          }
+        }
+      },
+      1);
+
+  PackingRoundTripResult result{};
+  for (const Errors& errors : batchErrors) {
+    result.maxNormalErrorDegrees =
+        std::max(result.maxNormalErrorDegrees, errors.normal);
+    result.maxAlbedoError   = std::max(result.maxAlbedoError, errors.albedo);
+    result.maxMaterialError = std::max(result.maxMaterialError, errors.material);
+    result.maxWorldPosRelativeError =
+        std::max(result.maxWorldPosRelativeError, errors.worldPos);
+    result.maxPHatRelativeError =
+        std::max(result.maxPHatRelativeError, errors.pHat);
+    result.reservoirMismatches += errors.reservoirMismatches;
+  }
+  return result;
+}
+
+std::vector<ValidationCheck> validatePacking(uint32_t numSamples,
+                                             uint32_t seed) {
+  const PackingRoundTripResult result =
+      measurePackingRoundTrip(numSamples, seed);
+  spdlog::debug("GBuffer: normal {:.5f} deg, albedo {:.5f}, material {:.5f}, "
+                "world position {:.2e} (relative to depth)",
+                result.maxNormalErrorDegrees, result.maxAlbedoError,
+                result.maxMaterialError, result.maxWorldPosRelativeError);
+  spdlog::debug("Reservoir: pHat {:.2e} (relative), {} mismatches",
+                result.maxPHatRelativeError, result.reservoirMismatches);
+
+  // the 8-bit bound carries a little slack for the float rounding of the
+  // decode, which lands a few ulps above 1/510
+  const float unormTolerance = 1.0f / 510.0f * (1.0f + 1e-4f);
+  const auto check = [](const char* scenario, float error, float tolerance) {
+    const std::string expected = fmt::format("within {:g}", tolerance);
+    return ValidationCheck{scenario, expected,
+                           error <= tolerance
+                               ? expected
+                               : fmt::format("off by {:g}", error)};
+  };
+  return {
+      check("GBuffer normal (degrees)", result.maxNormalErrorDegrees, 0.1f),
+      check("GBuffer albedo", result.maxAlbedoError, unormTolerance),
+      check("GBuffer material", result.maxMaterialError, unormTolerance),
+      check("GBuffer world position (relative to depth)",
+            result.maxWorldPosRelativeError, 1e-5f),
+      check("reservoir pHat (relative)", result.maxPHatRelativeError, 1e-3f),
+      {"reservoir fields", "0 mismatches",
+       fmt::format("{} mismatches", result.reservoirMismatches)},
+  };
+}
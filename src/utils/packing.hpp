@@ -0,0 +1,71 @@
+#ifndef __VOLUME_RESTIR_UTILS_PACKING_HPP__
+#define __VOLUME_RESTIR_UTILS_PACKING_HPP__
+
+/**
+ * @file packing.hpp
+ *
+ * @brief Host mirror of the 16-byte GBuffer (`shaders/headers/gbuffer.glsl`)
+ * and reservoir (`shaders/headers/reservoir.glsl`) encodings, with the GLSL
+ * pack/unpack built-ins they rely on.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "utils/reservoir.hpp"
+#include "utils/validation.hpp"
+
+// GLSL built-ins, with round-to-nearest where the spec leaves it open
+[[nodiscard]] uint32_t packUnorm4x8(const nvmath::vec4f& v);
+[[nodiscard]] nvmath::vec4f unpackUnorm4x8(uint32_t p);
+[[nodiscard]] uint32_t packSnorm2x16(const nvmath::vec2f& v);
+[[nodiscard]] nvmath::vec2f unpackSnorm2x16(uint32_t p);
+[[nodiscard]] uint32_t packHalf2x16(const nvmath::vec2f& v);
+[[nodiscard]] nvmath::vec2f unpackHalf2x16(uint32_t p);
+
+[[nodiscard]] nvmath::vec2f encodeOctahedral(const nvmath::vec3f& n);
+[[nodiscard]] nvmath::vec3f decodeOctahedral(const nvmath::vec2f& e);
+
+/// Direction of the primary ray through `pixel`, as traced by `restir.rgen`
+[[nodiscard]] nvmath::vec3f cameraRayDirection(
+    const nvmath::vec2i& pixel, const nvmath::vec2ui& screenSize,
+    const nvmath::mat4f& viewInverse, const nvmath::mat4f& projectionInverse);
+
+struct GBufferSample {
+  float depth = 0.0f;  // distance along the primary ray, 0 without geometry
+  nvmath::vec3f normal;
+  nvmath::vec4f albedo;
+  float roughness = 0.0f;
+  float metallic  = 0.0f;
+  bool inMedium    = false;  // scatter point of RESTIR_VOLUME_FLAG
+  float anisotropy = 0.0f;   // Henyey-Greenstein g, in [-1, 1]
+};
+
+[[nodiscard]] nvmath::vec4ui packGBuffer(const GBufferSample& sample);
+[[nodiscard]] GBufferSample unpackGBuffer(const nvmath::vec4ui& texel);
+
+[[nodiscard]] nvmath::vec4ui packReservoir(const HostReservoir& res);
+[[nodiscard]] HostReservoir unpackReservoir(const nvmath::vec4ui& texel);
+
+struct PackingRoundTripResult {
+  float maxNormalErrorDegrees;
+  float maxAlbedoError;
+  float maxMaterialError;
+  float maxWorldPosRelativeError;  // through depth and the camera ray
+  float maxPHatRelativeError;
+  uint32_t reservoirMismatches;  // index, kind, seed, M or w changed
+};
+
+/// Packs and unpacks random GBuffer texels and reservoirs
+[[nodiscard]] PackingRoundTripResult measurePackingRoundTrip(
+    uint32_t numSamples = 1 << 20, uint32_t seed = 0);
+
+/// Bounds every error of measurePackingRoundTrip by what its encoding allows:
+/// half a step of the 8-bit channels, 1e-5 of the depth for the position and
+/// the relative precision of a half float for pHat
+[[nodiscard]] std::vector<ValidationCheck> validatePacking(
+    uint32_t numSamples = 1 << 20, uint32_t seed = 0);
+
+#endif /* __VOLUME_RESTIR_UTILS_PACKING_HPP__ */
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Runs `fn(begin, end)` over contiguous batches of [0, count) on all
+ * hardware threads. Small workloads run inline on the calling thread.
+ */
+template <typename BatchFn>
+void parallelBatches(size_t count, BatchFn&& fn, size_t minBatchSize = 256) {
+  if (count == 0) {
+    return;
+  }
+  minBatchSize      = std::max<size_t>(1, minBatchSize);
+  size_t numThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, (count + minBatchSize - 1) / minBatchSize);
+  if (numThreads <= 1) {
+    fn(size_t(0), count);
+    return;
+  }
+
+  const size_t batchSize = (count + numThreads - 1) / numThreads;
+  std::vector<std::thread> workers;
+  workers.reserve(numThreads - 1);
+  for (size_t t = 1; t < numThreads; ++t) {
+    const size_t begin = t * batchSize;
+    const size_t end   = std::min(count, begin + batchSize);
+    if (begin >= end) {
+      break;
+    }
+    workers.emplace_back([&fn, begin, end]() { fn(begin, end); });
+  }
+  fn(size_t(0), std::min(count, batchSize));
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
@@ -0,0 +1,147 @@
+#include "utils/phase.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "spdlog/spdlog.h"
+#include "utils/parallel.hpp"
+#include "utils/rng.hpp"
+
+namespace {
+
+// midpoint steps in cosTheta of the integrals
+constexpr uint32_t kIntegrationSteps = 1 << 20;
+
+const char* phaseName(int model) {
+  switch (model) {
+    case PHASE_DOUBLE_HENYEY_GREENSTEIN:
+      return "double HG";
+    case PHASE_DRAINE:
+      return "Draine";
+  }
+  return "HG";
+}
+
+nvmath::vec3f uniformDirection(float u0, float u1) {
+  const float z   = 1.0f - 2.0f * u0;
+  const float r   = std::sqrt(std::max(0.0f, 1.0f - z * z));
+  const float phi = 6.28318530718f * u1;
+  return nvmath::vec3f(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+}  // namespace
+
+std::vector<PhaseValidationResult> validatePhase(uint32_t numSamples,
+                                                 uint32_t seed) {
+  using shader::PhaseFunction;
+  const std::vector<PhaseFunction> phases = {
+      {PHASE_HENYEY_GREENSTEIN, -0.7f, 0.0f, 1.0f, 0.0f},
+      {PHASE_HENYEY_GREENSTEIN, 0.0f, 0.0f, 1.0f, 0.0f},
+      {PHASE_HENYEY_GREENSTEIN, 0.3f, 0.0f, 1.0f, 0.0f},
+      {PHASE_HENYEY_GREENSTEIN, 0.9f, 0.0f, 1.0f, 0.0f},
+      {PHASE_DOUBLE_HENYEY_GREENSTEIN, 0.8f, -0.4f, 0.7f, 0.0f},
+      {PHASE_DOUBLE_HENYEY_GREENSTEIN, 0.95f, -0.2f, 0.2f, 0.0f},
+      {PHASE_DRAINE, 0.0f, 0.0f, 1.0f, 1.0f},
+      {PHASE_DRAINE, 0.05f, 0.0f, 1.0f, 2.0f},
+      {PHASE_DRAINE, 0.5f, 0.0f, 1.0f, 1.0f},
+      {PHASE_DRAINE, -0.8f, 0.0f, 1.0f, 0.5f},
+      // fog fit of Jendersie and d'Eon for 10 um droplets
+      {PHASE_DRAINE, 0.95f, 0.0f, 1.0f, 150.0f},
+  };
+
+  std::vector<PhaseValidationResult> results;
+  std::vector<double> cdf(kIntegrationSteps + 1);
+  std::vector<float> cosines(numSamples);
+  for (const PhaseFunction& phase : phases) {
+    PhaseValidationResult result;
+    result.phase = phase;
+
+    // integrals over the sphere, 2 pi times those over cosTheta
+    const double step = 2.0 / kIntegrationSteps;
+    double luminance = 0.0, meanCosine = 0.0;
+    cdf[0] = 0.0;
+    for (uint32_t i = 0; i < kIntegrationSteps; ++i) {
+      const float cosTheta = float(-1.0 + (i + 0.5) * step);
+      const double weight  = 6.283185307179586 * step;
+      const double p       = weight * shader::phaseEval(phase, cosTheta);
+      cdf[i + 1]           = cdf[i] + p;
+      meanCosine += p * cosTheta;
+      luminance += weight * shader::phaseLuminance(phase, cosTheta, 1.0f);
+    }
+    result.integral          = float(cdf[kIntegrationSteps]);
+    result.luminanceIntegral = float(luminance);
+    result.meanCosine        = float(meanCosine / cdf[kIntegrationSteps]);
+
+    const uint32_t key = hostRngKey(seed, uint32_t(results.size()) + 1);
+    std::vector<float> normErrors(numSamples);
+    parallelBatches(numSamples, [&](size_t begin, size_t end) {
+      for (size_t s = begin; s < end; ++s) {
+        float u[4];
+        generateUniformFloats(key, 4 * uint32_t(s), u, 4);
+        const nvmath::vec3f wo = uniformDirection(u[0], u[1]);
+        const nvmath::vec3f wi =
+            shader::phaseSample(phase, wo, nvmath::vec2f(u[2], u[3]));
+        cosines[s]    = std::clamp(nvmath::dot(wo, wi), -1.0f, 1.0f);
+        normErrors[s] = std::abs(nvmath::length(wi) - 1.0f);
+      }
+    });
+
+    double sum = 0.0, sumSquares = 0.0;
+    for (float c : cosines) {
+      sum += c;
+      sumSquares += double(c) * c;
+    }
+    const double mean        = sum / numSamples;
+    result.sampledMeanCosine = float(mean);
+    result.standardError     = float(
+        std::sqrt(std::max(0.0, sumSquares / numSamples - mean * mean) /
+                  numSamples));
+    result.maxNormError =
+        *std::max_element(normErrors.begin(), normErrors.end());
+
+    std::sort(cosines.begin(), cosines.end());
+    double ks = 0.0;
+    for (uint32_t s = 0; s < numSamples; ++s) {
+      const double x = (double(cosines[s]) + 1.0) / step;
+      const size_t i = std::min(size_t(x), size_t(kIntegrationSteps) - 1);
+      const double f =
+          (cdf[i] + (x - double(i)) * (cdf[i + 1] - cdf[i])) /
+          cdf[kIntegrationSteps];
+      ks = std::max({ks, std::abs(f - double(s) / numSamples),
+                     std::abs(f - double(s + 1) / numSamples)});
+    }
+    result.ksDistance  = float(ks);
+    result.ksThreshold = 1.95f / std::sqrt(float(numSamples));
+    results.push_back(result);
+  }
+  return results;
+}
+
+bool isPhaseValid(const std::vector<PhaseValidationResult>& results) {
+  return std::all_of(
+      results.begin(), results.end(),
+      [](const PhaseValidationResult& result) {
+        return std::abs(result.integral - 1.0f) < 1e-3f &&
+               std::abs(result.luminanceIntegral - 1.0f) < 5e-2f &&
+               std::abs(result.sampledMeanCosine - result.meanCosine) <=
+                   4.0f * result.standardError &&
+               result.ksDistance < result.ksThreshold &&
+               result.maxNormError < 1e-4f;
+      });
+}
+
+void logPhase(const std::vector<PhaseValidationResult>& results) {
+  spdlog::info(
+      "{:>10} {:>6} {:>6} {:>5} {:>6} {:>9} {:>9} {:>8} {:>8} {:>7} {:>7}",
+      "phase", "g", "g2", "blend", "alpha", "integral", "luminance",
+      "mean cos", "sampled", "KS", "KS max");
+  for (const PhaseValidationResult& result : results) {
+    spdlog::info(
+        "{:>10} {:>6.2f} {:>6.2f} {:>5.2f} {:>6.1f} {:>9.6f} {:>9.6f} "
+        "{:>8.4f} {:>8.4f} {:>7.4f} {:>7.4f}",
+        phaseName(result.phase.model), result.phase.g, result.phase.g2,
+        result.phase.blend, result.phase.alpha, result.integral,
+        result.luminanceIntegral, result.meanCosine, result.sampledMeanCosine,
+        result.ksDistance, result.ksThreshold);
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef __VOLUME_RESTIR_UTILS_PHASE_HPP__
+#define __VOLUME_RESTIR_UTILS_PHASE_HPP__
+
+/**
+ * @file phase.hpp
+ *
+ * @brief Host checks of the phase functions of `shaders/headers/phase.glsl`,
+ * which the host calls through `utils/shader_functions.hpp`.
+ *
+ *  `validatePhase` integrates every phase function and its luminance fast
+ *  path over the sphere, and draws directions with `phaseSample` to compare
+ *  their distribution (Kolmogorov-Smirnov distance of the cosines) and mean
+ *  cosine with the ones integrated from `phasePdf`.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "utils/shader_functions.hpp"
+
+struct PhaseValidationResult {
+  shader::PhaseFunction phase;
+  float integral;           // of phaseEval over the sphere
+  float luminanceIntegral;  // of phaseLuminance with a unit albedo
+  float meanCosine;         // of cosTheta, integrated
+  float sampledMeanCosine;  // of the phaseSample directions
+  float standardError;      // of sampledMeanCosine
+  float ksDistance;         // between the sampled and integrated cosines
+  float ksThreshold;        // at a 0.1% significance level
+  float maxNormError;       // of the sampled directions
+};
+
+[[nodiscard]] std::vector<PhaseValidationResult> validatePhase(
+    uint32_t numSamples = 1 << 16, uint32_t seed = 0);
+
+/// False if an integral is off 1, or the samples do not follow the pdf
+[[nodiscard]] bool isPhaseValid(
+    const std::vector<PhaseValidationResult>& results);
+
+void logPhase(const std::vector<PhaseValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_PHASE_HPP__ */
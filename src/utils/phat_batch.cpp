@@ -0,0 +1,230 @@
+#include "utils/phat_batch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/cpu_features.hpp"
+#include "spdlog/spdlog.h"
+#include "utils/phat_lanes.hpp"
+#include "utils/rng.hpp"
+#include "utils/shader_functions.hpp"
+
+namespace {
+
+PHatShadingConstants makeShadingConstants(const PHatShadingPoint& p) {
+  nvmath::vec3f wo = p.camPos - p.worldPos;
+  wo /= std::sqrt(nvmath::dot(wo, wo));
+
+  PHatShadingConstants c;
+  c.woX = wo.x;
+  c.woY = wo.y;
+  c.woZ = wo.z;
+
+  const float cosOut = nvmath::dot(p.normal, wo);
+  const float m      = std::min(std::max(1.0f - cosOut, 0.0f), 1.0f);
+  c.fresnelOut       = m * m * m * m * m;
+
+  const float a = std::max(0.001f, std::pow(p.roughness, 2.0f));
+  c.alpha2      = a * a;
+  const float b = cosOut * cosOut;
+  c.smithOut    = 1.0f / (std::abs(cosOut) +
+                       std::max(std::sqrt(c.alpha2 + b - c.alpha2 * b),
+                                0.0001f));
+  c.specularLum = 0.04f * (1.0f - p.metallic) + p.albedoLum * p.metallic;
+  return c;
+}
+
+struct ScalarLanes {
+  using F = float;
+  static F set1(float v) { return v; }
+  static F load(const float* p) { return *p; }
+  static F add(F a, F b) { return a + b; }
+  static F sub(F a, F b) { return a - b; }
+  static F mul(F a, F b) { return a * b; }
+  static F div(F a, F b) { return a / b; }
+  static F sqrt(F a) { return std::sqrt(a); }
+  static F min(F a, F b) { return std::min(a, b); }
+  static F max(F a, F b) { return std::max(a, b); }
+  static F abs(F a) { return std::abs(a); }
+  // GLSL's `if (x < 0.0f) return 0.0f;`, which lets NaN through
+  static F keepIfNonNegative(F x, F v) { return x < 0.0f ? 0.0f : v; }
+};
+
+// The widest kernel the build compiles and the CPU runs, chosen once
+PHatLanesPath selectBatchPath() {
+  const PHatLanesPath avx512 = pHatAvx512Path();
+  if (avx512.kernel != nullptr && cpuSupportsAvx512f()) {
+    return avx512;
+  }
+  const PHatLanesPath avx2 = pHatAvx2Path();
+  if (avx2.kernel != nullptr && cpuSupportsAvx2()) {
+    return avx2;
+  }
+  return {1, nullptr};
+}
+
+const PHatLanesPath& batchPath() {
+  static const PHatLanesPath path = selectBatchPath();
+  return path;
+}
+
+}  // namespace
+
+size_t pHatBatchWidth() { return batchPath().width; }
+
+PointLightsSoA toPointLightsSoA(const std::vector<PointLight>& lights) {
+  PointLightsSoA result;
+  result.posX.reserve(lights.size());
+  result.posY.reserve(lights.size());
+  result.posZ.reserve(lights.size());
+  result.emissionLum.reserve(lights.size());
+  for (const PointLight& light : lights) {
+    result.posX.push_back(light.pos.x);
+    result.posY.push_back(light.pos.y);
+    result.posZ.push_back(light.pos.z);
+    result.emissionLum.push_back(light.emission_luminance.w);
+  }
+  return result;
+}
+
+float evaluatePointLightPHat(const PHatShadingPoint& point,
+                             const nvmath::vec3f& lightPos,
+                             float emissionLum) {
+  nvmath::vec3f wi = lightPos - point.worldPos;
+  if (nvmath::dot(wi, point.normal) < 0.0f) {
+    return 0.0f;
+  }
+
+  const float sqrDist    = nvmath::dot(wi, wi);
+  wi                    /= std::sqrt(sqrDist);
+  const nvmath::vec3f wo = nvmath::normalize(point.camPos - point.worldPos);
+
+  const float cosIn           = nvmath::dot(point.normal, wi);
+  const float cosOut          = nvmath::dot(point.normal, wo);
+  const nvmath::vec3f halfVec = nvmath::normalize(wi + wo);
+  const float cosHalf         = nvmath::dot(point.normal, halfVec);
+  const float cosInHalf       = nvmath::dot(wi, halfVec);
+
+  const float geometry = cosIn / sqrDist;
+
+  return emissionLum *
+         shader::disneyBrdfLuminance(cosIn, cosOut, cosHalf, cosInHalf,
+                                     point.albedoLum, point.roughness,
+                                     point.metallic) *
+         geometry;
+}
+
+void evaluatePointLightPHatBatch(const PHatShadingPoint& point,
+                                 const PointLightsSoA& lights, float* out) {
+  const PHatShadingConstants constants = makeShadingConstants(point);
+  const PHatLanesPath& path            = batchPath();
+  const size_t count                   = lights.size();
+
+  size_t i = 0;
+  if (path.kernel != nullptr) {
+    i = count - count % path.width;
+    path.kernel(point, constants, lights.posX.data(), lights.posY.data(),
+                lights.posZ.data(), lights.emissionLum.data(), i, out);
+  }
+  for (; i < count; ++i) {
+    out[i] = evaluatePHatLanes<ScalarLanes>(
+        point, constants, lights.posX.data() + i, lights.posY.data() + i,
+        lights.posZ.data() + i, lights.emissionLum.data() + i);
+  }
+}
+
+namespace {
+
+// Largest deviation of the batch from the scalar reference, relative to the
+// reference or, for the values that cancel out near the horizon, to a
+// millionth of the largest one
+float maxBatchDeviation(const PHatShadingPoint& point,
+                        const PointLightsSoA& lights) {
+  std::vector<float> batch(lights.size()), reference(lights.size());
+  evaluatePointLightPHatBatch(point, lights, batch.data());
+  float peak = 0.0f;
+  for (size_t i = 0; i < lights.size(); ++i) {
+    reference[i] = evaluatePointLightPHat(
+        point,
+        nvmath::vec3f(lights.posX[i], lights.posY[i], lights.posZ[i]),
+        lights.emissionLum[i]);
+    peak = std::max(peak, std::abs(reference[i]));
+  }
+  float deviation = 0.0f;
+  for (size_t i = 0; i < lights.size(); ++i) {
+    deviation = std::max(deviation,
+                         std::abs(batch[i] - reference[i]) /
+                             std::max(std::abs(reference[i]), 1e-6f * peak));
+  }
+  return deviation;
+}
+
+// `count` lights of random luminance at `center` + `extent` * [-1, 1]^3
+PointLightsSoA randomLights(const nvmath::vec3f& center,
+                            const nvmath::vec3f& extent, uint32_t count,
+                            uint32_t stream) {
+  std::vector<float> r(4 * size_t(count));
+  generateUniformFloats(hostRngKey(28, stream), 0, r.data(), r.size());
+  PointLightsSoA lights;
+  for (uint32_t i = 0; i < count; ++i) {
+    const float* u = &r[4 * size_t(i)];
+    lights.posX.push_back(center.x + extent.x * (2.0f * u[0] - 1.0f));
+    lights.posY.push_back(center.y + extent.y * (2.0f * u[1] - 1.0f));
+    lights.posZ.push_back(center.z + extent.z * (2.0f * u[2] - 1.0f));
+    lights.emissionLum.push_back(0.1f + 10.0f * u[3]);
+  }
+  return lights;
+}
+
+}  // namespace
+
+std::vector<ValidationCheck> validatePHatBatch(uint32_t numLights) {
+  struct Scenario {
+    const char* name;
+    nvmath::vec3f lightCenter;
+    nvmath::vec3f lightExtent;
+    float roughness;
+    float metallic;
+    float tolerance;
+  };
+  // The shading point sits at the origin, facing up; a count that is not a
+  // multiple of the width also runs the scalar tail. GTR2 scales the rounding
+  // of cosHalf by up to 1 / a^2 = roughness^-4, so the float kernel and the
+  // reference, whose literals are doubles on the host, round further apart on
+  // the peak of smooth surfaces.
+  const Scenario scenarios[] = {
+      {"rough dielectric", {0.0f, 5.0f, 0.0f}, {10.0f, 5.0f, 10.0f}, 0.8f,
+       0.0f, 1e-3f},
+      {"glossy", {0.0f, 5.0f, 0.0f}, {10.0f, 5.0f, 10.0f}, 0.3f, 0.5f, 1e-3f},
+      {"smooth metal", {0.0f, 5.0f, 0.0f}, {10.0f, 5.0f, 10.0f}, 0.1f, 1.0f,
+       1e-2f},
+      {"mirror", {0.0f, 5.0f, 0.0f}, {10.0f, 5.0f, 10.0f}, 0.0f, 1.0f,
+       5e-2f},
+      {"grazing", {0.0f, 0.01f, 0.0f}, {10.0f, 0.01f, 10.0f}, 0.5f, 0.0f,
+       1e-3f},
+      {"behind", {0.0f, -5.0f, 0.0f}, {10.0f, 4.0f, 10.0f}, 0.5f, 0.0f, 0.0f},
+  };
+
+  std::vector<ValidationCheck> results;
+  uint32_t stream = 0;
+  for (const Scenario& scenario : scenarios) {
+    const PHatShadingPoint point{{0.0f, 0.0f, 0.0f},
+                                 {0.0f, 1.0f, 0.0f},
+                                 {3.0f, 4.0f, 12.0f},
+                                 0.7f,
+                                 scenario.roughness,
+                                 scenario.metallic};
+    const float deviation = maxBatchDeviation(
+        point, randomLights(scenario.lightCenter, scenario.lightExtent,
+                            numLights, stream++));
+    spdlog::debug("{}: largest deviation {:g}", scenario.name, deviation);
+
+    const std::string expected =
+        fmt::format("within {:g}", scenario.tolerance);
+    results.push_back({scenario.name, expected,
+                       deviation <= scenario.tolerance
+                           ? expected
+                           : fmt::format("off by {:g}", deviation)});
+  }
+  return results;
+}
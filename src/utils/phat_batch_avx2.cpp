@@ -0,0 +1,44 @@
+#include "utils/phat_lanes.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Lanes {
+  using F = __m256;
+  static F set1(float v) { return _mm256_set1_ps(v); }
+  static F load(const float* p) { return _mm256_loadu_ps(p); }
+  static F add(F a, F b) { return _mm256_add_ps(a, b); }
+  static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+  static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+  static F div(F a, F b) { return _mm256_div_ps(a, b); }
+  static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+  static F min(F a, F b) { return _mm256_min_ps(a, b); }
+  static F max(F a, F b) { return _mm256_max_ps(a, b); }
+  static F abs(F a) {
+    return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)));
+  }
+  static F keepIfNonNegative(F x, F v) {
+    return _mm256_andnot_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ),
+                            v);
+  }
+};
+
+void evaluateAvx2(const PHatShadingPoint& point,
+                  const PHatShadingConstants& constants, const float* posX,
+                  const float* posY, const float* posZ,
+                  const float* emissionLum, size_t count, float* out) {
+  for (size_t i = 0; i < count; i += 8) {
+    _mm256_storeu_ps(out + i, evaluatePHatLanes<Avx2Lanes>(
+                                  point, constants, posX + i, posY + i,
+                                  posZ + i, emissionLum + i));
+  }
+}
+
+}  // namespace
+
+PHatLanesPath pHatAvx2Path() { return {8, evaluateAvx2}; }
+#else
+PHatLanesPath pHatAvx2Path() { return {8, nullptr}; }
+#endif
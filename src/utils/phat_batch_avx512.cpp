@@ -0,0 +1,42 @@
+#include "utils/phat_lanes.hpp"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512Lanes {
+  using F = __m512;
+  static F set1(float v) { return _mm512_set1_ps(v); }
+  static F load(const float* p) { return _mm512_loadu_ps(p); }
+  static F add(F a, F b) { return _mm512_add_ps(a, b); }
+  static F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+  static F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+  static F div(F a, F b) { return _mm512_div_ps(a, b); }
+  static F sqrt(F a) { return _mm512_sqrt_ps(a); }
+  static F min(F a, F b) { return _mm512_min_ps(a, b); }
+  static F max(F a, F b) { return _mm512_max_ps(a, b); }
+  static F abs(F a) { return _mm512_abs_ps(a); }
+  static F keepIfNonNegative(F x, F v) {
+    return _mm512_maskz_mov_ps(
+        _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_NLT_UQ), v);
+  }
+};
+
+void evaluateAvx512(const PHatShadingPoint& point,
+                    const PHatShadingConstants& constants, const float* posX,
+                    const float* posY, const float* posZ,
+                    const float* emissionLum, size_t count, float* out) {
+  for (size_t i = 0; i < count; i += 16) {
+    _mm512_storeu_ps(out + i, evaluatePHatLanes<Avx512Lanes>(
+                                  point, constants, posX + i, posY + i,
+                                  posZ + i, emissionLum + i));
+  }
+}
+
+}  // namespace
+
+PHatLanesPath pHatAvx512Path() { return {16, evaluateAvx512}; }
+#else
+PHatLanesPath pHatAvx512Path() { return {16, nullptr}; }
+#endif
@@ -0,0 +1,136 @@
+#ifndef __VOLUME_RESTIR_UTILS_PHAT_LANES_HPP__
+#define __VOLUME_RESTIR_UTILS_PHAT_LANES_HPP__
+
+/**
+ * @file phat_lanes.hpp
+ *
+ * @brief Per-light part of `evaluatePHat` for point lights, shared by the
+ * scalar path of `phat_batch.cpp` and the AVX2 and AVX-512 kernels.
+ *
+ *  The kernels are compiled in translation units of their own with the
+ *  instruction set enabled, so this header only declares plain data and a
+ *  template over the lane operations: nothing inline here may be emitted
+ *  with wider instructions and picked by the linker for the scalar path.
+ */
+
+#include <cstddef>
+
+#include "utils/phat_batch.hpp"
+
+// Everything in `evaluatePHat` that only depends on the shading point
+struct PHatShadingConstants {
+  float woX, woY, woZ;
+  float fresnelOut;   // schlickFresnel(cosOut)
+  float alpha2;       // a * a in GTR2 and smithG_GGX
+  float smithOut;     // smithG_GGX(cosOut, a)
+  float specularLum;  // mix(0.04f, luminance, metallic)
+};
+
+/// Writes the target function of lights [0, count) to `out`, for `count` a
+/// multiple of the width of the kernel
+using PHatLanesKernel = void (*)(const PHatShadingPoint& point,
+                                 const PHatShadingConstants& constants,
+                                 const float* posX, const float* posY,
+                                 const float* posZ, const float* emissionLum,
+                                 size_t count, float* out);
+
+struct PHatLanesPath {
+  size_t width;
+  PHatLanesKernel kernel;  // null when the build does not compile it
+};
+
+[[nodiscard]] PHatLanesPath pHatAvx2Path();
+[[nodiscard]] PHatLanesPath pHatAvx512Path();
+
+/**
+ * @brief The per-light part of `evaluatePHat`, written once against a small
+ * set of lane-wise operations so the scalar, AVX2 and AVX-512 paths evaluate
+ * the same expression tree.
+ */
+template <typename S>
+typename S::F evaluatePHatLanes(const PHatShadingPoint& p,
+                                const PHatShadingConstants& c,
+                                const float* posX, const float* posY,
+                                const float* posZ, const float* emissionLum) {
+  using F            = typename S::F;
+  constexpr float pi = 3.14159265358979323846f;
+  const F zero       = S::set1(0.0f);
+  const F one        = S::set1(1.0f);
+  const F nx = S::set1(p.normal.x), ny = S::set1(p.normal.y),
+          nz = S::set1(p.normal.z);
+
+  F wix = S::sub(S::load(posX), S::set1(p.worldPos.x));
+  F wiy = S::sub(S::load(posY), S::set1(p.worldPos.y));
+  F wiz = S::sub(S::load(posZ), S::set1(p.worldPos.z));
+  const F facing = S::add(S::add(S::mul(wix, nx), S::mul(wiy, ny)),
+                          S::mul(wiz, nz));
+
+  const F sqrDist = S::add(S::add(S::mul(wix, wix), S::mul(wiy, wiy)),
+                           S::mul(wiz, wiz));
+  const F dist = S::sqrt(sqrDist);
+  wix = S::div(wix, dist);
+  wiy = S::div(wiy, dist);
+  wiz = S::div(wiz, dist);
+
+  F hx = S::add(wix, S::set1(c.woX));
+  F hy = S::add(wiy, S::set1(c.woY));
+  F hz = S::add(wiz, S::set1(c.woZ));
+  const F hLen = S::sqrt(
+      S::add(S::add(S::mul(hx, hx), S::mul(hy, hy)), S::mul(hz, hz)));
+  hx = S::div(hx, hLen);
+  hy = S::div(hy, hLen);
+  hz = S::div(hz, hLen);
+
+  const F cosIn =
+      S::add(S::add(S::mul(nx, wix), S::mul(ny, wiy)), S::mul(nz, wiz));
+  const F cosHalf =
+      S::add(S::add(S::mul(nx, hx), S::mul(ny, hy)), S::mul(nz, hz));
+  const F cosInHalf =
+      S::add(S::add(S::mul(wix, hx), S::mul(wiy, hy)), S::mul(wiz, hz));
+  const F geometry = S::div(cosIn, sqrDist);
+
+  // diffuse
+  F m = S::min(S::max(S::sub(one, cosIn), zero), one);
+  F sm = S::mul(m, m);
+  const F fresnelIn = S::mul(S::mul(sm, sm), m);
+  const F fresnelDiffuse90 =
+      S::add(S::set1(0.5f), S::mul(S::mul(S::mul(S::set1(2.0f), cosInHalf),
+                                          cosInHalf),
+                                   S::set1(p.roughness)));
+  const F fresnelDiffuse =
+      S::mul(S::add(S::mul(one, S::sub(one, fresnelIn)),
+                    S::mul(fresnelDiffuse90, fresnelIn)),
+             S::add(S::mul(one, S::set1(1.0f - c.fresnelOut)),
+                    S::mul(fresnelDiffuse90, S::set1(c.fresnelOut))));
+  const F diffuse = S::mul(
+      S::set1(p.albedoLum),
+      S::div(S::mul(fresnelDiffuse, S::set1(1.0f - p.metallic)),
+             S::set1(pi)));
+
+  // specular
+  m  = S::min(S::max(S::sub(one, cosInHalf), zero), one);
+  sm = S::mul(m, m);
+  const F fresnelInHalf = S::mul(S::mul(sm, sm), m);
+  const F t  = S::add(one, S::mul(S::mul(S::set1(c.alpha2 - 1.0f), cosHalf),
+                                  cosHalf));
+  const F ds = S::div(S::set1(c.alpha2), S::mul(S::mul(S::set1(pi), t), t));
+  const F b  = S::mul(cosIn, cosIn);
+  const F alpha2 = S::set1(c.alpha2);
+  const F smithIn = S::div(
+      one, S::add(S::abs(cosIn),
+                  S::max(S::sqrt(S::sub(S::add(alpha2, b), S::mul(alpha2, b))),
+                         S::set1(0.0001f))));
+  const F gs = S::mul(smithIn, S::set1(c.smithOut));
+  const F fs =
+      S::add(S::mul(S::set1(c.specularLum), S::sub(one, fresnelInHalf)),
+             S::mul(one, fresnelInHalf));
+  const F specular = S::mul(fs, S::mul(gs, ds));
+
+  // `disneyBrdfLuminance` returns 0 for cosIn < 0, `evaluatePHat` for lights
+  // behind the surface
+  const F brdf   = S::keepIfNonNegative(cosIn, S::add(diffuse, specular));
+  const F result = S::mul(S::mul(S::load(emissionLum), brdf), geometry);
+  return S::keepIfNonNegative(facing, result);
+}
+
+#endif /* __VOLUME_RESTIR_UTILS_PHAT_LANES_HPP__ */
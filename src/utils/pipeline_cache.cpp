@@ -0,0 +1,191 @@
+#include "utils/pipeline_cache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+// VkPipelineCacheHeaderVersionOne
+constexpr size_t kHeaderSize      = 16 + VK_UUID_SIZE;
+constexpr uint32_t kHeaderVersion = 1;
+
+uint32_t readLittleEndian(const std::vector<uint8_t>& data, size_t offset) {
+  return uint32_t(data[offset]) | uint32_t(data[offset + 1]) << 8 |
+         uint32_t(data[offset + 2]) << 16 | uint32_t(data[offset + 3]) << 24;
+}
+
+void writeLittleEndian(std::vector<uint8_t>& data, size_t offset,
+                       uint32_t value) {
+  for (size_t i = 0; i < 4; ++i) {
+    data[offset + i] = uint8_t(value >> (8 * i));
+  }
+}
+
+// what a driver of `device` returns, followed by `payload` bytes
+std::vector<uint8_t> makeCacheData(const PipelineCacheDevice& device,
+                                   size_t payload, uint8_t fill) {
+  std::vector<uint8_t> data(kHeaderSize + payload, fill);
+  writeLittleEndian(data, 0, uint32_t(kHeaderSize));
+  writeLittleEndian(data, 4, kHeaderVersion);
+  writeLittleEndian(data, 8, device.vendorID);
+  writeLittleEndian(data, 12, device.deviceID);
+  std::copy(device.pipelineCacheUUID.begin(), device.pipelineCacheUUID.end(),
+            data.begin() + 16);
+  return data;
+}
+
+void writeRaw(const std::string& filename, const std::vector<uint8_t>& data) {
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+}  // namespace
+
+bool isPipelineCacheCompatible(const std::vector<uint8_t>& data,
+                               const PipelineCacheDevice& device) {
+  if (data.size() < kHeaderSize) {
+    return false;
+  }
+  const uint32_t headerSize = readLittleEndian(data, 0);
+  return headerSize >= kHeaderSize && headerSize <= data.size() &&
+         readLittleEndian(data, 4) == kHeaderVersion &&
+         readLittleEndian(data, 8) == device.vendorID &&
+         readLittleEndian(data, 12) == device.deviceID &&
+         std::equal(device.pipelineCacheUUID.begin(),
+                    device.pipelineCacheUUID.end(), data.begin() + 16);
+}
+
+std::optional<std::vector<uint8_t>> loadPipelineCache(
+    const std::string& filename, const PipelineCacheDevice& device) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    spdlog::info("No pipeline cache at {}", filename);
+    return std::nullopt;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  if (!isPipelineCacheCompatible(data, device)) {
+    spdlog::warn("Ignoring pipeline cache {} of another device or driver",
+                 filename);
+    return std::nullopt;
+  }
+  return data;
+}
+
+bool savePipelineCache(const std::string& filename,
+                       const std::vector<uint8_t>& data) {
+  const std::string temporary = filename + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (!file) {
+      spdlog::error("Failed writing pipeline cache to {}", temporary);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, filename, error);
+  if (error) {
+    spdlog::error("Cannot replace pipeline cache {}: {}", filename,
+                  error.message());
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+  return true;
+}
+
+std::vector<PipelineCacheValidationResult> validatePipelineCacheFiles() {
+  const std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "volume_restir_pipeline_cache";
+  std::filesystem::create_directories(directory);
+  const std::string filename = (directory / "pipelines.cache").string();
+
+  const PipelineCacheDevice device{0x10de, 0x2204,
+                                   {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                    14, 15, 16}};
+  std::vector<PipelineCacheValidationResult> results;
+  const auto check = [&](std::string scenario, bool expectLoaded,
+                         const std::vector<uint8_t>& saved) {
+    const std::optional<std::vector<uint8_t>> loaded =
+        loadPipelineCache(filename, device);
+    results.push_back({std::move(scenario), expectLoaded, bool(loaded),
+                       loaded && *loaded == saved});
+  };
+
+  std::vector<uint8_t> data = makeCacheData(device, 4096, 0xab);
+  std::filesystem::remove(filename);
+  check("missing", false, {});
+
+  savePipelineCache(filename, data);
+  check("saved", true, data);
+
+  data = makeCacheData(device, 8192, 0xcd);
+  savePipelineCache(filename, data);
+  check("replaced", true, data);
+
+  // a run that stopped while saving leaves the previous cache
+  writeRaw(filename + ".tmp", std::vector<uint8_t>(100, 0xee));
+  check("interrupted", true, data);
+  savePipelineCache(filename, data);
+  check("after interrupted", true, data);
+
+  PipelineCacheDevice other = device;
+  other.pipelineCacheUUID[15] ^= 1;
+  savePipelineCache(filename, makeCacheData(other, 4096, 0xab));
+  check("other driver", false, {});
+
+  other          = device;
+  other.deviceID = 0x2684;
+  savePipelineCache(filename, makeCacheData(other, 4096, 0xab));
+  check("other device", false, {});
+
+  other          = device;
+  other.vendorID = 0x1002;
+  savePipelineCache(filename, makeCacheData(other, 4096, 0xab));
+  check("other vendor", false, {});
+
+  std::vector<uint8_t> damaged = makeCacheData(device, 4096, 0xab);
+  writeLittleEndian(damaged, 4, kHeaderVersion + 1);
+  savePipelineCache(filename, damaged);
+  check("header version", false, {});
+
+  damaged = makeCacheData(device, 4096, 0xab);
+  writeLittleEndian(damaged, 0, uint32_t(damaged.size() + 1));
+  savePipelineCache(filename, damaged);
+  check("header size", false, {});
+
+  damaged = makeCacheData(device, 0, 0);
+  damaged.resize(kHeaderSize - 1);
+  savePipelineCache(filename, damaged);
+  check("truncated", false, {});
+
+  savePipelineCache(filename, {});
+  check("empty", false, {});
+
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+  return results;
+}
+
+bool isPipelineCacheFileValid(
+    const std::vector<PipelineCacheValidationResult>& results) {
+  return std::all_of(results.begin(), results.end(),
+                     [](const PipelineCacheValidationResult& result) {
+                       return result.loaded == result.expectLoaded &&
+                              (!result.loaded || result.intact);
+                     });
+}
+
+void logPipelineCacheFiles(
+    const std::vector<PipelineCacheValidationResult>& results) {
+  spdlog::info("{:>17} {:>8} {:>6} {:>6}", "scenario", "expected", "loaded",
+               "intact");
+  for (const PipelineCacheValidationResult& result : results) {
+    spdlog::info("{:>17} {:>8} {:>6} {:>6}", result.scenario,
+                 result.expectLoaded, result.loaded, result.intact);
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef __VOLUME_RESTIR_UTILS_PIPELINE_CACHE_HPP__
+#define __VOLUME_RESTIR_UTILS_PIPELINE_CACHE_HPP__
+
+/**
+ * @file pipeline_cache.hpp
+ *
+ * @brief Pipeline cache data kept on disk between runs, dropped when its
+ * header names another device or driver.
+ *
+ *  The data starts with the header Vulkan defines for pipeline caches
+ *  (`VkPipelineCacheHeaderVersionOne`, least significant byte first), which
+ *  names the vendor, device and driver build (`pipelineCacheUUID`) it was
+ *  made by. Data from another device or driver is not given to the driver,
+ *  which would reject it anyway. Saving writes a temporary file next to the
+ *  cache and renames it over the cache, so an interrupted run never leaves
+ *  a truncated cache behind.
+ */
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct PipelineCacheDevice {
+  uint32_t vendorID;
+  uint32_t deviceID;
+  std::array<uint8_t, VK_UUID_SIZE> pipelineCacheUUID;
+};
+
+/// Whether the header of `data` was written for `device`
+[[nodiscard]] bool isPipelineCacheCompatible(const std::vector<uint8_t>& data,
+                                             const PipelineCacheDevice& device);
+
+/// Cache data of `filename` if it was written for `device`
+[[nodiscard]] std::optional<std::vector<uint8_t>> loadPipelineCache(
+    const std::string& filename, const PipelineCacheDevice& device);
+
+/// Replaces `filename` with `data` at once
+bool savePipelineCache(const std::string& filename,
+                       const std::vector<uint8_t>& data);
+
+struct PipelineCacheValidationResult {
+  std::string scenario;
+  bool expectLoaded;
+  bool loaded;
+  bool intact;  // the loaded data is the data saved last
+};
+
+/// Saves and loads caches in the temporary directory, with mismatching,
+/// damaged and interrupted files
+[[nodiscard]] std::vector<PipelineCacheValidationResult>
+validatePipelineCacheFiles();
+
+/// False if a cache is loaded when it should not be, or changed
+[[nodiscard]] bool isPipelineCacheFileValid(
+    const std::vector<PipelineCacheValidationResult>& results);
+
+void logPipelineCacheFiles(
+    const std::vector<PipelineCacheValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_PIPELINE_CACHE_HPP__ */
@@ -0,0 +1,313 @@
+#include "utils/profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+
+std::string escapeJson(const std::string& text) {
+  std::string escaped;
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += fmt::format("\\u{:04x}", int(c));
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// nearest rank of the sorted `values`
+double percentile(const std::vector<double>& values, double p) {
+  const size_t rank = size_t(std::ceil(p * double(values.size())));
+  return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+}
+
+// whether `json` has balanced brackets outside of its strings, which are
+// all closed
+bool isBalancedJson(const std::string& json) {
+  std::vector<char> open;
+  bool inString = false;
+  for (size_t i = 0; i < json.size(); ++i) {
+    const char c = json[i];
+    if (inString) {
+      if (c == '\\') {
+        ++i;
+      } else if (c == '"') {
+        inString = false;
+      }
+    } else if (c == '"') {
+      inString = true;
+    } else if (c == '{' || c == '[') {
+      open.push_back(c == '{' ? '}' : ']');
+    } else if (c == '}' || c == ']') {
+      if (open.empty() || open.back() != c) {
+        return false;
+      }
+      open.pop_back();
+    }
+  }
+  return !inString && open.empty();
+}
+
+size_t countOf(const std::string& text, const std::string& pattern) {
+  size_t count = 0;
+  for (size_t found = text.find(pattern); found != std::string::npos;
+       found        = text.find(pattern, found + pattern.size())) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+Profiler::Profiler(size_t maxEvents, size_t window)
+    : m_origin(std::chrono::steady_clock::now()),
+      m_maxEvents(maxEvents),
+      m_window(std::max<size_t>(1, window)) {}
+
+Profiler& Profiler::global() {
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::record(ProfileEvent event) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::deque<double>& durations =
+      m_durations[{event.track == kGpuTrack, event.name}];
+  durations.push_back(event.duration);
+  if (durations.size() > m_window) {
+    durations.pop_front();
+  }
+  if (m_maxEvents > 0) {
+    m_events.push_back(std::move(event));
+    if (m_events.size() > m_maxEvents) {
+      m_events.pop_front();
+    }
+  }
+}
+
+double Profiler::now() const {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - m_origin)
+      .count();
+}
+
+uint32_t Profiler::threadTrack() {
+  static std::atomic<uint32_t> next{kGpuTrack + 1};
+  thread_local const uint32_t track = next++;
+  return track;
+}
+
+uint32_t& Profiler::threadDepth() {
+  thread_local uint32_t depth = 0;
+  return depth;
+}
+
+std::vector<ProfileStats> Profiler::stats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<ProfileStats> stats;
+  for (const auto& [key, durations] : m_durations) {
+    std::vector<double> sorted(durations.begin(), durations.end());
+    std::sort(sorted.begin(), sorted.end());
+    const double sum = std::accumulate(sorted.begin(), sorted.end(), 0.0);
+    stats.push_back({key.second, key.first, uint32_t(sorted.size()),
+                     sum / double(sorted.size()), percentile(sorted, 0.5),
+                     percentile(sorted, 0.99)});
+  }
+  return stats;
+}
+
+std::vector<ProfileEvent> Profiler::events() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return std::vector<ProfileEvent>(m_events.begin(), m_events.end());
+}
+
+std::string Profiler::chromeTrace() const {
+  const std::vector<ProfileEvent> events = this->events();
+  std::vector<uint32_t> tracks;
+  for (const ProfileEvent& event : events) {
+    tracks.push_back(event.track);
+  }
+  std::sort(tracks.begin(), tracks.end());
+  tracks.erase(std::unique(tracks.begin(), tracks.end()), tracks.end());
+
+  std::string json = "{\"traceEvents\":[";
+  bool first       = true;
+  const auto separate = [&]() {
+    json += first ? "\n" : ",\n";
+    first = false;
+  };
+  for (const uint32_t track : tracks) {
+    separate();
+    json += fmt::format(
+        "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},"
+        "\"args\":{{\"name\":\"{}\"}}}}",
+        track,
+        track == kGpuTrack ? "GPU" : fmt::format("Thread {}", track));
+  }
+  for (const ProfileEvent& event : events) {
+    separate();
+    json += fmt::format(
+        "{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},"
+        "\"dur\":{:.3f},\"pid\":1,\"tid\":{}}}",
+        escapeJson(event.name), event.track == kGpuTrack ? "gpu" : "cpu",
+        event.start, event.duration, event.track);
+  }
+  json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return json;
+}
+
+bool Profiler::writeChromeTrace(const std::string& filename) const {
+  std::ofstream file(filename, std::ios::trunc);
+  file << chromeTrace();
+  if (!file) {
+    spdlog::error("Failed writing the trace to {}", filename);
+    return false;
+  }
+  spdlog::info("Wrote the trace to {}", filename);
+  return true;
+}
+
+void Profiler::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_events.clear();
+  m_durations.clear();
+}
+
+ProfileScope::ProfileScope(Profiler& profiler, const char* name)
+    : m_profiler(profiler), m_name(name), m_start(profiler.now()) {
+  ++Profiler::threadDepth();
+}
+
+ProfileScope::~ProfileScope() {
+  const uint32_t depth = --Profiler::threadDepth();
+  m_profiler.record({m_name, Profiler::threadTrack(), depth, m_start,
+                     m_profiler.now() - m_start});
+}
+
+double timestampMicroseconds(uint64_t begin, uint64_t end, uint32_t validBits,
+                             float timestampPeriod) {
+  const uint64_t mask =
+      validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+  return double((end - begin) & mask) * double(timestampPeriod) / 1000.0;
+}
+
+void logProfileStats(const std::vector<ProfileStats>& stats) {
+  spdlog::info("{:>16} {:>4} {:>6} {:>9} {:>9} {:>9}", "scope", "on", "count",
+               "mean us", "p50 us", "p99 us");
+  for (const ProfileStats& scope : stats) {
+    spdlog::info("{:>16} {:>4} {:>6} {:>9.1f} {:>9.1f} {:>9.1f}", scope.name,
+                 scope.gpu ? "gpu" : "cpu", scope.count, scope.mean, scope.p50,
+                 scope.p99);
+  }
+}
+
+std::vector<ValidationCheck> validateProfiler() {
+  std::vector<ValidationCheck> results;
+
+  {
+    Profiler profiler;
+    {
+      const ProfileScope outer(profiler, "outer");
+      const ProfileScope inner(profiler, "inner");
+    }
+    const std::vector<ProfileEvent> events = profiler.events();
+    const bool nested =
+        events.size() == 2 && events[0].name == "inner" &&
+        events[0].depth == 1 && events[1].depth == 0 &&
+        events[0].start >= events[1].start &&
+        events[0].start + events[0].duration <=
+            events[1].start + events[1].duration;
+    results.push_back({"nested", "inner within outer",
+                       nested ? "inner within outer" : "not nested"});
+  }
+  {
+    Profiler profiler;
+    { const ProfileScope scope(profiler, "main"); }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; ++i) {
+      threads.emplace_back(
+          [&profiler]() { const ProfileScope scope(profiler, "worker"); });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    std::vector<uint32_t> tracks;
+    for (const ProfileEvent& event : profiler.events()) {
+      if (event.track != Profiler::kGpuTrack && event.depth == 0) {
+        tracks.push_back(event.track);
+      }
+    }
+    std::sort(tracks.begin(), tracks.end());
+    tracks.erase(std::unique(tracks.begin(), tracks.end()), tracks.end());
+    results.push_back({"threads", "3 host tracks",
+                       fmt::format("{} host tracks", tracks.size())});
+  }
+  const auto describeStats = [](const ProfileStats& stats) {
+    return fmt::format("{} {}, mean {}, p50 {}, p99 {}", stats.count,
+                       stats.gpu ? "gpu" : "cpu", stats.mean, stats.p50,
+                       stats.p99);
+  };
+  {
+    Profiler profiler;
+    for (int i = 100; i >= 1; --i) {
+      profiler.record({"pass", 1, 0, 0.0, double(i)});
+    }
+    results.push_back({"statistics", "100 cpu, mean 50.5, p50 50, p99 99",
+                       describeStats(profiler.stats()[0])});
+  }
+  {
+    // the window forgets the slow start
+    Profiler profiler(0, 256);
+    for (int i = 0; i < 300; ++i) {
+      profiler.record({"pass", Profiler::kGpuTrack, 0, 0.0,
+                       i < 44 ? 1000.0 : 2.0});
+    }
+    results.push_back({"rolling window", "256 gpu, mean 2, p50 2, p99 2",
+                       describeStats(profiler.stats()[0])});
+  }
+  {
+    Profiler profiler(4);
+    for (int i = 0; i < 10; ++i) {
+      profiler.record({std::to_string(i), 1, 0, double(i), 1.0});
+    }
+    std::string names;
+    for (const ProfileEvent& event : profiler.events()) {
+      names += event.name;
+    }
+    results.push_back({"event cap", "6789", names});
+  }
+  results.push_back(
+      {"timestamps", "32 us, 0.5 us",
+       fmt::format("{} us, {} us",
+                   timestampMicroseconds(0xfffffff0u, 0x10u, 32, 1000.f),
+                   timestampMicroseconds(100, 1100, 64, 0.5f))});
+  {
+    Profiler profiler;
+    profiler.record({"restir", Profiler::kGpuTrack, 0, 1.0, 2.0});
+    profiler.record({"a \"quoted\" \\ name", 1, 0, 0.5, 3.0});
+    profiler.record({"line\nbreak", 2, 1, 0.75, 0.25});
+    const std::string trace = profiler.chromeTrace();
+    const bool escaped =
+        trace.find("a \\\"quoted\\\" \\\\ name") != std::string::npos &&
+        trace.find("line\\u000abreak") != std::string::npos;
+    results.push_back(
+        {"trace", "balanced, escaped, 3 tracks, 3 events",
+         fmt::format("{}, {}, {} tracks, {} events",
+                     isBalancedJson(trace) ? "balanced" : "unbalanced",
+                     escaped ? "escaped" : "not escaped",
+                     countOf(trace, "\"ph\":\"M\""),
+                     countOf(trace, "\"ph\":\"X\""))});
+  }
+  return results;
+}
@@ -0,0 +1,123 @@
+#ifndef __VOLUME_RESTIR_UTILS_PROFILER_HPP__
+#define __VOLUME_RESTIR_UTILS_PROFILER_HPP__
+
+/**
+ * @file profiler.hpp
+ *
+ * @brief Timed scopes of the host threads and the device, their rolling
+ * statistics and their export as a Chrome trace (chrome://tracing,
+ * ui.perfetto.dev).
+ *
+ *  `PROFILE_SCOPE("name")` times the rest of the enclosing block on the
+ *  calling thread; scopes nest, and each thread gets its own track. Device
+ *  scopes are timed with timestamp queries by `GpuProfiler` and recorded
+ *  here on a track of their own. Without USE_PROFILER (see
+ *  config/static_config.hpp) the macros expand to nothing.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "config/static_config.hpp"
+#include "utils/validation.hpp"
+
+struct ProfileEvent {
+  std::string name;
+  uint32_t track;  // host thread, or kGpuTrack
+  uint32_t depth;  // of nested scopes on the track
+  double start;    // microseconds since the profiler was created
+  double duration;
+};
+
+struct ProfileStats {
+  std::string name;
+  bool gpu;
+  uint32_t count;  // of the durations in the window
+  double mean;     // microseconds
+  double p50;
+  double p99;
+};
+
+class Profiler {
+public:
+  static constexpr uint32_t kGpuTrack = 0;  // host threads count from 1
+
+  /// Keeps the last `maxEvents` events for the trace, and the last
+  /// `window` durations of each scope for the statistics
+  explicit Profiler(size_t maxEvents = 1 << 16, size_t window = 256);
+
+  /// The one the macros record to
+  static Profiler& global();
+
+  void record(ProfileEvent event);
+
+  /// Microseconds since the profiler was created
+  [[nodiscard]] double now() const;
+
+  /// Track of the calling thread, and the depth of its open scopes
+  [[nodiscard]] static uint32_t threadTrack();
+  static uint32_t& threadDepth();
+
+  /// Mean and nearest-rank percentiles of the window of each scope, by
+  /// name, host scopes first
+  [[nodiscard]] std::vector<ProfileStats> stats() const;
+  [[nodiscard]] std::vector<ProfileEvent> events() const;
+
+  /// JSON object format of the Chrome trace events, complete events only
+  [[nodiscard]] std::string chromeTrace() const;
+  bool writeChromeTrace(const std::string& filename) const;
+
+  void clear();
+
+private:
+  const std::chrono::steady_clock::time_point m_origin;
+  const size_t m_maxEvents;
+  const size_t m_window;
+  mutable std::mutex m_mutex;
+  std::deque<ProfileEvent> m_events;
+  // rolling durations by device flag and name
+  std::map<std::pair<bool, std::string>, std::deque<double>> m_durations;
+};
+
+/// Times its lifetime on the calling thread
+class ProfileScope {
+public:
+  ProfileScope(Profiler& profiler, const char* name);
+  ~ProfileScope();
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+  Profiler& m_profiler;
+  const char* m_name;
+  double m_start;
+};
+
+/// Elapsed microseconds between two timestamps of a queue with
+/// `validBits` valid bits, which wrap around
+[[nodiscard]] double timestampMicroseconds(uint64_t begin, uint64_t end,
+                                           uint32_t validBits,
+                                           float timestampPeriod);
+
+void logProfileStats(const std::vector<ProfileStats>& stats);
+
+/// Nesting, threads, statistics, timestamps and the trace of a profiler of
+/// its own
+[[nodiscard]] std::vector<ValidationCheck> validateProfiler();
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#ifdef USE_PROFILER
+#define PROFILE_SCOPE(name)                                  \
+  const ProfileScope PROFILE_CONCAT(profileScope, __LINE__)( \
+      Profiler::global(), name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+#endif /* __VOLUME_RESTIR_UTILS_PROFILER_HPP__ */
@@ -0,0 +1,169 @@
+#ifndef __VOLUME_RESTIR_UTILS_RESERVOIR_HPP__
+#define __VOLUME_RESTIR_UTILS_RESERVOIR_HPP__
+
+/**
+ * @file reservoir.hpp
+ *
+ * @brief Host mirror of the reservoir operations in
+ * `shaders/headers/reservoir.glsl`, for CPU references of the reuse passes.
+ *
+ *  Target functions are passed in as already evaluated values or callables,
+ *  and the uniform number deciding a replacement is passed explicitly, so the
+ *  same sequence of calls reproduces the GPU result.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// keep in sync with reservoir.glsl
+constexpr float kReuseDepthThreshold  = 0.1f;
+constexpr float kReuseNormalThreshold = 0.5f;
+
+struct HostReservoir {
+  uint32_t numStreamSamples = 0;
+  uint32_t lightIndex       = 0;
+  int32_t lightKind         = 0;  // LIGHT_KIND_* of structs/light.glsl
+  uint32_t sampleSeed       = 0;
+  float pHat                = 0.0f;
+  float sumWeights          = 0.0f;
+  float w                   = 0.0f;
+};
+
+/// `updateReservoir`, with `u` standing in for `rnd(seed)`
+inline void updateReservoir(HostReservoir& res, uint32_t lightIndex,
+                            float weight, float pHat, float w, float u) {
+  res.sumWeights += weight;
+  const float replacePossibility = weight / res.sumWeights;
+  if (u < replacePossibility) {
+    res.lightIndex = lightIndex;
+    res.pHat       = pHat;
+    res.w          = w;
+  }
+}
+
+/// `addSampleToReservoir` for a candidate with target `pHat` drawn with
+/// probability `lightPdf`
+inline void addSampleToReservoir(HostReservoir& res, uint32_t lightIndex,
+                                 float pHat, float lightPdf, float u) {
+  const float weight = pHat / lightPdf;
+  res.numStreamSamples += 1;
+  const float w = (res.sumWeights + weight) / (res.numStreamSamples * pHat);
+  updateReservoir(res, lightIndex, weight, pHat, w, u);
+}
+
+/// `addSampleToReservoirs`: the `N` reservoirs of a pixel share the target
+/// evaluation of a candidate, with `u[i]` deciding for reservoir `i`
+template <size_t N>
+void addSampleToReservoirs(std::array<HostReservoir, N>& reservoirs,
+                           uint32_t lightIndex, float pHat, float lightPdf,
+                           const std::array<float, N>& u) {
+  const float weight = pHat / lightPdf;
+  for (size_t i = 0; i < N; ++i) {
+    HostReservoir& res = reservoirs[i];
+    res.numStreamSamples += 1;
+    const float w = (res.sumWeights + weight) / (res.numStreamSamples * pHat);
+    updateReservoir(res, lightIndex, weight, pHat, w, u[i]);
+  }
+}
+
+/// `finalizeReservoir`
+inline void finalizeReservoir(HostReservoir& res) {
+  res.w = res.pHat > 0.0f ? res.sumWeights / (res.numStreamSamples * res.pHat)
+                          : 0.0f;
+}
+
+/**
+ * @brief `combineReservoirs` with the Z bias correction: `pHatAtSelf(i)` and
+ * `pHatAtOther(i)` evaluate the target of light `i` at the shading points of
+ * `self` and `other`.
+ */
+template <typename PHatAtSelf, typename PHatAtOther>
+void combineReservoirs(HostReservoir& self, const HostReservoir& other,
+                       PHatAtSelf&& pHatAtSelf, PHatAtOther&& pHatAtOther,
+                       float u) {
+  uint32_t z = self.numStreamSamples;
+
+  self.numStreamSamples += other.numStreamSamples;
+  float pHat         = pHatAtSelf(other.lightIndex);
+  const float weight = pHat * other.w * other.numStreamSamples;
+  if (weight > 0.0f) {
+    updateReservoir(self, other.lightIndex, weight, pHat, other.w, u);
+  }
+
+  pHat = pHatAtOther(self.lightIndex);
+  if (pHat > 0.0f) {
+    z += other.numStreamSamples;
+  }
+  if (self.w > 0.0f) {
+    self.w = self.sumWeights / (z * self.pHat);
+  }
+}
+
+/// Normalization of the reuse passes, see `RESTIR_MIS_REUSE_FLAG`
+enum class ReuseWeighting {
+  eUniform,           // 1 / M, biased where a neighbour cannot produce a sample
+  eBiasCorrected,     // 1 / Z
+  eBalanceHeuristic,  // generalized balance heuristic MIS weights
+};
+
+/**
+ * @brief Combines `count` reservoirs with generalized balance heuristic MIS
+ * weights, as `combineReservoirsMis` in reservoir.glsl.
+ *
+ *  `reservoirs[0]` belongs to the shading point. `pHatAt(j, i)` is the target
+ *  of light `i` at the shading point of `reservoirs[j]`; it is only called for
+ *  samples of other reservoirs, since each reservoir stores the target of its
+ *  own sample.
+ */
+template <typename PHatAt, typename Uniform>
+HostReservoir combineReservoirsMis(const HostReservoir* const* reservoirs,
+                                   uint32_t count, PHatAt&& pHatAt,
+                                   Uniform&& uniform) {
+  HostReservoir res;
+  for (uint32_t i = 0; i < count; ++i) {
+    const HostReservoir& other = *reservoirs[i];
+    res.numStreamSamples += other.numStreamSamples;
+
+    float pHatHere = other.pHat;
+    float sum      = other.numStreamSamples * other.pHat;
+    for (uint32_t j = 0; j < count; ++j) {
+      if (j == i) {
+        continue;
+      }
+      const float pHat = pHatAt(j, other.lightIndex);
+      sum += reservoirs[j]->numStreamSamples * pHat;
+      if (j == 0) {
+        pHatHere = pHat;
+      }
+    }
+    const float misWeight =
+        sum > 0.0f ? other.numStreamSamples * other.pHat / sum : 0.0f;
+    const float weight = misWeight * pHatHere * other.w;
+    if (weight > 0.0f) {
+      updateReservoir(res, other.lightIndex, weight, pHatHere, other.w,
+                      uniform());
+    }
+  }
+  res.w = res.pHat > 0.0f ? res.sumWeights / res.pHat : 0.0f;
+  return res;
+}
+
+/// `isSimilarSurface`: depth relative to the respective camera and normal
+/// agreement
+inline bool isSimilarSurface(const nvmath::vec3f& worldPos,
+                             const nvmath::vec3f& normal,
+                             const nvmath::vec3f& camPos,
+                             const nvmath::vec3f& otherWorldPos,
+                             const nvmath::vec3f& otherNormal,
+                             const nvmath::vec3f& otherCamPos) {
+  const float depth      = nvmath::length(worldPos - camPos);
+  const float otherDepth = nvmath::length(otherWorldPos - otherCamPos);
+  return std::abs(depth - otherDepth) <= kReuseDepthThreshold * depth &&
+         nvmath::dot(normal, otherNormal) >= kReuseNormalThreshold;
+}
+
+#endif /* __VOLUME_RESTIR_UTILS_RESERVOIR_HPP__ */
@@ -0,0 +1,53 @@
+#include "utils/restir_frame.hpp"
+
+#include <algorithm>
+
+std::vector<PushConstantSpatialReuse> spatialReuseDispatches(
+    uint32_t iterations) {
+  // iterations alternate between the temporary and the final reservoirs; an
+  // even count ends on the temporary ones and needs a final copy
+  std::vector<PushConstantSpatialReuse> dispatches;
+  PushConstantSpatialReuse pushC{};
+  for (uint32_t i = 0; i < std::max(iterations, 1u); ++i) {
+    pushC.iteration     = i;
+    pushC.readTemporary = i % 2 == 0;
+    dispatches.push_back(pushC);
+  }
+  if (!pushC.readTemporary) {
+    pushC.readTemporary = 1;
+    pushC.copyOnly      = 1;
+    dispatches.push_back(pushC);
+  }
+  return dispatches;
+}
+
+std::vector<std::vector<ResourceUse>> restirFrameUses(
+    const RestirFrameResources& resources,
+    const std::vector<PushConstantSpatialReuse>& spatialDispatches) {
+  using U                       = ResourceUsage;
+  const RestirFrameResources& r = resources;
+
+  std::vector<std::vector<ResourceUse>> passes = {
+      {{r.gBuffer, U::eRayTracingStorageWrite},
+       {r.tmpReservoirs, U::eRayTracingStorageWrite},
+       {r.visibilityCache, U::eRayTracingStorageReadWrite}},
+      {{r.gBuffer, U::eComputeStorageRead},
+       {r.prevGBuffer, U::eComputeStorageRead},
+       {r.prevReservoirs, U::eComputeStorageRead},
+       {r.tmpReservoirs, U::eComputeStorageReadWrite}},
+  };
+  for (const PushConstantSpatialReuse& pushC : spatialDispatches) {
+    const uint32_t source =
+        pushC.readTemporary ? r.tmpReservoirs : r.reservoirs;
+    const uint32_t target =
+        pushC.readTemporary ? r.reservoirs : r.tmpReservoirs;
+    passes.push_back({{r.gBuffer, U::eComputeStorageRead},
+                      {source, U::eComputeStorageRead},
+                      {target, U::eComputeStorageWrite}});
+  }
+  // accumulates into the storage image over the frames
+  passes.push_back({{r.gBuffer, U::eFragmentStorageRead},
+                    {r.reservoirs, U::eFragmentStorageRead},
+                    {r.storageImage, U::eFragmentStorageReadWrite}});
+  return passes;
+}
@@ -0,0 +1,55 @@
+#ifndef __VOLUME_RESTIR_UTILS_RESTIR_FRAME_HPP__
+#define __VOLUME_RESTIR_UTILS_RESTIR_FRAME_HPP__
+
+/**
+ * @file restir_frame.hpp
+ *
+ * @brief The passes of one ReSTIR frame and the images each one reads and
+ * writes, shared by the render graph of `Renderer::addRestirPasses`, the
+ * transient image allocation of `Renderer::createRestirBuffer` and the host
+ * checks of both.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "shaders/host_device.h"
+#include "utils/barrier_planner.hpp"
+
+/// Resource ids of the images of one frame; the GBuffers and reservoirs
+/// swap roles from one frame to the next
+struct RestirFrameResources {
+  uint32_t gBuffer;
+  uint32_t prevGBuffer;
+  uint32_t reservoirs;
+  uint32_t prevReservoirs;
+  uint32_t tmpReservoirs;
+  uint32_t visibilityCache;
+  uint32_t storageImage;
+};
+
+/// Push constants of the spatial reuse dispatches of one frame, in order
+[[nodiscard]] std::vector<PushConstantSpatialReuse> spatialReuseDispatches(
+    uint32_t iterations);
+
+/// Uses of restir.rgen, temporalReuse.comp, each spatial reuse dispatch and
+/// restir_post.frag, in this order
+[[nodiscard]] std::vector<std::vector<ResourceUse>> restirFrameUses(
+    const RestirFrameResources& resources,
+    const std::vector<PushConstantSpatialReuse>& spatialDispatches);
+
+/// Ids of frame `frame` when images `gBuffers` and `reservoirs` alternate
+template <size_t N>
+RestirFrameResources restirFrameResources(const uint32_t (&gBuffers)[N],
+                                          const uint32_t (&reservoirs)[N],
+                                          uint32_t tmpReservoirs,
+                                          uint32_t visibilityCache,
+                                          uint32_t storageImage,
+                                          uint32_t frame) {
+  const uint32_t current = frame % N, previous = (frame + N - 1) % N;
+  return {gBuffers[current],   gBuffers[previous], reservoirs[current],
+          reservoirs[previous], tmpReservoirs,     visibilityCache,
+          storageImage};
+}
+
+#endif /* __VOLUME_RESTIR_UTILS_RESTIR_FRAME_HPP__ */
@@ -1,7 +1,11 @@
 #include "utils/restir_utils.h"
 
+#include <algorithm>
+#include <cmath>
 #include <queue>
 
+#include "utils/parallel.hpp"
+#include "utils/rng.hpp"
 #include "utils/shader_functions.hpp"
 
 std::vector<PointLight> collectPointLights(const nvh::GltfScene& scene) {
@@ -21,69 +25,163 @@ std::vector<PointLight> collectPointLights(const nvh::GltfScene& scene) {
 
 std::vector<PointLight> generatePointLights(nvmath::vec3 min, nvmath::vec3 max,
                                             bool isGenerateWhiteLight,
-                                            uint32_t numPointLightGenerates) {
-  std::uniform_real_distribution<float> distR =
-      std::uniform_real_distribution<float>(0.0f, 1.0f);
-  std::uniform_real_distribution<float> distG =
-      std::uniform_real_distribution<float>(0.0f, 1.0f);
-  std::uniform_real_distribution<float> distB =
-      std::uniform_real_distribution<float>(0.0f, 1.0f);
-  std::uniform_real_distribution<float> distX(min.x, max.x);
-  std::uniform_real_distribution<float> distY(min.y, max.y);
-  std::uniform_real_distribution<float> distZ(min.z, max.z);
-  std::default_random_engine rand;
+                                            uint32_t numPointLightGenerates,
+                                            uint32_t seed) {
+  // every light draws from its own slice of a counter-based stream, so the
+  // result does not depend on how the work is split across threads
+  constexpr uint32_t kRandomsPerLight = 6;
+  const uint32_t key                  = hostRngKey(seed, 0);
 
   std::vector<PointLight> result(numPointLightGenerates);
-  for (PointLight& light : result) {
-    light.pos = nvmath::vec4(distX(rand), distY(rand), distZ(rand), 1.0f);
-    if (isGenerateWhiteLight) {
-      light.emission_luminance = nvmath::vec4(1.0f, 1.0f, 1.0f, 0.0f);
-
-    } else {
-      light.emission_luminance =
-          nvmath::vec4(distR(rand), distG(rand), distB(rand), 0.0f);
+  parallelBatches(result.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      float r[kRandomsPerLight];
+      generateUniformFloats(key, static_cast<uint32_t>(i) * kRandomsPerLight,
+                            r, kRandomsPerLight);
+
+      PointLight& light = result[i];
+      light.pos = nvmath::vec4(min.x + r[0] * (max.x - min.x),
+                               min.y + r[1] * (max.y - min.y),
+                               min.z + r[2] * (max.z - min.z), 1.0f);
+      if (isGenerateWhiteLight) {
+        light.emission_luminance = nvmath::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+      } else {
+        light.emission_luminance = nvmath::vec4(r[3], r[4], r[5], 0.0f);
+      }
+      light.emission_luminance.w = shader::luminance(
+          light.emission_luminance.x, light.emission_luminance.y,
+          light.emission_luminance.z);
     }
-    light.emission_luminance.w = shader::luminance(light.emission_luminance.x,
-                                                   light.emission_luminance.y,
-                                                   light.emission_luminance.z);
-  }
+  });
   return result;
 }
 
-std::vector<TriangleLight> collectTriangleLights(const nvh::GltfScene& scene) {
-  std::vector<TriangleLight> result;
+namespace {
+
+// Points per triangle used to average its emissive texture
+constexpr uint32_t kEmissiveTextureSamples = 16;
+
+struct EmissivePrimitive {
+  const nvh::GltfNode* node;
+  const nvh::GltfPrimMesh* mesh;
+  const nvh::GltfMaterial* material;
+  const tinygltf::Image* emissiveImage;  // nullptr for the factor alone
+  size_t firstLight;
+};
+
+const tinygltf::Image* findEmissiveImage(const tinygltf::Model* model,
+                                         const nvh::GltfMaterial& material) {
+  if (!model || material.emissiveTexture < 0 ||
+      material.emissiveTexture >= int(model->textures.size())) {
+    return nullptr;
+  }
+  const int source = model->textures[material.emissiveTexture].source;
+  if (source < 0 || source >= int(model->images.size())) {
+    return nullptr;
+  }
+  const tinygltf::Image& image = model->images[source];
+  if (image.width <= 0 || image.height <= 0 || image.bits != 8 ||
+      image.component < 3 || image.image.empty()) {
+    return nullptr;
+  }
+  return &image;
+}
+
+/// Linear RGB of the nearest texel at `uv`, with repeat addressing
+nvmath::vec3f fetchTexel(const tinygltf::Image& image, nvmath::vec2f uv) {
+  const float u = uv.x - std::floor(uv.x);
+  const float v = uv.y - std::floor(uv.y);
+  const int x   = std::min(int(u * image.width), image.width - 1);
+  const int y   = std::min(int(v * image.height), image.height - 1);
+  const unsigned char* texel =
+      image.image.data() + (size_t(y) * image.width + x) * image.component;
+  // emissive textures are sRGB
+  return nvmath::vec3f(std::pow(texel[0] / 255.0f, 2.2f),
+                       std::pow(texel[1] / 255.0f, 2.2f),
+                       std::pow(texel[2] / 255.0f, 2.2f));
+}
+
+/// Average of the emissive texture over the UV triangle (t1, t2, t3)
+nvmath::vec3f averageTexture(const tinygltf::Image& image, nvmath::vec2f t1,
+                             nvmath::vec2f t2, nvmath::vec2f t3,
+                             uint32_t triangleIndex) {
+  nvmath::vec3f sum(0.0f);
+  for (uint32_t i = 0; i < kEmissiveTextureSamples; ++i) {
+    // same warp as `getTrianglePoint` in restirUtils.glsl
+    const nvmath::vec2f r = shader::ldOwenSobol2D(i, triangleIndex, 0u);
+    const float sqrtR1    = std::sqrt(r.x);
+    const nvmath::vec2f uv = (1.0f - sqrtR1) * t1 +
+                             (sqrtR1 * (1.0f - r.y)) * t2 + (r.y * sqrtR1) * t3;
+    sum += fetchTexel(image, uv);
+  }
+  return sum / float(kEmissiveTextureSamples);
+}
+
+}  // namespace
+
+std::vector<TriangleLight> collectTriangleLights(const nvh::GltfScene& scene,
+                                                 const tinygltf::Model* model) {
+  // one entry per emissive primitive, with the offset of its first light so
+  // triangles can be processed independently
+  std::vector<EmissivePrimitive> primitives;
+  size_t lightCount = 0;
   for (const nvh::GltfNode& node : scene.m_nodes) {
     const nvh::GltfPrimMesh& mesh     = scene.m_primMeshes[node.primMesh];
     const nvh::GltfMaterial& material = scene.m_materials[mesh.materialIndex];
     if (material.emissiveFactor.sq_norm() > 1e-6) {
-      const uint32_t* indices = scene.m_indices.data() + mesh.firstIndex;
+      primitives.push_back(EmissivePrimitive{
+          &node, &mesh, &material, findEmissiveImage(model, material),
+          lightCount});
+      lightCount += mesh.indexCount / 3;
+    }
+  }
+
+  std::vector<TriangleLight> result(lightCount);
+  parallelBatches(result.size(), [&](size_t begin, size_t end) {
+    // primitive containing `begin`, later ones are reached by walking forward
+    auto prim = std::upper_bound(primitives.begin(), primitives.end(), begin,
+                                 [](size_t i, const EmissivePrimitive& p) {
+                                   return i < p.firstLight;
+                                 }) -
+                1;
+    for (size_t lightIdx = begin; lightIdx < end; ++lightIdx) {
+      while (lightIdx >= prim->firstLight + prim->mesh->indexCount / 3) {
+        ++prim;
+      }
+      const nvh::GltfPrimMesh& mesh = *prim->mesh;
+      const uint32_t* indices = scene.m_indices.data() + mesh.firstIndex +
+                                3 * (lightIdx - prim->firstLight);
       const nvmath::vec3* pos = scene.m_positions.data() + mesh.vertexOffset;
-      for (uint32_t i = 0; i < mesh.indexCount; i += 3, indices += 3) {
-        // triangle
-        vec4 p1 = node.worldMatrix * nvmath::vec4(pos[indices[0]], 1.0f);
-        vec4 p2 = node.worldMatrix * nvmath::vec4(pos[indices[1]], 1.0f);
-        vec4 p3 = node.worldMatrix * nvmath::vec4(pos[indices[2]], 1.0f);
-        vec3 p1_vec3(p1.x, p1.y, p1.z), p2_vec3(p2.x, p2.y, p2.z),
-            p3_vec3(p3.x, p3.y, p3.z);
-
-        vec3 normal = nvmath::cross(p2_vec3 - p1_vec3, p3_vec3 - p1_vec3);
-        float area  = normal.norm();
-        normal /= area;
-        area *= 0.5f;
-
-        float emissionLuminance = shader::luminance(material.emissiveFactor.x,
-                                                    material.emissiveFactor.y,
-                                                    material.emissiveFactor.z);
-
-        TriangleLight tmpTriLight{p1, p2, p3,
-                                  vec4(material.emissiveFactor, 0.0), area};
-        result.push_back(TriangleLight{
-            p1, p2, p3,
-            nvmath::vec4(material.emissiveFactor, emissionLuminance),
-            nvmath::vec4(normal, area)});
+
+      const nvmath::mat4f& world = prim->node->worldMatrix;
+      vec4 p1 = world * nvmath::vec4(pos[indices[0]], 1.0f);
+      vec4 p2 = world * nvmath::vec4(pos[indices[1]], 1.0f);
+      vec4 p3 = world * nvmath::vec4(pos[indices[2]], 1.0f);
+      vec3 p1_vec3(p1.x, p1.y, p1.z), p2_vec3(p2.x, p2.y, p2.z),
+          p3_vec3(p3.x, p3.y, p3.z);
+
+      vec3 normal = nvmath::cross(p2_vec3 - p1_vec3, p3_vec3 - p1_vec3);
+      float area  = normal.norm();
+      // degenerate triangles keep zero power instead of a NaN normal
+      normal = area > 0.0f ? normal / area : vec3(0.0f);
+      area *= 0.5f;
+
+      vec3 emission = prim->material->emissiveFactor;
+      if (prim->emissiveImage) {
+        const nvmath::vec2f* uv =
+            scene.m_texcoords0.data() + mesh.vertexOffset;
+        emission *= averageTexture(*prim->emissiveImage, uv[indices[0]],
+                                   uv[indices[1]], uv[indices[2]],
+                                   static_cast<uint32_t>(lightIdx));
       }
+      const float emissionLuminance =
+          shader::luminance(emission.x, emission.y, emission.z);
+
+      result[lightIdx] =
+          TriangleLight{p1, p2, p3, nvmath::vec4(emission, emissionLuminance),
+                        nvmath::vec4(normal, area)};
     }
-  }
+  });
   return result;
 }
 
@@ -20,10 +20,13 @@
 [[nodiscard]] std::vector<PointLight> collectPointLights(const nvh::GltfScene&);
 [[nodiscard]] std::vector<PointLight> generatePointLights(
     nvmath::vec3 min, nvmath::vec3 max, bool isGenerateWhiteLight = true,
-    uint32_t numPointLightGenerates = 100);
+    uint32_t numPointLightGenerates = 100, uint32_t seed = 0);
 
+/// Every triangle with an emissive material, transformed to world space. With
+/// `model`, the emissive factor is scaled by the average of the material's
+/// emissive texture over the triangle
 [[nodiscard]] std::vector<TriangleLight> collectTriangleLights(
-    const nvh::GltfScene&);
+    const nvh::GltfScene&, const tinygltf::Model* model = nullptr);
 
 [[nodiscard]] std::vector<AliasTableCell> createAliasTable(
     const std::vector<float>& pdf);
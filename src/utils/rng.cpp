@@ -0,0 +1,129 @@
+#include "utils/rng.hpp"
+
+#include <type_traits>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "utils/cpu_features.hpp"
+#include "utils/rng_avx2.hpp"
+
+namespace {
+
+bool useAvx2() {
+  static const bool supported = rngAvx2Compiled() && cpuSupportsAvx2();
+  return supported;
+}
+
+void generateRandomWordsScalar(uint32_t key, uint32_t firstCounter,
+                               uint32_t* out, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = shader::rngAt(key, firstCounter + static_cast<uint32_t>(i));
+  }
+}
+
+void generateUniformFloatsScalar(uint32_t key, uint32_t firstCounter,
+                                 float* out, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = shader::rngUniformAt(key, firstCounter + static_cast<uint32_t>(i));
+  }
+}
+
+}  // namespace
+
+void generateRandomWords(uint32_t key, uint32_t firstCounter, uint32_t* out,
+                         size_t count) {
+  const size_t done =
+      useAvx2() ? generateRandomWordsAvx2(key, firstCounter, out, count) : 0;
+  generateRandomWordsScalar(key, firstCounter + static_cast<uint32_t>(done),
+                            out + done, count - done);
+}
+
+void generateUniformFloats(uint32_t key, uint32_t firstCounter, float* out,
+                           size_t count) {
+  const size_t done =
+      useAvx2() ? generateUniformFloatsAvx2(key, firstCounter, out, count) : 0;
+  generateUniformFloatsScalar(key, firstCounter + static_cast<uint32_t>(done),
+                              out + done, count - done);
+}
+
+namespace {
+
+// Fills batches of `count` elements of `T` with `fill` for several keys and
+// first counters, and compares the `count - count % width` elements it
+// reports with `shader::rngAt` or `shader::rngUniformAt`
+template <typename T, typename Fill>
+std::string compareWithShader(size_t count, size_t width, Fill fill) {
+  // the last counters wrap around 2^32 within a batch
+  const uint32_t keys[]     = {0u, 1u, hostRngKey(26, 0), 0xffffffffu};
+  const uint32_t counters[] = {0u, 5u, 123456789u, 0xfffffff3u};
+
+  std::vector<T> batch(count);
+  for (const uint32_t key : keys) {
+    for (const uint32_t first : counters) {
+      const size_t done = fill(key, first, batch.data(), count);
+      if (done != count - count % width) {
+        return fmt::format("{} of {} filled", done, count);
+      }
+      for (size_t i = 0; i < done; ++i) {
+        const uint32_t counter = first + static_cast<uint32_t>(i);
+        T expected;
+        if constexpr (std::is_same_v<T, float>) {
+          expected = shader::rngUniformAt(key, counter);
+        } else {
+          expected = shader::rngAt(key, counter);
+        }
+        if (batch[i] != expected) {
+          return fmt::format("differ at key {:#x}, counter {:#x}", key,
+                             counter);
+        }
+      }
+    }
+  }
+  return "agree";
+}
+
+}  // namespace
+
+std::vector<ValidationCheck> validateRng(size_t count) {
+  const std::string expected = "agree";
+  std::vector<ValidationCheck> results;
+  results.push_back(
+      {"scalar words", expected,
+       compareWithShader<uint32_t>(
+           count, 1, [](uint32_t key, uint32_t first, uint32_t* out, size_t n) {
+             generateRandomWordsScalar(key, first, out, n);
+             return n;
+           })});
+  results.push_back(
+      {"scalar floats", expected,
+       compareWithShader<float>(
+           count, 1, [](uint32_t key, uint32_t first, float* out, size_t n) {
+             generateUniformFloatsScalar(key, first, out, n);
+             return n;
+           })});
+  if (useAvx2()) {
+    results.push_back({"avx2 words", expected,
+                       compareWithShader<uint32_t>(count, 8,
+                                                   generateRandomWordsAvx2)});
+    results.push_back({"avx2 floats", expected,
+                       compareWithShader<float>(count, 8,
+                                                generateUniformFloatsAvx2)});
+  } else {
+    spdlog::info("AVX2 not available, the batches run the scalar path");
+  }
+  results.push_back(
+      {"batch words", expected,
+       compareWithShader<uint32_t>(
+           count, 1, [](uint32_t key, uint32_t first, uint32_t* out, size_t n) {
+             generateRandomWords(key, first, out, n);
+             return n;
+           })});
+  results.push_back(
+      {"batch floats", expected,
+       compareWithShader<float>(
+           count, 1, [](uint32_t key, uint32_t first, float* out, size_t n) {
+             generateUniformFloats(key, first, out, n);
+             return n;
+           })});
+  return results;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utils/shader_functions.hpp"
+#include "utils/validation.hpp"
+
+/**
+ * @brief Host side of the counter-based RNG in `shaders/headers/rng.glsl`.
+ *
+ * Element `i` of a batch is `shader::rngUniformAt(key, firstCounter + i)`, so
+ * batches can be generated in any order or on any thread and still reproduce
+ * the exact values the shaders see. The batch generator runs 8 counters at a
+ * time with AVX2 when the CPU supports it (see `utils/rng_avx2.hpp`) and the
+ * scalar shader functions otherwise and for the rest of the batch.
+ */
+
+/// Key of a host-side random stream, e.g. for procedural scene generation
+[[nodiscard]] inline uint32_t hostRngKey(uint32_t seed, uint32_t streamIndex) {
+  return shader::rngKey(seed, streamIndex, 0u, RNG_PASS_HOST);
+}
+
+/// Fills `out[i]` with the random word `rngAt(key, firstCounter + i)`
+void generateRandomWords(uint32_t key, uint32_t firstCounter, uint32_t* out,
+                         size_t count);
+
+/// Fills `out[i]` with the uniform float `rngUniformAt(key, firstCounter + i)`
+void generateUniformFloats(uint32_t key, uint32_t firstCounter, float* out,
+                           size_t count);
+
+/// The scalar, AVX2 and dispatched batches of `count` elements against the
+/// shader functions, for several keys and first counters, some of which wrap
+/// around 2^32 within the batch
+[[nodiscard]] std::vector<ValidationCheck> validateRng(size_t count = 67);
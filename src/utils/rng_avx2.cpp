@@ -0,0 +1,69 @@
+#include "utils/rng_avx2.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+// 8-wide version of `shader::rngHash`
+inline __m256i rngHash8(__m256i v) {
+  const __m256i state =
+      _mm256_add_epi32(_mm256_mullo_epi32(v, _mm256_set1_epi32(747796405u)),
+                       _mm256_set1_epi32(static_cast<int>(2891336453u)));
+  const __m256i shift = _mm256_add_epi32(_mm256_srli_epi32(state, 28),
+                                         _mm256_set1_epi32(4));
+  const __m256i word = _mm256_mullo_epi32(
+      _mm256_xor_si256(_mm256_srlv_epi32(state, shift), state),
+      _mm256_set1_epi32(277803737u));
+  return _mm256_xor_si256(_mm256_srli_epi32(word, 22), word);
+}
+
+// 8-wide version of `shader::rngAt` for counters [first, first + 8)
+inline __m256i rngAt8(__m256i key, uint32_t first) {
+  const __m256i counters = _mm256_add_epi32(
+      _mm256_set1_epi32(static_cast<int>(first)),
+      _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  return rngHash8(_mm256_add_epi32(rngHash8(counters), key));
+}
+
+}  // namespace
+
+bool rngAvx2Compiled() { return true; }
+
+size_t generateRandomWordsAvx2(uint32_t key, uint32_t firstCounter,
+                               uint32_t* out, size_t count) {
+  const __m256i key8 = _mm256_set1_epi32(static_cast<int>(key));
+  size_t i           = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(out + i),
+        rngAt8(key8, firstCounter + static_cast<uint32_t>(i)));
+  }
+  return i;
+}
+
+size_t generateUniformFloatsAvx2(uint32_t key, uint32_t firstCounter,
+                                 float* out, size_t count) {
+  const __m256i key8  = _mm256_set1_epi32(static_cast<int>(key));
+  const __m256 scale8 = _mm256_set1_ps(1.0f / 16777216.0f);
+  size_t i            = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i words =
+        rngAt8(key8, firstCounter + static_cast<uint32_t>(i));
+    // the upper 24 bits are exactly representable, matching `rngToFloat`
+    const __m256 values = _mm256_cvtepi32_ps(_mm256_srli_epi32(words, 8));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(values, scale8));
+  }
+  return i;
+}
+#else
+bool rngAvx2Compiled() { return false; }
+
+size_t generateRandomWordsAvx2(uint32_t, uint32_t, uint32_t*, size_t) {
+  return 0;
+}
+
+size_t generateUniformFloatsAvx2(uint32_t, uint32_t, float*, size_t) {
+  return 0;
+}
+#endif
@@ -0,0 +1,29 @@
+#ifndef __VOLUME_RESTIR_UTILS_RNG_AVX2_HPP__
+#define __VOLUME_RESTIR_UTILS_RNG_AVX2_HPP__
+
+/**
+ * @file rng_avx2.hpp
+ *
+ * @brief 8-wide halves of the host RNG batches in `utils/rng.hpp`, compiled
+ * with AVX2 in `rng_avx2.cpp` and entered only when `cpuSupportsAvx2()`.
+ *
+ *  Each fills `out[0, n)` for `n`, the count rounded down to a multiple of 8,
+ *  and returns `n`, or returns 0 when the build does not compile it; the
+ *  caller finishes the batch with the scalar shader functions.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+/// False when the build compiles `rng_avx2.cpp` without AVX2
+[[nodiscard]] bool rngAvx2Compiled();
+
+[[nodiscard]] size_t generateRandomWordsAvx2(uint32_t key,
+                                             uint32_t firstCounter,
+                                             uint32_t* out, size_t count);
+
+[[nodiscard]] size_t generateUniformFloatsAvx2(uint32_t key,
+                                               uint32_t firstCounter,
+                                               float* out, size_t count);
+
+#endif /* __VOLUME_RESTIR_UTILS_RNG_AVX2_HPP__ */
@@ -0,0 +1,945 @@
+#include "utils/sampling_benchmark.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+
+#include "spdlog/spdlog.h"
+#include "utils/low_discrepancy.hpp"
+#include "utils/parallel.hpp"
+#include "utils/phat_batch.hpp"
+#include "utils/reservoir.hpp"
+#include "utils/restir_utils.h"
+#include "utils/rng.hpp"
+#include "utils/shader_functions.hpp"
+#include "utils/spatial_reuse.hpp"
+#include "utils/temporal_reuse.hpp"
+#include "utils/visibility_cache.hpp"
+
+namespace {
+
+// mirrors `lcg` and `rnd` in `shaders/headers/random.glsl`
+float lcgUniform(uint32_t& state) {
+  state = 1664525u * state + 1013904223u;
+  return float(state & 0x00FFFFFFu) / float(0x01000000);
+}
+
+// mirrors `aliasTableSample` in `shaders/restir.rgen`
+float aliasTableSample(const std::vector<AliasTableCell>& aliasTable, float r1,
+                       float r2, uint32_t& index) {
+  const uint32_t count  = static_cast<uint32_t>(aliasTable.size());
+  const uint32_t column = std::min(uint32_t(r1 * count), count - 1);
+  const AliasTableCell& cell = aliasTable[column];
+  if (cell.prob > r2) {
+    index = column;
+    return cell.pdf;
+  }
+  index = static_cast<uint32_t>(cell.alias);
+  return cell.aliasPdf;
+}
+
+float lambertTarget(const PointLight& light, const nvmath::vec3f& pos,
+                    const nvmath::vec3f& normal) {
+  nvmath::vec3f toLight =
+      nvmath::vec3f(light.pos.x, light.pos.y, light.pos.z) - pos;
+  const float dist2 = std::max(nvmath::dot(toLight, toLight), 1e-4f);
+  toLight /= std::sqrt(dist2);
+  return light.emission_luminance.w *
+         std::max(0.0f, nvmath::dot(normal, toLight)) / dist2;
+}
+
+}  // namespace
+
+std::vector<CandidateConvergenceResult> benchmarkCandidateConvergence(
+    uint32_t maxCandidateCount, uint32_t numLights, uint32_t numShadingPoints,
+    uint32_t numTrials, uint32_t seed) {
+  const nvmath::vec3f sceneMin(-10.0f, 0.0f, -10.0f);
+  const nvmath::vec3f sceneMax(10.0f, 10.0f, 10.0f);
+  const nvmath::vec3f floorNormal(0.0f, 1.0f, 0.0f);
+
+  const std::vector<PointLight> lights =
+      generatePointLights(sceneMin + nvmath::vec3f(0.0f, 1.0f, 0.0f), sceneMax,
+                          false, numLights, seed);
+  std::vector<float> pdf;
+  pdf.reserve(lights.size());
+  for (const PointLight& light : lights) {
+    pdf.push_back(light.emission_luminance.w);
+  }
+  const std::vector<AliasTableCell> aliasTable = createAliasTable(pdf);
+  const LowDiscrepancyTables tables = generateLowDiscrepancyTables();
+
+  // shading points on a regular grid over the floor, one per "pixel"
+  const uint32_t gridSize =
+      std::max<uint32_t>(1, uint32_t(std::ceil(std::sqrt(numShadingPoints))));
+
+  std::vector<CandidateConvergenceResult> results;
+  for (uint32_t m = 1; m <= maxCandidateCount; m *= 2) {
+    std::vector<double> errorRandom(numShadingPoints, 0.0);
+    std::vector<double> errorLowDiscrepancy(numShadingPoints, 0.0);
+
+    parallelBatches(numShadingPoints, [&](size_t begin, size_t end) {
+      for (size_t p = begin; p < end; ++p) {
+        const uint32_t px = static_cast<uint32_t>(p % gridSize);
+        const uint32_t py = static_cast<uint32_t>(p / gridSize);
+        const nvmath::vec3f pos(
+            sceneMin.x + (px + 0.5f) / gridSize * (sceneMax.x - sceneMin.x),
+            0.0f,
+            sceneMin.z + (py + 0.5f) / gridSize * (sceneMax.z - sceneMin.z));
+
+        double reference = 0.0;
+        for (const PointLight& light : lights) {
+          reference += lambertTarget(light, pos, floorNormal);
+        }
+        if (reference <= 0.0) {
+          continue;
+        }
+
+        for (uint32_t frame = 0; frame < numTrials; ++frame) {
+          const uint32_t key = shader::rngKey(px, py, frame,
+                                              RNG_PASS_INITIAL_SAMPLING);
+          const uint32_t ldSeed = shader::rngHash(
+              shader::rngKey(0, 0, frame, RNG_PASS_INITIAL_SAMPLING));
+          const nvmath::vec2f rotation =
+              blueNoiseRotation(tables, px, py, frame);
+          uint32_t state = key;
+
+          double sumRandom = 0.0, sumLowDiscrepancy = 0.0;
+          for (uint32_t i = 0; i < m; ++i) {
+            uint32_t index;
+            const float r1 = lcgUniform(state);
+            const float r2 = lcgUniform(state);
+            float lightPdf = aliasTableSample(aliasTable, r1, r2, index);
+            sumRandom += lambertTarget(lights[index], pos, floorNormal) /
+                         lightPdf;
+
+            const nvmath::vec2f u =
+                shader::ldOwenSobol2D(i, ldSeed, 0) + rotation;
+            lightPdf = aliasTableSample(aliasTable, u.x - std::floor(u.x),
+                                        u.y - std::floor(u.y), index);
+            sumLowDiscrepancy +=
+                lambertTarget(lights[index], pos, floorNormal) / lightPdf;
+          }
+
+          const double relRandom = sumRandom / m / reference - 1.0;
+          const double relLowDiscrepancy =
+              sumLowDiscrepancy / m / reference - 1.0;
+          errorRandom[p] += relRandom * relRandom;
+          errorLowDiscrepancy[p] += relLowDiscrepancy * relLowDiscrepancy;
+        }
+      }
+    });
+
+    double sumRandom = 0.0, sumLowDiscrepancy = 0.0;
+    for (uint32_t p = 0; p < numShadingPoints; ++p) {
+      sumRandom += errorRandom[p];
+      sumLowDiscrepancy += errorLowDiscrepancy[p];
+    }
+    const double numSamples = double(numShadingPoints) * numTrials;
+    results.push_back(CandidateConvergenceResult{
+        m, float(std::sqrt(sumRandom / numSamples)),
+        float(std::sqrt(sumLowDiscrepancy / numSamples))});
+  }
+  return results;
+}
+
+void logCandidateConvergence(
+    const std::vector<CandidateConvergenceResult>& results) {
+  spdlog::info("{:>10} {:>12} {:>12}", "candidates", "RMSE (LCG)",
+               "RMSE (Sobol)");
+  for (const CandidateConvergenceResult& result : results) {
+    spdlog::info("{:>10} {:>12.5f} {:>12.5f}", result.candidateCount,
+                 result.rmseRandom, result.rmseLowDiscrepancy);
+  }
+}
+
+PHatBenchmarkResult benchmarkPHatBatch(uint32_t numLights,
+                                       uint32_t numShadingPoints,
+                                       uint32_t seed) {
+  const std::vector<PointLight> lights =
+      generatePointLights(nvmath::vec3f(-10.0f, -10.0f, -10.0f),
+                          nvmath::vec3f(10.0f, 10.0f, 10.0f), false, numLights,
+                          seed);
+  const PointLightsSoA soa = toPointLightsSoA(lights);
+
+  // random shading points inside the light volume, looking up at the camera
+  std::vector<PHatShadingPoint> points(numShadingPoints);
+  std::vector<float> r(8);
+  const uint32_t key = hostRngKey(seed, 2);
+  for (uint32_t i = 0; i < numShadingPoints; ++i) {
+    generateUniformFloats(key, i * 8, r.data(), r.size());
+    PHatShadingPoint& p = points[i];
+    p.worldPos  = nvmath::vec3f(r[0], r[1], r[2]) * 20.0f - 10.0f;
+    p.normal    = nvmath::normalize(nvmath::vec3f(r[3] - 0.5f, 1.0f,
+                                                  r[4] - 0.5f));
+    p.camPos    = nvmath::vec3f(0.0f, 15.0f, 25.0f);
+    p.albedoLum = r[5];
+    p.roughness = r[6];
+    p.metallic  = r[7];
+  }
+
+  using Clock = std::chrono::high_resolution_clock;
+  std::vector<float> scalar(lights.size()), batch(lights.size());
+  double checksum = 0.0;
+  float maxRelativeError = 0.0f;
+
+  auto start = Clock::now();
+  for (const PHatShadingPoint& p : points) {
+    for (size_t i = 0; i < lights.size(); ++i) {
+      scalar[i] = evaluatePointLightPHat(
+          p, nvmath::vec3f(soa.posX[i], soa.posY[i], soa.posZ[i]),
+          soa.emissionLum[i]);
+    }
+    checksum += scalar[0];
+  }
+  const double scalarSeconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  for (const PHatShadingPoint& p : points) {
+    evaluatePointLightPHatBatch(p, soa, batch.data());
+    checksum += batch[0];
+  }
+  const double batchSeconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  for (const PHatShadingPoint& p : points) {
+    for (size_t i = 0; i < lights.size(); ++i) {
+      scalar[i] = evaluatePointLightPHat(
+          p, nvmath::vec3f(soa.posX[i], soa.posY[i], soa.posZ[i]),
+          soa.emissionLum[i]);
+    }
+    evaluatePointLightPHatBatch(p, soa, batch.data());
+    for (size_t i = 0; i < lights.size(); ++i) {
+      const float error = std::abs(batch[i] - scalar[i]) /
+                          std::max(std::abs(scalar[i]), 1e-20f);
+      maxRelativeError = std::max(maxRelativeError, error);
+    }
+  }
+  spdlog::debug("pHat benchmark checksum {}", checksum);
+
+  const double numEvaluations = double(numShadingPoints) * lights.size();
+  return PHatBenchmarkResult{pHatBatchWidth(),
+                             scalarSeconds * 1e9 / numEvaluations,
+                             batchSeconds * 1e9 / numEvaluations,
+                             maxRelativeError};
+}
+
+void logPHatBenchmark(const PHatBenchmarkResult& result) {
+  spdlog::info("evaluatePHat scalar: {:.3f} ns/light", result.nsPerLightScalar);
+  spdlog::info("evaluatePHat batch ({} wide): {:.3f} ns/light",
+               result.batchWidth, result.nsPerLightBatch);
+  spdlog::info("max relative deviation from the GLSL reference: {:g}",
+               result.maxRelativeError);
+}
+
+namespace {
+
+// camera of one benchmark frame, orbiting the origin
+struct BenchmarkCamera {
+  nvmath::vec3f eye;
+  nvmath::mat4f projectionView;
+  nvmath::mat4f viewInverse;
+  nvmath::mat4f projInverse;
+};
+
+BenchmarkCamera makeOrbitCamera(uint32_t frame) {
+  const float angle = 0.01f * frame;
+  BenchmarkCamera camera;
+  camera.eye = nvmath::vec3f(18.0f * std::sin(angle), 8.0f,
+                             18.0f * std::cos(angle));
+  const nvmath::mat4f view =
+      nvmath::look_at(camera.eye, nvmath::vec3f(0.0f, 0.0f, 0.0f),
+                      nvmath::vec3f(0.0f, 1.0f, 0.0f));
+  const nvmath::mat4f proj =
+      nvmath::perspectiveVK(45.0f, 1.0f, 0.1f, 1000.0f);
+  camera.projectionView = proj * view;
+  camera.viewInverse    = nvmath::invert(view);
+  camera.projInverse    = nvmath::invert(proj);
+  return camera;
+}
+
+// primary ray of `restir.rgen` against the floor y = 0
+std::optional<nvmath::vec3f> traceFloor(const BenchmarkCamera& camera,
+                                        uint32_t x, uint32_t y,
+                                        uint32_t resolution) {
+  const float dx = float(x) / resolution * 2.0f - 1.0f;
+  const float dy = float(y) / resolution * 2.0f - 1.0f;
+  const nvmath::vec4f target =
+      camera.projInverse * nvmath::vec4f(dx, dy, 1.0f, 1.0f);
+  const nvmath::vec4f direction =
+      camera.viewInverse *
+      nvmath::vec4f(nvmath::normalize(nvmath::vec3f(target)), 0.0f);
+  if (direction.y >= 0.0f) {
+    return std::nullopt;
+  }
+  const float t = -camera.eye.y / direction.y;
+  const nvmath::vec3f hit = camera.eye + t * nvmath::vec3f(direction);
+  if (std::abs(hit.x) > 10.0f || std::abs(hit.z) > 10.0f) {
+    return std::nullopt;
+  }
+  return hit;
+}
+
+}  // namespace
+
+TemporalReuseResult benchmarkTemporalReuse(uint32_t numFrames,
+                                           uint32_t numLights,
+                                           uint32_t resolution,
+                                           uint32_t historyMultiplier,
+                                           uint32_t seed) {
+  const nvmath::vec3f floorNormal(0.0f, 1.0f, 0.0f);
+  const std::vector<PointLight> lights =
+      generatePointLights(nvmath::vec3f(-10.0f, 1.0f, -10.0f),
+                          nvmath::vec3f(10.0f, 10.0f, 10.0f), false, numLights,
+                          seed);
+  std::vector<float> pdf;
+  pdf.reserve(lights.size());
+  for (const PointLight& light : lights) {
+    pdf.push_back(light.emission_luminance.w);
+  }
+  const std::vector<AliasTableCell> aliasTable = createAliasTable(pdf);
+
+  const size_t numPixels = size_t(resolution) * resolution;
+  const nvmath::vec2ui screenSize(resolution, resolution);
+  std::vector<HostReservoir> prevReservoirs(numPixels);
+  std::vector<nvmath::vec3f> prevWorldPos(numPixels);
+  std::vector<bool> prevExists(numPixels, false);
+  BenchmarkCamera prevCamera = makeOrbitCamera(0);
+
+  TemporalReuseResult result{};
+  std::vector<HostReservoir> reservoirs(numPixels);
+  std::vector<nvmath::vec3f> worldPos(numPixels);
+  std::vector<bool> exists(numPixels);
+  std::vector<double> errorFresh(numPixels), errorReuse(numPixels);
+  std::vector<uint8_t> reused(numPixels);
+  std::vector<uint8_t> mismatch(numPixels);
+
+  for (uint32_t frame = 1; frame <= numFrames; ++frame) {
+    const BenchmarkCamera camera = makeOrbitCamera(frame);
+
+    parallelBatches(numPixels, [&](size_t begin, size_t end) {
+      for (size_t p = begin; p < end; ++p) {
+        const uint32_t x = static_cast<uint32_t>(p % resolution);
+        const uint32_t y = static_cast<uint32_t>(p / resolution);
+        errorFresh[p] = errorReuse[p] = 0.0;
+        reused[p] = mismatch[p] = 0;
+
+        const std::optional<nvmath::vec3f> hit =
+            traceFloor(camera, x, y, resolution);
+        exists[p] = hit.has_value();
+        if (!hit) {
+          continue;
+        }
+        worldPos[p] = *hit;
+
+        // the current frame must reproject every surface to its own pixel
+        const std::optional<nvmath::vec2i> self =
+            reprojectToPreviousFrame(camera.projectionView, *hit, screenSize);
+        mismatch[p] = !self || self->x != int(x) || self->y != int(y);
+
+        double reference = 0.0;
+        for (const PointLight& light : lights) {
+          reference += lambertTarget(light, *hit, floorNormal);
+        }
+
+        // one initial candidate, as in restir.rgen
+        uint32_t state = shader::rngKey(x, y, frame, RNG_PASS_INITIAL_SAMPLING);
+        HostReservoir res;
+        uint32_t index;
+        const float r1       = lcgUniform(state);
+        const float r2       = lcgUniform(state);
+        const float lightPdf = aliasTableSample(aliasTable, r1, r2, index);
+        addSampleToReservoir(res, index,
+                             lambertTarget(lights[index], *hit, floorNormal),
+                             lightPdf, lcgUniform(state));
+
+        const double fresh = res.pHat * res.w / reference - 1.0;
+        errorFresh[p]      = fresh * fresh;
+
+        // temporal reuse, as in temporalReuse.comp
+        const std::optional<nvmath::vec2i> prevCoord =
+            reprojectToPreviousFrame(prevCamera.projectionView, *hit,
+                                     screenSize);
+        if (prevCoord) {
+          const size_t q = size_t(prevCoord->y) * resolution + prevCoord->x;
+          if (prevExists[q] &&
+              isSimilarSurface(*hit, floorNormal, camera.eye, prevWorldPos[q],
+                               floorNormal, prevCamera.eye)) {
+            uint32_t reuseState =
+                shader::rngKey(x, y, frame, RNG_PASS_TEMPORAL_REUSE);
+            const HostReservoir prev =
+                clampHistory(prevReservoirs[q], res, historyMultiplier);
+            combineReservoirs(
+                res, prev,
+                [&](uint32_t i) {
+                  return lambertTarget(lights[i], *hit, floorNormal);
+                },
+                [&](uint32_t i) {
+                  return lambertTarget(lights[i], prevWorldPos[q],
+                                       floorNormal);
+                },
+                lcgUniform(reuseState));
+            reused[p] = 1;
+          }
+        }
+        reservoirs[p] = res;
+
+        const double reuse = res.w > 0.0f
+                                 ? res.pHat * res.w / reference - 1.0
+                                 : -1.0;
+        errorReuse[p] = reuse * reuse;
+      }
+    });
+
+    double sumFresh = 0.0, sumReuse = 0.0;
+    size_t numValid = 0, numReused = 0;
+    for (size_t p = 0; p < numPixels; ++p) {
+      if (!exists[p]) {
+        continue;
+      }
+      sumFresh += errorFresh[p];
+      sumReuse += errorReuse[p];
+      numReused += reused[p];
+      result.reprojectionMismatches += mismatch[p];
+      ++numValid;
+    }
+    numValid = std::max<size_t>(numValid, 1);
+    result.rmseWithoutReuse.push_back(float(std::sqrt(sumFresh / numValid)));
+    result.rmseWithReuse.push_back(float(std::sqrt(sumReuse / numValid)));
+    result.reuseRate.push_back(float(numReused) / numValid);
+
+    std::swap(prevReservoirs, reservoirs);
+    std::swap(prevWorldPos, worldPos);
+    std::swap(prevExists, exists);
+    prevCamera = camera;
+  }
+  return result;
+}
+
+void logTemporalReuse(const TemporalReuseResult& result) {
+  spdlog::info("{:>6} {:>14} {:>14} {:>8}", "frame", "RMSE (fresh)",
+               "RMSE (reuse)", "reused");
+  for (size_t i = 0; i < result.rmseWithReuse.size(); ++i) {
+    if ((i & (i + 1)) == 0 || i + 1 == result.rmseWithReuse.size()) {
+      spdlog::info("{:>6} {:>14.5f} {:>14.5f} {:>7.1f}%", i + 1,
+                   result.rmseWithoutReuse[i], result.rmseWithReuse[i],
+                   100.0f * result.reuseRate[i]);
+    }
+  }
+  spdlog::info("reprojection round-trip mismatches: {}",
+               result.reprojectionMismatches);
+}
+
+std::vector<ValidationCheck> validateTemporalReuse() {
+  const TemporalReuseResult result = benchmarkTemporalReuse();
+  // the first frame has no history and is the same in both columns
+  double fresh = 0.0, reuse = 0.0;
+  for (size_t i = 1; i < result.rmseWithReuse.size(); ++i) {
+    fresh += result.rmseWithoutReuse[i];
+    reuse += result.rmseWithReuse[i];
+  }
+  const size_t numFrames = std::max<size_t>(result.rmseWithReuse.size(), 2) - 1;
+  fresh /= numFrames;
+  reuse /= numFrames;
+
+  const std::string lower = "lower with reuse";
+  return {
+      {"reprojection round trip", "0 mismatches",
+       fmt::format("{} mismatches", result.reprojectionMismatches)},
+      {"mean RMSE", lower,
+       reuse < fresh ? lower
+                     : fmt::format("{:.5f} with reuse, {:.5f} without", reuse,
+                                   fresh)},
+  };
+}
+
+SpatialReuseResult benchmarkSpatialReuse(uint32_t maxIterations,
+                                         uint32_t numNeighbors, float radius,
+                                         uint32_t numCandidates,
+                                         uint32_t numLights,
+                                         uint32_t resolution,
+                                         uint32_t numTrials, uint32_t seed) {
+  constexpr float kPi = 3.14159265358979323846f;
+  const std::vector<PointLight> lights =
+      generatePointLights(nvmath::vec3f(-10.0f, -5.0f, -10.0f),
+                          nvmath::vec3f(10.0f, 10.0f, 10.0f), false, numLights,
+                          seed);
+  std::vector<float> pdf;
+  pdf.reserve(lights.size());
+  for (const PointLight& light : lights) {
+    pdf.push_back(light.emission_luminance.w);
+  }
+  const std::vector<AliasTableCell> aliasTable = createAliasTable(pdf);
+
+  // one floor point per pixel, seen from straight above
+  const size_t numPixels = size_t(resolution) * resolution;
+  const nvmath::vec3f camPos(0.0f, 20.0f, 0.0f);
+  std::vector<nvmath::vec3f> worldPos(numPixels), normal(numPixels);
+  std::vector<double> reference(numPixels, 0.0);
+  for (size_t p = 0; p < numPixels; ++p) {
+    const uint32_t x = static_cast<uint32_t>(p % resolution);
+    const uint32_t y = static_cast<uint32_t>(p / resolution);
+    worldPos[p] = nvmath::vec3f(20.0f * (x + 0.5f) / resolution - 10.0f, 0.0f,
+                                20.0f * (y + 0.5f) / resolution - 10.0f);
+    uint32_t state  = shader::rngKey(x, y, seed, RNG_PASS_HOST);
+    const float tilt = 0.3f * kPi * lcgUniform(state);
+    const float phi  = 2.0f * kPi * lcgUniform(state);
+    normal[p] = nvmath::vec3f(std::sin(tilt) * std::cos(phi), std::cos(tilt),
+                              std::sin(tilt) * std::sin(phi));
+    for (const PointLight& light : lights) {
+      reference[p] += lambertTarget(light, worldPos[p], normal[p]);
+    }
+  }
+
+  const auto pixelIndex = [&](const nvmath::vec2i& coord) {
+    return size_t(coord.y) * resolution + coord.x;
+  };
+  const auto pHatAt = [&](const nvmath::vec2i& coord, uint32_t light) {
+    const size_t p = pixelIndex(coord);
+    return lambertTarget(lights[light], worldPos[p], normal[p]);
+  };
+
+  // per-pixel sums of the estimate and its squared error, for no reuse and
+  // for each iteration count and weighting, and the mean estimate of every
+  // trial, whose spread gives the standard error of the bias; reuse makes the
+  // pixels of a trial correlated, the trials are independent
+  constexpr ReuseWeighting kWeightings[] = {ReuseWeighting::eUniform,
+                                            ReuseWeighting::eBiasCorrected,
+                                            ReuseWeighting::eBalanceHeuristic};
+  constexpr size_t kNumWeightings = std::size(kWeightings);
+  const size_t numModes = 1 + kNumWeightings * size_t(maxIterations);
+  std::vector<double> sums(numModes * numPixels, 0.0);
+  std::vector<double> squaredErrors(numModes * numPixels, 0.0);
+  std::vector<double> trialMeans(numModes * numTrials, 0.0);
+  const auto accumulate = [&](size_t mode, uint32_t trial, size_t p,
+                              const HostReservoir& res) {
+    const double estimate = res.pHat * res.w / reference[p];
+    sums[mode * numPixels + p] += estimate;
+    squaredErrors[mode * numPixels + p] += (estimate - 1.0) * (estimate - 1.0);
+    trialMeans[mode * numTrials + trial] += estimate / numPixels;
+  };
+
+  std::vector<HostReservoir> initial(numPixels), source(numPixels),
+      target(numPixels);
+  for (uint32_t trial = 0; trial < numTrials; ++trial) {
+    // initial candidates, as in restir.rgen
+    for (size_t p = 0; p < numPixels; ++p) {
+      const uint32_t x = static_cast<uint32_t>(p % resolution);
+      const uint32_t y = static_cast<uint32_t>(p / resolution);
+      uint32_t state = shader::rngKey(x, y, trial, RNG_PASS_INITIAL_SAMPLING);
+      HostReservoir res;
+      for (uint32_t c = 0; c < numCandidates; ++c) {
+        uint32_t index;
+        const float r1       = lcgUniform(state);
+        const float r2       = lcgUniform(state);
+        const float lightPdf = aliasTableSample(aliasTable, r1, r2, index);
+        addSampleToReservoir(
+            res, index, lambertTarget(lights[index], worldPos[p], normal[p]),
+            lightPdf, lcgUniform(state));
+      }
+      finalizeReservoir(res);
+      initial[p] = res;
+      accumulate(0, trial, p, res);
+    }
+
+    for (size_t weighting = 0; weighting < kNumWeightings; ++weighting) {
+      source = initial;
+      for (uint32_t iteration = 0; iteration < maxIterations; ++iteration) {
+        const auto neighborAt =
+            [&](const nvmath::vec2i& coord) -> const HostReservoir* {
+          if (coord.x < 0 || coord.y < 0 || coord.x >= int(resolution) ||
+              coord.y >= int(resolution)) {
+            return nullptr;
+          }
+          return &source[pixelIndex(coord)];
+        };
+        parallelBatches(numPixels, [&](size_t begin, size_t end) {
+          for (size_t p = begin; p < end; ++p) {
+            const nvmath::vec2i pixel(int(p % resolution),
+                                      int(p / resolution));
+            const auto similarNeighborAt = [&](const nvmath::vec2i& coord) {
+              const HostReservoir* neighbor = neighborAt(coord);
+              const size_t q = pixelIndex(coord);
+              return neighbor != nullptr &&
+                             isSimilarSurface(worldPos[p], normal[p], camPos,
+                                              worldPos[q], normal[q], camPos)
+                         ? neighbor
+                         : nullptr;
+            };
+            uint32_t state = shader::rngHash(
+                shader::rngKey(pixel.x, pixel.y, trial,
+                               RNG_PASS_SPATIAL_REUSE) +
+                iteration);
+            target[p] = spatialReuse(
+                pixel, source[p], numNeighbors, radius, similarNeighborAt,
+                pHatAt, [&]() { return lcgUniform(state); },
+                kWeightings[weighting]);
+          }
+        });
+        std::swap(source, target);
+
+        const size_t mode =
+            1 + kNumWeightings * size_t(iteration) + weighting;
+        for (size_t p = 0; p < numPixels; ++p) {
+          accumulate(mode, trial, p, source[p]);
+        }
+      }
+    }
+  }
+
+  const auto summarize = [&](size_t mode, float& bias, float& rmse,
+                             float& stdError) {
+    double sumBias = 0.0, sumSquared = 0.0;
+    for (size_t p = 0; p < numPixels; ++p) {
+      sumBias += sums[mode * numPixels + p] / numTrials - 1.0;
+      sumSquared += squaredErrors[mode * numPixels + p];
+    }
+    bias = float(sumBias / numPixels);
+    rmse = float(std::sqrt(sumSquared / (double(numPixels) * numTrials)));
+
+    double variance = 0.0;
+    for (uint32_t trial = 0; trial < numTrials; ++trial) {
+      const double deviation =
+          trialMeans[mode * numTrials + trial] - 1.0 - bias;
+      variance += deviation * deviation;
+    }
+    variance /= std::max<uint32_t>(numTrials, 2) - 1;
+    stdError = float(std::sqrt(variance / numTrials));
+  };
+
+  SpatialReuseResult result{};
+  summarize(0, result.biasWithoutReuse, result.rmseWithoutReuse,
+            result.stdErrorWithoutReuse);
+  for (uint32_t iteration = 0; iteration < maxIterations; ++iteration) {
+    const size_t mode = 1 + kNumWeightings * size_t(iteration);
+    float bias, rmse, stdError;
+    summarize(mode, bias, rmse, stdError);
+    result.biasNaive.push_back(bias);
+    result.rmseNaive.push_back(rmse);
+    result.stdErrorNaive.push_back(stdError);
+    summarize(mode + 1, bias, rmse, stdError);
+    result.biasCorrected.push_back(bias);
+    result.rmseCorrected.push_back(rmse);
+    result.stdErrorCorrected.push_back(stdError);
+    summarize(mode + 2, bias, rmse, stdError);
+    result.biasMis.push_back(bias);
+    result.rmseMis.push_back(rmse);
+    result.stdErrorMis.push_back(stdError);
+  }
+  return result;
+}
+
+void logSpatialReuse(const SpatialReuseResult& result) {
+  spdlog::info("{:>10} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12}",
+               "iterations", "bias (1/M)", "RMSE (1/M)", "bias (1/Z)",
+               "RMSE (1/Z)", "bias (MIS)", "RMSE (MIS)");
+  spdlog::info(
+      "{:>10} {:>12.5f} {:>12.5f} {:>12.5f} {:>12.5f} {:>12.5f} {:>12.5f}", 0,
+      result.biasWithoutReuse, result.rmseWithoutReuse,
+      result.biasWithoutReuse, result.rmseWithoutReuse,
+      result.biasWithoutReuse, result.rmseWithoutReuse);
+  for (size_t i = 0; i < result.biasCorrected.size(); ++i) {
+    spdlog::info(
+        "{:>10} {:>12.5f} {:>12.5f} {:>12.5f} {:>12.5f} {:>12.5f} {:>12.5f}",
+        i + 1, result.biasNaive[i], result.rmseNaive[i],
+        result.biasCorrected[i], result.rmseCorrected[i], result.biasMis[i],
+        result.rmseMis[i]);
+  }
+}
+
+std::vector<ValidationCheck> validateSpatialReuse() {
+  // a false alarm of an unbiased estimator at 4 standard errors has a
+  // probability below 1e-4
+  constexpr float kStdErrors = 4.0f;
+  const SpatialReuseResult result = benchmarkSpatialReuse();
+
+  std::vector<ValidationCheck> results;
+  for (size_t i = 0; i < result.biasCorrected.size(); ++i) {
+    const float corrected = kStdErrors * result.stdErrorCorrected[i];
+    const std::string unbiased = fmt::format("|bias| <= {:.5f}", corrected);
+    results.push_back(
+        {fmt::format("1/Z, iteration {}", i + 1), unbiased,
+         std::abs(result.biasCorrected[i]) <= corrected
+             ? unbiased
+             : fmt::format("bias {:.5f}", result.biasCorrected[i])});
+
+    const float naive        = kStdErrors * result.stdErrorNaive[i];
+    const std::string biased  = fmt::format("|bias| > {:.5f}", naive);
+    results.push_back(
+        {fmt::format("1/M, iteration {}", i + 1), biased,
+         std::abs(result.biasNaive[i]) > naive
+             ? biased
+             : fmt::format("bias {:.5f}", result.biasNaive[i])});
+
+    const float mis = kStdErrors * result.stdErrorMis[i];
+    const std::string misUnbiased = fmt::format("|bias| <= {:.5f}", mis);
+    results.push_back(
+        {fmt::format("MIS, iteration {}", i + 1), misUnbiased,
+         std::abs(result.biasMis[i]) <= mis
+             ? misUnbiased
+             : fmt::format("bias {:.5f}", result.biasMis[i])});
+    const std::string converges =
+        fmt::format("RMSE <= {:.5f} (1/Z)", result.rmseCorrected[i]);
+    results.push_back(
+        {fmt::format("MIS RMSE, iteration {}", i + 1), converges,
+         result.rmseMis[i] <= result.rmseCorrected[i]
+             ? converges
+             : fmt::format("RMSE {:.5f}", result.rmseMis[i])});
+  }
+  return results;
+}
+
+namespace {
+
+// floor scene of `benchmarkReservoirSize`
+struct OccludedFloor {
+  std::vector<PointLight> lights;
+  std::vector<AliasTableCell> aliasTable;
+  uint32_t gridSize;
+};
+
+nvmath::vec3f occludedFloorPoint(const OccludedFloor& scene, size_t p) {
+  const float x = (p % scene.gridSize + 0.5f) / scene.gridSize;
+  const float z = (p / scene.gridSize + 0.5f) / scene.gridSize;
+  return nvmath::vec3f(20.0f * x - 10.0f, 0.0f, 20.0f * z - 10.0f);
+}
+
+// stands in for the shadow ray of a shading point, hiding every light from
+// about half of the pixels
+bool isLightVisible(uint32_t pixelKey, uint32_t light) {
+  return (shader::rngHash(pixelKey + light) & 1u) != 0;
+}
+
+/// Relative squared error of the `N`-reservoir shading of one pixel and trial,
+/// with one shared candidate stream or one stream per reservoir
+template <size_t N>
+double shadeOccludedFloor(const OccludedFloor& scene, size_t p,
+                          uint32_t trial, uint32_t numCandidates,
+                          double reference, bool shared) {
+  const nvmath::vec3f pos = occludedFloorPoint(scene, p);
+  const nvmath::vec3f normal(0.0f, 1.0f, 0.0f);
+  const uint32_t pixelKey =
+      shader::rngKey(uint32_t(p), 0u, 0u, RNG_PASS_HOST);
+  const uint32_t key =
+      shader::rngKey(uint32_t(p % scene.gridSize),
+                     uint32_t(p / scene.gridSize), trial,
+                     RNG_PASS_INITIAL_SAMPLING);
+
+  std::array<HostReservoir, N> reservoirs{};
+  if (shared) {
+    uint32_t state = key;
+    for (uint32_t c = 0; c < numCandidates; ++c) {
+      uint32_t index;
+      const float r1       = lcgUniform(state);
+      const float r2       = lcgUniform(state);
+      const float lightPdf = aliasTableSample(scene.aliasTable, r1, r2, index);
+      std::array<float, N> u;
+      for (float& value : u) {
+        value = lcgUniform(state);
+      }
+      addSampleToReservoirs(reservoirs, index,
+                            lambertTarget(scene.lights[index], pos, normal),
+                            lightPdf, u);
+    }
+  } else {
+    for (size_t i = 0; i < N; ++i) {
+      uint32_t state = shader::rngHash(key + uint32_t(i));
+      for (uint32_t c = 0; c < numCandidates; ++c) {
+        uint32_t index;
+        const float r1 = lcgUniform(state);
+        const float r2 = lcgUniform(state);
+        const float lightPdf =
+            aliasTableSample(scene.aliasTable, r1, r2, index);
+        addSampleToReservoir(reservoirs[i], index,
+                             lambertTarget(scene.lights[index], pos, normal),
+                             lightPdf, lcgUniform(state));
+      }
+    }
+  }
+
+  // `restir_post.frag` averages the reservoirs
+  double estimate = 0.0;
+  for (HostReservoir& res : reservoirs) {
+    finalizeReservoir(res);
+    if (isLightVisible(pixelKey, res.lightIndex)) {
+      estimate += double(res.pHat) * res.w;
+    }
+  }
+  const double relative = estimate / N / reference - 1.0;
+  return relative * relative;
+}
+
+template <size_t N>
+ReservoirSizeResult runReservoirSize(const OccludedFloor& scene,
+                                     uint32_t numCandidates,
+                                     uint32_t numShadingPoints,
+                                     uint32_t numTrials) {
+  std::vector<double> errorShared(numShadingPoints, 0.0);
+  std::vector<double> errorIndependent(numShadingPoints, 0.0);
+  parallelBatches(numShadingPoints, [&](size_t begin, size_t end) {
+    const nvmath::vec3f normal(0.0f, 1.0f, 0.0f);
+    for (size_t p = begin; p < end; ++p) {
+      const nvmath::vec3f pos = occludedFloorPoint(scene, p);
+      const uint32_t pixelKey =
+          shader::rngKey(uint32_t(p), 0u, 0u, RNG_PASS_HOST);
+      double reference = 0.0;
+      for (uint32_t i = 0; i < scene.lights.size(); ++i) {
+        if (isLightVisible(pixelKey, i)) {
+          reference += lambertTarget(scene.lights[i], pos, normal);
+        }
+      }
+      if (reference <= 0.0) {
+        continue;
+      }
+      for (uint32_t trial = 0; trial < numTrials; ++trial) {
+        errorShared[p] += shadeOccludedFloor<N>(scene, p, trial,
+                                                numCandidates, reference,
+                                                true);
+        errorIndependent[p] += shadeOccludedFloor<N>(
+            scene, p, trial, numCandidates, reference, false);
+      }
+    }
+  });
+
+  double sumShared = 0.0, sumIndependent = 0.0;
+  for (uint32_t p = 0; p < numShadingPoints; ++p) {
+    sumShared += errorShared[p];
+    sumIndependent += errorIndependent[p];
+  }
+  const double numSamples = double(numShadingPoints) * numTrials;
+  return ReservoirSizeResult{uint32_t(N), numCandidates,
+                             uint32_t(N) * numCandidates,
+                             float(std::sqrt(sumShared / numSamples)),
+                             float(std::sqrt(sumIndependent / numSamples))};
+}
+
+}  // namespace
+
+std::vector<ReservoirSizeResult> benchmarkReservoirSize(
+    uint32_t numCandidates, uint32_t numLights, uint32_t numShadingPoints,
+    uint32_t numTrials, uint32_t seed) {
+  OccludedFloor scene;
+  scene.lights = generatePointLights(nvmath::vec3f(-10.0f, 1.0f, -10.0f),
+                                     nvmath::vec3f(10.0f, 10.0f, 10.0f),
+                                     false, numLights, seed);
+  std::vector<float> pdf;
+  pdf.reserve(scene.lights.size());
+  for (const PointLight& light : scene.lights) {
+    pdf.push_back(light.emission_luminance.w);
+  }
+  scene.aliasTable = createAliasTable(pdf);
+  scene.gridSize   = std::max<uint32_t>(
+      1, uint32_t(std::ceil(std::sqrt(numShadingPoints))));
+  numShadingPoints = scene.gridSize * scene.gridSize;
+
+  return {
+      runReservoirSize<1>(scene, numCandidates, numShadingPoints, numTrials),
+      runReservoirSize<2>(scene, numCandidates, numShadingPoints, numTrials),
+      runReservoirSize<4>(scene, numCandidates, numShadingPoints, numTrials),
+      runReservoirSize<8>(scene, numCandidates, numShadingPoints, numTrials),
+  };
+}
+
+void logReservoirSize(const std::vector<ReservoirSizeResult>& results) {
+  spdlog::info("{:>10} {:>14} {:>14} {:>14} {:>14}", "reservoirs",
+               "evals (shared)", "RMSE (shared)", "evals (indep.)",
+               "RMSE (indep.)");
+  for (const ReservoirSizeResult& result : results) {
+    spdlog::info("{:>10} {:>14} {:>14.5f} {:>14} {:>14.5f}",
+                 result.reservoirSize, result.sharedEvaluations,
+                 result.rmseShared, result.independentEvaluations,
+                 result.rmseIndependent);
+  }
+}
+
+std::vector<VisibilityCacheResult> benchmarkVisibilityCache(
+    uint32_t numFrames, uint32_t numCandidates, uint32_t numShadingPoints,
+    uint32_t maxAge, uint32_t maxAgeMoving, uint32_t seed) {
+  const nvmath::vec3f normal(0.0f, 1.0f, 0.0f);
+  const uint32_t gridSize =
+      std::max<uint32_t>(1, uint32_t(std::ceil(std::sqrt(numShadingPoints))));
+  numShadingPoints = gridSize * gridSize;
+  // the camera 20 units above the floor, sliding by about one cache cell every
+  // two frames when it moves
+  const float depth = 20.0f;
+  const nvmath::vec3f velocity(0.03f, 0.0f, 0.0f);
+
+  std::vector<VisibilityCacheResult> results;
+  for (uint32_t numLights = 4; numLights <= 2048; numLights *= 8) {
+    const std::vector<PointLight> lights =
+        generatePointLights(nvmath::vec3f(-10.0f, 1.0f, -10.0f),
+                            nvmath::vec3f(10.0f, 10.0f, 10.0f), false,
+                            numLights, seed);
+    std::vector<float> pdf;
+    pdf.reserve(lights.size());
+    for (const PointLight& light : lights) {
+      pdf.push_back(light.emission_luminance.w);
+    }
+    const std::vector<AliasTableCell> aliasTable = createAliasTable(pdf);
+
+    VisibilityCacheResult result{numLights, 0.0f, 0.0f};
+    for (int moving = 0; moving < 2; ++moving) {
+      std::vector<uint32_t> rays(numShadingPoints, 0);
+      parallelBatches(numShadingPoints, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+          const uint32_t x = static_cast<uint32_t>(p % gridSize);
+          const uint32_t y = static_cast<uint32_t>(p / gridSize);
+          const nvmath::vec3f base(20.0f * (x + 0.5f) / gridSize - 10.0f, 0.0f,
+                                   20.0f * (y + 0.5f) / gridSize - 10.0f);
+          VisibilityCacheEntry entry;  // cleared, epoch 0
+          for (uint32_t frame = 1; frame <= numFrames; ++frame) {
+            const nvmath::vec3f pos =
+                moving ? base + float(frame) * velocity : base;
+            uint32_t state =
+                shader::rngKey(x, y, frame, RNG_PASS_INITIAL_SAMPLING);
+            HostReservoir res;
+            for (uint32_t c = 0; c < numCandidates; ++c) {
+              uint32_t index;
+              const float r1       = lcgUniform(state);
+              const float r2       = lcgUniform(state);
+              const float lightPdf = aliasTableSample(aliasTable, r1, r2,
+                                                      index);
+              addSampleToReservoir(res, index,
+                                   lambertTarget(lights[index], pos, normal),
+                                   lightPdf, lcgUniform(state));
+            }
+            finalizeReservoir(res);
+            if (res.w <= 0.0f) {
+              continue;
+            }
+            const uint32_t lightKey = visibilityCacheLightKey(
+                res.lightIndex, res.lightKind, res.sampleSeed);
+            const uint32_t positionKey = visibilityCachePositionKey(pos,
+                                                                    depth);
+            if (!isVisibilityCacheHit(entry, lightKey, positionKey, 1, frame,
+                                      moving ? maxAgeMoving : maxAge)) {
+              entry = makeVisibilityCacheEntry(lightKey, positionKey, 1,
+                                               frame, false);
+              ++rays[p];
+            }
+          }
+        }
+      });
+      double sum = 0.0;
+      for (uint32_t count : rays) {
+        sum += count;
+      }
+      const float perPixelFrame =
+          float(sum / (double(numShadingPoints) * numFrames));
+      (moving ? result.raysMoving : result.raysStatic) = perPixelFrame;
+    }
+    results.push_back(result);
+  }
+  return results;
+}
+
+void logVisibilityCache(const std::vector<VisibilityCacheResult>& results) {
+  spdlog::info("{:>8} {:>16} {:>16}", "lights", "rays (static)",
+               "rays (moving)");
+  for (const VisibilityCacheResult& result : results) {
+    spdlog::info("{:>8} {:>16.4f} {:>16.4f}", result.numLights,
+                 result.raysStatic, result.raysMoving);
+  }
+}
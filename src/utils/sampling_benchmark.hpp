@@ -0,0 +1,156 @@
+#ifndef __VOLUME_RESTIR_UTILS_SAMPLING_BENCHMARK_HPP__
+#define __VOLUME_RESTIR_UTILS_SAMPLING_BENCHMARK_HPP__
+
+/**
+ * @file sampling_benchmark.hpp
+ *
+ * @brief CPU convergence benchmark of the initial candidate sampling in
+ * `restir.rgen`.
+ *
+ *  Shading points on a floor below a set of random point lights estimate the
+ *  unshadowed Lambertian light sum from `M` alias-table candidates, once with
+ *  the LCG stream of `restir.rgen` without `RESTIR_LOW_DISCREPANCY_FLAG` and
+ *  once with the Owen-scrambled Sobol points rotated by the blue noise that
+ *  the flag, on by default, selects. Each trial uses the frame index as its
+ *  seed, like consecutive frames on the GPU.
+ *
+ *  The target-function micro-benchmark times `evaluatePointLightPHatBatch`
+ *  against the scalar reference, the GLSL `evaluatePHat` compiled for the
+ *  host, and reports their largest relative deviation (`--validate-phat`
+ *  checks it against its tolerances).
+ *
+ *  The temporal benchmark renders the same floor through a slowly orbiting
+ *  camera with one candidate per pixel and frame, and runs the host
+ *  reference of `temporalReuse.comp` against fresh reservoirs every frame.
+ *
+ *  The spatial benchmark shades a grid of floor points with randomly tilted
+ *  normals, lit by lights on both sides of the floor, so neighbours often
+ *  cannot produce every sample of a pixel. Starting from `numCandidates`
+ *  initial candidates per pixel, it averages the host reference of
+ *  `spatialReuse.comp` over many trials with 1 / M, 1 / Z and balance
+ *  heuristic weights, and reports the mean relative bias against the exact
+ *  light sum (`--validate-spatial` bounds it by its standard error).
+ *
+ *  The reservoir-size benchmark shades floor points whose lights are each
+ *  hidden from half of the pixels, so the shaded estimate depends on the
+ *  selected lights and not only on the candidate weights. It compares `N`
+ *  reservoirs fed from one shared candidate stream, as `RESERVOIR_SIZE` does
+ *  in `restir.rgen`, with `N` reservoirs drawing their own candidates.
+ *
+ *  The visibility-cache benchmark replays the candidate selection of
+ *  `restir.rgen` on the floor for a number of frames and counts the shadow
+ *  rays the cache of `utils/visibility_cache.hpp` cannot answer, for a static
+ *  camera and for one sliding over the floor.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utils/validation.hpp"
+
+struct CandidateConvergenceResult {
+  uint32_t candidateCount;
+  float rmseRandom;            // relative RMSE of the LCG path
+  float rmseLowDiscrepancy;    // relative RMSE of the Owen-Sobol path
+};
+
+/// Runs candidate counts 1, 2, 4, ... up to `maxCandidateCount`
+[[nodiscard]] std::vector<CandidateConvergenceResult>
+benchmarkCandidateConvergence(uint32_t maxCandidateCount = 64,
+                              uint32_t numLights         = 1000,
+                              uint32_t numShadingPoints  = 1024,
+                              uint32_t numTrials         = 64,
+                              uint32_t seed              = 0);
+
+void logCandidateConvergence(
+    const std::vector<CandidateConvergenceResult>& results);
+
+struct PHatBenchmarkResult {
+  size_t batchWidth;
+  double nsPerLightScalar;
+  double nsPerLightBatch;
+  float maxRelativeError;
+};
+
+[[nodiscard]] PHatBenchmarkResult benchmarkPHatBatch(
+    uint32_t numLights = 4096, uint32_t numShadingPoints = 4096,
+    uint32_t seed = 0);
+
+void logPHatBenchmark(const PHatBenchmarkResult& result);
+
+struct TemporalReuseResult {
+  std::vector<float> rmseWithoutReuse;  // relative RMSE per frame
+  std::vector<float> rmseWithReuse;
+  std::vector<float> reuseRate;         // pixels that found a history
+  uint32_t reprojectionMismatches;      // current-frame round trips that
+                                        // missed their own pixel
+};
+
+[[nodiscard]] TemporalReuseResult benchmarkTemporalReuse(
+    uint32_t numFrames = 32, uint32_t numLights = 1000,
+    uint32_t resolution = 64, uint32_t historyMultiplier = 20,
+    uint32_t seed = 0);
+
+void logTemporalReuse(const TemporalReuseResult& result);
+
+/// The temporal benchmark with its defaults: no surface may reproject to
+/// another pixel of its own frame, and the RMSE averaged over the frames with
+/// a history must be lower with reuse than without
+[[nodiscard]] std::vector<ValidationCheck> validateTemporalReuse();
+
+struct SpatialReuseResult {
+  float biasWithoutReuse;      // mean relative bias over all pixels
+  float rmseWithoutReuse;      // relative RMSE of a single trial
+  float stdErrorWithoutReuse;  // standard error of the bias
+  // per iteration count 1, 2, ..., normalized by 1 / M, by 1 / Z and with
+  // balance heuristic MIS weights
+  std::vector<float> biasNaive, rmseNaive, stdErrorNaive;
+  std::vector<float> biasCorrected, rmseCorrected, stdErrorCorrected;
+  std::vector<float> biasMis, rmseMis, stdErrorMis;
+};
+
+[[nodiscard]] SpatialReuseResult benchmarkSpatialReuse(
+    uint32_t maxIterations = 2, uint32_t numNeighbors = 4,
+    float radius = 5.0f, uint32_t numCandidates = 16, uint32_t numLights = 1000,
+    uint32_t resolution = 32, uint32_t numTrials = 256, uint32_t seed = 0);
+
+void logSpatialReuse(const SpatialReuseResult& result);
+
+/// The spatial benchmark with its defaults, per iteration count: the 1 / Z
+/// and MIS biases within four standard errors of 0, and the 1 / M bias
+/// outside of them, which shows that the scene reveals a bias at all; MIS
+/// must also not have a larger RMSE than 1 / Z
+[[nodiscard]] std::vector<ValidationCheck> validateSpatialReuse();
+
+struct ReservoirSizeResult {
+  uint32_t reservoirSize;
+  uint32_t sharedEvaluations;       // target evaluations per pixel
+  uint32_t independentEvaluations;
+  float rmseShared;                 // relative RMSE of the shaded estimate
+  float rmseIndependent;
+};
+
+/// Runs reservoir sizes 1, 2, 4 and 8
+[[nodiscard]] std::vector<ReservoirSizeResult> benchmarkReservoirSize(
+    uint32_t numCandidates = 32, uint32_t numLights = 1000,
+    uint32_t numShadingPoints = 1024, uint32_t numTrials = 64,
+    uint32_t seed = 0);
+
+void logReservoirSize(const std::vector<ReservoirSizeResult>& results);
+
+struct VisibilityCacheResult {
+  uint32_t numLights;
+  float raysStatic;  // shadow rays per pixel and frame
+  float raysMoving;
+};
+
+/// Runs light counts 4, 32, 256 and 2048
+[[nodiscard]] std::vector<VisibilityCacheResult> benchmarkVisibilityCache(
+    uint32_t numFrames = 64, uint32_t numCandidates = 64,
+    uint32_t numShadingPoints = 4096, uint32_t maxAge = 16,
+    uint32_t maxAgeMoving = 2, uint32_t seed = 0);
+
+void logVisibilityCache(const std::vector<VisibilityCacheResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_SAMPLING_BENCHMARK_HPP__ */
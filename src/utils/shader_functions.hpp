@@ -2,6 +2,13 @@
 #include <nvmath/nvmath.h>
 #include <nvmath/nvmath_glsltypes.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// included by the shared headers below, outside of the namespace
+#include "shaders/host_device.h"
+
 #define KIND_SPHERE 0
 #define KIND_CUBE   1
 
@@ -9,6 +16,7 @@ namespace shader {
 
 #define uint  ::std::uint32_t
 #define vec2  ::nvmath::vec2
+#define vec3  ::nvmath::vec3
 #define vec4  ::nvmath::vec4
 #define ivec2 ::nvmath::ivec2
 #define ivec4 ::nvmath::ivec4
@@ -18,10 +26,31 @@ namespace shader {
 
 #define CPP_FUNCTION inline
 
+// GLSL built-ins on floats, which GLSL evaluates in single precision whatever
+// the type of the literals
+CPP_FUNCTION float clamp(float x, float minVal, float maxVal) {
+  return std::min(std::max(x, minVal), maxVal);
+}
+CPP_FUNCTION float max(float x, float y) { return std::max(x, y); }
+CPP_FUNCTION float abs(float x) { return std::abs(x); }
+CPP_FUNCTION float pow(float x, float y) { return std::pow(x, y); }
+CPP_FUNCTION float mix(float x, float y, float a) {
+  return x * (1.0f - a) + y * a;
+}
+CPP_FUNCTION vec3 mix(const vec3& x, const vec3& y, float a) {
+  return x * (1.0f - a) + y * a;
+}
+
 #include "shaders/headers/common.glsl"
+#include "shaders/headers/rng.glsl"
+#include "shaders/headers/lowDiscrepancy.glsl"
+#include "shaders/headers/phase.glsl"
+#include "shaders/headers/transmittance.glsl"
+#include "shaders/headers/disneyBRDF.glsl"
 
 #undef uint
 #undef vec2
+#undef vec3
 #undef vec4
 #undef ivec2
 #undef ivec4
@@ -0,0 +1,12 @@
+#include "utils/spatial_reuse.hpp"
+
+#include <cmath>
+
+nvmath::vec2i spatialNeighborCoord(const nvmath::vec2i& pixel, float radius,
+                                   float u1, float u2) {
+  constexpr float kPi = 3.14159265358979323846f;
+  const float r     = radius * std::sqrt(u1);
+  const float angle = 2.0f * kPi * u2;
+  return pixel + nvmath::vec2i(int(std::round(r * std::cos(angle))),
+                               int(std::round(r * std::sin(angle))));
+}
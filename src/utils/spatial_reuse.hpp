@@ -0,0 +1,104 @@
+#ifndef __VOLUME_RESTIR_UTILS_SPATIAL_REUSE_HPP__
+#define __VOLUME_RESTIR_UTILS_SPATIAL_REUSE_HPP__
+
+/**
+ * @file spatial_reuse.hpp
+ *
+ * @brief Host reference of one iteration of `shaders/spatialReuse.comp` for a
+ * single pixel.
+ *
+ *  The uniform numbers are drawn from `uniform()` in the order the shader
+ *  draws them from `rnd(seed)`: two per neighbour for its position, then,
+ *  once all neighbours are chosen, one per reservoir with a non-zero
+ *  resampling weight.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#include "utils/reservoir.hpp"
+
+// keep in sync with spatialReuse.comp
+constexpr uint32_t kMaxSpatialNeighbors = 8;
+
+/// Neighbour of `pixel` for two uniform numbers, uniform in the disk of
+/// `radius` pixels
+[[nodiscard]] nvmath::vec2i spatialNeighborCoord(const nvmath::vec2i& pixel,
+                                                 float radius, float u1,
+                                                 float u2);
+
+/**
+ * @brief Resamples up to `numNeighbors` neighbouring reservoirs into `center`.
+ *
+ *  `neighborAt(coord)` returns the reservoir of a neighbour that passes the
+ *  bounds and surface similarity tests, or nullptr. `pHatAt(coord, i)` is the
+ *  target of light `i` at pixel `coord`. `ReuseWeighting::eUniform`
+ *  normalizes by the total sample count instead of Z, which is biased
+ *  wherever the neighbours cannot produce every sample of the pixel.
+ */
+template <typename NeighborAt, typename PHatAt, typename Uniform>
+HostReservoir spatialReuse(
+    const nvmath::vec2i& pixel, const HostReservoir& center,
+    uint32_t numNeighbors, float radius, NeighborAt&& neighborAt,
+    PHatAt&& pHatAt, Uniform&& uniform,
+    ReuseWeighting weighting = ReuseWeighting::eBiasCorrected) {
+  // index 0 is the pixel itself
+  nvmath::vec2i coords[kMaxSpatialNeighbors + 1] = {pixel};
+  const HostReservoir* reservoirs[kMaxSpatialNeighbors + 1] = {&center};
+  uint32_t count = 1;
+  numNeighbors   = std::min(numNeighbors, kMaxSpatialNeighbors);
+  for (uint32_t i = 0; i < numNeighbors; ++i) {
+    const float u1 = uniform();
+    const float u2 = uniform();
+    const nvmath::vec2i coord = spatialNeighborCoord(pixel, radius, u1, u2);
+    if (coord == pixel) {
+      continue;
+    }
+    const HostReservoir* neighbor = neighborAt(coord);
+    if (neighbor == nullptr) {
+      continue;
+    }
+    coords[count]     = coord;
+    reservoirs[count] = neighbor;
+    ++count;
+  }
+
+  if (weighting == ReuseWeighting::eBalanceHeuristic) {
+    return combineReservoirsMis(
+        reservoirs, count,
+        [&](uint32_t j, uint32_t light) { return pHatAt(coords[j], light); },
+        uniform);
+  }
+
+  HostReservoir res;
+  for (uint32_t i = 0; i < count; ++i) {
+    const HostReservoir& other = *reservoirs[i];
+    const float pHat = i == 0 ? other.pHat : pHatAt(pixel, other.lightIndex);
+    res.numStreamSamples += other.numStreamSamples;
+    const float weight = pHat * other.w * other.numStreamSamples;
+    if (weight > 0.0f) {
+      updateReservoir(res, other.lightIndex, weight, pHat, other.w,
+                      uniform());
+    }
+  }
+
+  if (res.sumWeights > 0.0f && res.pHat > 0.0f) {
+    uint32_t z = res.numStreamSamples;
+    if (weighting == ReuseWeighting::eBiasCorrected) {
+      z = center.numStreamSamples;
+      for (uint32_t i = 1; i < count; ++i) {
+        if (pHatAt(coords[i], res.lightIndex) > 0.0f) {
+          z += reservoirs[i]->numStreamSamples;
+        }
+      }
+    }
+    res.w = z > 0 ? res.sumWeights / (z * res.pHat) : 0.0f;
+  } else {
+    res.w = 0.0f;
+  }
+  return res;
+}
+
+#endif /* __VOLUME_RESTIR_UTILS_SPATIAL_REUSE_HPP__ */
@@ -0,0 +1,178 @@
+#include "utils/staging_ring.hpp"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+#include "utils/rng.hpp"
+
+std::optional<VkDeviceSize> StagingRing::allocate(VkDeviceSize size,
+                                                  VkDeviceSize alignment) {
+  if (size == 0 || size > m_capacity) {
+    return std::nullopt;
+  }
+  if (m_used == 0) {
+    m_head = 0;
+  }
+  alignment = std::max<VkDeviceSize>(alignment, 1);
+  VkDeviceSize offset = (m_head + alignment - 1) / alignment * alignment;
+  VkDeviceSize padded = offset + size - m_head;
+  if (offset + size > m_capacity) {
+    // skip the end of the ring
+    offset = 0;
+    padded = m_capacity - m_head + size;
+  }
+  if (m_used + padded > m_capacity) {
+    return std::nullopt;
+  }
+  m_used += padded;
+  m_open += padded;
+  m_head = offset + size;
+  return offset;
+}
+
+void StagingRing::close(uint64_t value) {
+  if (m_open > 0) {
+    m_closed.push_back({value, m_open});
+    m_open = 0;
+  }
+}
+
+void StagingRing::release(uint64_t completed) {
+  while (!m_closed.empty() && m_closed.front().value <= completed) {
+    m_used -= m_closed.front().bytes;
+    m_closed.pop_front();
+  }
+}
+
+std::optional<uint64_t> StagingRing::oldestPending() const {
+  if (m_closed.empty()) {
+    return std::nullopt;
+  }
+  return m_closed.front().value;
+}
+
+namespace {
+
+struct UploadSizes {
+  const char* name;
+  uint32_t maxQuarters;  // of the ring
+  uint32_t minBytes;
+};
+
+StagingValidationResult replay(const UploadSizes& sizes, uint32_t sequences,
+                               uint32_t seed) {
+  constexpr uint64_t kOpen = ~0ull;
+  struct Live {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint64_t value;
+  };
+
+  StagingValidationResult result{sizes.name, 0, 0, 0, 0, 0.0, 0, 0, 0};
+  for (uint32_t sequence = 0; sequence < sequences; ++sequence) {
+    const uint32_t key = hostRngKey(seed, sequence + 1);
+    uint32_t counter   = 0;
+    const auto draw    = [&](uint32_t n) {
+      uint32_t word;
+      generateRandomWords(key, counter++, &word, 1);
+      return word % n;
+    };
+
+    StagingRing ring(VkDeviceSize(16 + draw(48)) * 4096);
+    uint64_t submitted = 0, completed = 0;
+    std::vector<Live> live;
+    const auto complete = [&](uint64_t value) {
+      completed = std::max(completed, std::min(value, submitted));
+      ring.release(completed);
+      live.erase(std::remove_if(live.begin(), live.end(),
+                                [&](const Live& l) {
+                                  return l.value <= completed;
+                                }),
+                 live.end());
+    };
+    const auto submit = [&] {
+      if (ring.hasOpenAllocations()) {
+        ring.close(++submitted);
+        for (Live& l : live) {
+          l.value = l.value == kOpen ? submitted : l.value;
+        }
+        ++result.submissions;
+      }
+    };
+
+    for (uint32_t upload = 0; upload < 64; ++upload) {
+      const VkDeviceSize size =
+          sizes.minBytes +
+          VkDeviceSize(draw(sizes.maxQuarters * 1024)) * ring.capacity() / 4096;
+      const VkDeviceSize alignment = VkDeviceSize(1) << draw(9);
+      ++result.uploads;
+      // as UploadManager::copy
+      for (VkDeviceSize done = 0; done < size;) {
+        const VkDeviceSize chunk = std::min(size - done, ring.maxChunk());
+        const std::optional<VkDeviceSize> offset =
+            ring.allocate(chunk, alignment);
+        if (!offset) {
+          submit();
+          const std::optional<uint64_t> pending = ring.oldestPending();
+          if (!pending) {
+            ++result.stallErrors;
+            break;
+          }
+          complete(*pending);
+          ++result.waits;
+          continue;
+        }
+        const bool inRange = *offset % alignment == 0 &&
+                             *offset + chunk <= ring.capacity() &&
+                             ring.used() <= ring.capacity();
+        result.rangeErrors += inRange ? 0 : 1;
+        result.overlapErrors += uint32_t(
+            std::count_if(live.begin(), live.end(), [&](const Live& l) {
+              return l.offset < *offset + chunk && *offset < l.offset + l.size;
+            }));
+        live.push_back({*offset, chunk, kOpen});
+        result.fill += double(ring.used()) / ring.capacity();
+        ++result.chunks;
+        done += chunk;
+      }
+      if (draw(4) == 0) {
+        submit();
+      }
+      // the device catches up with some of the submissions
+      complete(completed + draw(3));
+    }
+  }
+  result.fill /= std::max(result.chunks, 1u);
+  return result;
+}
+
+}  // namespace
+
+std::vector<StagingValidationResult> validateStagingRing(uint32_t sequences,
+                                                         uint32_t seed) {
+  return {replay({"small", 1, 1}, sequences, seed),
+          replay({"large", 12, 1}, sequences, seed),
+          replay({"ring-sized", 1, 1 << 18}, sequences, seed)};
+}
+
+bool isStagingRingValid(const std::vector<StagingValidationResult>& results) {
+  return std::all_of(results.begin(), results.end(),
+                     [](const StagingValidationResult& result) {
+                       return result.overlapErrors == 0 &&
+                              result.rangeErrors == 0 &&
+                              result.stallErrors == 0;
+                     });
+}
+
+void logStagingRing(const std::vector<StagingValidationResult>& results) {
+  spdlog::info("{:>10} {:>7} {:>7} {:>11} {:>6} {:>5} {:>8} {:>6} {:>6}",
+               "scenario", "uploads", "chunks", "submissions", "waits", "fill",
+               "overlaps", "ranges", "stalls");
+  for (const StagingValidationResult& result : results) {
+    spdlog::info(
+        "{:>10} {:>7} {:>7} {:>11} {:>6} {:>4.0f}% {:>8} {:>6} {:>6}",
+        result.scenario, result.uploads, result.chunks, result.submissions,
+        result.waits, 100.0 * result.fill, result.overlapErrors,
+        result.rangeErrors, result.stallErrors);
+  }
+}
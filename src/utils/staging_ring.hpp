@@ -0,0 +1,89 @@
+#ifndef __VOLUME_RESTIR_UTILS_STAGING_RING_HPP__
+#define __VOLUME_RESTIR_UTILS_STAGING_RING_HPP__
+
+/**
+ * @file staging_ring.hpp
+ *
+ * @brief Offsets into a fixed-size staging buffer for uploads, reused once the
+ * device has finished reading them; plain C++ so that it runs without a
+ * device.
+ *
+ *  Allocations are made one after the other and wrap around to the start of
+ *  the buffer, skipping the end when it is too short. The allocations made
+ *  between two calls of `close` belong to one submission, identified by the
+ *  value its timeline semaphore signals, and are freed together by `release`
+ *  once that value is reached. Uploads larger than the ring are split into
+ *  chunks by the caller, see `UploadManager`.
+ */
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+class StagingRing {
+public:
+  explicit StagingRing(VkDeviceSize capacity = 0) : m_capacity(capacity) {}
+
+  /// Offset of `size` bytes aligned to `alignment`, nothing when the ring is
+  /// too full until a submission completes
+  [[nodiscard]] std::optional<VkDeviceSize> allocate(VkDeviceSize size,
+                                                     VkDeviceSize alignment);
+
+  /// The allocations since the previous call are read until `value`
+  void close(uint64_t value);
+
+  /// Frees the allocations closed with a value up to `completed`
+  void release(uint64_t completed);
+
+  /// Value to wait for before the oldest closed allocations are freed
+  [[nodiscard]] std::optional<uint64_t> oldestPending() const;
+
+  /// Largest chunk of an upload, so that the copy of a chunk overlaps the
+  /// filling of the next ones
+  [[nodiscard]] VkDeviceSize maxChunk() const { return m_capacity / 4; }
+
+  [[nodiscard]] VkDeviceSize capacity() const { return m_capacity; }
+  [[nodiscard]] VkDeviceSize used() const { return m_used; }  // with padding
+  [[nodiscard]] bool hasOpenAllocations() const { return m_open > 0; }
+
+private:
+  struct Region {
+    uint64_t value;
+    VkDeviceSize bytes;
+  };
+
+  VkDeviceSize m_capacity;
+  VkDeviceSize m_head = 0;  // next free byte
+  VkDeviceSize m_used = 0;  // from the oldest live byte to the head
+  VkDeviceSize m_open = 0;  // of the allocations not closed yet
+  std::deque<Region> m_closed;
+};
+
+struct StagingValidationResult {
+  std::string scenario;
+  uint32_t uploads;
+  uint32_t chunks;
+  uint32_t submissions;
+  uint32_t waits;          // for the device to free ring space
+  double fill;             // mean used fraction of the ring at allocation
+  uint32_t overlapErrors;  // allocations over bytes the device still reads
+  uint32_t rangeErrors;    // misaligned or outside the ring
+  uint32_t stallErrors;    // failures with nothing left to wait for
+};
+
+/// Replays random uploads, split in chunks and submitted as `UploadManager`
+/// does, against a device completing submissions at random times
+[[nodiscard]] std::vector<StagingValidationResult> validateStagingRing(
+    uint32_t sequences = 256, uint32_t seed = 0);
+
+/// False if an allocation is wrong in any scenario
+[[nodiscard]] bool isStagingRingValid(
+    const std::vector<StagingValidationResult>& results);
+
+void logStagingRing(const std::vector<StagingValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_STAGING_RING_HPP__ */
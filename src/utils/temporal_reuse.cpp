@@ -0,0 +1,31 @@
+#include "utils/temporal_reuse.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+std::optional<nvmath::vec2i> reprojectToPreviousFrame(
+    const nvmath::mat4f& prevProjectionView, const nvmath::vec3f& worldPos,
+    const nvmath::vec2ui& screenSize) {
+  const nvmath::vec4f clip =
+      prevProjectionView * nvmath::vec4f(worldPos, 1.0f);
+  if (clip.w <= 0.0f) {
+    return std::nullopt;
+  }
+  const float px = (clip.x / clip.w + 1.0f) * 0.5f * float(screenSize.x);
+  const float py = (clip.y / clip.w + 1.0f) * 0.5f * float(screenSize.y);
+  const nvmath::vec2i coord(int(std::floor(px + 0.5f)),
+                            int(std::floor(py + 0.5f)));
+  if (coord.x < 0 || coord.y < 0 || coord.x >= int(screenSize.x) ||
+      coord.y >= int(screenSize.y)) {
+    return std::nullopt;
+  }
+  return coord;
+}
+
+HostReservoir clampHistory(HostReservoir prev, const HostReservoir& current,
+                           uint32_t multiplier) {
+  prev.numStreamSamples =
+      std::min(prev.numStreamSamples,
+               multiplier * std::max(current.numStreamSamples, 1u));
+  return prev;
+}
@@ -0,0 +1,30 @@
+#ifndef __VOLUME_RESTIR_UTILS_TEMPORAL_REUSE_HPP__
+#define __VOLUME_RESTIR_UTILS_TEMPORAL_REUSE_HPP__
+
+/**
+ * @file temporal_reuse.hpp
+ *
+ * @brief Host reference of `shaders/temporalReuse.comp`: reprojection into
+ * the previous frame and history clamping. The surface similarity test is
+ * `isSimilarSurface` in `utils/reservoir.hpp`.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <cstdint>
+#include <optional>
+
+#include "utils/reservoir.hpp"
+
+/// Pixel of the previous frame that saw `worldPos`, where pixel p looks
+/// through NDC 2p / size - 1 as the camera rays of `restir.rgen` do
+[[nodiscard]] std::optional<nvmath::vec2i> reprojectToPreviousFrame(
+    const nvmath::mat4f& prevProjectionView, const nvmath::vec3f& worldPos,
+    const nvmath::vec2ui& screenSize);
+
+/// Caps the history of `prev` to `multiplier` times the current sample count
+[[nodiscard]] HostReservoir clampHistory(HostReservoir prev,
+                                         const HostReservoir& current,
+                                         uint32_t multiplier);
+
+#endif /* __VOLUME_RESTIR_UTILS_TEMPORAL_REUSE_HPP__ */
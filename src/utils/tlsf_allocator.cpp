@@ -0,0 +1,729 @@
+#include "utils/tlsf_allocator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+#include "spdlog/spdlog.h"
+#include "utils/rng.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// index of the highest set bit of a non-zero value
+uint32_t highestBit(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return index;
+#else
+  return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+// index of the lowest set bit of a non-zero value
+uint32_t lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}  // namespace
+
+TlsfAllocator::TlsfAllocator() {
+  for (auto& heads : m_heads) {
+    heads.fill(kNoNode);
+  }
+}
+
+uint32_t TlsfAllocator::addBlock(VkDeviceSize size) {
+  const uint32_t node  = newNode();
+  const uint32_t block = static_cast<uint32_t>(m_blocks.size());
+  m_nodes[node]        = freeRange(block, 0, size, kNoNode, kNoNode);
+  m_blocks.push_back({size, 0, node});
+  insertFree(node);
+  return block;
+}
+
+std::optional<TlsfAllocation> TlsfAllocator::allocate(VkDeviceSize size,
+                                                      VkDeviceSize alignment) {
+  size      = std::max<VkDeviceSize>(size, 1);
+  alignment = std::max<VkDeviceSize>(alignment, 1);
+  const auto fits = [&](uint32_t node) {
+    const Node& range = m_nodes[node];
+    return alignUp(range.offset, alignment) + size <= range.offset + range.size;
+  };
+  // the head of the list of the size may fit, else any range of the next
+  // lists does once aligned
+  uint32_t node        = kNoNode;
+  const ListIndex list = listOf(size);
+  const uint32_t head  = m_heads[list.first][list.second];
+  if (head != kNoNode && fits(head)) {
+    node = head;
+  } else {
+    node = findFree(size + alignment - 1);
+  }
+  if (node == kNoNode) {
+    return std::nullopt;
+  }
+  removeFree(node);
+
+  // the padding in front goes back to the free lists; the range before is
+  // not free, ranges next to a free one never are
+  const VkDeviceSize padding =
+      alignUp(m_nodes[node].offset, alignment) - m_nodes[node].offset;
+  if (padding > 0) {
+    const uint32_t front = newNode();
+    Node& range          = m_nodes[node];
+    m_nodes[front] =
+        freeRange(range.block, range.offset, padding, range.prevPhysical, node);
+    if (range.prevPhysical != kNoNode) {
+      m_nodes[range.prevPhysical].nextPhysical = front;
+    } else {
+      m_blocks[range.block].firstNode = front;
+    }
+    range.prevPhysical = front;
+    range.offset += padding;
+    range.size -= padding;
+    insertFree(front);
+  }
+  // and so does the end
+  if (m_nodes[node].size > size) {
+    const uint32_t back = newNode();
+    Node& range         = m_nodes[node];
+    m_nodes[back]       = freeRange(range.block, range.offset + size,
+                              range.size - size, node, range.nextPhysical);
+    if (range.nextPhysical != kNoNode) {
+      m_nodes[range.nextPhysical].prevPhysical = back;
+    }
+    range.nextPhysical = back;
+    range.size         = size;
+    insertFree(back);
+  }
+
+  Node& range     = m_nodes[node];
+  range.free      = false;
+  range.alignment = alignment;
+  m_blocks[range.block].used += range.size;
+  return TlsfAllocation{range.block, range.offset, range.size, node};
+}
+
+void TlsfAllocator::free(uint32_t node) {
+  Node& range = m_nodes[node];
+  range.free  = true;
+  m_blocks[range.block].used -= range.size;
+  const uint32_t next = range.nextPhysical;
+  if (next != kNoNode && m_nodes[next].free) {
+    removeFree(next);
+    mergeInto(node, next);
+  }
+  const uint32_t prev = m_nodes[node].prevPhysical;
+  if (prev != kNoNode && m_nodes[prev].free) {
+    removeFree(prev);
+    mergeInto(prev, node);
+    node = prev;
+  }
+  insertFree(node);
+}
+
+std::vector<TlsfMove> TlsfAllocator::planDefragmentation(uint32_t maxMoves) {
+  std::vector<TlsfMove> moves;
+  uint32_t source = kNoNode;
+  uint32_t live   = 0;
+  for (uint32_t block = 0; block < m_blocks.size(); ++block) {
+    if (m_blocks[block].firstNode == kNoNode) {
+      continue;
+    }
+    ++live;
+    if (m_blocks[block].used > 0 &&
+        (source == kNoNode || m_blocks[block].used < m_blocks[source].used)) {
+      source = block;
+    }
+  }
+  if (source == kNoNode || live < 2) {
+    return moves;
+  }
+
+  // the free ranges of the source leave the lists, so that nothing moves
+  // within it
+  std::vector<uint32_t> allocated;
+  std::vector<uint32_t> freeRanges;
+  for (uint32_t node = m_blocks[source].firstNode; node != kNoNode;
+       node          = m_nodes[node].nextPhysical) {
+    if (m_nodes[node].free) {
+      removeFree(node);
+      freeRanges.push_back(node);
+    } else {
+      allocated.push_back(node);
+    }
+  }
+  for (uint32_t node : allocated) {
+    if (moves.size() >= maxMoves) {
+      break;
+    }
+    const Node from = m_nodes[node];
+    const std::optional<TlsfAllocation> to =
+        allocate(from.size, from.alignment);
+    if (to) {
+      moves.push_back({{from.block, from.offset, from.size, node}, *to});
+    }
+  }
+  for (uint32_t node : freeRanges) {
+    insertFree(node);
+  }
+  return moves;
+}
+
+std::vector<uint32_t> TlsfAllocator::releaseEmptyBlocks() {
+  std::vector<uint32_t> released;
+  for (uint32_t block = 0; block < m_blocks.size(); ++block) {
+    const uint32_t node = m_blocks[block].firstNode;
+    if (node == kNoNode || m_blocks[block].used > 0) {
+      continue;
+    }
+    // a single free range covers it
+    removeFree(node);
+    m_unusedNodes.push_back(node);
+    m_blocks[block].firstNode = kNoNode;
+    released.push_back(block);
+  }
+  return released;
+}
+
+TlsfStats TlsfAllocator::stats() const {
+  TlsfStats stats{0, 0, 0, 0, 0};
+  for (const Block& block : m_blocks) {
+    if (block.firstNode == kNoNode) {
+      continue;
+    }
+    ++stats.blocks;
+    stats.capacity += block.size;
+    stats.used += block.used;
+  }
+  for (const auto& heads : m_heads) {
+    for (uint32_t node : heads) {
+      for (; node != kNoNode; node = m_nodes[node].nextFree) {
+        ++stats.freeRanges;
+        stats.largestFree = std::max(stats.largestFree, m_nodes[node].size);
+      }
+    }
+  }
+  return stats;
+}
+
+uint32_t TlsfAllocator::checkConsistency() const {
+  uint32_t errors    = 0;
+  uint32_t freeCount = 0;
+  for (uint32_t block = 0; block < m_blocks.size(); ++block) {
+    if (m_blocks[block].firstNode == kNoNode) {
+      continue;
+    }
+    VkDeviceSize offset = 0;
+    VkDeviceSize used   = 0;
+    uint32_t prev       = kNoNode;
+    for (uint32_t node = m_blocks[block].firstNode; node != kNoNode;
+         node          = m_nodes[node].nextPhysical) {
+      const Node& range = m_nodes[node];
+      errors += range.block != block || range.offset != offset ||
+                        range.prevPhysical != prev
+                    ? 1
+                    : 0;
+      errors += range.free && prev != kNoNode && m_nodes[prev].free ? 1 : 0;
+      used += range.free ? 0 : range.size;
+      freeCount += range.free ? 1 : 0;
+      offset += range.size;
+      prev = node;
+    }
+    errors += offset != m_blocks[block].size ? 1 : 0;
+    errors += used != m_blocks[block].used ? 1 : 0;
+  }
+
+  uint32_t listed = 0;
+  for (uint32_t first = 0; first < kFirstLevels; ++first) {
+    const bool firstBit = (m_firstLevelMap >> first) & 1;
+    errors += firstBit != (m_secondLevelMaps[first] != 0) ? 1 : 0;
+    for (uint32_t second = 0; second < kSecondLevels; ++second) {
+      const uint32_t head = m_heads[first][second];
+      const bool bit      = (m_secondLevelMaps[first] >> second) & 1;
+      errors += bit != (head != kNoNode) ? 1 : 0;
+      uint32_t prev = kNoNode;
+      for (uint32_t node = head; node != kNoNode;
+           node          = m_nodes[node].nextFree) {
+        const ListIndex list = listOf(m_nodes[node].size);
+        errors += !m_nodes[node].free || m_nodes[node].prevFree != prev ||
+                          list.first != first || list.second != second
+                      ? 1
+                      : 0;
+        ++listed;
+        prev = node;
+      }
+    }
+  }
+  errors += listed != freeCount ? 1 : 0;
+  return errors;
+}
+
+// sizes below kSecondLevels have a list each, larger ones one of
+// kSecondLevels per power of two
+TlsfAllocator::ListIndex TlsfAllocator::listOf(VkDeviceSize size) {
+  if (size < kSecondLevels) {
+    return {0, static_cast<uint32_t>(size)};
+  }
+  const uint32_t bit = highestBit(size);
+  return {bit - kSecondLevelBits + 1,
+          static_cast<uint32_t>(size >> (bit - kSecondLevelBits)) -
+              kSecondLevels};
+}
+
+// head of the first non-empty list whose ranges all hold `size` bytes
+uint32_t TlsfAllocator::findFree(VkDeviceSize size) const {
+  if (size >= kSecondLevels) {
+    // rounded up to the next list
+    size += (VkDeviceSize(1) << (highestBit(size) - kSecondLevelBits)) - 1;
+  }
+  const ListIndex list = listOf(size);
+  uint32_t first       = list.first;
+  uint32_t seconds     = m_secondLevelMaps[first] & (~0u << list.second);
+  if (seconds == 0) {
+    const uint64_t firsts =
+        first + 1 < 64 ? m_firstLevelMap & (~uint64_t(0) << (first + 1)) : 0;
+    if (firsts == 0) {
+      return kNoNode;
+    }
+    first   = lowestBit(firsts);
+    seconds = m_secondLevelMaps[first];
+  }
+  return m_heads[first][lowestBit(seconds)];
+}
+
+TlsfAllocator::Node TlsfAllocator::freeRange(uint32_t block,
+                                             VkDeviceSize offset,
+                                             VkDeviceSize size,
+                                             uint32_t prevPhysical,
+                                             uint32_t nextPhysical) {
+  return {block,        offset,  size,    1, prevPhysical,
+          nextPhysical, kNoNode, kNoNode, true};
+}
+
+uint32_t TlsfAllocator::newNode() {
+  if (!m_unusedNodes.empty()) {
+    const uint32_t node = m_unusedNodes.back();
+    m_unusedNodes.pop_back();
+    return node;
+  }
+  m_nodes.emplace_back();
+  return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void TlsfAllocator::insertFree(uint32_t node) {
+  const ListIndex list = listOf(m_nodes[node].size);
+  uint32_t& head       = m_heads[list.first][list.second];
+  m_nodes[node].prevFree = kNoNode;
+  m_nodes[node].nextFree = head;
+  if (head != kNoNode) {
+    m_nodes[head].prevFree = node;
+  }
+  head = node;
+  m_firstLevelMap |= uint64_t(1) << list.first;
+  m_secondLevelMaps[list.first] |= 1u << list.second;
+}
+
+void TlsfAllocator::removeFree(uint32_t node) {
+  const Node& range = m_nodes[node];
+  if (range.prevFree != kNoNode) {
+    m_nodes[range.prevFree].nextFree = range.nextFree;
+  } else {
+    const ListIndex list = listOf(range.size);
+    m_heads[list.first][list.second] = range.nextFree;
+    if (range.nextFree == kNoNode) {
+      m_secondLevelMaps[list.first] &= ~(1u << list.second);
+      if (m_secondLevelMaps[list.first] == 0) {
+        m_firstLevelMap &= ~(uint64_t(1) << list.first);
+      }
+    }
+  }
+  if (range.nextFree != kNoNode) {
+    m_nodes[range.nextFree].prevFree = range.prevFree;
+  }
+}
+
+// appends the physical range `next` to `node`, out of the free lists
+void TlsfAllocator::mergeInto(uint32_t node, uint32_t next) {
+  Node& range = m_nodes[node];
+  range.size += m_nodes[next].size;
+  range.nextPhysical = m_nodes[next].nextPhysical;
+  if (range.nextPhysical != kNoNode) {
+    m_nodes[range.nextPhysical].prevPhysical = node;
+  }
+  m_unusedNodes.push_back(next);
+}
+
+namespace {
+
+// the allocator TLSF is timed against: per block the free ranges sorted by
+// offset, searched from the first block
+class FirstFitAllocator {
+public:
+  void addBlock(VkDeviceSize size) { m_blocks.push_back({{0, size}}); }
+
+  std::optional<std::pair<uint32_t, VkDeviceSize>> allocate(
+      VkDeviceSize size, VkDeviceSize alignment) {
+    for (uint32_t block = 0; block < m_blocks.size(); ++block) {
+      auto& ranges = m_blocks[block];
+      for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+        const VkDeviceSize begin  = it->first;
+        const VkDeviceSize end    = it->second;
+        const VkDeviceSize offset = alignUp(begin, alignment);
+        if (offset + size > end) {
+          continue;
+        }
+        ranges.erase(it);
+        if (offset > begin) {
+          ranges[begin] = offset;
+        }
+        if (offset + size < end) {
+          ranges[offset + size] = end;
+        }
+        return std::make_pair(block, offset);
+      }
+    }
+    return std::nullopt;
+  }
+
+  void free(uint32_t block, VkDeviceSize offset, VkDeviceSize size) {
+    auto& ranges     = m_blocks[block];
+    VkDeviceSize end = offset + size;
+    auto next        = ranges.lower_bound(offset);
+    if (next != ranges.end() && next->first == end) {
+      end  = next->second;
+      next = ranges.erase(next);
+    }
+    if (next != ranges.begin() && std::prev(next)->second == offset) {
+      std::prev(next)->second = end;
+    } else {
+      ranges[offset] = end;
+    }
+  }
+
+private:
+  std::vector<std::map<VkDeviceSize, VkDeviceSize>> m_blocks;
+};
+
+struct Operation {
+  bool allocate;
+  VkDeviceSize size;  // of an allocation
+  VkDeviceSize alignment;
+  uint32_t live;  // index among the live allocations to free
+};
+
+constexpr VkDeviceSize kBlockSize = 64ull << 20;
+
+// allocations of 256 bytes to 4 MiB, uniform in log, aligned to up to 64 KiB,
+// slightly more often than frees until `kMaxLive` are live
+constexpr uint32_t kMaxLive = 2048;
+
+std::vector<Operation> randomOperations(uint32_t count, uint32_t seed) {
+  const uint32_t key = hostRngKey(seed, 0);
+  uint32_t counter   = 0;
+  const auto draw    = [&](uint32_t n) {
+    uint32_t word;
+    generateRandomWords(key, counter++, &word, 1);
+    return word % n;
+  };
+  std::vector<Operation> operations;
+  uint32_t live = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    Operation operation{live == 0 || (live < kMaxLive && draw(100) < 55), 0,
+                        1, 0};
+    if (operation.allocate) {
+      const uint32_t bits = 8 + draw(14);
+      operation.size      = (VkDeviceSize(1) << bits) + draw(1u << bits);
+      operation.alignment = VkDeviceSize(1) << draw(17);
+      ++live;
+    } else {
+      operation.live = draw(live);
+      --live;
+    }
+    operations.push_back(operation);
+  }
+  return operations;
+}
+
+// the operations on the allocator, adding blocks when it is full; calls
+// `allocated` with each allocation and `freed` before each free
+template <typename Allocate, typename Free, typename AddBlock>
+uint32_t replayOperations(const std::vector<Operation>& operations,
+                          Allocate allocate, Free free, AddBlock addBlock) {
+  using Allocation = decltype(*allocate(VkDeviceSize(), VkDeviceSize()));
+  std::vector<std::decay_t<Allocation>> live;
+  uint32_t blocks = 0;
+  for (const Operation& operation : operations) {
+    if (operation.allocate) {
+      auto allocation = allocate(operation.size, operation.alignment);
+      if (!allocation) {
+        addBlock();
+        ++blocks;
+        allocation = allocate(operation.size, operation.alignment);
+      }
+      live.push_back(*allocation);
+    } else {
+      free(live[operation.live]);
+      live[operation.live] = live.back();
+      live.pop_back();
+    }
+  }
+  return blocks;
+}
+
+template <typename Function>
+double nanosecondsPer(uint32_t operations, Function function) {
+  const auto start = std::chrono::steady_clock::now();
+  function();
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / std::max(operations, 1u);
+}
+
+double fragmentation(const TlsfStats& stats) {
+  const VkDeviceSize free = stats.capacity - stats.used;
+  return free > 0 ? 1.0 - double(stats.largestFree) / double(free) : 0.0;
+}
+
+TlsfValidationResult checkRandom(uint32_t count, uint32_t seed) {
+  const std::vector<Operation> operations = randomOperations(count, seed);
+  TlsfValidationResult result{"random", count, 0,   0, 0.0,
+                              0.0,      0.0,   0,   0, 0};
+
+  // against the live ranges of each block
+  TlsfAllocator allocator;
+  std::vector<std::map<VkDeviceSize, VkDeviceSize>> shadow;
+  uint32_t done = 0;
+  replayOperations(
+      operations,
+      [&](VkDeviceSize size, VkDeviceSize alignment) {
+        const std::optional<TlsfAllocation> allocation =
+            allocator.allocate(size, alignment);
+        if (allocation) {
+          auto& ranges = shadow[allocation->block];
+          result.rangeErrors +=
+              allocation->offset % alignment != 0 || allocation->size < size ||
+                      allocation->offset + allocation->size > kBlockSize
+                  ? 1
+                  : 0;
+          const auto next = ranges.lower_bound(allocation->offset);
+          result.overlapErrors +=
+              (next != ranges.end() &&
+               next->first < allocation->offset + allocation->size) ||
+                      (next != ranges.begin() &&
+                       std::prev(next)->second > allocation->offset)
+                  ? 1
+                  : 0;
+          ranges[allocation->offset] = allocation->offset + allocation->size;
+        }
+        if (++done % 4096 == 0) {
+          result.consistencyErrors += allocator.checkConsistency();
+        }
+        return allocation;
+      },
+      [&](const TlsfAllocation& allocation) {
+        shadow[allocation.block].erase(allocation.offset);
+        allocator.free(allocation.node);
+      },
+      [&]() {
+        allocator.addBlock(kBlockSize);
+        shadow.emplace_back();
+      });
+  result.consistencyErrors += allocator.checkConsistency();
+  result.blocks        = allocator.stats().blocks;
+  result.fragmentation = fragmentation(allocator.stats());
+
+  // the same operations, timed
+  result.nsPerOperation = nanosecondsPer(count, [&]() {
+    TlsfAllocator timed;
+    replayOperations(
+        operations,
+        [&](VkDeviceSize size, VkDeviceSize alignment) {
+          return timed.allocate(size, alignment);
+        },
+        [&](const TlsfAllocation& allocation) { timed.free(allocation.node); },
+        [&]() { timed.addBlock(kBlockSize); });
+  });
+  result.firstFitNsPerOperation = nanosecondsPer(count, [&]() {
+    FirstFitAllocator timed;
+    std::vector<VkDeviceSize> sizes;
+    replayOperations(
+        operations,
+        [&](VkDeviceSize size, VkDeviceSize alignment) {
+          auto allocation = timed.allocate(size, alignment);
+          return allocation ? std::optional<std::array<VkDeviceSize, 3>>(
+                                  {allocation->first, allocation->second, size})
+                            : std::nullopt;
+        },
+        [&](const std::array<VkDeviceSize, 3>& allocation) {
+          timed.free(static_cast<uint32_t>(allocation[0]), allocation[1],
+                     allocation[2]);
+        },
+        [&]() { timed.addBlock(kBlockSize); });
+  });
+  return result;
+}
+
+// freed neighbours merge into one range that a larger allocation reuses
+TlsfValidationResult checkMerging() {
+  TlsfValidationResult result{"merging", 0, 0, 0, 0.0, 0.0, 0.0, 0, 0, 0};
+  TlsfAllocator allocator;
+  allocator.addBlock(1 << 20);
+  std::vector<TlsfAllocation> quarters;
+  for (int i = 0; i < 4; ++i) {
+    const std::optional<TlsfAllocation> quarter =
+        allocator.allocate(256 << 10, 256);
+    result.consistencyErrors += quarter ? 0 : 1;
+    if (quarter) {
+      quarters.push_back(*quarter);
+    }
+    ++result.operations;
+  }
+  result.consistencyErrors += allocator.stats().freeRanges != 0 ? 1 : 0;
+  result.consistencyErrors +=
+      allocator.allocate(1, 1).has_value() ? 1 : 0;  // full
+  if (quarters.size() == 4) {
+    allocator.free(quarters[1].node);
+    allocator.free(quarters[2].node);
+    result.operations += 3;
+    result.consistencyErrors +=
+        allocator.stats().freeRanges != 1 ||
+                allocator.stats().largestFree != (512 << 10)
+            ? 1
+            : 0;
+    const std::optional<TlsfAllocation> half =
+        allocator.allocate(512 << 10, 4096);
+    result.consistencyErrors +=
+        !half || half->offset != quarters[1].offset ? 1 : 0;
+    allocator.free(quarters[0].node);
+    allocator.free(quarters[3].node);
+    if (half) {
+      allocator.free(half->node);
+    }
+    result.operations += 4;
+  }
+  const TlsfStats stats = allocator.stats();
+  result.consistencyErrors +=
+      stats.freeRanges != 1 || stats.largestFree != (1 << 20) ? 1 : 0;
+  result.consistencyErrors += allocator.checkConsistency();
+  result.blocks         = stats.blocks;
+  result.releasedBlocks = static_cast<uint32_t>(
+      allocator.releaseEmptyBlocks().size());
+  result.consistencyErrors += result.releasedBlocks != 1 ? 1 : 0;
+  return result;
+}
+
+// blocks filled with allocations, three quarters of them freed at random,
+// then compacted
+TlsfValidationResult checkDefragmentation(uint32_t seed) {
+  TlsfValidationResult result{"defragment", 0, 0, 0, 0.0, 0.0, 0.0, 0, 0, 0};
+  const uint32_t key = hostRngKey(seed, 1);
+  uint32_t counter   = 0;
+
+  constexpr VkDeviceSize kSmallBlock = 16 << 20;
+  TlsfAllocator allocator;
+  std::vector<TlsfAllocation> live;
+  for (int block = 0; block < 4; ++block) {
+    allocator.addBlock(kSmallBlock);
+  }
+  while (const std::optional<TlsfAllocation> allocation =
+             allocator.allocate(64 << 10, 256)) {
+    live.push_back(*allocation);
+    ++result.operations;
+  }
+  result.blocks = allocator.stats().blocks;
+  std::vector<TlsfAllocation> kept;
+  for (const TlsfAllocation& allocation : live) {
+    uint32_t word;
+    generateRandomWords(key, counter++, &word, 1);
+    if (word % 4 == 0) {
+      kept.push_back(allocation);
+    } else {
+      allocator.free(allocation.node);
+      ++result.operations;
+    }
+  }
+
+  // the moved ranges must not overlap the kept ones
+  std::map<std::pair<uint32_t, VkDeviceSize>, TlsfAllocation> ranges;
+  for (const TlsfAllocation& allocation : kept) {
+    ranges[{allocation.block, allocation.offset}] = allocation;
+  }
+  for (;;) {
+    const std::vector<TlsfMove> moves = allocator.planDefragmentation(64);
+    if (moves.empty()) {
+      break;
+    }
+    for (const TlsfMove& move : moves) {
+      result.rangeErrors += move.to.block == move.from.block ||
+                                    move.to.size != move.from.size ||
+                                    move.to.offset % 256 != 0
+                                ? 1
+                                : 0;
+      result.overlapErrors +=
+          ranges.count({move.to.block, move.to.offset}) != 0 ? 1 : 0;
+      ranges.erase({move.from.block, move.from.offset});
+      ranges[{move.to.block, move.to.offset}] = move.to;
+      allocator.free(move.from.node);
+      result.operations += 2;
+    }
+    result.releasedBlocks +=
+        static_cast<uint32_t>(allocator.releaseEmptyBlocks().size());
+  }
+  // nothing got lost
+  result.consistencyErrors += ranges.size() != kept.size() ? 1 : 0;
+  result.consistencyErrors +=
+      allocator.stats().used != kept.size() * (64 << 10) ? 1 : 0;
+  result.consistencyErrors += allocator.checkConsistency();
+  result.fragmentation = fragmentation(allocator.stats());
+  return result;
+}
+
+}  // namespace
+
+std::vector<TlsfValidationResult> validateTlsf(uint32_t operations,
+                                               uint32_t seed) {
+  return {checkRandom(operations, seed), checkMerging(),
+          checkDefragmentation(seed)};
+}
+
+bool isTlsfValid(const std::vector<TlsfValidationResult>& results) {
+  return std::all_of(results.begin(), results.end(),
+                     [](const TlsfValidationResult& result) {
+                       return result.overlapErrors == 0 &&
+                              result.rangeErrors == 0 &&
+                              result.consistencyErrors == 0 &&
+                              (result.scenario != "defragment" ||
+                               result.releasedBlocks > 0);
+                     });
+}
+
+void logTlsf(const std::vector<TlsfValidationResult>& results) {
+  spdlog::info("{:>10} {:>10} {:>6} {:>8} {:>9} {:>8} {:>10} {:>8} {:>6} {:>6}",
+               "scenario", "operations", "blocks", "released", "fragments",
+               "ns/op", "first fit", "overlaps", "ranges", "errors");
+  for (const TlsfValidationResult& result : results) {
+    spdlog::info(
+        "{:>10} {:>10} {:>6} {:>8} {:>8.1f}% {:>8.1f} {:>10.1f} {:>8} {:>6} "
+        "{:>6}",
+        result.scenario, result.operations, result.blocks,
+        result.releasedBlocks, 100.0 * result.fragmentation,
+        result.nsPerOperation, result.firstFitNsPerOperation,
+        result.overlapErrors, result.rangeErrors, result.consistencyErrors);
+  }
+}
@@ -0,0 +1,156 @@
+#ifndef __VOLUME_RESTIR_UTILS_TLSF_ALLOCATOR_HPP__
+#define __VOLUME_RESTIR_UTILS_TLSF_ALLOCATOR_HPP__
+
+/**
+ * @file tlsf_allocator.hpp
+ *
+ * @brief Two-level segregated fit sub-allocation of ranges of large memory
+ * blocks, the device memory of the renderer's resources.
+ *
+ *  Each block is a chain of adjacent ranges, allocated or free, and no two
+ *  free ranges are adjacent: freeing merges a range with its free
+ *  neighbours. The free ranges are kept in lists segregated by size, a first
+ *  level per power of two split into 32 second-level lists, with a bitmap of
+ *  the non-empty lists at each level, so that allocating and freeing take
+ *  constant time whatever the number of ranges. An allocation takes the
+ *  head of the first list whose ranges are all large enough, or of the list
+ *  of its own size when that head fits, and gives back what it does not use
+ *  in front of the aligned offset and after its end.
+ *
+ *  The allocator does not own memory: the caller adds blocks when an
+ *  allocation fails and frees the memory of the blocks `releaseEmptyBlocks`
+ *  forgets. `planDefragmentation` moves allocations out of the emptiest
+ *  block; the caller copies their content, rebinds the resources and frees
+ *  the ranges they moved from, after which the block can be released.
+ */
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct TlsfAllocation {
+  uint32_t block;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  uint32_t node;  // to free it with
+};
+
+struct TlsfMove {
+  TlsfAllocation from;
+  TlsfAllocation to;
+};
+
+struct TlsfStats {
+  uint32_t blocks;
+  VkDeviceSize capacity;
+  VkDeviceSize used;  // with the alignment padding given to allocations
+  VkDeviceSize largestFree;
+  uint32_t freeRanges;
+};
+
+class TlsfAllocator {
+public:
+  static constexpr uint32_t kNoNode = ~0u;
+
+  TlsfAllocator();
+
+  /// Index of a new block of `size` bytes
+  uint32_t addBlock(VkDeviceSize size);
+
+  /// `size` bytes at an offset aligned to `alignment`, a power of two;
+  /// nothing when no block has room
+  [[nodiscard]] std::optional<TlsfAllocation> allocate(VkDeviceSize size,
+                                                       VkDeviceSize alignment);
+
+  void free(uint32_t node);
+
+  /// At most `maxMoves` allocations of the least used block reallocated in
+  /// the other blocks; both ranges stay allocated until the caller frees
+  /// the ones moved from
+  [[nodiscard]] std::vector<TlsfMove> planDefragmentation(uint32_t maxMoves);
+
+  /// Forgets the blocks without allocations and returns their indices,
+  /// whose memory the caller frees; the indices are not reused
+  std::vector<uint32_t> releaseEmptyBlocks();
+
+  [[nodiscard]] TlsfStats stats() const;
+
+  /// Broken invariants: ranges not tiling their block, adjacent free ranges,
+  /// free lists or bitmaps out of date
+  [[nodiscard]] uint32_t checkConsistency() const;
+
+private:
+  static constexpr uint32_t kSecondLevelBits = 5;
+  static constexpr uint32_t kSecondLevels    = 1u << kSecondLevelBits;
+  static constexpr uint32_t kFirstLevels     = 64 - kSecondLevelBits + 1;
+
+  struct Node {
+    uint32_t block;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    VkDeviceSize alignment;  // requested, for the defragmentation
+    uint32_t prevPhysical;
+    uint32_t nextPhysical;
+    uint32_t prevFree;
+    uint32_t nextFree;
+    bool free;
+  };
+
+  struct Block {
+    VkDeviceSize size;
+    VkDeviceSize used;
+    uint32_t firstNode;  // kNoNode once released
+  };
+
+  struct ListIndex {
+    uint32_t first;
+    uint32_t second;
+  };
+
+  static ListIndex listOf(VkDeviceSize size);
+  static Node freeRange(uint32_t block, VkDeviceSize offset, VkDeviceSize size,
+                        uint32_t prevPhysical, uint32_t nextPhysical);
+  uint32_t findFree(VkDeviceSize size) const;
+  uint32_t newNode();
+  void insertFree(uint32_t node);
+  void removeFree(uint32_t node);
+  void mergeInto(uint32_t node, uint32_t next);
+
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_unusedNodes;
+  std::vector<Block> m_blocks;
+  uint64_t m_firstLevelMap = 0;
+  std::array<uint32_t, kFirstLevels> m_secondLevelMaps{};
+  std::array<std::array<uint32_t, kSecondLevels>, kFirstLevels> m_heads;
+};
+
+struct TlsfValidationResult {
+  std::string scenario;
+  uint32_t operations;
+  uint32_t blocks;          // at the peak
+  uint32_t releasedBlocks;  // emptied and forgotten
+  double fragmentation;     // 1 - largest free range / free bytes, at the end
+  double nsPerOperation;
+  double firstFitNsPerOperation;  // of a sorted free list, 0 when not timed
+  uint32_t overlapErrors;         // allocations over live ones
+  uint32_t rangeErrors;           // misaligned or outside their block
+  uint32_t consistencyErrors;     // see checkConsistency, and expectations
+};
+
+/// Replays random allocations and frees against a shadow of the live ranges
+/// and times them against a first-fit allocator, then checks the merging of
+/// free ranges and a defragmentation emptying blocks
+[[nodiscard]] std::vector<TlsfValidationResult> validateTlsf(
+    uint32_t operations = 200000, uint32_t seed = 0);
+
+/// False on any error, or when the defragmentation released no block
+[[nodiscard]] bool isTlsfValid(
+    const std::vector<TlsfValidationResult>& results);
+
+void logTlsf(const std::vector<TlsfValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_TLSF_ALLOCATOR_HPP__ */
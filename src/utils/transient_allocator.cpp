@@ -0,0 +1,328 @@
+#include "utils/transient_allocator.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "spdlog/spdlog.h"
+#include "utils/restir_frame.hpp"
+#include "utils/rng.hpp"
+
+namespace {
+
+constexpr uint32_t kNotPlaced = ~0u;
+
+VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment) {
+  return alignment > 1 ? (offset + alignment - 1) / alignment * alignment
+                       : offset;
+}
+
+bool overlapInTime(const std::vector<bool>& a, const std::vector<bool>& b) {
+  for (size_t p = 0; p < a.size() && p < b.size(); ++p) {
+    if (a[p] && b[p]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool isWriteOnly(ResourceUsage usage) {
+  switch (usage) {
+    case ResourceUsage::eRayTracingStorageWrite:
+    case ResourceUsage::eComputeStorageWrite:
+    case ResourceUsage::eColorAttachment:
+    case ResourceUsage::eTransferWrite:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool readsAt(const std::vector<ResourceUse>& pass, uint32_t resource) {
+  return std::any_of(pass.begin(), pass.end(), [&](const ResourceUse& use) {
+    return use.resource == resource && !isWriteOnly(use.usage);
+  });
+}
+
+bool usesAt(const std::vector<ResourceUse>& pass, uint32_t resource) {
+  return std::any_of(pass.begin(), pass.end(), [&](const ResourceUse& use) {
+    return use.resource == resource;
+  });
+}
+
+// forward scan of the uses: the value left by pass `p` is read again before
+// it is overwritten
+bool isNeededAfter(const std::vector<std::vector<ResourceUse>>& passes,
+                   uint32_t resource, size_t p) {
+  const size_t n = passes.size();
+  for (size_t i = 1; i <= n; ++i) {
+    const std::vector<ResourceUse>& pass = passes[(p + i) % n];
+    if (usesAt(pass, resource)) {
+      return readsAt(pass, resource);
+    }
+  }
+  return false;
+}
+
+uint32_t countLifetimeErrors(
+    uint32_t numResources, const std::vector<std::vector<ResourceUse>>& passes,
+    const std::vector<std::vector<bool>>& lifetimes) {
+  uint32_t errors = 0;
+  for (uint32_t r = 0; r < numResources; ++r) {
+    for (size_t p = 0; p < passes.size(); ++p) {
+      const bool expected =
+          usesAt(passes[p], r) || isNeededAfter(passes, r, p);
+      errors += lifetimes[r][p] == expected ? 0 : 1;
+    }
+  }
+  return errors;
+}
+
+uint32_t countPlacementErrors(
+    const std::vector<TransientRequirements>& requirements,
+    const std::vector<std::vector<bool>>& lifetimes,
+    const TransientPlan& plan) {
+  uint32_t errors = 0;
+  for (size_t a = 0; a < requirements.size(); ++a) {
+    const TransientPlacement& pa = plan.placements[a];
+    if (pa.block >= plan.blocks.size()) {
+      ++errors;
+      continue;
+    }
+    const TransientBlock& block = plan.blocks[pa.block];
+    const bool misplaced =
+        pa.offset % requirements[a].alignment != 0 ||
+        block.alignment % requirements[a].alignment != 0 ||
+        pa.offset + requirements[a].size > block.size ||
+        block.memoryTypeBits == 0 ||
+        (block.memoryTypeBits & ~requirements[a].memoryTypeBits) != 0;
+    errors += misplaced ? 1 : 0;
+    for (size_t b = a + 1; b < requirements.size(); ++b) {
+      const TransientPlacement& pb = plan.placements[b];
+      const bool overlapInMemory =
+          pa.block == pb.block &&
+          pa.offset < pb.offset + requirements[b].size &&
+          pb.offset < pa.offset + requirements[a].size;
+      if (overlapInMemory && overlapInTime(lifetimes[a], lifetimes[b])) {
+        ++errors;
+      }
+    }
+  }
+  return errors;
+}
+
+TransientValidationResult validate(
+    std::string scenario, uint32_t numResources,
+    const std::vector<std::vector<ResourceUse>>& passes,
+    const std::vector<TransientRequirements>& requirements,
+    const std::vector<uint32_t>& packed) {
+  const std::vector<std::vector<bool>> lifetimes =
+      computeTransientLifetimes(numResources, passes);
+  std::vector<std::vector<bool>> packedLifetimes;
+  for (uint32_t r : packed) {
+    packedLifetimes.push_back(lifetimes[r]);
+  }
+  const TransientPlan plan =
+      packTransientResources(requirements, packedLifetimes);
+
+  TransientValidationResult result;
+  result.scenario       = std::move(scenario);
+  result.resources      = uint32_t(requirements.size());
+  result.blocks         = uint32_t(plan.blocks.size());
+  result.dedicatedBytes = plan.dedicatedBytes;
+  result.packedBytes    = plan.packedBytes;
+  result.lifetimeErrors = countLifetimeErrors(numResources, passes, lifetimes);
+  result.placementErrors =
+      countPlacementErrors(requirements, packedLifetimes, plan);
+  return result;
+}
+
+// the images of Renderer::createRestirBuffer over one ping-pong period
+TransientValidationResult restirScenario(uint32_t spatialIterations) {
+  const uint32_t gBuffers[2] = {0, 1}, reservoirs[2] = {2, 3};
+  std::vector<std::vector<ResourceUse>> passes;
+  for (uint32_t frame = 0; frame < 2; ++frame) {
+    const std::vector<std::vector<ResourceUse>> frameUses = restirFrameUses(
+        restirFrameResources(gBuffers, reservoirs, 4, 5, 6, frame),
+        spatialReuseDispatches(spatialIterations));
+    passes.insert(passes.end(), frameUses.begin(), frameUses.end());
+  }
+
+  const VkDeviceSize pixels = 1920 * 1080, texel = 16;
+  const TransientRequirements reservoir{pixels * texel * RESERVOIR_SIZE,
+                                        1 << 16, 1};
+  const TransientRequirements storage{pixels * texel, 1 << 16, 1};
+  return validate(fmt::format("ReSTIR, {} spatial", spatialIterations), 7,
+                  passes, {reservoir, reservoir, reservoir, reservoir, storage},
+                  {2, 3, 4, 5, 6});
+}
+
+TransientValidationResult randomScenario(uint32_t numSequences,
+                                         uint32_t seed) {
+  constexpr uint32_t kResources = 6, kPasses = 10;
+  constexpr uint32_t kUsages = uint32_t(ResourceUsage::eTransferWrite) + 1;
+
+  TransientValidationResult total{"random", 0, 0, 0, 0, 0, 0};
+  for (uint32_t sequence = 0; sequence < numSequences; ++sequence) {
+    const uint32_t key = hostRngKey(seed, sequence + 1);
+    uint32_t counter   = 0;
+    const auto draw    = [&](uint32_t n) {
+      uint32_t word;
+      generateRandomWords(key, counter++, &word, 1);
+      return word % n;
+    };
+
+    std::vector<std::vector<ResourceUse>> passes(kPasses);
+    for (auto& pass : passes) {
+      for (uint32_t u = 1 + draw(3); u > 0; --u) {
+        pass.push_back({draw(kResources), ResourceUsage(draw(kUsages))});
+      }
+    }
+    std::vector<TransientRequirements> requirements(kResources);
+    for (TransientRequirements& requirement : requirements) {
+      requirement.size           = VkDeviceSize(1 + draw(64)) * 4096;
+      requirement.alignment      = VkDeviceSize(1) << draw(17);
+      requirement.memoryTypeBits = 1 + draw(15);
+    }
+    std::vector<uint32_t> packed(kResources);
+    std::iota(packed.begin(), packed.end(), 0);
+
+    const TransientValidationResult result =
+        validate("random", kResources, passes, requirements, packed);
+    total.resources += result.resources;
+    total.blocks += result.blocks;
+    total.dedicatedBytes += result.dedicatedBytes;
+    total.packedBytes += result.packedBytes;
+    total.lifetimeErrors += result.lifetimeErrors;
+    total.placementErrors += result.placementErrors;
+  }
+  return total;
+}
+
+}  // namespace
+
+std::vector<std::vector<bool>> computeTransientLifetimes(
+    uint32_t numResources,
+    const std::vector<std::vector<ResourceUse>>& passes) {
+  const size_t n = passes.size();
+  std::vector<std::vector<bool>> lifetimes(numResources,
+                                           std::vector<bool>(n, false));
+  for (uint32_t r = 0; r < numResources; ++r) {
+    // backward liveness around the cycle of passes, to a fixed point
+    std::vector<bool> liveIn(n, false), liveOut(n, false);
+    for (bool changed = n > 0; changed;) {
+      changed = false;
+      for (size_t i = n; i-- > 0;) {
+        liveOut[i]       = liveIn[(i + 1) % n];
+        const bool in    = readsAt(passes[i], r) ||
+                        (liveOut[i] && !usesAt(passes[i], r));
+        changed          = changed || in != liveIn[i];
+        liveIn[i]        = in;
+      }
+    }
+    for (size_t i = 0; i < n; ++i) {
+      lifetimes[r][i] = usesAt(passes[i], r) || liveOut[i];
+    }
+  }
+  return lifetimes;
+}
+
+TransientPlan packTransientResources(
+    const std::vector<TransientRequirements>& requirements,
+    const std::vector<std::vector<bool>>& lifetimes) {
+  TransientPlan plan;
+  plan.placements.assign(requirements.size(), {kNotPlaced, 0});
+
+  std::vector<uint32_t> order(requirements.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return requirements[a].size > requirements[b].size;
+  });
+
+  for (uint32_t r : order) {
+    const TransientRequirements& requirement = requirements[r];
+    plan.dedicatedBytes += requirement.size;
+
+    // a block is worth sharing only if it grows by less than the image
+    uint32_t bestBlock      = kNotPlaced;
+    VkDeviceSize bestOffset = 0, bestGrowth = requirement.size;
+    for (uint32_t b = 0; b < plan.blocks.size(); ++b) {
+      const TransientBlock& block = plan.blocks[b];
+      if (!(block.memoryTypeBits & requirement.memoryTypeBits)) {
+        continue;
+      }
+      // memory ranges of the images of the block alive at the same time
+      std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+      for (uint32_t q = 0; q < requirements.size(); ++q) {
+        if (plan.placements[q].block == b &&
+            overlapInTime(lifetimes[q], lifetimes[r])) {
+          taken.emplace_back(plan.placements[q].offset,
+                             plan.placements[q].offset + requirements[q].size);
+        }
+      }
+      std::sort(taken.begin(), taken.end());
+      VkDeviceSize offset = 0;
+      for (const auto& [begin, end] : taken) {
+        if (alignUp(offset, requirement.alignment) + requirement.size <=
+            begin) {
+          break;
+        }
+        offset = std::max(offset, end);
+      }
+      offset = alignUp(offset, requirement.alignment);
+      const VkDeviceSize end    = offset + requirement.size;
+      const VkDeviceSize growth = end > block.size ? end - block.size : 0;
+      if (growth < bestGrowth) {
+        bestBlock  = b;
+        bestOffset = offset;
+        bestGrowth = growth;
+      }
+    }
+
+    if (bestBlock == kNotPlaced) {
+      plan.placements[r] = {uint32_t(plan.blocks.size()), 0};
+      plan.blocks.push_back({requirement.size, requirement.alignment,
+                             requirement.memoryTypeBits});
+      continue;
+    }
+    TransientBlock& block = plan.blocks[bestBlock];
+    plan.placements[r]    = {bestBlock, bestOffset};
+    block.size      = std::max(block.size, bestOffset + requirement.size);
+    block.alignment = std::max(block.alignment, requirement.alignment);
+    block.memoryTypeBits &= requirement.memoryTypeBits;
+  }
+
+  for (const TransientBlock& block : plan.blocks) {
+    plan.packedBytes += block.size;
+  }
+  return plan;
+}
+
+std::vector<TransientValidationResult> validateTransientPacking(
+    uint32_t randomSequences, uint32_t seed) {
+  return {restirScenario(1), restirScenario(2),
+          randomScenario(randomSequences, seed)};
+}
+
+bool isTransientPackingValid(
+    const std::vector<TransientValidationResult>& results) {
+  return std::all_of(results.begin(), results.end(),
+                     [](const TransientValidationResult& result) {
+                       return result.lifetimeErrors == 0 &&
+                              result.placementErrors == 0;
+                     });
+}
+
+void logTransientPacking(
+    const std::vector<TransientValidationResult>& results) {
+  spdlog::info("{:>18} {:>9} {:>6} {:>13} {:>10} {:>6} {:>9} {:>10}",
+               "scenario", "resources", "blocks", "dedicated MiB",
+               "packed MiB", "saved", "lifetimes", "placements");
+  for (const TransientValidationResult& result : results) {
+    spdlog::info(
+        "{:>18} {:>9} {:>6} {:>13.1f} {:>10.1f} {:>5.1f}% {:>9} {:>10}",
+        result.scenario, result.resources, result.blocks,
+        result.dedicatedBytes / 1048576.0, result.packedBytes / 1048576.0,
+        100.0 * (1.0 - double(result.packedBytes) / result.dedicatedBytes),
+        result.lifetimeErrors, result.placementErrors);
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef __VOLUME_RESTIR_UTILS_TRANSIENT_ALLOCATOR_HPP__
+#define __VOLUME_RESTIR_UTILS_TRANSIENT_ALLOCATOR_HPP__
+
+/**
+ * @file transient_allocator.hpp
+ *
+ * @brief Lifetimes of the frame images from the order of the passes that use
+ * them, and packing of the images whose lifetimes do not overlap into shared
+ * memory blocks.
+ *
+ *  The pass list repeats every frame (for ping-ponged images, give the passes
+ *  of as many frames as the ping-pong period), so an image is live from each
+ *  write to the last read of the value it wrote, possibly in a later frame,
+ *  and an image read before it is written in the list is live across the
+ *  frame boundary. A write use is taken to overwrite everything the later
+ *  reads see; read-write uses keep the content. Two images may share memory
+ *  when no pass falls in both lifetimes; the pass that first writes one then
+ *  follows the last read of the other, which the render graph orders when
+ *  both are imported as one resource.
+ *
+ *  The packing is greedy: the largest images first, each at the lowest
+ *  aligned offset of the block that grows least, skipping the ranges of the
+ *  images it overlaps in time, or in a new block when no block saves memory.
+ */
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils/barrier_planner.hpp"
+
+/// Per resource, whether its memory is in use at each pass of the cycle
+[[nodiscard]] std::vector<std::vector<bool>> computeTransientLifetimes(
+    uint32_t numResources, const std::vector<std::vector<ResourceUse>>& passes);
+
+struct TransientRequirements {
+  VkDeviceSize size;
+  VkDeviceSize alignment;
+  uint32_t memoryTypeBits;
+};
+
+struct TransientPlacement {
+  uint32_t block;
+  VkDeviceSize offset;
+};
+
+struct TransientBlock {
+  VkDeviceSize size;
+  VkDeviceSize alignment;
+  uint32_t memoryTypeBits;  // allowed by all its images
+};
+
+struct TransientPlan {
+  std::vector<TransientPlacement> placements;  // per resource
+  std::vector<TransientBlock> blocks;
+  VkDeviceSize dedicatedBytes = 0;  // with one allocation per resource
+  VkDeviceSize packedBytes    = 0;  // of the blocks
+};
+
+/// Packs the resources of `requirements`, whose lifetimes are `lifetimes`
+/// (of `computeTransientLifetimes`, one row per resource)
+[[nodiscard]] TransientPlan packTransientResources(
+    const std::vector<TransientRequirements>& requirements,
+    const std::vector<std::vector<bool>>& lifetimes);
+
+struct TransientValidationResult {
+  std::string scenario;
+  uint32_t resources;
+  uint32_t blocks;
+  VkDeviceSize dedicatedBytes;
+  VkDeviceSize packedBytes;
+  uint32_t lifetimeErrors;   // against a forward scan of the uses
+  uint32_t placementErrors;  // overlaps in time and memory, misalignment
+};
+
+/// Packs the ReSTIR frame images at 1080p, and random images and pass lists
+[[nodiscard]] std::vector<TransientValidationResult> validateTransientPacking(
+    uint32_t randomSequences = 256, uint32_t seed = 0);
+
+/// False if a lifetime or a placement is wrong in any scenario
+[[nodiscard]] bool isTransientPackingValid(
+    const std::vector<TransientValidationResult>& results);
+
+void logTransientPacking(const std::vector<TransientValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_TRANSIENT_ALLOCATOR_HPP__ */
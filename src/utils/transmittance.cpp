@@ -0,0 +1,224 @@
+#include "utils/transmittance.hpp"
+
+#include <chrono>
+#include <cmath>
+
+#include "spdlog/spdlog.h"
+#include "utils/rng.hpp"
+#include "utils/shader_functions.hpp"
+
+namespace {
+
+const char* estimatorName(int estimator) {
+  switch (estimator) {
+    case TRANSMITTANCE_DELTA_TRACKING:
+      return "delta";
+    case TRANSMITTANCE_RATIO_TRACKING:
+      return "ratio";
+    case TRANSMITTANCE_RESIDUAL_RATIO_TRACKING:
+      return "residual ratio";
+    case TRANSMITTANCE_NEXT_FLIGHT:
+      return "next flight";
+  }
+  return "unknown";
+}
+
+struct Tracker {
+  const DensityGrid& grid;
+  const nvmath::vec3f& origin;
+  const nvmath::vec3f& dir;
+  uint32_t key;
+  uint32_t& counter;
+  uint64_t lookups = 0;
+
+  float uniform() { return shader::rngUniformAt(key, counter++); }
+
+  float extinctionAt(float t) {
+    ++lookups;
+    return densityGridExtinction(grid, origin + t * dir);
+  }
+
+  /// Multiplies `transmittance` by the estimate over [t0, t1), which lies in
+  /// one brick whose extinction spans `range`; as `trackBrick` in volume.glsl
+  void trackBrick(float t0, float t1, const nvmath::vec2f& range,
+                  int estimator, float& transmittance) {
+    if (estimator == TRANSMITTANCE_RESIDUAL_RATIO_TRACKING) {
+      const float control = shader::controlExtinction(range.x);
+      const float majorant =
+          shader::residualMajorant(range.x, range.y, control);
+      transmittance *= std::exp(-control * (t1 - t0));
+      if (majorant <= 0.0f) {
+        return;
+      }
+      for (float t = t0;;) {
+        t += shader::sampleFreeFlight(uniform(), majorant);
+        if (t >= t1 || transmittance == 0.0f) {
+          return;
+        }
+        transmittance *=
+            shader::residualRatioWeight(extinctionAt(t), control, majorant);
+        transmittance = shader::rouletteTransmittance(transmittance, uniform());
+      }
+    }
+
+    const float majorant = range.y;
+    if (estimator == TRANSMITTANCE_NEXT_FLIGHT) {
+      float weight = 1.0f, sum = 0.0f;
+      for (float t = t0; weight != 0.0f;) {
+        sum += weight * shader::nextFlightProbability(majorant, t, t1);
+        t += shader::sampleFreeFlight(uniform(), majorant);
+        if (t >= t1) {
+          break;
+        }
+        weight *= shader::ratioTrackingWeight(extinctionAt(t), majorant);
+      }
+      transmittance *= sum;
+      return;
+    }
+
+    for (float t = t0;;) {
+      t += shader::sampleFreeFlight(uniform(), majorant);
+      if (t >= t1 || transmittance == 0.0f) {
+        return;
+      }
+      const float extinction = extinctionAt(t);
+      if (estimator == TRANSMITTANCE_DELTA_TRACKING) {
+        if (uniform() * majorant < extinction) {
+          transmittance = 0.0f;
+        }
+      } else {
+        transmittance *= shader::ratioTrackingWeight(extinction, majorant);
+        transmittance = shader::rouletteTransmittance(transmittance, uniform());
+      }
+    }
+  }
+};
+
+struct ShadowRay {
+  nvmath::vec3f origin;
+  nvmath::vec3f dir;
+  float distance;
+  float transmittance;  // exact
+};
+
+}  // namespace
+
+float estimateTransmittance(const DensityGrid& grid,
+                            const nvmath::vec3f& origin,
+                            const nvmath::vec3f& dir, float tMax,
+                            int estimator, uint32_t key, uint32_t& counter,
+                            uint64_t* lookups) {
+  if (grid.brickExtinction.empty()) {
+    return 1.0f;
+  }
+  Tracker tracker{grid, origin, dir, key, counter};
+  float transmittance = 1.0f;
+  traverseCells(
+      grid.boundsMin, grid.boundsMax, grid.brickResolution, origin, dir, tMax,
+      [&](float t0, float t1, const nvmath::vec3i& brick) {
+        const nvmath::vec2f& range = grid.brickExtinction
+            [(size_t(brick.z) * grid.brickResolution.y + brick.y) *
+                 grid.brickResolution.x +
+             brick.x];
+        if (range.y > 0.0f && transmittance != 0.0f) {
+          tracker.trackBrick(t0, t1, range, estimator, transmittance);
+        }
+      });
+  if (lookups) {
+    *lookups += tracker.lookups;
+  }
+  return transmittance;
+}
+
+std::vector<TransmittanceBenchmarkResult> benchmarkTransmittance(
+    uint32_t numRays, uint32_t samplesPerRay, uint32_t seed) {
+  using Clock = std::chrono::high_resolution_clock;
+  const std::vector<Sphere> cloud = makeGaussianPointCloud(20000, 0.6f, seed);
+
+  std::vector<TransmittanceBenchmarkResult> results;
+  for (float maxExtinction : {2.0f, 20.0f}) {
+    const DensityGrid grid = createDensityGrid(cloud, maxExtinction, 64);
+
+    // from points of the cloud toward lights around it
+    std::vector<ShadowRay> rays(numRays);
+    double meanTransmittance = 0.0;
+    for (uint32_t r = 0; r < numRays; ++r) {
+      float u[3];
+      generateUniformFloats(hostRngKey(seed, r + 1), 0, u, 3);
+      const nvmath::vec3f origin =
+          cloud[std::min(size_t(u[0] * cloud.size()), cloud.size() - 1)]
+              .center;
+      const float cosTheta = 2.0f * u[1] - 1.0f;
+      const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+      const float phi      = 6.28318530718f * u[2];
+      const nvmath::vec3f light =
+          3.0f * nvmath::vec3f(sinTheta * std::cos(phi),
+                               sinTheta * std::sin(phi), cosTheta);
+
+      ShadowRay& ray = rays[r];
+      ray.origin     = origin;
+      ray.distance   = nvmath::length(light - origin);
+      ray.dir        = (light - origin) / ray.distance;
+      ray.transmittance =
+          std::exp(-opticalDepth(grid, ray.origin, ray.dir, ray.distance));
+      meanTransmittance += ray.transmittance;
+    }
+
+    for (int estimator :
+         {TRANSMITTANCE_DELTA_TRACKING, TRANSMITTANCE_RATIO_TRACKING,
+          TRANSMITTANCE_RESIDUAL_RATIO_TRACKING, TRANSMITTANCE_NEXT_FLIGHT}) {
+      double bias = 0.0, variance = 0.0;
+      uint64_t lookups = 0;
+      const auto start = Clock::now();
+      for (uint32_t r = 0; r < numRays; ++r) {
+        const ShadowRay& ray = rays[r];
+        const uint32_t key   = hostRngKey(seed + 1, r);
+        uint32_t counter     = 0;
+        double sum = 0.0, sumSquares = 0.0;
+        for (uint32_t s = 0; s < samplesPerRay; ++s) {
+          const double sample =
+              estimateTransmittance(grid, ray.origin, ray.dir, ray.distance,
+                                    estimator, key, counter, &lookups);
+          sum += sample;
+          sumSquares += sample * sample;
+        }
+        const double mean = sum / samplesPerRay;
+        bias += mean - ray.transmittance;
+        variance +=
+            std::max(0.0, (sumSquares - sum * mean) / (samplesPerRay - 1));
+      }
+      const double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+      const double numSamples = double(numRays) * samplesPerRay;
+
+      TransmittanceBenchmarkResult result;
+      result.maxExtinction     = maxExtinction;
+      result.estimator         = estimator;
+      result.meanTransmittance = float(meanTransmittance / numRays);
+      result.bias              = float(bias / numRays);
+      result.standardError =
+          float(std::sqrt(variance / samplesPerRay) / numRays);
+      result.variance         = float(variance / numRays);
+      result.lookupsPerSample = float(double(lookups) / numSamples);
+      result.nsPerSample      = float(seconds * 1e9 / numSamples);
+      results.push_back(result);
+    }
+  }
+  return results;
+}
+
+void logTransmittance(
+    const std::vector<TransmittanceBenchmarkResult>& results) {
+  spdlog::info("{:>7} {:>15} {:>8} {:>10} {:>10} {:>10} {:>9} {:>9} {:>12}",
+               "sigma", "estimator", "T", "bias", "std error", "variance",
+               "lookups", "ns", "var x ns");
+  for (const TransmittanceBenchmarkResult& result : results) {
+    spdlog::info(
+        "{:>7.1f} {:>15} {:>8.4f} {:>10.6f} {:>10.6f} {:>10.6f} {:>9.2f} "
+        "{:>9.1f} {:>12.4f}",
+        result.maxExtinction, estimatorName(result.estimator),
+        result.meanTransmittance, result.bias, result.standardError,
+        result.variance, result.lookupsPerSample, result.nsPerSample,
+        result.variance * result.nsPerSample);
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef __VOLUME_RESTIR_UTILS_TRANSMITTANCE_HPP__
+#define __VOLUME_RESTIR_UTILS_TRANSMITTANCE_HPP__
+
+/**
+ * @file transmittance.hpp
+ *
+ * @brief Host mirror of the shadow-ray transmittance estimators of
+ * `shaders/headers/volume.glsl`, built from the shared functions of
+ * `shaders/headers/transmittance.glsl`.
+ *
+ *  The estimators walk the bricks of the density grid, skip the empty ones
+ *  and track the others against the brick's own majorant (and control for
+ *  residual ratio tracking), so sparse and smooth media cost few lookups.
+ *
+ *  `benchmarkTransmittance` estimates the transmittance of shadow rays from
+ *  points inside a Gaussian smoke cloud, thin and thick, with every
+ *  estimator, and compares the variance per sample and the density lookups
+ *  and time per sample against the exact voxel-by-voxel optical depth.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "utils/volume.hpp"
+
+/// Transmittance along the ray up to `tMax` with the TRANSMITTANCE_*
+/// `estimator`, drawing `rngUniformAt(key, counter++)`; adds the density
+/// lookups to `lookups` if given
+[[nodiscard]] float estimateTransmittance(const DensityGrid& grid,
+                                          const nvmath::vec3f& origin,
+                                          const nvmath::vec3f& dir, float tMax,
+                                          int estimator, uint32_t key,
+                                          uint32_t& counter,
+                                          uint64_t* lookups = nullptr);
+
+struct TransmittanceBenchmarkResult {
+  float maxExtinction;  // of the densest voxel
+  int estimator;
+  float meanTransmittance;  // exact, over the shadow rays
+  float bias;               // mean estimate minus the exact transmittance
+  float standardError;      // of the bias
+  float variance;           // per sample, averaged over the shadow rays
+  float lookupsPerSample;
+  float nsPerSample;  // single thread
+};
+
+/// Runs every estimator in a thin and a thick cloud
+[[nodiscard]] std::vector<TransmittanceBenchmarkResult> benchmarkTransmittance(
+    uint32_t numRays = 2048, uint32_t samplesPerRay = 64, uint32_t seed = 0);
+
+void logTransmittance(const std::vector<TransmittanceBenchmarkResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_TRANSMITTANCE_HPP__ */
@@ -0,0 +1,278 @@
+#include "utils/upsampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "spdlog/spdlog.h"
+#include "utils/parallel.hpp"
+
+namespace {
+
+const char* renderScaleName(int renderScale) {
+  switch (renderScale) {
+    case RENDER_SCALE_HALF:
+      return "half";
+    case RENDER_SCALE_QUARTER:
+      return "quarter";
+    case RENDER_SCALE_CHECKERBOARD:
+      return "checkerboard";
+  }
+  return "full";
+}
+
+/// Tent with a radius of two blocks, four blocks wide, as in renderScale.glsl
+float spatialWeight(const nvmath::vec2i& pixel, const nvmath::vec2i& shaded,
+                    int renderScale) {
+  const nvmath::vec2i block = renderScaleBlockSize(renderScale);
+  const float radius        = 2.0f * float(std::max(block.x, block.y));
+  const float tentX =
+      std::max(0.0f, 1.0f - std::abs(float(pixel.x - shaded.x)) / radius);
+  const float tentY =
+      std::max(0.0f, 1.0f - std::abs(float(pixel.y - shaded.y)) / radius);
+  return tentX * tentY;
+}
+
+float bilateralWeight(const GBufferSample& pixel,
+                      const GBufferSample& shaded) {
+  const float depthWeight =
+      std::exp(-std::abs(pixel.depth - shaded.depth) /
+               (kRenderScaleDepthSigma * pixel.depth));
+  const float normalWeight =
+      std::pow(std::max(nvmath::dot(pixel.normal, shaded.normal), 0.0f),
+               kRenderScaleNormalPower);
+  return depthWeight * normalWeight;
+}
+
+/// Synthetic frame: a textured wall, a tilted slab in front of it and a
+/// bright disk closest to the camera, so every kind of edge shows up
+struct SyntheticPixel {
+  GBufferSample gBuffer;
+  nvmath::vec3f radiance;
+  int surface;
+};
+
+SyntheticPixel syntheticPixel(const nvmath::vec2i& pixel,
+                              const nvmath::vec2ui& size) {
+  const float x = (pixel.x + 0.5f) / float(size.x);
+  const float y = (pixel.y + 0.5f) / float(size.y);
+
+  SyntheticPixel result;
+  const float dx = (x - 0.7f) * float(size.x) / float(size.y);
+  const float dy = y - 0.4f;
+  if (dx * dx + dy * dy < 0.04f) {
+    result.surface        = 2;
+    result.gBuffer.depth  = 3.0f;
+    result.gBuffer.normal = nvmath::vec3f(0.0f, 0.0f, 1.0f);
+    result.radiance       = nvmath::vec3f(4.0f, 3.5f, 3.0f);
+  } else if (x > 0.2f && x < 0.5f) {
+    result.surface        = 1;
+    result.gBuffer.depth  = 5.0f + 3.0f * (x - 0.2f) / 0.3f;
+    result.gBuffer.normal = nvmath::normalize(nvmath::vec3f(0.6f, 0.0f, 0.8f));
+    result.radiance       = nvmath::vec3f(0.8f * y, 0.3f, 0.1f + 0.5f * x);
+  } else {
+    result.surface        = 0;
+    result.gBuffer.depth  = 20.0f;
+    result.gBuffer.normal = nvmath::vec3f(0.0f, 0.0f, 1.0f);
+    const float pattern =
+        0.5f + 0.5f * std::sin(40.0f * x) * std::cos(25.0f * y);
+    result.radiance = nvmath::vec3f(0.2f + 0.3f * pattern, 0.25f, 0.3f);
+  }
+  return result;
+}
+
+float squaredError(const nvmath::vec3f& a, const nvmath::vec3f& b) {
+  const nvmath::vec3f d = a - b;
+  return nvmath::dot(d, d) / 3.0f;
+}
+
+}  // namespace
+
+nvmath::vec2i renderScaleBlockSize(int renderScale) {
+  switch (renderScale) {
+    case RENDER_SCALE_HALF:
+      return nvmath::vec2i(2, 2);
+    case RENDER_SCALE_QUARTER:
+      return nvmath::vec2i(4, 4);
+    case RENDER_SCALE_CHECKERBOARD:
+      return nvmath::vec2i(2, 1);
+  }
+  return nvmath::vec2i(1, 1);
+}
+
+nvmath::vec2ui renderScaleSize(const nvmath::vec2ui& screenSize,
+                               int renderScale) {
+  const nvmath::vec2i block = renderScaleBlockSize(renderScale);
+  return nvmath::vec2ui((screenSize.x + block.x - 1) / block.x,
+                        (screenSize.y + block.y - 1) / block.y);
+}
+
+nvmath::vec2i renderScalePixel(const nvmath::vec2i& coord, int renderScale,
+                               uint32_t frameIndex,
+                               const nvmath::vec2ui& screenSize) {
+  const nvmath::vec2i block = renderScaleBlockSize(renderScale);
+  const uint32_t width      = uint32_t(block.x);
+  const uint32_t offset =
+      (frameIndex + uint32_t(coord.y)) % (width * uint32_t(block.y));
+  return nvmath::vec2i(
+      std::min(coord.x * block.x + int(offset % width), int(screenSize.x) - 1),
+      std::min(coord.y * block.y + int(offset / width), int(screenSize.y) - 1));
+}
+
+nvmath::vec2i renderScaleCoord(const nvmath::vec2i& pixel, int renderScale) {
+  const nvmath::vec2i block = renderScaleBlockSize(renderScale);
+  return nvmath::vec2i(pixel.x / block.x, pixel.y / block.y);
+}
+
+std::vector<nvmath::vec3f> upsampleJointBilateral(
+    const std::vector<nvmath::vec3f>& radiance,
+    const std::vector<GBufferSample>& gBuffer, const nvmath::vec2ui& screenSize,
+    int renderScale, uint32_t frameIndex) {
+  if (renderScale == RENDER_SCALE_FULL) {
+    return radiance;
+  }
+  const nvmath::vec2ui renderSize = renderScaleSize(screenSize, renderScale);
+  std::vector<nvmath::vec3f> result(gBuffer.size(), nvmath::vec3f(0.0f));
+
+  parallelBatches(screenSize.y, [&](size_t begin, size_t end) {
+    for (size_t y = begin; y < end; ++y) {
+      for (uint32_t x = 0; x < screenSize.x; ++x) {
+        const nvmath::vec2i pixel(static_cast<int>(x), static_cast<int>(y));
+        const GBufferSample& sample = gBuffer[y * screenSize.x + x];
+        if (sample.depth <= 0.0f) {
+          continue;
+        }
+        const nvmath::vec2i center = renderScaleCoord(pixel, renderScale);
+        nvmath::vec3f sum(0.0f), spatialSum(0.0f);
+        float weight = 0.0f, spatialWeightSum = 0.0f;
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dx = -1; dx <= 1; ++dx) {
+            const nvmath::vec2i coord = center + nvmath::vec2i(dx, dy);
+            if (coord.x < 0 || coord.y < 0 || coord.x >= int(renderSize.x) ||
+                coord.y >= int(renderSize.y)) {
+              continue;
+            }
+            const nvmath::vec2i shaded =
+                renderScalePixel(coord, renderScale, frameIndex, screenSize);
+            const GBufferSample& shadedSample =
+                gBuffer[size_t(shaded.y) * screenSize.x + shaded.x];
+            const float ws = spatialWeight(pixel, shaded, renderScale);
+            if (ws <= 0.0f || shadedSample.depth <= 0.0f) {
+              continue;
+            }
+            const nvmath::vec3f& value =
+                radiance[size_t(coord.y) * renderSize.x + coord.x];
+            const float wb = ws * bilateralWeight(sample, shadedSample);
+            sum += wb * value;
+            weight += wb;
+            spatialSum += ws * value;
+            spatialWeightSum += ws;
+          }
+        }
+        nvmath::vec3f& out = result[y * screenSize.x + x];
+        if (weight > kRenderScaleMinWeight) {
+          out = sum / weight;
+        } else if (spatialWeightSum > 0.0f) {
+          out = spatialSum / spatialWeightSum;
+        }
+      }
+    }
+  });
+  return result;
+}
+
+std::vector<UpsamplingResult> validateUpsampling(uint32_t width,
+                                                 uint32_t height,
+                                                 uint32_t frameIndex) {
+  const nvmath::vec2ui screenSize(width, height);
+  std::vector<GBufferSample> gBuffer(size_t(width) * height);
+  std::vector<nvmath::vec3f> reference(gBuffer.size());
+  std::vector<int> surface(gBuffer.size());
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      const SyntheticPixel p =
+          syntheticPixel(nvmath::vec2i(int(x), int(y)), screenSize);
+      gBuffer[size_t(y) * width + x]   = p.gBuffer;
+      reference[size_t(y) * width + x] = p.radiance;
+      surface[size_t(y) * width + x]   = p.surface;
+    }
+  }
+  auto isEdge = [&](uint32_t x, uint32_t y) {
+    const int s = surface[size_t(y) * width + x];
+    return (x > 0 && surface[size_t(y) * width + x - 1] != s) ||
+           (x + 1 < width && surface[size_t(y) * width + x + 1] != s) ||
+           (y > 0 && surface[size_t(y - 1) * width + x] != s) ||
+           (y + 1 < height && surface[size_t(y + 1) * width + x] != s);
+  };
+
+  std::vector<UpsamplingResult> results;
+  for (int renderScale : {RENDER_SCALE_FULL, RENDER_SCALE_CHECKERBOARD,
+                          RENDER_SCALE_HALF, RENDER_SCALE_QUARTER}) {
+    // shade the reservoir grid as restir.rgen does
+    const nvmath::vec2ui renderSize = renderScaleSize(screenSize, renderScale);
+    std::vector<nvmath::vec3f> radiance(size_t(renderSize.x) * renderSize.y);
+    for (uint32_t y = 0; y < renderSize.y; ++y) {
+      for (uint32_t x = 0; x < renderSize.x; ++x) {
+        const nvmath::vec2i shaded = renderScalePixel(
+            nvmath::vec2i(int(x), int(y)), renderScale, frameIndex, screenSize);
+        radiance[size_t(y) * renderSize.x + x] =
+            reference[size_t(shaded.y) * width + shaded.x];
+      }
+    }
+    const std::vector<nvmath::vec3f> upsampled = upsampleJointBilateral(
+        radiance, gBuffer, screenSize, renderScale, frameIndex);
+
+    double sumBilateral = 0.0, sumNearest = 0.0;
+    double edgeBilateral = 0.0, edgeNearest = 0.0;
+    size_t numEdges = 0;
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        const size_t i = size_t(y) * width + x;
+        const nvmath::vec2i coord =
+            renderScaleCoord(nvmath::vec2i(int(x), int(y)), renderScale);
+        const float errorBilateral = squaredError(upsampled[i], reference[i]);
+        const float errorNearest   = squaredError(
+            radiance[size_t(coord.y) * renderSize.x + coord.x], reference[i]);
+        sumBilateral += errorBilateral;
+        sumNearest += errorNearest;
+        if (isEdge(x, y)) {
+          edgeBilateral += errorBilateral;
+          edgeNearest += errorNearest;
+          ++numEdges;
+        }
+      }
+    }
+    const double numPixels = double(gBuffer.size());
+    const double edges     = double(std::max<size_t>(numEdges, 1));
+
+    UpsamplingResult result;
+    result.renderScale    = renderScale;
+    result.shadedFraction = float(radiance.size() / numPixels);
+    result.rmseBilateral  = float(std::sqrt(sumBilateral / numPixels));
+    result.rmseNearest    = float(std::sqrt(sumNearest / numPixels));
+    result.edgeRmseBilateral = float(std::sqrt(edgeBilateral / edges));
+    result.edgeRmseNearest   = float(std::sqrt(edgeNearest / edges));
+    results.push_back(result);
+  }
+  return results;
+}
+
+bool isUpsamplingValid(const std::vector<UpsamplingResult>& results) {
+  return std::all_of(
+      results.begin(), results.end(), [](const UpsamplingResult& result) {
+        if (result.renderScale == RENDER_SCALE_FULL) {
+          return result.rmseBilateral == 0.0f;
+        }
+        return result.edgeRmseBilateral <= result.edgeRmseNearest;
+      });
+}
+
+void logUpsampling(const std::vector<UpsamplingResult>& results) {
+  spdlog::info("{:>13} {:>8} {:>12} {:>12} {:>12} {:>12}", "scale", "shaded",
+               "rmse", "rmse (near)", "edge", "edge (near)");
+  for (const UpsamplingResult& result : results) {
+    spdlog::info("{:>13} {:>8.3f} {:>12.5f} {:>12.5f} {:>12.5f} {:>12.5f}",
+                 renderScaleName(result.renderScale), result.shadedFraction,
+                 result.rmseBilateral, result.rmseNearest,
+                 result.edgeRmseBilateral, result.edgeRmseNearest);
+  }
+}
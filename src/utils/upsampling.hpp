@@ -0,0 +1,71 @@
+#ifndef __VOLUME_RESTIR_UTILS_UPSAMPLING_HPP__
+#define __VOLUME_RESTIR_UTILS_UPSAMPLING_HPP__
+
+/**
+ * @file upsampling.hpp
+ *
+ * @brief Host reference of the reduced-rate ReSTIR modes: the reservoir grid
+ * of `shaders/headers/renderScale.glsl` and the joint-bilateral upsampler of
+ * `restir_post.frag`.
+ *
+ *  `validateUpsampling` renders a synthetic GBuffer with depth and normal
+ *  discontinuities at full resolution and through every render scale, and
+ *  diffs the upsampled images against the full resolution one, with nearest
+ *  neighbour upsampling as the baseline.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "shaders/host_device.h"
+#include "utils/packing.hpp"
+
+// keep in sync with renderScale.glsl
+constexpr float kRenderScaleDepthSigma  = 0.05f;
+constexpr float kRenderScaleNormalPower = 32.0f;
+constexpr float kRenderScaleMinWeight   = 1e-4f;
+
+[[nodiscard]] nvmath::vec2i renderScaleBlockSize(int renderScale);
+
+/// Size of the reservoir grid covering `screenSize`
+[[nodiscard]] nvmath::vec2ui renderScaleSize(const nvmath::vec2ui& screenSize,
+                                             int renderScale);
+
+/// Pixel shaded for reservoir texel `coord` in frame `frameIndex`
+[[nodiscard]] nvmath::vec2i renderScalePixel(const nvmath::vec2i& coord,
+                                             int renderScale,
+                                             uint32_t frameIndex,
+                                             const nvmath::vec2ui& screenSize);
+
+[[nodiscard]] nvmath::vec2i renderScaleCoord(const nvmath::vec2i& pixel,
+                                             int renderScale);
+
+/// Upsamples `radiance`, one value per reservoir texel shaded at
+/// `renderScalePixel`, to the full resolution `gBuffer`
+[[nodiscard]] std::vector<nvmath::vec3f> upsampleJointBilateral(
+    const std::vector<nvmath::vec3f>& radiance,
+    const std::vector<GBufferSample>& gBuffer, const nvmath::vec2ui& screenSize,
+    int renderScale, uint32_t frameIndex);
+
+struct UpsamplingResult {
+  int renderScale;
+  float shadedFraction;  // shaded pixels per screen pixel
+  float rmseBilateral;
+  float rmseNearest;
+  float edgeRmseBilateral;  // pixels next to a depth or normal discontinuity
+  float edgeRmseNearest;
+};
+
+[[nodiscard]] std::vector<UpsamplingResult> validateUpsampling(
+    uint32_t width = 960, uint32_t height = 540, uint32_t frameIndex = 1);
+
+/// False if the full rate image differs from the reference or the upsampler
+/// does worse than nearest neighbour at the discontinuities
+[[nodiscard]] bool isUpsamplingValid(
+    const std::vector<UpsamplingResult>& results);
+
+void logUpsampling(const std::vector<UpsamplingResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_UPSAMPLING_HPP__ */
@@ -0,0 +1,30 @@
+#include "utils/validation.hpp"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+bool allChecksPassed(const std::vector<ValidationCheck>& checks) {
+  return std::all_of(checks.begin(), checks.end(),
+                     [](const ValidationCheck& check) {
+                       return check.expected == check.observed;
+                     });
+}
+
+void logValidationChecks(const std::vector<ValidationCheck>& checks) {
+  size_t width = 0;
+  for (const ValidationCheck& check : checks) {
+    width = std::max(width, check.scenario.size());
+  }
+  for (const ValidationCheck& check : checks) {
+    spdlog::info("{:>{}}: {} {}", check.scenario, width, check.observed,
+                 check.expected == check.observed
+                     ? "as expected"
+                     : fmt::format("(expected {})", check.expected));
+  }
+}
+
+int reportValidationChecks(const std::vector<ValidationCheck>& checks) {
+  logValidationChecks(checks);
+  return allChecksPassed(checks) ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+#ifndef __VOLUME_RESTIR_UTILS_VALIDATION_HPP__
+#define __VOLUME_RESTIR_UTILS_VALIDATION_HPP__
+
+/**
+ * @file validation.hpp
+ *
+ * @brief Outcome of the `--validate-*` scenarios that state what they expect
+ * as text.
+ *
+ *  A check passes when it observed exactly what it expected; the scenarios
+ *  format both with the same precision, so that the comparison and the log
+ *  read the same.
+ */
+
+#include <string>
+#include <vector>
+
+struct ValidationCheck {
+  std::string scenario;
+  std::string expected;
+  std::string observed;
+};
+
+/// False if a scenario did not observe what it expected
+[[nodiscard]] bool allChecksPassed(const std::vector<ValidationCheck>& checks);
+
+void logValidationChecks(const std::vector<ValidationCheck>& checks);
+
+/// Logs the checks and returns the exit code of their `--validate-*` flag
+[[nodiscard]] int reportValidationChecks(
+    const std::vector<ValidationCheck>& checks);
+
+#endif /* __VOLUME_RESTIR_UTILS_VALIDATION_HPP__ */
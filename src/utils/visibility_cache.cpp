@@ -0,0 +1,52 @@
+#include "utils/visibility_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/shader_functions.hpp"
+
+namespace {
+
+// keep in sync with RESERVOIR_LIGHT_INDEX_BITS in reservoir.glsl
+constexpr uint32_t kLightIndexBits = 30;
+// keep in sync with LIGHT_KIND_TRIANGLE in structs/light.glsl
+constexpr int32_t kLightKindTriangle = 1;
+
+}  // namespace
+
+uint32_t visibilityCacheLightKey(uint32_t lightIndex, int32_t lightKind,
+                                 uint32_t sampleSeed) {
+  const uint32_t key = lightIndex | (uint32_t(lightKind) << kLightIndexBits);
+  return lightKind == kLightKindTriangle
+             ? shader::rngHash(key ^ shader::rngHash(sampleSeed))
+             : key;
+}
+
+uint32_t visibilityCachePositionKey(const nvmath::vec3f& worldPos,
+                                    float depth) {
+  const float scaled = std::max(depth * kVisibilityCacheCellScale, 1e-6f);
+  const int level    = int(std::floor(std::log2(scaled)));
+  const float cell   = std::exp2(float(level));
+  uint32_t key = shader::rngHash(uint32_t(int(std::floor(worldPos.x / cell))) +
+                                 shader::rngHash(uint32_t(level)));
+  key = shader::rngHash(uint32_t(int(std::floor(worldPos.y / cell))) + key);
+  return shader::rngHash(uint32_t(int(std::floor(worldPos.z / cell))) + key);
+}
+
+bool isVisibilityCacheHit(const VisibilityCacheEntry& entry,
+                          uint32_t lightKey, uint32_t positionKey,
+                          uint32_t epoch, uint32_t frameIndex,
+                          uint32_t maxAge) {
+  return entry.lightKey == lightKey && entry.positionKey == positionKey &&
+         (entry.stamp >> 1) == (epoch & 0x7FFFFFFFu) &&
+         frameIndex - entry.frameIndex <= maxAge;
+}
+
+VisibilityCacheEntry makeVisibilityCacheEntry(uint32_t lightKey,
+                                              uint32_t positionKey,
+                                              uint32_t epoch,
+                                              uint32_t frameIndex,
+                                              bool shadowed) {
+  return VisibilityCacheEntry{lightKey, positionKey, frameIndex,
+                              (epoch << 1) | (shadowed ? 0u : 1u)};
+}
@@ -0,0 +1,46 @@
+#ifndef __VOLUME_RESTIR_UTILS_VISIBILITY_CACHE_HPP__
+#define __VOLUME_RESTIR_UTILS_VISIBILITY_CACHE_HPP__
+
+/**
+ * @file visibility_cache.hpp
+ *
+ * @brief Host mirror of the per-pixel shadow-ray cache of `restir.rgen`,
+ * see `shaders/headers/visibilityCache.glsl` for the entry layout and the
+ * invalidation rules.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <cstdint>
+
+// keep in sync with visibilityCache.glsl
+constexpr float kVisibilityCacheCellScale = 1.0f / 256.0f;
+
+struct VisibilityCacheEntry {
+  uint32_t lightKey    = 0;
+  uint32_t positionKey = 0;
+  uint32_t frameIndex  = 0;
+  uint32_t stamp       = 0;  // epoch << 1 | visible
+};
+
+/// Light index and kind, hashed with `sampleSeed` for triangle lights whose
+/// sampled point it picks
+[[nodiscard]] uint32_t visibilityCacheLightKey(uint32_t lightIndex,
+                                               int32_t lightKind,
+                                               uint32_t sampleSeed);
+
+/// Hash of the power-of-two cell around `worldPos` whose edge is about
+/// `kVisibilityCacheCellScale` times the camera distance `depth`
+[[nodiscard]] uint32_t visibilityCachePositionKey(
+    const nvmath::vec3f& worldPos, float depth);
+
+[[nodiscard]] bool isVisibilityCacheHit(const VisibilityCacheEntry& entry,
+                                        uint32_t lightKey,
+                                        uint32_t positionKey, uint32_t epoch,
+                                        uint32_t frameIndex, uint32_t maxAge);
+
+[[nodiscard]] VisibilityCacheEntry makeVisibilityCacheEntry(
+    uint32_t lightKey, uint32_t positionKey, uint32_t epoch,
+    uint32_t frameIndex, bool shadowed);
+
+#endif /* __VOLUME_RESTIR_UTILS_VISIBILITY_CACHE_HPP__ */
@@ -0,0 +1,397 @@
+#include "utils/volume.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "spdlog/spdlog.h"
+#include "utils/parallel.hpp"
+#include "utils/rng.hpp"
+#include "utils/shader_functions.hpp"
+#include "utils/transmittance.hpp"
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+bool intersectBounds(const DensityGrid& grid, const nvmath::vec3f& origin,
+                     const nvmath::vec3f& dir, float& tEnter, float& tExit) {
+  tEnter = 0.0f;
+  tExit  = kInfinity;
+  for (int a = 0; a < 3; ++a) {
+    const float invDir = 1.0f / dir[a];
+    float t0           = (grid.boundsMin[a] - origin[a]) * invDir;
+    float t1           = (grid.boundsMax[a] - origin[a]) * invDir;
+    if (t0 > t1) {
+      std::swap(t0, t1);
+    }
+    tEnter = std::max(tEnter, t0);
+    tExit  = std::min(tExit, t1);
+  }
+  return tEnter < tExit;
+}
+
+nvmath::vec3i voxelOf(const DensityGrid& grid, const nvmath::vec3f& p) {
+  nvmath::vec3i voxel;
+  for (int a = 0; a < 3; ++a) {
+    const float uvw = (p[a] - grid.boundsMin[a]) /
+                      (grid.boundsMax[a] - grid.boundsMin[a]);
+    voxel[a] = std::clamp(int(uvw * float(grid.resolution[a])), 0,
+                          grid.resolution[a] - 1);
+  }
+  return voxel;
+}
+
+size_t voxelIndex(const DensityGrid& grid, const nvmath::vec3i& voxel) {
+  return (size_t(voxel.z) * grid.resolution.y + voxel.y) * grid.resolution.x +
+         voxel.x;
+}
+
+/// Calls `fn(tBegin, tEnd, extinction)` for every voxel the ray crosses
+/// before `tMax`
+template <typename SegmentFn>
+void traverseGrid(const DensityGrid& grid, const nvmath::vec3f& origin,
+                  const nvmath::vec3f& dir, float tMax, SegmentFn&& fn) {
+  if (grid.extinction.empty()) {
+    return;
+  }
+  traverseCells(grid.boundsMin, grid.boundsMax, grid.resolution, origin, dir,
+                tMax,
+                [&](float t0, float t1, const nvmath::vec3i& voxel) {
+                  fn(t0, t1, grid.extinction[voxelIndex(grid, voxel)]);
+                });
+}
+
+struct VolumeLight {
+  nvmath::vec3f position;
+  float power;  // emission luminance
+};
+
+struct VolumeScene {
+  DensityGrid grid;
+  std::vector<VolumeLight> lights;
+  float totalPower;
+  float albedo;
+  float anisotropy;
+};
+
+// keep in sync with the default initial candidate count of the renderer
+constexpr uint32_t kVolumeCandidates = 8;
+
+/// Unshadowed in-scattered luminance of `light` at `x`, as evaluatePHatFull
+/// in restirUtils.glsl, or with the `luminanceFastPath` of the phase function
+/// the target function of evaluatePHat
+float volumeTarget(const VolumeScene& scene, const VolumeLight& light,
+                   const nvmath::vec3f& x, const nvmath::vec3f& wo,
+                   nvmath::vec3f& wi, float& distance,
+                   bool luminanceFastPath = false) {
+  wi                  = light.position - x;
+  const float sqrDist = nvmath::dot(wi, wi);
+  distance            = std::sqrt(sqrDist);
+  wi /= distance;
+  const shader::PhaseFunction phase{PHASE_HENYEY_GREENSTEIN, scene.anisotropy,
+                                    0.0f, 1.0f, 0.0f};
+  const float cosTheta = nvmath::dot(wo, wi);
+  const float scattered =
+      luminanceFastPath
+          ? shader::phaseLuminance(phase, cosTheta, scene.albedo)
+          : scene.albedo * shader::phaseEval(phase, cosTheta);
+  return light.power * scattered / sqrDist;
+}
+
+/// Single scattering along the camera ray, integrated voxel by voxel with
+/// the midpoint rule and exact shadow transmittance
+float referenceRadiance(const VolumeScene& scene, const nvmath::vec3f& origin,
+                        const nvmath::vec3f& dir) {
+  constexpr int kSubsteps = 8;
+  double radiance = 0.0;
+  float tau       = 0.0f;
+  traverseGrid(
+      scene.grid, origin, dir, kInfinity,
+      [&](float t0, float t1, float sigma) {
+        if (sigma > 0.0f) {
+          const float dt = (t1 - t0) / kSubsteps;
+          for (int k = 0; k < kSubsteps; ++k) {
+            const float t = t0 + (float(k) + 0.5f) * dt;
+            const nvmath::vec3f x = origin + t * dir;
+            double inScattered    = 0.0;
+            for (const VolumeLight& light : scene.lights) {
+              nvmath::vec3f wi;
+              float distance;
+              const float target =
+                  volumeTarget(scene, light, x, -dir, wi, distance);
+              inScattered +=
+                  target *
+                  std::exp(-opticalDepth(scene.grid, x, wi, distance));
+            }
+            radiance += std::exp(-(tau + sigma * (t - t0))) * sigma *
+                        inScattered * dt;
+          }
+        }
+        tau += sigma * (t1 - t0);
+      });
+  return float(radiance);
+}
+
+/// One sample of restir.rgen in the volume mode: delta-tracked scatter
+/// point, RIS over the lights drawn by power with the fast-path target,
+/// ratio-tracked shadow ray as the renderer's default
+/// `kTransmittanceEstimator`
+float estimateRadiance(const VolumeScene& scene, const nvmath::vec3f& origin,
+                       const nvmath::vec3f& dir, uint32_t key,
+                       uint32_t& counter) {
+  const std::optional<float> t =
+      deltaTrack(scene.grid, origin, dir, kInfinity, key, counter);
+  if (!t) {
+    return 0.0f;
+  }
+  const nvmath::vec3f x = origin + *t * dir;
+
+  float sumWeights = 0.0f, selectedTarget = 0.0f, selectedDistance = 0.0f;
+  float selectedRadiance = 0.0f;
+  nvmath::vec3f selectedWi;
+  for (uint32_t i = 0; i < kVolumeCandidates; ++i) {
+    float u = shader::rngUniformAt(key, counter++) * scene.totalPower;
+    size_t l = 0;
+    while (l + 1 < scene.lights.size() && u >= scene.lights[l].power) {
+      u -= scene.lights[l].power;
+      ++l;
+    }
+    const float pdf = scene.lights[l].power / scene.totalPower;
+    nvmath::vec3f wi;
+    float distance;
+    const float target =
+        volumeTarget(scene, scene.lights[l], x, -dir, wi, distance, true);
+    const float weight = target / pdf;
+    sumWeights += weight;
+    if (shader::rngUniformAt(key, counter++) * sumWeights < weight) {
+      selectedTarget   = target;
+      selectedRadiance = volumeTarget(scene, scene.lights[l], x, -dir, wi,
+                                      distance);
+      selectedDistance = distance;
+      selectedWi       = wi;
+    }
+  }
+  if (selectedTarget <= 0.0f) {
+    return 0.0f;
+  }
+  return estimateTransmittance(scene.grid, x, selectedWi, selectedDistance,
+                               TRANSMITTANCE_RATIO_TRACKING, key, counter) *
+         selectedRadiance / selectedTarget * sumWeights /
+         float(kVolumeCandidates);
+}
+
+VolumeScene makeVolumeScene(uint32_t seed, float anisotropy) {
+  // a Gaussian cloud as dense as the VDB spheres
+  VolumeScene scene;
+  scene.grid =
+      createDensityGrid(makeGaussianPointCloud(20000, 0.6f, seed), 6.0f, 32);
+  scene.lights     = {{nvmath::vec3f(2.0f, 1.5f, 0.0f), 20.0f},
+                      {nvmath::vec3f(-2.0f, 0.5f, 1.0f), 10.0f},
+                      {nvmath::vec3f(0.0f, -2.0f, -1.0f), 5.0f},
+                      {nvmath::vec3f(0.5f, 2.5f, 2.0f), 15.0f}};
+  scene.totalPower = 0.0f;
+  for (const VolumeLight& light : scene.lights) {
+    scene.totalPower += light.power;
+  }
+  scene.albedo     = 0.8f;
+  scene.anisotropy = anisotropy;
+  return scene;
+}
+
+}  // namespace
+
+DensityGrid createDensityGrid(const std::vector<Sphere>& spheres,
+                              float maxExtinction, int maxResolution) {
+  DensityGrid grid;
+  if (spheres.empty() || maxResolution <= 0) {
+    return grid;
+  }
+  grid.boundsMin = nvmath::vec3f(kInfinity);
+  nvmath::vec3f boundsMax(-kInfinity);
+  for (const Sphere& s : spheres) {
+    for (int a = 0; a < 3; ++a) {
+      grid.boundsMin[a] = std::min(grid.boundsMin[a], s.center[a] - s.radius);
+      boundsMax[a]      = std::max(boundsMax[a], s.center[a] + s.radius);
+    }
+  }
+  const nvmath::vec3f extent = boundsMax - grid.boundsMin;
+  const float voxelSize =
+      std::max({extent.x, extent.y, extent.z}) / float(maxResolution);
+  for (int a = 0; a < 3; ++a) {
+    const int bricks = std::max(
+        1, int(std::ceil(extent[a] / (voxelSize * kDensityBrickSize))));
+    grid.brickResolution[a] = bricks;
+    grid.resolution[a]      = bricks * kDensityBrickSize;
+    grid.boundsMax[a] = grid.boundsMin[a] + grid.resolution[a] * voxelSize;
+  }
+
+  std::vector<uint32_t> counts(size_t(grid.resolution.x) * grid.resolution.y *
+                               grid.resolution.z);
+  for (const Sphere& s : spheres) {
+    ++counts[voxelIndex(grid, voxelOf(grid, s.center))];
+  }
+  const uint32_t maxCount = *std::max_element(counts.begin(), counts.end());
+  grid.extinction.resize(counts.size());
+  for (size_t i = 0; i < counts.size(); ++i) {
+    grid.extinction[i] = maxExtinction * float(counts[i]) / float(maxCount);
+  }
+  grid.majorant = maxExtinction;
+
+  grid.brickExtinction.assign(size_t(grid.brickResolution.x) *
+                                  grid.brickResolution.y *
+                                  grid.brickResolution.z,
+                              nvmath::vec2f(kInfinity, 0.0f));
+  for (int z = 0; z < grid.resolution.z; ++z) {
+    for (int y = 0; y < grid.resolution.y; ++y) {
+      for (int x = 0; x < grid.resolution.x; ++x) {
+        const float sigma =
+            grid.extinction[voxelIndex(grid, nvmath::vec3i(x, y, z))];
+        const size_t brick =
+            (size_t(z / kDensityBrickSize) * grid.brickResolution.y +
+             y / kDensityBrickSize) *
+                grid.brickResolution.x +
+            x / kDensityBrickSize;
+        nvmath::vec2f& range = grid.brickExtinction[brick];
+        range.x              = std::min(range.x, sigma);
+        range.y              = std::max(range.y, sigma);
+      }
+    }
+  }
+  return grid;
+}
+
+std::vector<Sphere> makeGaussianPointCloud(uint32_t numPoints, float sigma,
+                                           uint32_t seed) {
+  const uint32_t key = hostRngKey(seed, 0);
+  std::vector<Sphere> spheres(numPoints);
+  for (uint32_t i = 0; i < numPoints; ++i) {
+    float u[4];
+    generateUniformFloats(key, 4 * i, u, 4);
+    // Box-Muller
+    const float r0   = std::sqrt(-2.0f * std::log(1.0f - u[0]));
+    const float r1   = std::sqrt(-2.0f * std::log(1.0f - u[2]));
+    const float phi0 = 6.28318530718f * u[1];
+    const float phi1 = 6.28318530718f * u[3];
+    spheres[i].center =
+        sigma * nvmath::vec3f(r0 * std::cos(phi0), r0 * std::sin(phi0),
+                              r1 * std::cos(phi1));
+    spheres[i].radius = 0.005f;
+  }
+  return spheres;
+}
+
+float densityGridExtinction(const DensityGrid& grid, const nvmath::vec3f& p) {
+  if (grid.extinction.empty()) {
+    return 0.0f;
+  }
+  return grid.extinction[voxelIndex(grid, voxelOf(grid, p))];
+}
+
+std::optional<float> deltaTrack(const DensityGrid& grid,
+                                const nvmath::vec3f& origin,
+                                const nvmath::vec3f& dir, float tMax,
+                                uint32_t key, uint32_t& counter) {
+  float t, tExit;
+  if (grid.majorant <= 0.0f || !intersectBounds(grid, origin, dir, t, tExit)) {
+    return std::nullopt;
+  }
+  tExit = std::min(tExit, tMax);
+  while (true) {
+    t -= std::log(1.0f - shader::rngUniformAt(key, counter++)) / grid.majorant;
+    if (t >= tExit) {
+      return std::nullopt;
+    }
+    if (shader::rngUniformAt(key, counter++) * grid.majorant <
+        densityGridExtinction(grid, origin + t * dir)) {
+      return t;
+    }
+  }
+}
+
+float opticalDepth(const DensityGrid& grid, const nvmath::vec3f& origin,
+                   const nvmath::vec3f& dir, float tMax) {
+  float tau = 0.0f;
+  traverseGrid(grid, origin, dir, tMax, [&](float t0, float t1, float sigma) {
+    tau += sigma * (t1 - t0);
+  });
+  return tau;
+}
+
+std::vector<VolumeValidationResult> validateVolume(uint32_t numRays,
+                                                   uint32_t samplesPerRay,
+                                                   uint32_t seed) {
+  const nvmath::vec3f eye(0.0f, 0.0f, -4.0f);
+
+  std::vector<VolumeValidationResult> results;
+  for (float anisotropy : {-0.5f, 0.0f, 0.7f}) {
+    const VolumeScene scene = makeVolumeScene(seed, anisotropy);
+
+    struct RayResult {
+      double reference = 0.0, mean = 0.0, variance = 0.0;
+    };
+    std::vector<RayResult> rays(numRays);
+    parallelBatches(
+        numRays,
+        [&](size_t begin, size_t end) {
+          for (size_t r = begin; r < end; ++r) {
+            // camera rays through the middle of the cloud
+            const uint32_t key = hostRngKey(seed, uint32_t(r) + 1);
+            uint32_t counter   = 0;
+            const float x = 0.6f * shader::rngUniformAt(key, counter++) - 0.3f;
+            const float y = 0.6f * shader::rngUniformAt(key, counter++) - 0.3f;
+            const nvmath::vec3f dir = nvmath::normalize(nvmath::vec3f(x, y, 1));
+
+            RayResult& ray = rays[r];
+            ray.reference  = referenceRadiance(scene, eye, dir);
+            double sum = 0.0, sumSquares = 0.0;
+            for (uint32_t s = 0; s < samplesPerRay; ++s) {
+              const double sample =
+                  estimateRadiance(scene, eye, dir, key, counter);
+              sum += sample;
+              sumSquares += sample * sample;
+            }
+            ray.mean     = sum / samplesPerRay;
+            ray.variance = std::max(
+                0.0, (sumSquares - sum * ray.mean) / (samplesPerRay - 1));
+          }
+        },
+        1);
+
+    // the rays are shared, so only the variance within each ray counts
+    double reference = 0.0, estimate = 0.0, variance = 0.0;
+    for (const RayResult& ray : rays) {
+      reference += ray.reference;
+      estimate += ray.mean;
+      variance += ray.variance / samplesPerRay;
+    }
+    VolumeValidationResult result;
+    result.anisotropy    = anisotropy;
+    result.reference     = float(reference / numRays);
+    result.estimate      = float(estimate / numRays);
+    result.standardError = float(std::sqrt(variance) / numRays);
+    results.push_back(result);
+  }
+  return results;
+}
+
+bool isVolumeValid(const std::vector<VolumeValidationResult>& results) {
+  return std::all_of(results.begin(), results.end(),
+                     [](const VolumeValidationResult& result) {
+                       return result.reference > 0.0f &&
+                              std::abs(result.estimate - result.reference) <=
+                                  4.0f * result.standardError;
+                     });
+}
+
+void logVolume(const std::vector<VolumeValidationResult>& results) {
+  spdlog::info("{:>6} {:>12} {:>12} {:>12} {:>8}", "g", "reference",
+               "estimate", "std error", "sigmas");
+  for (const VolumeValidationResult& result : results) {
+    spdlog::info("{:>6.2f} {:>12.5f} {:>12.5f} {:>12.5f} {:>8.2f}",
+                 result.anisotropy, result.reference, result.estimate,
+                 result.standardError,
+                 std::abs(result.estimate - result.reference) /
+                     std::max(result.standardError, 1e-12f));
+  }
+}
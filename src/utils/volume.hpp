@@ -0,0 +1,145 @@
+#ifndef __VOLUME_RESTIR_UTILS_VOLUME_HPP__
+#define __VOLUME_RESTIR_UTILS_VOLUME_HPP__
+
+/**
+ * @file volume.hpp
+ *
+ * @brief Host side of the participating medium of `RESTIR_VOLUME_FLAG`: the
+ * extinction grid splatted from the VDB points and the delta tracking of
+ * `shaders/headers/volume.glsl`.
+ *
+ *  `validateVolume` checks the volumetric ReSTIR estimator of `restir.rgen`
+ *  (delta-tracked scatter point, RIS over the lights with the
+ *  Henyey-Greenstein target, ratio-tracked shadow ray) against a
+ *  deterministic single-scattering integral on a synthetic point cloud.
+ */
+
+#include <nvmath/nvmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "shaders/host_device.h"
+
+// voxels along each edge of a brick, keep in sync with volume.glsl
+constexpr int kDensityBrickSize = 8;
+
+struct DensityGrid {
+  nvmath::vec3i resolution{0, 0, 0};  // a multiple of kDensityBrickSize
+  nvmath::vec3f boundsMin;
+  nvmath::vec3f boundsMax;
+  std::vector<float> extinction;  // sigma_t per voxel, x fastest
+  float majorant = 0.0f;
+  // min and max extinction of each brick, the local controls and majorants
+  // of the transmittance estimators; empty bricks are skipped
+  nvmath::vec3i brickResolution{0, 0, 0};
+  std::vector<nvmath::vec2f> brickExtinction;
+};
+
+/// Counts the spheres per cubic voxel of a grid with `maxResolution` voxels
+/// along its longest axis, padded to whole bricks; the densest voxel gets
+/// `maxExtinction`
+[[nodiscard]] DensityGrid createDensityGrid(const std::vector<Sphere>& spheres,
+                                            float maxExtinction,
+                                            int maxResolution);
+
+/// Points drawn from an isotropic Gaussian of deviation `sigma` around the
+/// origin, as spheres of the VDB point radius
+[[nodiscard]] std::vector<Sphere> makeGaussianPointCloud(uint32_t numPoints,
+                                                         float sigma,
+                                                         uint32_t seed);
+
+/// Nearest-voxel extinction, as `volumeExtinction` in volume.glsl
+[[nodiscard]] float densityGridExtinction(const DensityGrid& grid,
+                                          const nvmath::vec3f& p);
+
+/// Distance of a delta-tracking collision before `tMax`, drawing the random
+/// numbers `rngUniformAt(key, counter++)`
+[[nodiscard]] std::optional<float> deltaTrack(const DensityGrid& grid,
+                                              const nvmath::vec3f& origin,
+                                              const nvmath::vec3f& dir,
+                                              float tMax, uint32_t key,
+                                              uint32_t& counter);
+
+/// Calls `fn(tBegin, tEnd, cell)` for every cell of a `resolution` grid over
+/// [boundsMin, boundsMax] that the ray crosses before `tMax`, in order
+/// (Amanatides and Woo)
+template <typename SegmentFn>
+void traverseCells(const nvmath::vec3f& boundsMin,
+                   const nvmath::vec3f& boundsMax,
+                   const nvmath::vec3i& resolution, const nvmath::vec3f& origin,
+                   const nvmath::vec3f& dir, float tMax, SegmentFn&& fn) {
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+  float tEnter = 0.0f, tExit = tMax;
+  for (int a = 0; a < 3; ++a) {
+    float t0 = (boundsMin[a] - origin[a]) / dir[a];
+    float t1 = (boundsMax[a] - origin[a]) / dir[a];
+    if (t0 > t1) {
+      std::swap(t0, t1);
+    }
+    tEnter = std::max(tEnter, t0);
+    tExit  = std::min(tExit, t1);
+  }
+  if (!(tEnter < tExit)) {
+    return;
+  }
+
+  nvmath::vec3i cell;
+  int step[3];
+  float tNext[3], tDelta[3];
+  for (int a = 0; a < 3; ++a) {
+    const float cellSize = (boundsMax[a] - boundsMin[a]) / float(resolution[a]);
+    const float p        = origin[a] + tEnter * dir[a];
+    cell[a] = std::clamp(int((p - boundsMin[a]) / cellSize), 0,
+                         resolution[a] - 1);
+    const int boundary = dir[a] > 0.0f ? cell[a] + 1 : cell[a];
+    step[a]   = dir[a] > 0.0f ? 1 : (dir[a] < 0.0f ? -1 : 0);
+    tNext[a]  = step[a] == 0
+                    ? kInfinity
+                    : (boundsMin[a] + boundary * cellSize - origin[a]) / dir[a];
+    tDelta[a] = step[a] == 0 ? kInfinity : cellSize / std::abs(dir[a]);
+  }
+
+  float t = tEnter;
+  while (t < tExit) {
+    const int a = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2)
+                                      : (tNext[1] < tNext[2] ? 1 : 2);
+    const float tEnd = std::min(tNext[a], tExit);
+    if (tEnd > t) {
+      fn(t, tEnd, cell);
+    }
+    t = tEnd;
+    cell[a] += step[a];
+    tNext[a] += tDelta[a];
+    if (cell[a] < 0 || cell[a] >= resolution[a]) {
+      break;
+    }
+  }
+}
+
+/// Exact optical depth along the ray up to `tMax`, voxel by voxel
+[[nodiscard]] float opticalDepth(const DensityGrid& grid,
+                                 const nvmath::vec3f& origin,
+                                 const nvmath::vec3f& dir, float tMax);
+
+struct VolumeValidationResult {
+  float anisotropy;
+  float reference;  // mean single-scattered luminance of the camera rays
+  float estimate;
+  float standardError;
+};
+
+[[nodiscard]] std::vector<VolumeValidationResult> validateVolume(
+    uint32_t numRays = 256, uint32_t samplesPerRay = 256, uint32_t seed = 0);
+
+/// False if an estimate is more than four standard errors off its reference
+[[nodiscard]] bool isVolumeValid(
+    const std::vector<VolumeValidationResult>& results);
+
+void logVolume(const std::vector<VolumeValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_VOLUME_HPP__ */
@@ -0,0 +1,248 @@
+#include "utils/volume_chunks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "spdlog/spdlog.h"
+#include "utils/rng.hpp"
+#include "utils/volume.hpp"
+
+namespace {
+
+// distance anim.comp moves a sphere per second of animation
+constexpr float kAnimationSpeed = 0.05f;
+
+struct Box {
+  nvmath::vec3f min{std::numeric_limits<float>::max()};
+  nvmath::vec3f max{-std::numeric_limits<float>::max()};
+
+  void extend(const Sphere& sphere) {
+    for (int a = 0; a < 3; ++a) {
+      min[a] = std::min(min[a], sphere.center[a] - sphere.radius);
+      max[a] = std::max(max[a], sphere.center[a] + sphere.radius);
+    }
+  }
+  float area() const {
+    const nvmath::vec3f d = max - min;
+    return d.x < 0.0f ? 0.0f : 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
+};
+
+// 10 bits of each coordinate interleaved
+uint32_t mortonCode(const nvmath::vec3f& unit) {
+  const auto spread = [](float x) {
+    uint32_t v = uint32_t(std::clamp(x, 0.0f, 1.0f) * 1023.0f);
+    v          = (v | (v << 16)) & 0x030000FF;
+    v          = (v | (v << 8)) & 0x0300F00F;
+    v          = (v | (v << 4)) & 0x030C30C3;
+    v          = (v | (v << 2)) & 0x09249249;
+    return v;
+  };
+  return spread(unit.x) | (spread(unit.y) << 1) | (spread(unit.z) << 2);
+}
+
+}  // namespace
+
+void VolumeChunks::create(std::vector<Sphere> spheres,
+                          std::vector<nvmath::vec3f> velocities,
+                          uint32_t chunkSpheres, float rebuildRatio) {
+  m_spheres      = std::move(spheres);
+  m_rebuildRatio = rebuildRatio;
+  // anim.comp moves along the direction of the velocity at a fixed speed
+  m_velocities.assign(m_spheres.size(), nvmath::vec3f(0.0f));
+  for (size_t i = 0; i < std::min(velocities.size(), m_spheres.size()); ++i) {
+    if (nvmath::dot(velocities[i], velocities[i]) > 0.0f) {
+      m_velocities[i] = nvmath::normalize(velocities[i]) * kAnimationSpeed;
+    }
+  }
+
+  m_chunks.clear();
+  m_movingChunks = 0;
+  chunkSpheres   = std::max(chunkSpheres, 1u);
+  for (uint32_t first = 0; first < m_spheres.size(); first += chunkSpheres) {
+    VolumeChunk chunk{};
+    chunk.first = first;
+    chunk.count =
+        std::min(chunkSpheres, static_cast<uint32_t>(m_spheres.size()) - first);
+    for (uint32_t i = first; i < first + chunk.count && !chunk.moving; ++i) {
+      chunk.moving = nvmath::dot(m_velocities[i], m_velocities[i]) > 0.0f;
+    }
+    m_movingChunks += chunk.moving ? 1 : 0;
+    sortLeaves(chunk);
+    chunk.cost = chunk.builtCost = chunk.rebuiltFrom = proxyCost(chunk);
+    m_chunks.push_back(std::move(chunk));
+  }
+  m_updates.assign(m_chunks.size(), ChunkUpdate::eNone);
+}
+
+const std::vector<ChunkUpdate>& VolumeChunks::advance(float deltaTime) {
+  for (size_t c = 0; c < m_chunks.size(); ++c) {
+    VolumeChunk& chunk = m_chunks[c];
+    m_updates[c]       = ChunkUpdate::eNone;
+    if (!chunk.moving || deltaTime <= 0.0f) {
+      continue;
+    }
+    for (uint32_t i = chunk.first; i < chunk.first + chunk.count; ++i) {
+      m_spheres[i].center += m_velocities[i] * deltaTime;
+    }
+
+    chunk.cost   = proxyCost(chunk);
+    m_updates[c] = ChunkUpdate::eRefit;
+    if (chunk.cost > chunk.builtCost * m_rebuildRatio) {
+      chunk.rebuiltFrom = chunk.cost;
+      sortLeaves(chunk);
+      chunk.cost = chunk.builtCost = proxyCost(chunk);
+      m_updates[c]                 = ChunkUpdate::eRebuild;
+    }
+  }
+  return m_updates;
+}
+
+void VolumeChunks::sortLeaves(VolumeChunk& chunk) const {
+  Box bounds;
+  for (uint32_t i = chunk.first; i < chunk.first + chunk.count; ++i) {
+    bounds.extend(m_spheres[i]);
+  }
+  const nvmath::vec3f extent = bounds.max - bounds.min;
+  const float scale = 1.0f / std::max({extent.x, extent.y, extent.z, 1e-20f});
+
+  std::vector<std::pair<uint32_t, uint32_t>> codes(chunk.count);
+  for (uint32_t i = 0; i < chunk.count; ++i) {
+    const Sphere& sphere = m_spheres[chunk.first + i];
+    codes[i] = {mortonCode((sphere.center - bounds.min) * scale),
+                chunk.first + i};
+  }
+  std::sort(codes.begin(), codes.end());
+  chunk.leafOrder.resize(chunk.count);
+  for (uint32_t i = 0; i < chunk.count; ++i) {
+    chunk.leafOrder[i] = codes[i].second;
+  }
+}
+
+float VolumeChunks::proxyCost(const VolumeChunk& chunk) const {
+  Box bounds;
+  double leaves = 0.0;
+  for (uint32_t first = 0; first < chunk.count; first += kLeafSpheres) {
+    const uint32_t end = std::min(first + kLeafSpheres, chunk.count);
+    Box leaf;
+    for (uint32_t i = first; i < end; ++i) {
+      leaf.extend(m_spheres[chunk.leafOrder[i]]);
+    }
+    leaves += double(leaf.area()) * (end - first);
+    bounds.extend({leaf.min, 0.0f});
+    bounds.extend({leaf.max, 0.0f});
+  }
+  const float area = bounds.area();
+  return area > 0.0f ? static_cast<float>(leaves / area) : 0.0f;
+}
+
+std::vector<VolumeChunksValidationResult> validateVolumeChunks(uint32_t frames,
+                                                               uint32_t seed) {
+  // the moving tenth fills two chunks
+  constexpr uint32_t kSpheres      = 81920;
+  constexpr uint32_t kChunkSpheres = 4096;
+  constexpr float kDeltaTime       = 1.0f / 60.0f;
+  const std::vector<Sphere> cloud =
+      makeGaussianPointCloud(kSpheres, 0.5f, seed);
+
+  // the first tenth of the spheres moves, as the VDB animation does
+  const auto velocitiesOf = [&](const char* scenario) {
+    std::vector<nvmath::vec3f> velocities(kSpheres, nvmath::vec3f(0.0f));
+    if (std::string(scenario) == "static") {
+      return velocities;
+    }
+    std::vector<float> directions(3 * kSpheres / 10);
+    generateUniformFloats(hostRngKey(seed, 1), 0, directions.data(),
+                          directions.size());
+    for (uint32_t i = 0; i < kSpheres / 10; ++i) {
+      velocities[i] = std::string(scenario) == "drift"
+                          ? nvmath::vec3f(1.0f, 0.5f, 0.0f)
+                          : nvmath::vec3f(directions[3 * i] - 0.5f,
+                                          directions[3 * i + 1] - 0.5f,
+                                          directions[3 * i + 2] - 0.5f);
+    }
+    return velocities;
+  };
+
+  std::vector<VolumeChunksValidationResult> results;
+  for (const char* scenario : {"static", "drift", "turbulent"}) {
+    VolumeChunks chunks;
+    chunks.create(cloud, velocitiesOf(scenario), kChunkSpheres);
+
+    VolumeChunksValidationResult result{};
+    result.scenario     = scenario;
+    result.frames       = frames;
+    result.chunks       = chunks.chunkCount();
+    result.movingChunks = chunks.movingChunks();
+    double updatedSpheres = 0.0, gains = 0.0;
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+      const std::vector<Sphere> before = chunks.spheres();
+      std::vector<float> builtCosts(chunks.chunkCount());
+      for (uint32_t c = 0; c < chunks.chunkCount(); ++c) {
+        builtCosts[c] = chunks.chunk(c).builtCost;
+      }
+      const std::vector<ChunkUpdate>& updates = chunks.advance(kDeltaTime);
+
+      for (uint32_t c = 0; c < chunks.chunkCount(); ++c) {
+        const VolumeChunk& chunk = chunks.chunk(c);
+        bool moved               = false;
+        for (uint32_t i = chunk.first; i < chunk.first + chunk.count; ++i) {
+          moved = moved || chunks.spheres()[i].center != before[i].center;
+        }
+        if (moved != (updates[c] != ChunkUpdate::eNone)) {
+          ++result.dirtyErrors;
+        }
+        if (updates[c] == ChunkUpdate::eNone) {
+          continue;
+        }
+        ++result.refits;
+        updatedSpheres += chunk.count;
+        double growth = chunk.cost / builtCosts[c];
+        if (updates[c] == ChunkUpdate::eRebuild) {
+          ++result.rebuilds;
+          growth = chunk.rebuiltFrom / builtCosts[c];
+          gains += chunk.rebuiltFrom / chunk.cost;
+        }
+        result.maxCostGrowth = std::max(result.maxCostGrowth, growth);
+      }
+    }
+    result.refitShare  = updatedSpheres / (double(kSpheres) * frames);
+    result.rebuildGain = result.rebuilds > 0 ? gains / result.rebuilds : 0.0;
+    results.push_back(result);
+  }
+  return results;
+}
+
+bool isVolumeChunksValid(
+    const std::vector<VolumeChunksValidationResult>& results) {
+  return std::all_of(
+      results.begin(), results.end(),
+      [](const VolumeChunksValidationResult& result) {
+        const bool moving = result.scenario != "static";
+        // whole chunks are updated, and only the ones with moving spheres
+        const bool localized =
+            moving ? result.refits == result.movingChunks * result.frames &&
+                         result.refitShare < 0.5
+                   : result.refits == 0;
+        const bool rebuilt = result.scenario == "turbulent"
+                                 ? result.rebuilds > 0 &&
+                                       result.rebuildGain > 1.0
+                                 : result.rebuilds == 0;
+        return result.dirtyErrors == 0 && localized && rebuilt;
+      });
+}
+
+void logVolumeChunks(const std::vector<VolumeChunksValidationResult>& results) {
+  spdlog::info("{:>10} {:>6} {:>6} {:>6} {:>6} {:>8} {:>6} {:>7} {:>6} {:>5}",
+               "scenario", "frames", "chunks", "moving", "refits", "rebuilds",
+               "share", "growth", "gain", "dirty");
+  for (const VolumeChunksValidationResult& result : results) {
+    spdlog::info(
+        "{:>10} {:>6} {:>6} {:>6} {:>6} {:>8} {:>5.1f}% {:>6.2f}x {:>5.2f}x "
+        "{:>5}",
+        result.scenario, result.frames, result.chunks, result.movingChunks,
+        result.refits, result.rebuilds, 100.0 * result.refitShare,
+        result.maxCostGrowth, result.rebuildGain, result.dirtyErrors);
+  }
+}
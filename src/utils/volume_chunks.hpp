@@ -0,0 +1,109 @@
+#ifndef __VOLUME_RESTIR_UTILS_VOLUME_CHUNKS_HPP__
+#define __VOLUME_RESTIR_UTILS_VOLUME_CHUNKS_HPP__
+
+/**
+ * @file volume_chunks.hpp
+ *
+ * @brief Chunks of the VDB spheres with a BLAS each, which the animation
+ * refits only where spheres moved, and the host estimate of when a refit
+ * chunk is worth rebuilding.
+ *
+ *  Chunk c holds the spheres [c * chunkSpheres, (c + 1) * chunkSpheres), so
+ *  that its BLAS reads a slice of the AABB buffer and the chunk instances,
+ *  first in the TLAS, find their spheres by `VOLUME_SPHERE_INDEX`. A frame
+ *  updates the chunks holding a sphere with a velocity and leaves the others
+ *  alone. The host moves those spheres as `anim.comp` does.
+ *
+ *  A refit keeps the tree of the last build and only grows its boxes, so its
+ *  quality drops as the spheres of a leaf move apart. Each chunk keeps a
+ *  proxy of that tree: leaves of `kLeafSpheres` spheres in Morton order at
+ *  the last build. Its SAH cost is the area of the leaf boxes weighted by
+ *  their spheres, over the area of the chunk box. A chunk whose cost grew by
+ *  `rebuildRatio` since its last build is rebuilt instead of refit, and its
+ *  leaves are sorted again.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "shaders/host_device.h"
+
+enum class ChunkUpdate : uint8_t { eNone, eRefit, eRebuild };
+
+struct VolumeChunk {
+  uint32_t first;  // sphere
+  uint32_t count;
+  bool moving;      // holds a sphere with a velocity
+  float builtCost;    // SAH cost of the proxy at the last build
+  float cost;
+  float rebuiltFrom;  // cost that triggered the last rebuild
+  std::vector<uint32_t> leafOrder;  // spheres of the proxy leaves, in order
+};
+
+class VolumeChunks {
+public:
+  static constexpr uint32_t kLeafSpheres = 4;
+
+  /// Chunks of `chunkSpheres` spheres moving by `velocities`, all built
+  void create(std::vector<Sphere> spheres,
+              std::vector<nvmath::vec3f> velocities,
+              uint32_t chunkSpheres = VOLUME_CHUNK_SPHERES,
+              float rebuildRatio    = 1.5f);
+
+  /// Moves the spheres by `deltaTime` seconds of animation and returns the
+  /// update of each chunk; rebuilt chunks start over from their new cost
+  const std::vector<ChunkUpdate>& advance(float deltaTime);
+
+  [[nodiscard]] uint32_t chunkCount() const {
+    return static_cast<uint32_t>(m_chunks.size());
+  }
+  [[nodiscard]] const VolumeChunk& chunk(uint32_t index) const {
+    return m_chunks[index];
+  }
+  [[nodiscard]] const std::vector<Sphere>& spheres() const {
+    return m_spheres;
+  }
+  /// Chunks holding a sphere with a velocity
+  [[nodiscard]] uint32_t movingChunks() const { return m_movingChunks; }
+
+private:
+  void sortLeaves(VolumeChunk& chunk) const;
+  float proxyCost(const VolumeChunk& chunk) const;
+
+  std::vector<Sphere> m_spheres;
+  std::vector<nvmath::vec3f> m_velocities;
+  std::vector<VolumeChunk> m_chunks;
+  std::vector<ChunkUpdate> m_updates;
+  uint32_t m_movingChunks = 0;
+  float m_rebuildRatio    = 1.5f;
+};
+
+struct VolumeChunksValidationResult {
+  std::string scenario;
+  uint32_t frames;
+  uint32_t chunks;
+  uint32_t movingChunks;
+  uint32_t refits;    // chunk updates over all frames
+  uint32_t rebuilds;  // among them
+  double refitShare;  // spheres updated over spheres of whole-volume refits
+  double maxCostGrowth;  // of a chunk since its build, before a rebuild
+  double rebuildGain;    // mean cost before a rebuild over after
+  uint32_t dirtyErrors;  // moved spheres in chunks left alone, or updates of
+                         // chunks that did not move
+};
+
+/// Animates Gaussian clouds as the renderer does: one that does not move,
+/// one whose first tenth drifts apart from the center, and one whose first
+/// tenth explodes, the chunks of the two last ones degrading until rebuilt
+[[nodiscard]] std::vector<VolumeChunksValidationResult> validateVolumeChunks(
+    uint32_t frames = 240, uint32_t seed = 3);
+
+/// False on a dirty error, when spheres that did not move were updated, when
+/// an exploding chunk was never rebuilt or a rebuild did not lower the cost
+[[nodiscard]] bool isVolumeChunksValid(
+    const std::vector<VolumeChunksValidationResult>& results);
+
+void logVolumeChunks(const std::vector<VolumeChunksValidationResult>& results);
+
+#endif /* __VOLUME_RESTIR_UTILS_VOLUME_CHUNKS_HPP__ */